@@ -20,9 +20,23 @@
 // Example constants and database
 #include "CASBACnetSCExampleConstants.h"
 #include "CASBACnetSCExampleDatabase.h"
+#include "CASBACnetSCExamplePropertyTable.h"
+#include "CASBACnetSCExampleLoader.h"
+#include "CASBACnetSCExampleSnapshot.h"
+#include "CASBACnetSCExampleBenchmark.h"
+#include "CASBACnetSCExampleMetrics.h"
+#include "CASBACnetSCExampleMetricsServer.h"
+#include "CASBACnetSCExampleProfiler.h"
+#include "CASBACnetSCExampleTrace.h"
+#include "CASBACnetSCExampleDiscovery.h"
+#include "CASBACnetSCExamplePolling.h"
+#include "CASBACnetSCExampleCOVClient.h"
+#include "CASBACnetSCExampleCommandQueue.h"
 
 // Secure Connection libraries
 #include "WSClient.h"
+#include "WSHubFunction.h"
+#include "WSVirtualDevices.h"
 #include <boost/asio/ssl.hpp>
 #include <boost/beast/core.hpp>
 
@@ -36,10 +50,13 @@
 #include "CIBuildSettings.h"
 
 // System and OS
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <iomanip>
+#include <chrono>
 #include <cstdio>
+#include <thread>
 #ifndef __GNUC__   // Windows
 #include <conio.h> // _kbhit
 #else              // Linux
@@ -72,18 +89,208 @@ ExampleDatabase g_database; // The example database that stores current values.
 
 // Constants
 // ===========================================================================
-const std::string APPLICATION_VERSION = "0.0.3"; // See CHANGELOG.md for a full list of changes.
+const std::string APPLICATION_VERSION = "0.0.4"; // See CHANGELOG.md for a full list of changes.
 const uint32_t MAX_RENDER_BUFFER_LENGTH = 1024 * 20;
 
 // Network Settings and Globals
 // ===========================================================================
 
+// Bytes of the received frames waiting for the stack and of the frames waiting
+// in the write queues of the hub function, over all connections. Each queue is
+// also bounded on its own by WSQueueLimits: a full receive queue stops reading
+// from its socket until the stack catches up, a full hub write queue drops.
+// Declared first so it outlives the connections that use it.
+WSMemoryBudget g_memoryBudget(8 * 1024 * 1024);
+
+// Every BVLC-SC frame sent and received by the hub connections and the hub
+// function is written to this pcap file (link type USER0, a direction byte
+// then the frame), for Wireshark. Written in batches by its own thread. Empty
+// disables it. Declared before the connections so it outlives them.
+const std::string captureFilename = "";
+WSCapture g_capture;
 WSNetworkLayer g_ws_network;
 
+// Hand the TLS record layer of the wss:// hub connections to the Linux kernel
+// (kTLS) after the handshake, where OpenSSL 3 and the "tls" kernel module
+// allow it. A direction the kernel does not take stays in user space, and
+// builds without kTLS always use the Beast SSL stream, see WSTlsStream.h.
+// Not verified yet: the kernel offload has not run, only that fallback has.
+const bool ktlsEnabled = false;
+
+// TLS handshake of the wss:// hub connections, the hub function and the
+// virtual devices, see WSTlsSettings.h. Empty keeps the OpenSSL default. When a
+// hub restarts every node handshakes with it at once: X25519 and an ECDSA P-256
+// certificate key cost the least CPU per connect. The key type is the one of
+// the certificate and key files, see "TLS Handshake" in README.md.
+const std::string tlsGroups = "";
+const std::string tlsCiphersuites = "";
+const std::string tlsSignatureAlgorithms = "";
+const std::string certificateFilename = "./cert.pem";
+const std::string keyFilename = "./key.key";
+
 // ToDo: replace with the uri of the BACnet SC Hub device
 const std::string primaryHubUri = "wss://192.168.1.84:4443/";
 const std::string failoverHubUri = "wss://192.168.1.84:4444/";
 
+// Changes of value are collected for this long before they are reported to the
+// CAS BACnet Stack. Several changes to one object within the window are sent once.
+const uint32_t covCoalesceWindowMilliseconds = 100;
+std::vector<ExampleCOVChange> g_covChanges;
+
+// The properties of an object are requested one after the other, see ExampleObjectCache.
+// The objects of a ReadPropertyMultiple are looked up when it is received, see ExamplePropertyBatch.
+ExampleObjectCache g_objectCache;
+ExamplePropertyBatch g_propertyBatch;
+
+// Present values and reliability are saved to this file and restored at startup
+const std::string snapshotFile = "BACnetSCExampleSnapshot.bin";
+const uint32_t snapshotIntervalSeconds = 10;
+ExampleSnapshot g_snapshot;
+
+// The main loop sleeps until the next point update is due, but at most this
+// long so network messages are still handled promptly
+const uint32_t mainLoopMaxSleepMilliseconds = 5;
+
+// Optional hub function. When enabled this application also acts as a BACnet SC Hub
+// that other nodes can connect to. Point primaryHubUri at it (e.g. "wss://127.0.0.1:4443/")
+// to have this device connect to its own hub.
+const bool hubFunctionEnabled = false;
+const uint16_t hubFunctionPort = 4443;
+WSHubFunction g_hub;
+
+// Optional virtual devices, e.g. the downstream controllers of a gateway. Each
+// one connects to primaryHubUri with its own UUID and VMAC and answers Who-Is
+// and reads of its Analog Inputs itself, without the CAS BACnet Stack. All of
+// them share two transport threads and one TLS context. 0 disables them. The
+// 'i' key prints their state.
+const uint32_t virtualDeviceCount = 0;
+const uint32_t virtualDeviceFirstInstance = 390000;
+const uint32_t virtualDeviceAnalogInputs = 10;
+WSVirtualDevices g_virtualDevices;
+
+// Metrics of the websocket connections and the main loop. Printed with the 's'
+// key and, when enabled, served for Prometheus at http://127.0.0.1:9464/metrics
+const bool metricsServerEnabled = true;
+const std::string metricsServerAddress = "127.0.0.1";
+const uint16_t metricsServerPort = 9464;
+ExampleMetricsRegistry g_metrics;
+ExampleMetricsServer g_metricsServer;
+ExampleMetricHistogram* g_fpLoopDuration = NULL;
+ExampleMetricCounter* g_covReported = NULL;
+ExampleMetricGauge* g_covPending = NULL;
+ExampleMetricGauge* g_timerCount = NULL;
+
+// Profiler of the main loop and the callbacks. The 'p' key prints the report of
+// the time since the last one. Iterations slower than
+// profilerSlowIterationMicroseconds are printed with the time of each section.
+const bool profilerEnabled = true;
+const uint32_t profilerSlowIterationMicroseconds = 50000;
+ExampleProfiler g_profiler;
+
+// Message lifecycle tracer. One in traceSampleInterval received frames is
+// followed through the receive queue, the stack and the reply write. The 't'
+// key writes the last traceMaxMessages messages to traceFilename, open it in
+// chrome://tracing or ui.perfetto.dev.
+const bool traceEnabled = true;
+const uint32_t traceSampleInterval = 16;
+const uint32_t traceMaxMessages = 10000;
+const std::string traceFilename = "BACnetSCExampleTrace.json";
+ExampleMessageTracer g_tracer;
+
+// Device discovery. The 'w' key sweeps the instance space with ranged Who-Is
+// instead of one global Who-Is that every device on the hub answers at once.
+// The 'd' key prints the devices found.
+ExampleDiscovery g_discovery;
+uint16_t g_discoveryMessageId = 0;
+
+// Polling of remote points. The 'o' key polls the Present Value of Analog
+// Input 0 in every device discovered, every pollPeriodMilliseconds, with
+// ReadPropertyMultiple requests built here. The answers are consumed by
+// g_poller and not given to the CAS BACnet Stack. The 'v' key prints them.
+const uint32_t pollPeriodMilliseconds = 1000;
+ExamplePoller g_poller;
+
+// Invoke IDs of the confirmed requests of g_poller and g_covClient, so an
+// answer is taken by the client that sent the request
+ExampleInvokeIds g_invokeIds;
+
+// COV subscriptions to remote objects. The 'c' key subscribes to Analog Input 0
+// in every device discovered; objects that cannot be subscribed are polled.
+// The notifications are consumed by g_covClient. The 'u' key prints the values.
+ExampleCOVClient g_covClient;
+
+// The CAS BACnet Stack runs on its own thread, RunStack(). Every fp* call and
+// every stack callback happens there. Other threads hand it work through
+// g_stackCommands: the keyboard on the main thread here, a UI, field drivers
+// or a REST API in a real application.
+ExampleCommandQueue g_stackCommands;
+const size_t stackCommandsPerLoop = 64;         // Run between two fpLoop() calls
+const uint32_t keyboardPollMilliseconds = 20;
+bool g_stackRunning = true;                     // Stack thread only
+
+// Sections timed by g_profiler, the index in profilerSectionNames
+const uint32_t PROFILE_FPLOOP = 0;
+const uint32_t PROFILE_DATABASE_LOOP = 1;
+const uint32_t PROFILE_COV_FLUSH = 2;
+const uint32_t PROFILE_SNAPSHOT_SAVE = 3;
+const uint32_t PROFILE_RECEIVE_MESSAGE = 4;
+const uint32_t PROFILE_RECV_WS_MESSAGE = 5;
+const uint32_t PROFILE_SEND_MESSAGE = 6;
+const uint32_t PROFILE_SEND_WS_MESSAGE = 7;
+const uint32_t PROFILE_DECODE_AS_XML = 8;
+const uint32_t PROFILE_GET_SYSTEM_TIME = 9;
+const uint32_t PROFILE_LOG_DEBUG_MESSAGE = 10;
+const uint32_t PROFILE_GET_PROPERTY_BIT_STRING = 11;
+const uint32_t PROFILE_GET_PROPERTY_BOOL = 12;
+const uint32_t PROFILE_GET_PROPERTY_CHAR_STRING = 13;
+const uint32_t PROFILE_GET_PROPERTY_DATE = 14;
+const uint32_t PROFILE_GET_PROPERTY_DOUBLE = 15;
+const uint32_t PROFILE_GET_PROPERTY_ENUMERATED = 16;
+const uint32_t PROFILE_GET_PROPERTY_OCTET_STRING = 17;
+const uint32_t PROFILE_GET_PROPERTY_SIGNED_INTEGER = 18;
+const uint32_t PROFILE_GET_PROPERTY_REAL = 19;
+const uint32_t PROFILE_GET_PROPERTY_TIME = 20;
+const uint32_t PROFILE_GET_PROPERTY_UNSIGNED_INTEGER = 21;
+const uint32_t PROFILE_SET_PROPERTY_ENUMERATED = 22;
+const uint32_t PROFILE_SET_PROPERTY_NULL = 23;
+const uint32_t PROFILE_SET_PROPERTY_REAL = 24;
+const uint32_t PROFILE_SET_PROPERTY_UNSIGNED_INTEGER = 25;
+const uint32_t PROFILE_INITIATE_WEBSOCKET = 26;
+const uint32_t PROFILE_DISCONNECT_WEBSOCKET = 27;
+const uint32_t PROFILE_COMMANDS = 28;
+const uint32_t PROFILE_SECTION_COUNT = 29;
+const char* const profilerSectionNames[PROFILE_SECTION_COUNT] = {
+    "fpLoop",
+    "ExampleDatabase::Loop",
+    "COV flush and fpValueUpdated",
+    "ExampleSnapshot::Save",
+    "CallbackReceiveMessage",
+    "WSNetworkLayer::RecvWSMessage",
+    "CallbackSendMessage",
+    "WSNetworkLayer::SendWSMessage",
+    "fpDecodeAsXML and print",
+    "CallbackGetSystemTime",
+    "CallbackLogDebugMessage",
+    "CallbackGetPropertyBitString",
+    "CallbackGetPropertyBool",
+    "CallbackGetPropertyCharString",
+    "CallbackGetPropertyDate",
+    "CallbackGetPropertyDouble",
+    "CallbackGetPropertyEnumerated",
+    "CallbackGetPropertyOctetString",
+    "CallbackGetPropertySignedInteger",
+    "CallbackGetPropertyReal",
+    "CallbackGetPropertyTime",
+    "CallbackGetPropertyUnsignedInteger",
+    "CallbackSetPropertyEnumerated",
+    "CallbackSetPropertyNull",
+    "CallbackSetPropertyReal",
+    "CallbackSetPropertyUnsignedInteger",
+    "CallbackInitiateWebsocket",
+    "CallbackDisconnectWebsocket",
+    "ExampleCommandQueue::Run"
+};
+
 // Callback Functions to Register to the DLL
 // ===========================================================================
 // Message Functions
@@ -95,19 +302,64 @@ time_t CallbackGetSystemTime();
 void CallbackLogDebugMessage(const char *message, const uint16_t messageLength, const uint8_t messageType);
 
 // Get Property Functions
+bool CallbackGetPropertyBitString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool *value, uint32_t *valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool *value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
 bool CallbackGetPropertyCharString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, char *value, uint32_t *valueElementCount, const uint32_t maxElementCount, uint8_t *encodingType, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyDate(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t *year, uint8_t *month, uint8_t *day, uint8_t *weekday, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyDouble(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, double *value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyEnumerated(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t *value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyOctetString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t *value, uint32_t *valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertySignedInteger(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, int32_t *value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
 bool CallbackGetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float *value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyTime(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t *hour, uint8_t *minute, uint8_t *second, uint8_t *hundrethSeconds, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyUnsignedInteger(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t *value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+
+// Set Property Functions
+bool CallbackSetPropertyEnumerated(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode);
+bool CallbackSetPropertyNull(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode);
+bool CallbackSetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode);
+bool CallbackSetPropertyUnsignedInteger(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode);
 
 // Websocket Callbacks
 bool CallbackInitiateWebsocket(const char* websocketUri, const uint32_t websocketUriLength);
 void CallbackDisconnectWebsocket(const char* websocketUri, const uint32_t websocketUriLength);
 
 // Helper Functions
-bool DoUserInput();
+bool DoUserInput(const char action);
+void RunStack();
+uint64_t GetMilliseconds();
+void SendWhoIs(const uint32_t low, const uint32_t high);
 
 // A simple BACnetServerExample in CPP that uses secure connection
 // ===========================================================================
 int main(int argc, char **argv) {
+    // Benchmarks do not need the CAS BACnet Stack or a hub
+    // ---------------------------------------------------------------------------
+    if (argc >= 2 && std::string(argv[1]) == "--benchmark") {
+        return ExampleBenchmark::Run(argc - 2, argv + 2);
+    }
+
+    // Convert a CSV point list to a binary point file
+    // ---------------------------------------------------------------------------
+    if (argc >= 2 && std::string(argv[1]) == "--import") {
+        if (argc < 4) {
+            std::cerr << "Usage: BACnetSCExampleCPP --import <points.csv> <points.bin>" << std::endl;
+            return EXIT_FAILURE;
+        }
+        size_t objectCount = 0;
+        if (!ExampleDatabaseLoader::ImportCSV(argv[2], argv[3], &objectCount)) {
+            return EXIT_FAILURE;
+        }
+        std::cout << "Imported " << objectCount << " objects to [" << argv[3] << "]" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    // Optional binary point file that replaces the example objects
+    std::string pointFile;
+    if (argc >= 3 && std::string(argv[1]) == "--points") {
+        pointFile = argv[2];
+    }
+
     // Print the application version information
     // ---------------------------------------------------------------------------
     std::cout << "BACnetSecureConnectExampleCPP v" << APPLICATION_VERSION << std::endl;
@@ -136,8 +388,23 @@ int main(int argc, char **argv) {
     fpRegisterCallbackLogDebugMessage(CallbackLogDebugMessage);
 
     // Get Property callback functions
+    fpRegisterCallbackGetPropertyBitString(CallbackGetPropertyBitString);
+    fpRegisterCallbackGetPropertyBool(CallbackGetPropertyBool);
     fpRegisterCallbackGetPropertyCharacterString(CallbackGetPropertyCharString);
+    fpRegisterCallbackGetPropertyDate(CallbackGetPropertyDate);
+    fpRegisterCallbackGetPropertyDouble(CallbackGetPropertyDouble);
+    fpRegisterCallbackGetPropertyEnumerated(CallbackGetPropertyEnumerated);
+    fpRegisterCallbackGetPropertyOctetString(CallbackGetPropertyOctetString);
+    fpRegisterCallbackGetPropertySignedInteger(CallbackGetPropertySignedInteger);
     fpRegisterCallbackGetPropertyReal(CallbackGetPropertyReal);
+    fpRegisterCallbackGetPropertyTime(CallbackGetPropertyTime);
+    fpRegisterCallbackGetPropertyUnsignedInteger(CallbackGetPropertyUnsignedInteger);
+
+    // Set Property callback functions, for the commandable objects
+    fpRegisterCallbackSetPropertyEnumerated(CallbackSetPropertyEnumerated);
+    fpRegisterCallbackSetPropertyNull(CallbackSetPropertyNull);
+    fpRegisterCallbackSetPropertyReal(CallbackSetPropertyReal);
+    fpRegisterCallbackSetPropertyUnsignedInteger(CallbackSetPropertyUnsignedInteger);
 
     // Websocket callback functions
     fpRegisterCallbackInitiateWebsocket(CallbackInitiateWebsocket);
@@ -154,17 +421,124 @@ int main(int argc, char **argv) {
     }
     std::cout << "Created Device." << std::endl;
 
+    // Load the point database
+    // ---------------------------------------------------------------------------
+    if (!pointFile.empty()) {
+        std::cout << "Loading points from [" << pointFile << "]..." << std::endl;
+        g_database.objects.Clear();
+        ExampleLoadReport loadReport;
+        if (!ExampleDatabaseLoader::Load(pointFile, &g_database.objects, &loadReport)) {
+            std::cerr << "Failed to load the point file" << std::endl;
+            return -1;
+        }
+        loadReport.Print();
+    }
+
+    // Restore the values saved by the last run
+    std::chrono::steady_clock::time_point restoreStart = std::chrono::steady_clock::now();
+    if (g_snapshot.Open(snapshotFile, g_database.objects) && g_snapshot.Restore(&g_database.objects)) {
+        std::cout << "Restored snapshot generation " << g_snapshot.GetGeneration() << " in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - restoreStart).count() << " ms" << std::endl;
+    }
+    g_database.cov.Initialize(&g_database.objects);
+    g_database.cov.SetWindow(covCoalesceWindowMilliseconds);
+    g_database.ScheduleUpdates((uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
     // Add objects
     // ---------------------------------------------------------------------------
-    // AnalogInput (AI)
-    std::cout << "Adding AnalogInput. analogInput.instance=[" << g_database.analogInput.instance << "]... ";
-    if (!fpAddObject(g_database.device.instance, CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, g_database.analogInput.instance)) {
-        std::cerr << "Failed to add AnalogInput" << std::endl;
-        return -1;
+    // Every object in the object store, one table per object type. Properties
+    // are enabled once per object type, not per object.
+    std::chrono::steady_clock::time_point registerStart = std::chrono::steady_clock::now();
+    for (const ExampleObjectTable& table : g_database.objects.tables) {
+        std::cout << "Adding " << table.Size() << " objects of objectType=[" << table.objectType << "]... ";
+        for (uint32_t row = 0; row < table.Size(); row++) {
+            if (!fpAddObject(g_database.device.instance, table.objectType, table.instance[row])) {
+                std::cerr << "Failed to add objectType=[" << table.objectType << "], objectInstance=[" << table.instance[row] << "]" << std::endl;
+                return -1;
+            }
+            if (table.commandable) {
+                // Required writable for outputs, optional for values
+                fpSetPropertyWritable(g_database.device.instance, table.objectType, table.instance[row], CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, true);
+            }
+        }
+        if (table.commandable) {
+            fpSetPropertyByObjectTypeEnabled(g_database.device.instance, table.objectType, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY, true);
+            fpSetPropertyByObjectTypeEnabled(g_database.device.instance, table.objectType, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, true);
+        }
+        std::cout << "OK" << std::endl;
     }
     // Enable Reliability property
     fpSetPropertyByObjectTypeEnabled(g_database.device.instance, CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, true);
-    std::cout << "OK" << std::endl;
+    // Enable SubscribeCOV, changes are reported by the COV engine
+    fpSetServiceEnabled(g_database.device.instance, CASBACnetStackExampleConstants::SERVICE_SUBSCRIBE_COV, true);
+    // Enable WriteProperty, to command and relinquish the commandable objects
+    fpSetServiceEnabled(g_database.device.instance, CASBACnetStackExampleConstants::SERVICE_WRITE_PROPERTY, true);
+    std::cout << "Registered " << g_database.objects.GetObjectCount() << " objects in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - registerStart).count() << " ms" << std::endl;
+
+    // The clients of remote devices share the invoke IDs of the hub connection
+    g_poller.SetInvokeIds(&g_invokeIds);
+    g_covClient.SetInvokeIds(&g_invokeIds);
+
+    // Setup the metrics and the profiler
+    // ---------------------------------------------------------------------------
+    if (profilerEnabled) {
+        g_profiler.Initialize(profilerSectionNames, PROFILE_SECTION_COUNT, profilerSlowIterationMicroseconds);
+    }
+    if (traceEnabled) {
+        g_tracer.Initialize(traceSampleInterval, traceMaxMessages);
+    }
+    g_ws_network.SetMetrics(&g_metrics);
+    g_ws_network.SetQueueLimits(WSQueueLimits(), &g_memoryBudget);
+    // A received frame wakes the stack thread, so fpLoop() reads it without waiting for the next timer
+    g_ws_network.SetOnReceive([] { g_stackCommands.Wake(); });
+    std::cout << "Network backend: " << WSGetNetworkBackend() << std::endl;
+    g_ws_network.SetKtls(ktlsEnabled);
+    WSTlsSettings tlsSettings;
+    tlsSettings.groups = tlsGroups;
+    tlsSettings.ciphersuites = tlsCiphersuites;
+    tlsSettings.signatureAlgorithms = tlsSignatureAlgorithms;
+    g_ws_network.SetTlsSettings(tlsSettings);
+    if (captureFilename.size() > 0) {
+        std::cout << "Capturing frames to " << captureFilename << "... ";
+        if (!g_capture.Open(captureFilename)) {
+            // Not fatal, the connections run without a capture
+            std::cerr << "Failed to open the capture file" << std::endl;
+        }
+        else {
+            g_ws_network.SetCapture(&g_capture);
+            g_hub.SetCapture(&g_capture);
+            std::cout << "OK" << std::endl;
+        }
+    }
+    g_metrics.AddFunction("bacnet_sc_memory_budget_bytes", "Bytes of queued frames held against the memory budget", ExampleMetricsRegistry::TYPE_GAUGE, [] { return (double)g_memoryBudget.GetUsed(); });
+    g_fpLoopDuration = g_metrics.AddHistogram("bacnet_sc_fploop_duration_seconds", "Time spent in one call of fpLoop()");
+    g_covReported = g_metrics.AddCounter("bacnet_sc_cov_reported_total", "Changes of value reported to the CAS BACnet Stack");
+    g_covPending = g_metrics.AddGauge("bacnet_sc_cov_pending", "Objects changed and waiting for the end of the COV coalescing window");
+    g_timerCount = g_metrics.AddGauge("bacnet_sc_timers", "Point update and Trend Log timers scheduled");
+    if (hubFunctionEnabled) {
+        // The hub statistics are atomics, they are read when the metrics are rendered
+        g_metrics.AddFunction("bacnet_sc_hub_connections", "Nodes connected to the hub function", ExampleMetricsRegistry::TYPE_GAUGE, [] { return (double)g_hub.connectionCount.load(); });
+        g_metrics.AddFunction("bacnet_sc_hub_frames_received_total", "Frames received by the hub function", ExampleMetricsRegistry::TYPE_COUNTER, [] { return (double)g_hub.framesReceived.load(); });
+        g_metrics.AddFunction("bacnet_sc_hub_unicast_forwarded_total", "Unicast frames forwarded by the hub function", ExampleMetricsRegistry::TYPE_COUNTER, [] { return (double)g_hub.unicastForwarded.load(); });
+        g_metrics.AddFunction("bacnet_sc_hub_broadcast_deliveries_total", "Broadcast frames queued to nodes by the hub function", ExampleMetricsRegistry::TYPE_COUNTER, [] { return (double)g_hub.broadcastDeliveries.load(); });
+        g_metrics.AddFunction("bacnet_sc_hub_frames_dropped_total", "Frames dropped by the hub function", ExampleMetricsRegistry::TYPE_COUNTER, [] { return (double)g_hub.framesDropped.load(); });
+        for (uint8_t reason = 0; reason < WS_DROP_REASON_COUNT; reason++) {
+            g_metrics.AddFunction("bacnet_sc_hub_queue_drops_total", "Frames dropped by the write queues of the hub function, by reason", ExampleMetricsRegistry::TYPE_COUNTER, [reason] { return (double)g_hub.queueDrops.Get(reason); }, ExampleMetricsRegistry::Label("reason", WSDropCounters::GetReasonName(reason)));
+        }
+    }
+    if (virtualDeviceCount > 0) {
+        g_metrics.AddFunction("bacnet_sc_virtual_devices_connected", "Virtual devices connected to the hub", ExampleMetricsRegistry::TYPE_GAUGE, [] { return (double)g_virtualDevices.connectedCount.load(); });
+        g_metrics.AddFunction("bacnet_sc_virtual_devices_requests_total", "Requests answered by the virtual devices", ExampleMetricsRegistry::TYPE_COUNTER, [] { return (double)g_virtualDevices.requestsAnswered.load(); });
+    }
+    if (metricsServerEnabled) {
+        std::cout << "Starting metrics endpoint on http://" << metricsServerAddress << ":" << metricsServerPort << "/metrics... ";
+        if (!g_metricsServer.Start(metricsServerAddress, metricsServerPort, &g_metrics)) {
+            // Not fatal, the metrics can still be printed with the 's' key
+            std::cerr << "Failed to start the metrics endpoint" << std::endl;
+        }
+        else {
+            std::cout << "OK" << std::endl;
+        }
+    }
 
     // Setup BACnet SC
     // ---------------------------------------------------------------------------
@@ -177,6 +551,24 @@ int main(int argc, char **argv) {
     }
     std::cout << "OK" << std::endl;
 
+    // Start the hub function
+    if (hubFunctionEnabled) {
+        // The hub function has its own VMAC, it shares the UUID of this device
+        const uint8_t hubVmac[BACnetSCConstants::BACNET_SC_VMAC_LENGTH] = { 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A };
+        std::cout << "Starting hub function on port " << hubFunctionPort << "... ";
+        // A small socket send buffer keeps a backlog in the write queues, where
+        // heartbeats and answers go ahead of broadcasts
+        WSQueueLimits hubLimits;
+        hubLimits.socketSendBufferBytes = 64 * 1024;
+        g_hub.SetQueueLimits(hubLimits, &g_memoryBudget);
+        g_hub.SetTlsSettings(tlsSettings);
+        if (!g_hub.Start("0.0.0.0", hubFunctionPort, hubVmac, uuid, certificateFilename, keyFilename)) {
+            std::cerr << "Failed to start the hub function" << std::endl;
+            return -1;
+        }
+        std::cout << "OK" << std::endl;
+    }
+
     std::cout << "Setting up HubConnector... " << std::endl;
     // BACnet SC VMAC for this device is a local matter, must be unique on the BACnet SC network.
     const uint8_t vmac[BACnetSCConstants::BACNET_SC_VMAC_LENGTH] = { 0x09, 0x09, 0x09, 0x09 , 0x09 , 0x09 };
@@ -188,54 +580,249 @@ int main(int argc, char **argv) {
     }
     std::cout << "OK" << std::endl;
 
-    // Start the main loop
+    // Start the virtual devices
+    if (virtualDeviceCount > 0) {
+        std::cout << "Starting " << virtualDeviceCount << " virtual devices... ";
+        for (uint32_t offset = 0; offset < virtualDeviceCount; offset++) {
+            // Locally administered VMAC, and the UUID of this device with the instance in the last bytes
+            uint32_t instance = virtualDeviceFirstInstance + offset;
+            uint8_t virtualVmac[BVLC_SC_VMAC_LENGTH] = { 0x02, 0x00, (uint8_t)(instance >> 24), (uint8_t)(instance >> 16), (uint8_t)(instance >> 8), (uint8_t)instance };
+            uint8_t virtualUuid[BVLC_SC_UUID_LENGTH];
+            memcpy(virtualUuid, uuid, BVLC_SC_UUID_LENGTH);
+            memcpy(virtualUuid + BVLC_SC_UUID_LENGTH - 4, virtualVmac + 2, 4);
+            size_t position = g_virtualDevices.Add(instance, virtualVmac, virtualUuid, virtualDeviceAnalogInputs);
+            for (uint32_t object = 0; object < virtualDeviceAnalogInputs; object++) {
+                g_virtualDevices.SetPresentValue(position, object, (float)object);
+            }
+        }
+        g_virtualDevices.SetTlsSettings(tlsSettings);
+        if (!g_virtualDevices.Start(primaryHubUri, certificateFilename, keyFilename)) {
+            std::cerr << "Failed to start the virtual devices" << std::endl;
+            return -1;
+        }
+        std::cout << "OK" << std::endl;
+    }
+
+    // Start the stack thread
     // ---------------------------------------------------------------------------
+    // Everything above ran before the thread exists. From here on only the
+    // stack thread calls the stack and touches the database.
     std::cout << "FYI: Entering main loop..." << std::endl;
-    for (;;) {
-        fpLoop();
+    std::thread stackThread(RunStack);
 
-        // Handle User Input
-        if (!DoUserInput()) {
+    // The keyboard is read on this thread and the keys handled on the stack thread
+    for (;;) {
+        if (!_kbhit()) {
+            Sleep(keyboardPollMilliseconds);
+            continue;
+        }
+        // Extract the letter that the user hit and convert it to lower case
+        char action = (char)tolower(getchar());
+        if (!g_stackCommands.Submit([action] { return DoUserInput(action); }).get()) {
             // User press 'q' to quit the example application.
             break;
         }
+    }
+    stackThread.join();
+    g_virtualDevices.Stop();
 
-        g_database.Loop();   // Increment Analog Input object Present Value property
-
-        // Call Sleep to give some time back to the system
-        Sleep(0); // Windows
+    // Keep the latest values for the next start
+    if (g_snapshot.IsOpen()) {
+        g_snapshot.Save(g_database.objects, (uint64_t)time(0));
     }
     return EXIT_SUCCESS;
 }
 
+// Stack Thread
+// ===========================================================================
+// The main loop: the commands posted by other threads, fpLoop() and the work
+// of the example, then sleep until the next timer is due, a command is posted
+// or a frame is received.
+void RunStack() {
+    time_t lastSnapshot = time(0);
+    while (g_stackRunning) {
+        g_profiler.BeginIteration();
+        std::chrono::steady_clock::time_point loopStart = std::chrono::steady_clock::now();
+        {
+            ExampleProfilerScope profile(&g_profiler, PROFILE_FPLOOP);
+            fpLoop();
+        }
+        g_fpLoopDuration->Observe((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - loopStart).count());
+
+        // Commands from the other threads, the keys pressed among them
+        {
+            ExampleProfilerScope profile(&g_profiler, PROFILE_COMMANDS);
+            g_stackCommands.Run(stackCommandsPerLoop);
+        }
+
+        uint64_t nowMilliseconds = GetMilliseconds();
+
+        // Send the Who-Is of the discovery sweep that are due
+        uint32_t whoIsLow;
+        uint32_t whoIsHigh;
+        while (g_discovery.Poll(nowMilliseconds, &whoIsLow, &whoIsHigh)) {
+            SendWhoIs(whoIsLow, whoIsHigh);
+        }
+
+        // Send the polling requests that are due, within their windows
+        uint8_t pollFrame[APDU_MAX_LENGTH + 64];
+        size_t pollFrameLength;
+        while (g_poller.Poll(nowMilliseconds, pollFrame, sizeof(pollFrame), &pollFrameLength)) {
+            uint8_t errorCode = 0;
+            if (g_ws_network.SendWSMessage(primaryHubUri, pollFrame, (uint16_t)pollFrameLength, &errorCode) == 0) {
+                std::cout << "Polling: request not sent, errorCode=" << (int)errorCode << std::endl;
+            }
+        }
+        while (g_covClient.Poll(nowMilliseconds, pollFrame, sizeof(pollFrame), &pollFrameLength)) {
+            uint8_t errorCode = 0;
+            if (g_ws_network.SendWSMessage(primaryHubUri, pollFrame, (uint16_t)pollFrameLength, &errorCode) == 0) {
+                std::cout << "COV client: request not sent, errorCode=" << (int)errorCode << std::endl;
+            }
+        }
+
+        {
+            ExampleProfilerScope profile(&g_profiler, PROFILE_DATABASE_LOOP);
+            g_database.Loop(nowMilliseconds);   // Increment Analog Input object Present Value property
+        }
+
+        // Report the objects that changed by more than their COV increment
+        g_covChanges.clear();
+        {
+            ExampleProfilerScope profile(&g_profiler, PROFILE_COV_FLUSH);
+            if (g_database.cov.Flush(nowMilliseconds, &g_covChanges) > 0) {
+                for (const ExampleCOVChange& change : g_covChanges) {
+                    fpValueUpdated(g_database.device.instance, change.objectType, change.instance, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+                }
+                g_covReported->Add(g_covChanges.size());
+            }
+        }
+        g_covPending->Set((int64_t)g_database.cov.GetDirtyCount());
+        g_timerCount->Set((int64_t)g_database.timers.GetCount());
+
+        // Save the values for a warm restart
+        if (g_snapshot.IsOpen() && time(0) >= lastSnapshot + snapshotIntervalSeconds) {
+            lastSnapshot = time(0);
+            ExampleProfilerScope profile(&g_profiler, PROFILE_SNAPSHOT_SAVE);
+            g_snapshot.Save(g_database.objects, (uint64_t)lastSnapshot);
+        }
+        g_profiler.EndIteration();
+
+        // Give some time back to the system, until the next timer is due, a command is posted or a frame is received
+        uint64_t nextDeadline = std::min(std::min(g_database.timers.GetNextDeadline(), g_discovery.GetNextDeadline()), std::min(g_poller.GetNextDeadline(), g_covClient.GetNextDeadline()));
+        g_stackCommands.Wait(nextDeadline > nowMilliseconds ? (uint32_t)std::min<uint64_t>(nextDeadline - nowMilliseconds, mainLoopMaxSleepMilliseconds) : 0);
+    }
+}
+
 // Helper Functions
 // ===========================================================================
 
 // Handle User Input
 // Note: User input in this example is used for the following:
 //		h - Display options
-//      w - send Who-is broadcast
+//      w - discover the devices with a Who-Is sweep
+//      d - print the devices discovered
+//      o - poll Analog Input 0 in the devices discovered
+//      v - print the values polled
+//      c - subscribe to Analog Input 0 in the devices discovered
+//      u - print the values subscribed to
+//      r - print the newest records of the first Trend Log
+//      s - print the metrics
+//      p - print the profiler report since the last one
+//      i - print the state of the virtual devices
+//      t - write the message trace
 //		q - Quit
-bool DoUserInput() {
-    // Check to see if the user hit any key
-    if (!_kbhit()) {
-        // No keys have been hit
-        return true;
-    }
-
-    // Extract the letter that the user hit and convert it to lower case
-    char action = tolower(getchar());
-
+// Runs on the stack thread, main() reads the key.
+bool DoUserInput(const char action) {
     // Handle the action 
     switch (action) {
         // Quit
     case 'q': {
+        g_stackRunning = false;
         return false;
     }
-        // Send Who-is
+        // Discover the devices, in ranges of instances
     case 'w': {
-        size_t uriLength = primaryHubUri.size();
-        fpSendWhoIs((const uint8_t*)primaryHubUri.c_str(), primaryHubUri.size(), CASBACnetStackExampleConstants::NETWORK_TYPE_SC, true, 0, NULL, 0);
+        g_discovery.Start(0, APDU_MAX_INSTANCE, GetMilliseconds());
+        std::cout << "Discovery: sweep started, " << g_discovery.GetDevices().Size() << " devices known" << std::endl;
+        break;
+    }
+        // Print the devices discovered
+    case 'd': {
+        g_discovery.Print();
+        break;
+    }
+        // Poll the Present Value of Analog Input 0 in every device discovered
+    case 'o': {
+        g_poller.Reset(GetMilliseconds());
+        const ExampleDeviceTable& devices = g_discovery.GetDevices();
+        for (size_t position = 0; position < devices.Size(); position++) {
+            const ExampleDiscoveredDevice& device = devices.Get(position);
+            g_poller.AddDevice(device.instance, device.vmac, device.maxApdu);
+            g_poller.AddPoint(device.instance, CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, 0, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, pollPeriodMilliseconds);
+        }
+        std::cout << "Polling: " << g_poller.GetPointCount() << " points in " << g_poller.GetDeviceCount() << " devices" << std::endl;
+        break;
+    }
+        // Print the values polled
+    case 'v': {
+        g_poller.Print();
+        break;
+    }
+        // Subscribe to COV of Analog Input 0 in every device discovered
+    case 'c': {
+        g_covClient.Reset(GetMilliseconds());
+        const ExampleDeviceTable& devices = g_discovery.GetDevices();
+        for (size_t position = 0; position < devices.Size(); position++) {
+            const ExampleDiscoveredDevice& device = devices.Get(position);
+            g_covClient.Add(device.instance, device.vmac, device.maxApdu, CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, 0);
+        }
+        std::cout << "COV client: subscribing to " << g_covClient.Size() << " objects" << std::endl;
+        break;
+    }
+        // Print the values subscribed to
+    case 'u': {
+        g_covClient.Print();
+        break;
+    }
+        // Print a Trend Log
+    case 'r': {
+        if (g_database.trendLogs.empty()) {
+            std::cout << "No Trend Logs" << std::endl;
+            break;
+        }
+        // ReadRange by position, the 10 newest records
+        const ExampleDatabaseTrendLog& trendLog = g_database.trendLogs[0];
+        std::vector<ExampleTrendLogRecord> records;
+        trendLog.buffer.ReadByPosition((uint32_t)trendLog.buffer.GetRecordCount(), -10, &records);
+        std::cout << trendLog.objectName << ": recordCount=" << trendLog.buffer.GetRecordCount() << ", totalRecordCount=" << trendLog.buffer.GetTotalRecordCount() << std::endl;
+        for (const ExampleTrendLogRecord& record : records) {
+            std::cout << "  sequence=" << record.sequence << ", timestamp=" << record.timestamp << ", value=" << record.value << std::endl;
+        }
+        break;
+    }
+        // Print the metrics
+    case 's': {
+        std::string text;
+        g_metrics.Render(&text);
+        std::cout << text;
+        break;
+    }
+        // Print the profiler report
+    case 'p': {
+        g_profiler.Print();
+        g_profiler.Reset();
+        break;
+    }
+        // Print the state of the virtual devices
+    case 'i': {
+        g_virtualDevices.Print();
+        break;
+    }
+        // Write the message trace
+    case 't': {
+        if (g_tracer.Write(traceFilename)) {
+            std::cout << "Wrote " << g_tracer.GetMessageCount() << " messages to " << traceFilename << std::endl;
+        }
         break;
     }
     case 'h':
@@ -247,7 +834,17 @@ bool DoUserInput() {
         // Print the user actions
         std::cout << "=================================" << std::endl;
         std::cout << "User Actions:" << std::endl;
-        std::cout << "\tw - Send Who-is" << std::endl;
+        std::cout << "\tw - Discover the devices with a Who-Is sweep" << std::endl;
+        std::cout << "\td - Print the devices discovered" << std::endl;
+        std::cout << "\to - Poll Analog Input 0 in the devices discovered" << std::endl;
+        std::cout << "\tv - Print the values polled" << std::endl;
+        std::cout << "\tc - Subscribe to Analog Input 0 in the devices discovered" << std::endl;
+        std::cout << "\tu - Print the values subscribed to" << std::endl;
+        std::cout << "\tr - Print the newest records of the first Trend Log" << std::endl;
+        std::cout << "\ts - Print the metrics" << std::endl;
+        std::cout << "\tp - Print the profiler report since the last one" << std::endl;
+        std::cout << "\ti - Print the state of the virtual devices" << std::endl;
+        std::cout << "\tt - Write the message trace to " << traceFilename << std::endl;
         std::cout << "\tq - Exit Application" << std::endl;
         break;
     }
@@ -256,12 +853,31 @@ bool DoUserInput() {
     return true;
 }
 
+// Milliseconds of the monotonic clock used by the main loop
+uint64_t GetMilliseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Send a Who-Is for a range of instances to every device on the hub. The frame
+// is built and sent here, the I-Am still reach the CAS BACnet Stack as usual.
+void SendWhoIs(const uint32_t low, const uint32_t high) {
+    uint8_t apdu[16];
+    uint8_t frame[64];
+    size_t apduLength = ExampleApdu::BuildWhoIs(apdu, sizeof(apdu), low, high);
+    size_t frameLength = ExampleApdu::BuildFrame(frame, sizeof(frame), g_discoveryMessageId++, NULL, false, apdu, apduLength);
+    uint8_t errorCode = 0;
+    if (g_ws_network.SendWSMessage(primaryHubUri, frame, (uint16_t)frameLength, &errorCode) == 0) {
+        std::cout << "Discovery: Who-Is " << low << " - " << high << " not sent, errorCode=" << (int)errorCode << std::endl;
+    }
+}
+
 // Callback Implementations
 // ===========================================================================
 // Message callback functions
 // ---------------------------------------------------------------------------
 // Callback used by the BACnet Stack to check if there is a message to process
 uint16_t CallbackReceiveMessage(uint8_t *message, const uint16_t maxMessageLength, uint8_t *receivedConnectionString, const uint8_t maxConnectionStringLength, uint8_t *receivedConnectionStringLength, uint8_t *networkType) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_RECEIVE_MESSAGE);
     // Check parameters
     if (message == NULL || maxMessageLength == 0) {
         std::cerr << "Invalid input buffer" << std::endl;
@@ -278,18 +894,34 @@ uint16_t CallbackReceiveMessage(uint8_t *message, const uint16_t maxMessageLengt
 
     // Check the primary
     uint8_t errorCode = 0;
-    uint16_t bytesRead = g_ws_network.RecvWSMessage(primaryHubUri, message, maxMessageLength, &errorCode);
+    uint16_t bytesRead;
+    WSFrameTimes times = {};
+    {
+        ExampleProfilerScope profile(&g_profiler, PROFILE_RECV_WS_MESSAGE);
+        bytesRead = (uint16_t)g_ws_network.RecvWSMessage(primaryHubUri, message, maxMessageLength, &errorCode, &times);
+    }
     if (bytesRead > 0) {
+        g_tracer.OnReceived(message, bytesRead, times);
+        g_discovery.OnReceived(message, bytesRead, GetMilliseconds());
+        if (g_poller.OnReceived(message, bytesRead, GetMilliseconds()) || g_covClient.OnReceived(message, bytesRead, GetMilliseconds())) {
+            // An answer to our own request or a notification for our own
+            // subscription, the stack has no transaction for it
+            return 0;
+        }
+        g_propertyBatch.Prepare(&g_database, message, bytesRead);
         *networkType = CASBACnetStackExampleConstants::NETWORK_TYPE_SC;
         memcpy(receivedConnectionString, primaryHubUri.c_str(), primaryHubUri.size());
         *receivedConnectionStringLength = primaryHubUri.size();
 
 
         // Get the XML rendered version of the just sent message
-        static char xmlRenderBuffer[MAX_RENDER_BUFFER_LENGTH];
-        if (fpDecodeAsXML((char*)message, bytesRead, xmlRenderBuffer, MAX_RENDER_BUFFER_LENGTH, CASBACnetStackExampleConstants::NETWORK_TYPE_SC) > 0) {
-            std::cout << xmlRenderBuffer << std::endl;
-            memset(xmlRenderBuffer, 0, MAX_RENDER_BUFFER_LENGTH);
+        {
+            ExampleProfilerScope profile(&g_profiler, PROFILE_DECODE_AS_XML);
+            static char xmlRenderBuffer[MAX_RENDER_BUFFER_LENGTH];
+            if (fpDecodeAsXML((char*)message, bytesRead, xmlRenderBuffer, MAX_RENDER_BUFFER_LENGTH, CASBACnetStackExampleConstants::NETWORK_TYPE_SC) > 0) {
+                std::cout << xmlRenderBuffer << std::endl;
+                memset(xmlRenderBuffer, 0, MAX_RENDER_BUFFER_LENGTH);
+            }
         }
 
 
@@ -301,6 +933,7 @@ uint16_t CallbackReceiveMessage(uint8_t *message, const uint16_t maxMessageLengt
 
 // Callback used by the BACnet Stack to send a BACnet message
 uint16_t CallbackSendMessage(const uint8_t *message, const uint16_t messageLength, const uint8_t *connectionString, const uint8_t connectionStringLength, const uint8_t networkType, bool broadcast) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_SEND_MESSAGE);
     (void)broadcast;    // Not used by SC
 
     // Check parameters
@@ -316,20 +949,29 @@ uint16_t CallbackSendMessage(const uint8_t *message, const uint16_t messageLengt
     if (networkType == CASBACnetStackExampleConstants::NETWORK_TYPE_SC) {
         // Handle BACnet SC message
         uint8_t errorCode = 0;
-        size_t sentBytes = g_ws_network.SendWSMessage(WSURI((char*)connectionString, connectionStringLength), message, messageLength, &errorCode);
+        size_t sentBytes;
+        WSFrameTimes times = {};
+        {
+            ExampleProfilerScope profile(&g_profiler, PROFILE_SEND_WS_MESSAGE);
+            sentBytes = g_ws_network.SendWSMessage(WSURI((char*)connectionString, connectionStringLength), message, messageLength, &errorCode, &times);
+        }
 
         if (sentBytes == 0) {
             // ToDo: handle error
             fpSetBACnetSCWebSocketStatus((char*)connectionString, connectionStringLength, BACnetSCConstants::WebsocketStatus_Disconnected, 0);
             return 0;
         }
+        g_tracer.OnSent(message, messageLength, times);
 
-         // Get the XML rendered version of the just sent message
-         static char xmlRenderBuffer[MAX_RENDER_BUFFER_LENGTH];
-         if (fpDecodeAsXML((char*)message, messageLength, xmlRenderBuffer, MAX_RENDER_BUFFER_LENGTH, networkType) > 0) {
-             std::cout << xmlRenderBuffer << std::endl;
-             memset(xmlRenderBuffer, 0, MAX_RENDER_BUFFER_LENGTH);
-         }
+        // Get the XML rendered version of the just sent message
+        {
+            ExampleProfilerScope profile(&g_profiler, PROFILE_DECODE_AS_XML);
+            static char xmlRenderBuffer[MAX_RENDER_BUFFER_LENGTH];
+            if (fpDecodeAsXML((char*)message, messageLength, xmlRenderBuffer, MAX_RENDER_BUFFER_LENGTH, networkType) > 0) {
+                std::cout << xmlRenderBuffer << std::endl;
+                memset(xmlRenderBuffer, 0, MAX_RENDER_BUFFER_LENGTH);
+            }
+        }
 
         return sentBytes;
     }
@@ -342,10 +984,12 @@ uint16_t CallbackSendMessage(const uint8_t *message, const uint16_t messageLengt
 // ---------------------------------------------------------------------------
 // Callback used by the BACnet Stack to get the current time
 time_t CallbackGetSystemTime() {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_SYSTEM_TIME);
     return time(0);
 }
 
 void CallbackLogDebugMessage(const char *message, const uint16_t messageLength, const uint8_t messageType) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_LOG_DEBUG_MESSAGE);
     // This callback is called when the CAS BACnet Stack logs an error or info message
     // In this callback, you will be able to access this debug message. This callback is optional.
     std::cout << std::string(message, messageLength) << std::endl;
@@ -354,56 +998,141 @@ void CallbackLogDebugMessage(const char *message, const uint16_t messageLength,
 
 // Get Property callback functions
 // ---------------------------------------------------------------------------
+// Each callback packs its arguments and looks the property up in the
+// property table, see CASBACnetSCExamplePropertyTable.h
+// The object cache shared by the callbacks, holding the object if it was
+// looked up when the request was received
+ExampleObjectCache* GetObjectCache(const uint16_t objectType, const uint32_t objectInstance) {
+    g_propertyBatch.Resolve(objectType, objectInstance, &g_objectCache);
+    return &g_objectCache;
+}
+
+// Callback used by the BACnet Stack to get Bit String property values from the user
+bool CallbackGetPropertyBitString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool *value, uint32_t *valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_BIT_STRING);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleBitString bitString = { value, valueElementCount, maxElementCount };
+    return ExamplePropertyTable::GetBitString(request, &bitString);
+}
+
+// Callback used by the BACnet Stack to get Boolean property values from the user
+bool CallbackGetPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool *value, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_BOOL);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    return ExamplePropertyTable::GetBool(request, value);
+}
+
 // Callback used by the BACnet Stack to get Character String property values from the user
 bool CallbackGetPropertyCharString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, char *value, uint32_t *valueElementCount, const uint32_t maxElementCount, uint8_t *encodingType, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
-    // Example of Object Name property
-    if (propertyIdentifier == CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME) {
-        size_t stringSize = 0;
-        if (objectType == CASBACnetStackExampleConstants::OBJECT_TYPE_DEVICE && objectInstance == g_database.device.instance) {
-            stringSize = g_database.device.objectName.size();
-            if (stringSize > maxElementCount) {
-                std::cerr << "Error - not enough space to store full name of objectType=[" << objectType << "], objectInstance=[" << objectInstance << " ]" << std::endl;
-                return false;
-            }
-            memcpy(value, g_database.device.objectName.c_str(), stringSize);
-            *valueElementCount = (uint32_t)stringSize;
-            return true;
-        } else if (objectType == CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT && objectInstance == g_database.analogInput.instance) {
-            stringSize = g_database.analogInput.objectName.size();
-            if (stringSize > maxElementCount) {
-                std::cerr << "Error - not enough space to store full name of objectType=[" << objectType << "], objectInstance=[" << objectInstance << " ]" << std::endl;
-                return false;
-            }
-            memcpy(value, g_database.analogInput.objectName.c_str(), stringSize);
-            *valueElementCount = (uint32_t)stringSize;
-            return true;
-        }
-    }
-    return false;
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_CHAR_STRING);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleCharacterString characterString = { value, valueElementCount, maxElementCount, encodingType };
+    return ExamplePropertyTable::GetCharacterString(request, &characterString);
+}
+
+// Callback used by the BACnet Stack to get Date property values from the user
+bool CallbackGetPropertyDate(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t *year, uint8_t *month, uint8_t *day, uint8_t *weekday, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_DATE);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleDate date = { year, month, day, weekday };
+    return ExamplePropertyTable::GetDate(request, &date);
+}
+
+// Callback used by the BACnet Stack to get Double property values from the user
+bool CallbackGetPropertyDouble(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, double *value, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_DOUBLE);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    return ExamplePropertyTable::GetDouble(request, value);
+}
+
+// Callback used by the BACnet Stack to get Enumerated property values from the user
+bool CallbackGetPropertyEnumerated(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t *value, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_ENUMERATED);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    return ExamplePropertyTable::GetEnumerated(request, value);
+}
+
+// Callback used by the BACnet Stack to get Octet String property values from the user
+bool CallbackGetPropertyOctetString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t *value, uint32_t *valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_OCTET_STRING);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleOctetString octetString = { value, valueElementCount, maxElementCount };
+    return ExamplePropertyTable::GetOctetString(request, &octetString);
+}
+
+// Callback used by the BACnet Stack to get Signed Integer property values from the user
+bool CallbackGetPropertySignedInteger(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, int32_t *value, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_SIGNED_INTEGER);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    return ExamplePropertyTable::GetSignedInteger(request, value);
 }
 
 // Callback used by the BACnet Stack to get Real property values from the user
-bool CallbackGetPropertyReal(uint32_t deviceInstance, uint16_t objectType, uint32_t objectInstance, uint32_t propertyIdentifier, float *value, bool useArrayIndex, uint32_t propertyArrayIndex) {
+bool CallbackGetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float *value, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_REAL);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    return ExamplePropertyTable::GetReal(request, value);
+}
 
-    // Example of Analog Input object Present Value property
-    if (propertyIdentifier == CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE) {
-        if (objectType == CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT && objectInstance == g_database.analogInput.instance) {
-            *value = g_database.analogInput.presentValue;
-            return true;
-        }
-    }
-    return false;
+// Callback used by the BACnet Stack to get Time property values from the user
+bool CallbackGetPropertyTime(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t *hour, uint8_t *minute, uint8_t *second, uint8_t *hundrethSeconds, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_TIME);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleTime time = { hour, minute, second, hundrethSeconds };
+    return ExamplePropertyTable::GetTime(request, &time);
+}
+
+// Callback used by the BACnet Stack to get Unsigned Integer property values from the user
+bool CallbackGetPropertyUnsignedInteger(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t *value, const bool useArrayIndex, const uint32_t propertyArrayIndex) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_GET_PROPERTY_UNSIGNED_INTEGER);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    return ExamplePropertyTable::GetUnsignedInteger(request, value);
+}
+
+// Set Property callback functions
+// ---------------------------------------------------------------------------
+// Callback used by the BACnet Stack to set Enumerated property values to the user
+bool CallbackSetPropertyEnumerated(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_SET_PROPERTY_ENUMERATED);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleWriteValue write = { (float)value, priority, errorCode };
+    return ExamplePropertyTable::SetEnumerated(request, &write);
+}
+
+// Callback used by the BACnet Stack to set a property to NULL, which relinquishes a command
+bool CallbackSetPropertyNull(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_SET_PROPERTY_NULL);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleWriteValue write = { 0.0f, priority, errorCode };
+    return ExamplePropertyTable::SetNull(request, &write);
+}
+
+// Callback used by the BACnet Stack to set Real property values to the user
+bool CallbackSetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_SET_PROPERTY_REAL);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleWriteValue write = { value, priority, errorCode };
+    return ExamplePropertyTable::SetReal(request, &write);
+}
+
+// Callback used by the BACnet Stack to set Unsigned Integer property values to the user
+bool CallbackSetPropertyUnsignedInteger(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t *errorCode) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_SET_PROPERTY_UNSIGNED_INTEGER);
+    ExamplePropertyRequest request = { &g_database, deviceInstance, objectType, objectInstance, propertyIdentifier, useArrayIndex, propertyArrayIndex, GetObjectCache(objectType, objectInstance) };
+    ExampleWriteValue write = { (float)value, priority, errorCode };
+    return ExamplePropertyTable::SetUnsignedInteger(request, &write);
 }
 
 // Websocket Callbacks
 
 bool CallbackInitiateWebsocket(const char* websocketUri, const uint32_t websocketUriLength) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_INITIATE_WEBSOCKET);
     WSURI uri = WSURI(websocketUri, websocketUriLength);
 
     // Add connection to the network
 
     uint8_t errorCode = 0;
-    if (g_ws_network.AddConnection(uri, &errorCode, "./cert.pem", "./key.key")) {
+    if (g_ws_network.AddConnection(uri, &errorCode, certificateFilename, keyFilename)) {
         std::cout << "Connected to uri=[" << uri << "]" << std::endl;
         fpSetBACnetSCWebSocketStatus(websocketUri, websocketUriLength, BACnetSCConstants::WebsocketStatus_Connected, 0);
         return true;
@@ -416,6 +1145,7 @@ bool CallbackInitiateWebsocket(const char* websocketUri, const uint32_t websocke
 }
 
 void CallbackDisconnectWebsocket(const char* websocketUri, const uint32_t websocketUriLength) {
+    ExampleProfilerScope profile(&g_profiler, PROFILE_DISCONNECT_WEBSOCKET);
     if (websocketUri == NULL || websocketUriLength == 0) {
         // Nothing to do, no websocketUri provided
         return;
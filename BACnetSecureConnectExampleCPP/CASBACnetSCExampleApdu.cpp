@@ -0,0 +1,486 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleApdu.cpp
+ *
+ * See CASBACnetSCExampleApdu.h
+ */
+
+#include "CASBACnetSCExampleApdu.h"
+#include "WSHubFunction.h"
+
+#include <string.h>
+
+// Tag header bits (ASHRAE 135 20.2.1)
+static const uint8_t APDU_TAG_CLASS_CONTEXT = 0x08;
+static const uint8_t APDU_TAG_EXTENDED_NUMBER = 0x0F;
+static const uint8_t APDU_TAG_EXTENDED_LENGTH = 5;
+static const uint8_t APDU_TAG_OPENING = 6;
+static const uint8_t APDU_TAG_CLOSING = 7;
+
+//
+// ExampleApduWriter
+// ----------------------------------------------------------------------------
+
+ExampleApduWriter::ExampleApduWriter(uint8_t* buffer, const size_t capacity) {
+    this->buffer = buffer;
+    this->capacity = capacity;
+    this->length = 0;
+    this->overflow = false;
+}
+
+void ExampleApduWriter::Byte(const uint8_t value) {
+    if (this->length >= this->capacity) {
+        this->overflow = true;
+        return;
+    }
+    this->buffer[this->length++] = value;
+}
+
+void ExampleApduWriter::tag(const uint8_t number, const bool context, const uint32_t length) {
+    uint8_t header = context ? APDU_TAG_CLASS_CONTEXT : 0;
+    header |= number < APDU_TAG_EXTENDED_NUMBER ? (uint8_t)(number << 4) : (uint8_t)(APDU_TAG_EXTENDED_NUMBER << 4);
+    header |= length < APDU_TAG_EXTENDED_LENGTH ? (uint8_t)length : APDU_TAG_EXTENDED_LENGTH;
+    this->Byte(header);
+    if (number >= APDU_TAG_EXTENDED_NUMBER) {
+        this->Byte(number);
+    }
+    if (length >= APDU_TAG_EXTENDED_LENGTH) {
+        // Only short lengths are written by this example
+        this->Byte((uint8_t)length);
+    }
+}
+
+void ExampleApduWriter::unsignedContent(const uint32_t value, const uint8_t bytes) {
+    for (uint8_t index = bytes; index > 0; index--) {
+        this->Byte((uint8_t)(value >> (8 * (index - 1))));
+    }
+}
+
+uint8_t ExampleApduWriter::GetUnsignedLength(const uint32_t value) {
+    return value < 0x100 ? 1 : value < 0x10000 ? 2 : value < 0x1000000 ? 3 : 4;
+}
+
+void ExampleApduWriter::ContextUnsigned(const uint8_t number, const uint32_t value) {
+    uint8_t bytes = GetUnsignedLength(value);
+    this->tag(number, true, bytes);
+    this->unsignedContent(value, bytes);
+}
+
+void ExampleApduWriter::ContextBoolean(const uint8_t number, const bool value) {
+    // Unlike an application boolean the value is content, not the length
+    this->tag(number, true, 1);
+    this->Byte(value ? 1 : 0);
+}
+
+void ExampleApduWriter::ApplicationUnsigned(const uint32_t value) {
+    uint8_t bytes = GetUnsignedLength(value);
+    this->tag(APDU_TAG_UNSIGNED, false, bytes);
+    this->unsignedContent(value, bytes);
+}
+
+void ExampleApduWriter::ApplicationEnumerated(const uint32_t value) {
+    uint8_t bytes = GetUnsignedLength(value);
+    this->tag(APDU_TAG_ENUMERATED, false, bytes);
+    this->unsignedContent(value, bytes);
+}
+
+void ExampleApduWriter::OpeningTag(const uint8_t number) {
+    this->Byte(APDU_TAG_CLASS_CONTEXT | (uint8_t)(number << 4) | APDU_TAG_OPENING);
+}
+
+void ExampleApduWriter::ClosingTag(const uint8_t number) {
+    this->Byte(APDU_TAG_CLASS_CONTEXT | (uint8_t)(number << 4) | APDU_TAG_CLOSING);
+}
+
+void ExampleApduWriter::ContextObjectIdentifier(const uint8_t number, const uint16_t objectType, const uint32_t instance) {
+    this->tag(number, true, 4);
+    this->unsignedContent(((uint32_t)objectType << 22) | (instance & 0x3FFFFF), 4);
+}
+
+void ExampleApduWriter::ApplicationReal(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    this->tag(APDU_TAG_REAL, false, 4);
+    this->unsignedContent(bits, 4);
+}
+
+void ExampleApduWriter::ApplicationObjectIdentifier(const uint16_t objectType, const uint32_t instance) {
+    this->tag(APDU_TAG_OBJECT_IDENTIFIER, false, 4);
+    this->unsignedContent(((uint32_t)objectType << 22) | (instance & 0x3FFFFF), 4);
+}
+
+//
+// ExampleApduReader
+// ----------------------------------------------------------------------------
+
+ExampleApduReader::ExampleApduReader(const uint8_t* apdu, const size_t length, const size_t offset) {
+    this->apdu = apdu;
+    this->length = length;
+    this->offset = offset;
+}
+
+bool ExampleApduReader::PeekTag(ExampleApduTag* tag) const {
+    ExampleApduReader copy = *this;
+    return copy.ReadTag(tag);
+}
+
+bool ExampleApduReader::ReadTag(ExampleApduTag* tag) {
+    if (this->offset >= this->length) {
+        return false;
+    }
+    uint8_t header = this->apdu[this->offset++];
+    tag->number = header >> 4;
+    tag->context = (header & APDU_TAG_CLASS_CONTEXT) != 0;
+    tag->opening = false;
+    tag->closing = false;
+    if (tag->number == APDU_TAG_EXTENDED_NUMBER) {
+        if (this->offset >= this->length) {
+            return false;
+        }
+        tag->number = this->apdu[this->offset++];
+    }
+
+    uint8_t lengthValueType = header & 0x07;
+    if (tag->context && lengthValueType == APDU_TAG_OPENING) {
+        tag->opening = true;
+        tag->length = 0;
+        return true;
+    }
+    if (tag->context && lengthValueType == APDU_TAG_CLOSING) {
+        tag->closing = true;
+        tag->length = 0;
+        return true;
+    }
+    if (!tag->context && tag->number == APDU_TAG_BOOLEAN) {
+        tag->length = lengthValueType;      // The value, there is no content
+        return true;
+    }
+    if (lengthValueType < APDU_TAG_EXTENDED_LENGTH) {
+        tag->length = lengthValueType;
+        return this->offset + tag->length <= this->length;
+    }
+
+    // Extended length, one byte, or 254 and two bytes, or 255 and four bytes
+    if (this->offset >= this->length) {
+        return false;
+    }
+    uint8_t extended = this->apdu[this->offset++];
+    uint8_t bytes = extended == 254 ? 2 : extended == 255 ? 4 : 0;
+    if (this->offset + bytes > this->length) {
+        return false;
+    }
+    tag->length = bytes == 0 ? extended : 0;
+    for (uint8_t index = 0; index < bytes; index++) {
+        tag->length = (tag->length << 8) | this->apdu[this->offset++];
+    }
+    return this->offset + tag->length <= this->length;
+}
+
+bool ExampleApduReader::ReadUnsigned(const ExampleApduTag& tag, uint32_t* value) {
+    if (tag.length == 0 || tag.length > 4 || this->offset + tag.length > this->length) {
+        return false;
+    }
+    *value = 0;
+    for (uint32_t index = 0; index < tag.length; index++) {
+        *value = (*value << 8) | this->apdu[this->offset++];
+    }
+    return true;
+}
+
+bool ExampleApduReader::Skip(const ExampleApduTag& tag) {
+    if (tag.opening || tag.closing || (!tag.context && tag.number == APDU_TAG_BOOLEAN)) {
+        return true;
+    }
+    if (this->offset + tag.length > this->length) {
+        return false;
+    }
+    this->offset += tag.length;
+    return true;
+}
+
+bool ExampleApduReader::SkipToClosing(const uint8_t number) {
+    uint32_t depth = 1;
+    ExampleApduTag tag;
+    while (this->ReadTag(&tag)) {
+        if (tag.opening) {
+            depth++;
+        }
+        else if (tag.closing) {
+            if (--depth == 0) {
+                return tag.number == number;
+            }
+        }
+        else if (!this->Skip(tag)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool ExampleApduReader::ReadApplicationUnsigned(const uint8_t number, uint32_t* value) {
+    ExampleApduTag tag;
+    return this->ReadTag(&tag) && !tag.context && tag.number == number && this->ReadUnsigned(tag, value);
+}
+
+bool ExampleApduReader::ReadApplicationObjectIdentifier(uint16_t* objectType, uint32_t* instance) {
+    uint32_t value;
+    ExampleApduTag tag;
+    if (!this->ReadTag(&tag) || tag.context || tag.number != APDU_TAG_OBJECT_IDENTIFIER || tag.length != 4 || !this->ReadUnsigned(tag, &value)) {
+        return false;
+    }
+    *objectType = (uint16_t)(value >> 22);
+    *instance = value & 0x3FFFFF;
+    return true;
+}
+
+bool ExampleApduReader::ReadContextUnsigned(const uint8_t number, uint32_t* value) {
+    ExampleApduTag tag;
+    return this->ReadTag(&tag) && tag.context && !tag.opening && !tag.closing && tag.number == number && this->ReadUnsigned(tag, value);
+}
+
+bool ExampleApduReader::ReadContextObjectIdentifier(const uint8_t number, uint16_t* objectType, uint32_t* instance) {
+    uint32_t value;
+    if (!this->ReadContextUnsigned(number, &value)) {
+        return false;
+    }
+    *objectType = (uint16_t)(value >> 22);
+    *instance = value & 0x3FFFFF;
+    return true;
+}
+
+bool ExampleApduReader::ReadApplicationValue(double* value) {
+    ExampleApduTag tag;
+    if (!this->ReadTag(&tag) || tag.context) {
+        return false;
+    }
+    uint32_t bits;
+    switch (tag.number) {
+    case APDU_TAG_NULL:
+        *value = 0;
+        return true;
+    case APDU_TAG_BOOLEAN:
+        *value = tag.length != 0 ? 1 : 0;
+        return true;
+    case APDU_TAG_UNSIGNED:
+    case APDU_TAG_ENUMERATED:
+        if (!this->ReadUnsigned(tag, &bits)) {
+            return false;
+        }
+        *value = bits;
+        return true;
+    case APDU_TAG_SIGNED:
+        if (!this->ReadUnsigned(tag, &bits)) {
+            return false;
+        }
+        // Sign extend from the encoded length
+        *value = tag.length < 4 && (bits >> (8 * tag.length - 1)) ? (double)((int64_t)bits - ((int64_t)1 << (8 * tag.length))) : (double)(int32_t)bits;
+        return true;
+    case APDU_TAG_REAL: {
+        if (tag.length != 4 || !this->ReadUnsigned(tag, &bits)) {
+            return false;
+        }
+        float real;
+        memcpy(&real, &bits, sizeof(real));
+        *value = real;
+        return true;
+    }
+    case APDU_TAG_DOUBLE: {
+        uint32_t high;
+        ExampleApduTag half = tag;
+        half.length = 4;
+        if (tag.length != 8 || !this->ReadUnsigned(half, &high) || !this->ReadUnsigned(half, &bits)) {
+            return false;
+        }
+        uint64_t raw = ((uint64_t)high << 32) | bits;
+        memcpy(value, &raw, sizeof(raw));
+        return true;
+    }
+    default:
+        this->Skip(tag);
+        return false;
+    }
+}
+
+bool ExampleApduReader::ReadOpeningTag(const uint8_t number) {
+    ExampleApduTag tag;
+    return this->ReadTag(&tag) && tag.opening && tag.number == number;
+}
+
+bool ExampleApduReader::ReadClosingTag(const uint8_t number) {
+    ExampleApduTag tag;
+    return this->ReadTag(&tag) && tag.closing && tag.number == number;
+}
+
+bool ExampleApduReader::IsOpeningTag(const uint8_t number) const {
+    ExampleApduTag tag;
+    return this->PeekTag(&tag) && tag.opening && tag.number == number;
+}
+
+bool ExampleApduReader::IsClosingTag(const uint8_t number) const {
+    ExampleApduTag tag;
+    return this->PeekTag(&tag) && tag.closing && tag.number == number;
+}
+
+//
+// ExampleApdu
+// ----------------------------------------------------------------------------
+
+size_t ExampleApdu::BuildFrame(uint8_t* frame, const size_t capacity, const uint16_t messageId, const uint8_t* destinationVmac, const bool expectingReply, const uint8_t* apdu, const size_t apduLength) {
+    static const uint8_t BROADCAST_VMAC[BVLC_SC_VMAC_LENGTH] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    bool broadcast = destinationVmac == NULL;
+
+    // BVLC-SC header, the hub adds the originating VMAC
+    size_t length = 0;
+    size_t headerLength = BVLC_SC_FIXED_HEADER_LENGTH + BVLC_SC_VMAC_LENGTH + 2 + (broadcast ? 4 : 0);
+    if (headerLength + apduLength > capacity) {
+        return 0;
+    }
+    frame[length++] = BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+    frame[length++] = BVLC_SC_CONTROL_DESTINATION_VMAC;
+    frame[length++] = (uint8_t)(messageId >> 8);
+    frame[length++] = (uint8_t)messageId;
+    memcpy(frame + length, broadcast ? BROADCAST_VMAC : destinationVmac, BVLC_SC_VMAC_LENGTH);
+    length += BVLC_SC_VMAC_LENGTH;
+
+    // NPDU, a broadcast also goes to every BACnet network
+    frame[length++] = 0x01;
+    frame[length++] = (broadcast ? NPDU_CONTROL_DESTINATION : 0) | (expectingReply ? NPDU_CONTROL_EXPECTING_REPLY : 0);
+    if (broadcast) {
+        frame[length++] = 0xFF;     // DNET 65535
+        frame[length++] = 0xFF;
+        frame[length++] = 0x00;     // DLEN 0
+        frame[length++] = 0xFF;     // Hop count
+    }
+
+    memcpy(frame + length, apdu, apduLength);
+    return length + apduLength;
+}
+
+size_t ExampleApdu::BuildWhoIs(uint8_t* apdu, const size_t capacity, const uint32_t low, const uint32_t high) {
+    ExampleApduWriter writer(apdu, capacity);
+    writer.Byte(APDU_TYPE_UNCONFIRMED_REQUEST << 4);
+    writer.Byte(APDU_SERVICE_WHO_IS);
+    writer.ContextUnsigned(0, low);
+    writer.ContextUnsigned(1, high);
+    return writer.GetLength();
+}
+
+size_t ExampleApdu::BuildIAm(uint8_t* apdu, const size_t capacity, const uint32_t instance, const uint32_t maxApdu, const uint16_t vendorId) {
+    ExampleApduWriter writer(apdu, capacity);
+    writer.Byte(APDU_TYPE_UNCONFIRMED_REQUEST << 4);
+    writer.Byte(APDU_SERVICE_I_AM);
+    writer.ApplicationObjectIdentifier(APDU_OBJECT_TYPE_DEVICE, instance);
+    writer.ApplicationUnsigned(maxApdu);
+    writer.ApplicationEnumerated(APDU_SEGMENTATION_NONE);
+    writer.ApplicationUnsigned(vendorId);
+    return writer.GetLength();
+}
+
+bool ExampleApdu::ParseIAm(const uint8_t* frame, const size_t length, ExampleIAm* iAm) {
+    WSHubFrameHeader header;
+    if (!WSHubFrameHeader::Parse(frame, length, &header)) {
+        return false;
+    }
+    size_t apduLength;
+    const uint8_t* apdu = header.GetApdu(frame, length, &apduLength);
+    if (apdu == NULL || apduLength < 2 || apdu[0] != (APDU_TYPE_UNCONFIRMED_REQUEST << 4) || apdu[1] != APDU_SERVICE_I_AM) {
+        return false;
+    }
+
+    ExampleApduReader reader(apdu, apduLength, 2);
+    uint16_t objectType;
+    uint32_t segmentation;
+    uint32_t vendorId;
+    if (!reader.ReadApplicationObjectIdentifier(&objectType, &iAm->instance) || objectType != APDU_OBJECT_TYPE_DEVICE ||
+        !reader.ReadApplicationUnsigned(APDU_TAG_UNSIGNED, &iAm->maxApdu) ||
+        !reader.ReadApplicationUnsigned(APDU_TAG_ENUMERATED, &segmentation) ||
+        !reader.ReadApplicationUnsigned(APDU_TAG_UNSIGNED, &vendorId)) {
+        return false;
+    }
+    iAm->segmentation = (uint8_t)segmentation;
+    iAm->vendorId = (uint16_t)vendorId;
+    iAm->vmac = header.originatingVmac == NULL ? 0 : WSHubFrameHeader::PackVmac(header.originatingVmac);
+    return true;
+}
+
+size_t ExampleApdu::ParseReadPropertyMultiple(const uint8_t* frame, const size_t length, uint16_t* objectTypes, uint32_t* instances, const size_t capacity) {
+    WSHubFrameHeader header;
+    if (!WSHubFrameHeader::Parse(frame, length, &header)) {
+        return 0;
+    }
+    size_t apduLength;
+    const uint8_t* apdu = header.GetApdu(frame, length, &apduLength);
+    if (apdu == NULL || apduLength < 4 || (apdu[0] >> 4) != APDU_TYPE_CONFIRMED_REQUEST || (apdu[0] & APDU_SEGMENTED_MESSAGE) != 0 || apdu[3] != APDU_SERVICE_READ_PROPERTY_MULTIPLE) {
+        return 0;
+    }
+
+    // Each read access specification, its list of properties skipped
+    ExampleApduReader reader(apdu, apduLength, 4);
+    size_t count = 0;
+    while (!reader.IsEnd() && count < capacity) {
+        if (!reader.ReadContextObjectIdentifier(0, &objectTypes[count], &instances[count]) || !reader.ReadOpeningTag(1) || !reader.SkipToClosing(1)) {
+            return 0;
+        }
+        count++;
+    }
+    return count;
+}
+
+bool ExampleApdu::GetAnswerService(const uint8_t* apdu, const size_t length, uint8_t* service) {
+    if (length < 3) {
+        return false;
+    }
+    uint8_t type = apdu[0] >> 4;
+    if (type == APDU_TYPE_SIMPLE_ACK || type == APDU_TYPE_ERROR) {
+        *service = apdu[2];
+        return true;
+    }
+    if (type != APDU_TYPE_COMPLEX_ACK) {
+        return false;
+    }
+    // A segment has its sequence number and the proposed window size first
+    size_t offset = (apdu[0] & APDU_SEGMENTED_MESSAGE) != 0 ? 4 : 2;
+    if (length <= offset) {
+        return false;
+    }
+    *service = apdu[offset];
+    return true;
+}
+
+//
+// ExampleInvokeIds
+// ----------------------------------------------------------------------------
+
+bool ExampleInvokeIds::Allocate(const uint64_t vmac, uint8_t* invokeId) {
+    std::unordered_map<uint64_t, Peer>::iterator found = this->peers.find(vmac);
+    if (found == this->peers.end()) {
+        Peer peer = {};
+        found = this->peers.insert(std::make_pair(vmac, peer)).first;
+    }
+    Peer& peer = found->second;
+    if (peer.count == 256) {
+        return false;
+    }
+    while ((peer.used[peer.next >> 6] >> (peer.next & 63)) & 1) {
+        peer.next++;
+    }
+    *invokeId = peer.next++;
+    peer.used[*invokeId >> 6] |= (uint64_t)1 << (*invokeId & 63);
+    peer.count++;
+    return true;
+}
+
+void ExampleInvokeIds::Release(const uint64_t vmac, const uint8_t invokeId) {
+    std::unordered_map<uint64_t, Peer>::iterator found = this->peers.find(vmac);
+    if (found == this->peers.end() || !((found->second.used[invokeId >> 6] >> (invokeId & 63)) & 1)) {
+        return;
+    }
+    found->second.used[invokeId >> 6] &= ~((uint64_t)1 << (invokeId & 63));
+    found->second.count--;
+}
+
+bool ExampleInvokeIds::IsFull(const uint64_t vmac) const {
+    std::unordered_map<uint64_t, Peer>::const_iterator found = this->peers.find(vmac);
+    return found != this->peers.end() && found->second.count == 256;
+}
@@ -0,0 +1,237 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleApdu.h
+ *
+ * Minimal BACnet APDU encoder and decoder (ASHRAE 135 clause 20) for the
+ * client side of the example: the requests this device sends on its own and
+ * the answers it reads back, without going through the CAS BACnet Stack.
+ *
+ * ExampleApduWriter appends tags to a caller supplied buffer and remembers
+ * if it ran out of space. ExampleApduReader walks the tags of a received
+ * APDU and fails, instead of reading past the end, on a malformed one.
+ * ExampleApdu::BuildFrame wraps an APDU in an NPDU and a BVLC-SC
+ * Encapsulated-NPDU for WSNetworkLayer::SendWSMessage.
+ *
+ * ExampleInvokeIds hands out the invoke IDs of the confirmed requests, per
+ * peer. The poller and the COV client share one, so an answer from a device
+ * matches the request of only one of them.
+ */
+
+#ifndef __CASBACnetSCExampleApdu_h__
+#define __CASBACnetSCExampleApdu_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+
+// APDU types (ASHRAE 135 20.1)
+static const uint8_t APDU_TYPE_CONFIRMED_REQUEST = 0;
+static const uint8_t APDU_TYPE_UNCONFIRMED_REQUEST = 1;
+static const uint8_t APDU_TYPE_SIMPLE_ACK = 2;
+static const uint8_t APDU_TYPE_COMPLEX_ACK = 3;
+static const uint8_t APDU_TYPE_SEGMENT_ACK = 4;
+static const uint8_t APDU_TYPE_ERROR = 5;
+static const uint8_t APDU_TYPE_REJECT = 6;
+static const uint8_t APDU_TYPE_ABORT = 7;
+
+// Segmented message, in the first byte of a confirmed request or a complex ACK (ASHRAE 135 20.1.2.1)
+static const uint8_t APDU_SEGMENTED_MESSAGE = 0x08;
+
+// Unconfirmed services (ASHRAE 135 21)
+static const uint8_t APDU_SERVICE_I_AM = 0;
+static const uint8_t APDU_SERVICE_UNCONFIRMED_COV_NOTIFICATION = 2;
+static const uint8_t APDU_SERVICE_WHO_IS = 8;
+
+// Confirmed services (ASHRAE 135 21)
+static const uint8_t APDU_SERVICE_SUBSCRIBE_COV = 5;
+static const uint8_t APDU_SERVICE_READ_PROPERTY = 12;
+static const uint8_t APDU_SERVICE_READ_PROPERTY_MULTIPLE = 14;
+
+// Abort reasons (ASHRAE 135 21)
+static const uint8_t APDU_ABORT_BUFFER_OVERFLOW = 1;
+static const uint8_t APDU_ABORT_SEGMENTATION_NOT_SUPPORTED = 4;
+static const uint8_t APDU_ABORT_APDU_TOO_LONG = 11;
+
+// Reject reasons (ASHRAE 135 21)
+static const uint8_t APDU_REJECT_UNRECOGNIZED_SERVICE = 9;
+
+// Error classes and codes (ASHRAE 135 21)
+static const uint32_t APDU_ERROR_CLASS_OBJECT = 1;
+static const uint32_t APDU_ERROR_CLASS_PROPERTY = 2;
+static const uint32_t APDU_ERROR_CODE_UNKNOWN_OBJECT = 31;
+static const uint32_t APDU_ERROR_CODE_UNKNOWN_PROPERTY = 32;
+static const uint32_t APDU_ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY = 50;
+
+// No segmentation, the segmentation of an I-Am (ASHRAE 135 21)
+static const uint8_t APDU_SEGMENTATION_NONE = 3;
+
+// Max APDU length accepted, the second byte of a confirmed request: no
+// segmentation, up to 1476 bytes (ASHRAE 135 20.1.2.5)
+static const uint8_t APDU_MAX_APDU_ACCEPTED_1476 = 0x05;
+static const uint32_t APDU_MAX_LENGTH = 1476;
+
+// Application tags (ASHRAE 135 20.2.1.4)
+static const uint8_t APDU_TAG_NULL = 0;
+static const uint8_t APDU_TAG_BOOLEAN = 1;
+static const uint8_t APDU_TAG_UNSIGNED = 2;
+static const uint8_t APDU_TAG_SIGNED = 3;
+static const uint8_t APDU_TAG_REAL = 4;
+static const uint8_t APDU_TAG_DOUBLE = 5;
+static const uint8_t APDU_TAG_ENUMERATED = 9;
+static const uint8_t APDU_TAG_OBJECT_IDENTIFIER = 12;
+
+// Object types (ASHRAE 135 21)
+static const uint16_t APDU_OBJECT_TYPE_ANALOG_INPUT = 0;
+static const uint16_t APDU_OBJECT_TYPE_DEVICE = 8;
+
+// Property identifiers (ASHRAE 135 21)
+static const uint32_t APDU_PROPERTY_OBJECT_IDENTIFIER = 75;
+static const uint32_t APDU_PROPERTY_PRESENT_VALUE = 85;
+
+// Highest valid instance. 4194303 is the wildcard.
+static const uint32_t APDU_MAX_INSTANCE = 4194302;
+
+//
+// ExampleApduTag
+// ----------------------------------------------------------------------------
+struct ExampleApduTag {
+    uint8_t number;
+    bool context;           // Context specific, application tag otherwise
+    bool opening;
+    bool closing;
+    uint32_t length;        // Content length, the value of an application boolean
+};
+
+//
+// ExampleApduWriter
+// ----------------------------------------------------------------------------
+class ExampleApduWriter {
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+
+    void tag(const uint8_t number, const bool context, const uint32_t length);
+    void unsignedContent(const uint32_t value, const uint8_t bytes);
+
+public:
+    ExampleApduWriter(uint8_t* buffer, const size_t capacity);
+
+    void Byte(const uint8_t value);
+    void OpeningTag(const uint8_t number);
+    void ClosingTag(const uint8_t number);
+    void ContextUnsigned(const uint8_t number, const uint32_t value);
+    void ContextBoolean(const uint8_t number, const bool value);
+    void ContextObjectIdentifier(const uint8_t number, const uint16_t objectType, const uint32_t instance);
+    void ApplicationUnsigned(const uint32_t value);
+    void ApplicationEnumerated(const uint32_t value);
+    void ApplicationReal(const float value);
+    void ApplicationObjectIdentifier(const uint16_t objectType, const uint32_t instance);
+
+    // Length written, 0 if the buffer was too small
+    size_t GetLength() const { return this->overflow ? 0 : this->length; }
+    bool IsOverflow() const { return this->overflow; }
+
+    // Bytes needed for the content of an unsigned value
+    static uint8_t GetUnsignedLength(const uint32_t value);
+};
+
+//
+// ExampleApduReader
+// ----------------------------------------------------------------------------
+class ExampleApduReader {
+private:
+    const uint8_t* apdu;
+    size_t length;
+    size_t offset;
+
+public:
+    ExampleApduReader(const uint8_t* apdu, const size_t length, const size_t offset);
+
+    bool IsEnd() const { return this->offset >= this->length; }
+    size_t GetOffset() const { return this->offset; }
+
+    // Read the next tag header, the reader is then at its content
+    bool ReadTag(ExampleApduTag* tag);
+    bool PeekTag(ExampleApduTag* tag) const;
+    // Content of the tag just read
+    bool ReadUnsigned(const ExampleApduTag& tag, uint32_t* value);
+    bool Skip(const ExampleApduTag& tag);
+    // Skip everything up to and including the closing tag that matches an opening tag just read
+    bool SkipToClosing(const uint8_t number);
+
+    // A whole application tagged value of the given tag
+    bool ReadApplicationUnsigned(const uint8_t number, uint32_t* value);
+    bool ReadApplicationObjectIdentifier(uint16_t* objectType, uint32_t* instance);
+    bool ReadContextUnsigned(const uint8_t number, uint32_t* value);
+    bool ReadContextObjectIdentifier(const uint8_t number, uint16_t* objectType, uint32_t* instance);
+    // Null, Boolean, Unsigned, Signed, Real, Double or Enumerated as a double.
+    // False for any other type, the value is skipped.
+    bool ReadApplicationValue(double* value);
+    // A context opening or closing tag
+    bool ReadOpeningTag(const uint8_t number);
+    bool ReadClosingTag(const uint8_t number);
+    bool IsClosingTag(const uint8_t number) const;
+    bool IsOpeningTag(const uint8_t number) const;
+};
+
+//
+// ExampleApdu
+// ----------------------------------------------------------------------------
+struct ExampleIAm {
+    uint32_t instance;
+    uint32_t maxApdu;
+    uint8_t segmentation;
+    uint16_t vendorId;
+    uint64_t vmac;          // Originating VMAC packed by WSHubFrameHeader::PackVmac, 0 if not present
+};
+
+class ExampleApdu {
+public:
+    // Encapsulated-NPDU with the APDU, to the broadcast VMAC if destinationVmac
+    // is NULL. A broadcast is also a global BACnet broadcast. Returns the frame
+    // length, 0 if frame is too small.
+    static size_t BuildFrame(uint8_t* frame, const size_t capacity, const uint16_t messageId, const uint8_t* destinationVmac, const bool expectingReply, const uint8_t* apdu, const size_t apduLength);
+
+    // Who-Is for the instances low to high
+    static size_t BuildWhoIs(uint8_t* apdu, const size_t capacity, const uint32_t low, const uint32_t high);
+
+    // I-Am of a device
+    static size_t BuildIAm(uint8_t* apdu, const size_t capacity, const uint32_t instance, const uint32_t maxApdu, const uint16_t vendorId);
+
+    // I-Am in a received BVLC-SC frame
+    static bool ParseIAm(const uint8_t* frame, const size_t length, ExampleIAm* iAm);
+
+    // Object identifiers of a ReadPropertyMultiple request in a received
+    // BVLC-SC frame, in request order, up to capacity. Returns how many, 0 for
+    // any other frame, a segmented request or a malformed one.
+    static size_t ParseReadPropertyMultiple(const uint8_t* frame, const size_t length, uint16_t* objectTypes, uint32_t* instances, const size_t capacity);
+
+    // Service choice of a Simple ACK, Complex ACK or Error. False for a
+    // Reject or Abort, which do not carry one, and for a malformed APDU.
+    static bool GetAnswerService(const uint8_t* apdu, const size_t length, uint8_t* service);
+};
+
+//
+// ExampleInvokeIds
+// ----------------------------------------------------------------------------
+class ExampleInvokeIds {
+private:
+    struct Peer {
+        uint64_t used[4];       // One bit per invoke ID waiting for an answer
+        uint32_t count;
+        uint8_t next;           // IDs are handed out in turn, so a late answer rarely matches a new request
+    };
+    std::unordered_map<uint64_t, Peer> peers;   // By VMAC, packed by WSHubFrameHeader::PackVmac
+
+public:
+    // A free invoke ID for a request to the peer, false if all 256 wait for an answer
+    bool Allocate(const uint64_t vmac, uint8_t* invokeId);
+    // Once the request is answered or given up
+    void Release(const uint64_t vmac, const uint8_t invokeId);
+    bool IsFull(const uint64_t vmac) const;
+};
+
+#endif // __CASBACnetSCExampleApdu_h__
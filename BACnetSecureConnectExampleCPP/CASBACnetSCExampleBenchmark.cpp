@@ -0,0 +1,4267 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleBenchmark.cpp
+ *
+ * See CASBACnetSCExampleBenchmark.h
+ */
+
+#include "CASBACnetSCExampleBenchmark.h"
+#include "WSHubFunction.h"
+#include "CASBACnetSCExampleObjectStore.h"
+#include "CASBACnetSCExamplePropertyTable.h"
+#include "CASBACnetSCExampleLoader.h"
+#include "CASBACnetSCExampleCOV.h"
+#include "CASBACnetSCExampleSnapshot.h"
+#include "CASBACnetSCExampleTimerWheel.h"
+#include "CASBACnetSCExampleTrendLog.h"
+#include "CASBACnetSCExamplePriorityArray.h"
+#include "CASBACnetSCExampleMetrics.h"
+#include "CASBACnetSCExampleMetricsServer.h"
+#include "CASBACnetSCExampleProfiler.h"
+#include "CASBACnetSCExampleTrace.h"
+#include "CASBACnetSCExampleDiscovery.h"
+#include "CASBACnetSCExamplePolling.h"
+#include "CASBACnetSCExampleCOVClient.h"
+#include "CASBACnetSCExampleCommandQueue.h"
+#include "WSVirtualDevices.h"
+#include "WSFrameView.h"
+#include "CASBACnetSCExampleConstants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <math.h>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <thread>
+#include <vector>
+#ifdef __GNUC__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif // __GNUC__
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif // __linux__
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+// Parse an optional numeric argument
+static size_t BenchmarkArgument(int argc, char** argv, int index, size_t defaultValue) {
+    if (index < argc) {
+        return (size_t)std::stoull(argv[index]);
+    }
+    return defaultValue;
+}
+
+static double BenchmarkSeconds(BenchmarkClock::time_point start, BenchmarkClock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// Each local connection needs two file descriptors (client and hub side)
+static void BenchmarkRaiseFileLimit(size_t connections) {
+#ifdef __GNUC__
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < connections * 2 + 64) {
+        limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connections * 2 + 64);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#else
+    (void)connections;
+#endif // __GNUC__
+}
+
+// Resident memory of the process, 0 where it is not known
+static size_t BenchmarkResidentBytes() {
+#ifdef __GNUC__
+    size_t pages = 0;
+    size_t resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    if (statm >> pages >> resident) {
+        return resident * (size_t)sysconf(_SC_PAGESIZE);
+    }
+#endif // __GNUC__
+    return 0;
+}
+
+int ExampleBenchmark::Run(int argc, char** argv) {
+    if (argc < 1) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    std::string name = argv[0];
+    bool result = false;
+    if (name == "hub") {
+        result = Hub(argc, argv);
+    }
+    else if (name == "objectstore") {
+        result = ObjectStore(argc, argv);
+    }
+    else if (name == "properties") {
+        result = Properties(argc, argv);
+    }
+    else if (name == "loader") {
+        result = Loader(argc, argv);
+    }
+    else if (name == "cov") {
+        result = COV(argc, argv);
+    }
+    else if (name == "snapshot") {
+        result = Snapshot(argc, argv);
+    }
+    else if (name == "concurrency") {
+        result = Concurrency(argc, argv);
+    }
+    else if (name == "timers") {
+        result = Timers(argc, argv);
+    }
+    else if (name == "trendlog") {
+        result = TrendLog(argc, argv);
+    }
+    else if (name == "priority") {
+        result = Priority(argc, argv);
+    }
+    else if (name == "rpm") {
+        result = RPM(argc, argv);
+    }
+    else if (name == "metrics") {
+        result = Metrics(argc, argv);
+    }
+    else if (name == "profiler") {
+        result = Profiler(argc, argv);
+    }
+    else if (name == "trace") {
+        result = Trace(argc, argv);
+    }
+    else if (name == "discovery") {
+        result = Discovery(argc, argv);
+    }
+    else if (name == "polling") {
+        result = Polling(argc, argv);
+    }
+    else if (name == "covclient") {
+        result = COVClient(argc, argv);
+    }
+    else if (name == "commands") {
+        result = CommandQueue(argc, argv);
+    }
+    else if (name == "virtualdevices") {
+        result = VirtualDevices(argc, argv);
+    }
+    else if (name == "flood") {
+        result = Flood(argc, argv);
+    }
+    else if (name == "outbound") {
+        result = OutboundPriority(argc, argv);
+    }
+    else if (name == "classify") {
+        result = Classify(argc, argv);
+    }
+    else if (name == "backend") {
+        result = Backend(argc, argv);
+    }
+    else if (name == "ktls") {
+        result = Ktls(argc, argv);
+    }
+    else if (name == "handshake") {
+        result = Handshake(argc, argv);
+    }
+    else {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void ExampleBenchmark::PrintUsage() {
+    std::cout << "Usage: BACnetSCExampleCPP --benchmark <name> [arguments]" << std::endl;
+    std::cout << "Benchmarks:" << std::endl;
+    std::cout << "\thub [connections=1000] [framesPerNode=100] [broadcasts=100]" << std::endl;
+    std::cout << "\tobjectstore [objectCount...=1000 100000 1000000]" << std::endl;
+    std::cout << "\tproperties [objectCount=1000]" << std::endl;
+    std::cout << "\tloader [objectCount=100000]" << std::endl;
+    std::cout << "\tcov [points=100000] [seconds=60] [windowMilliseconds=1000]" << std::endl;
+    std::cout << "\tsnapshot [objectCount=100000]" << std::endl;
+    std::cout << "\tconcurrency [points=100000] [milliseconds=1000] [maxThreads=cores]" << std::endl;
+    std::cout << "\ttimers [timers=100000] [seconds=60]" << std::endl;
+    std::cout << "\ttrendlog [records=1000000] [queries=10000]" << std::endl;
+    std::cout << "\tpriority [outputs=100000] [operations=10000000]" << std::endl;
+    std::cout << "\trpm [requests=100000] [objectCount...=100000 1000000]" << std::endl;
+    std::cout << "\tmetrics [operations=10000000] [threads=2] [connections=100]" << std::endl;
+    std::cout << "\tprofiler [samples=1000000] [iterations=100]" << std::endl;
+    std::cout << "\ttrace [messages=1000000] [sampleInterval=16]" << std::endl;
+    std::cout << "\tdiscovery [devices=10000] [clusterPercent=80] [maxDelayMilliseconds=200]" << std::endl;
+    std::cout << "\tpolling [devices=1000] [pointsPerDevice=50] [seconds=60]" << std::endl;
+    std::cout << "\tcovclient [points=10000] [changePercent=1] [seconds=900]" << std::endl;
+    std::cout << "\tcommands [producers=4] [commandsPerProducer=1000000]" << std::endl;
+    std::cout << "\tvirtualdevices [deviceCount...=100 1000]" << std::endl;
+    std::cout << "\tflood [frames=100000] [frameLength=100]" << std::endl;
+    std::cout << "\toutbound [bulkFrames=20000] [receivers=8]" << std::endl;
+    std::cout << "\tclassify [frames=10000000]" << std::endl;
+    std::cout << "\tbackend [connections=100] [framesPerNode=200]" << std::endl;
+    std::cout << "\tktls [frames=20000] [frameLength=1400]" << std::endl;
+    std::cout << "\thandshake [handshakes=300]" << std::endl;
+}
+
+//
+// Hub
+// ----------------------------------------------------------------------------
+// Connects many local nodes to an embedded hub over loopback and measures
+// unicast forwarding rate and broadcast fan-out cost.
+
+class BenchmarkHubNode : public std::enable_shared_from_this<BenchmarkHubNode> {
+private:
+    websocket::stream<beast::tcp_stream> ws;
+    beast::flat_buffer buffer;
+    std::deque<WSHubFrame> writeQueue;
+    bool writePending;
+
+    void onConnect(beast::error_code errorCode) {
+        if (errorCode) {
+            std::cout << "Error: benchmark node connect failed errorCode=" << errorCode << std::endl;
+            return;
+        }
+        beast::get_lowest_layer(this->ws).socket().set_option(tcp::no_delay(true));
+        this->ws.set_option(websocket::stream_base::decorator(
+            [](websocket::request_type& req) {
+                req.set(http::field::sec_websocket_protocol,
+                    "hub.bsc.bacnet.org");
+            }));
+        this->ws.binary(true);
+        this->ws.async_handshake("127.0.0.1", "/", beast::bind_front_handler(&BenchmarkHubNode::onHandshake, shared_from_this()));
+    }
+
+    void onHandshake(beast::error_code errorCode) {
+        if (errorCode) {
+            std::cout << "Error: benchmark node handshake failed errorCode=" << errorCode << std::endl;
+            return;
+        }
+
+        // Connect-Request: VMAC (6), Device UUID (16), Max BVLC Length (2), Max NPDU Length (2)
+        std::shared_ptr<std::string> request = std::make_shared<std::string>(BVLC_SC_FIXED_HEADER_LENGTH + 26, '\0');
+        uint8_t* out = reinterpret_cast<uint8_t*>(&(*request)[0]);
+        out[0] = BVLC_SC_FUNCTION_CONNECT_REQUEST;
+        out[3] = 1;
+        memcpy(out + 4, this->vmac, BVLC_SC_VMAC_LENGTH);
+        memcpy(out + 10, this->vmac, BVLC_SC_VMAC_LENGTH); // UUID, unique enough for the benchmark
+        out[26] = (uint8_t)(BVLC_SC_MAX_BVLC_LENGTH >> 8);
+        out[27] = (uint8_t)(BVLC_SC_MAX_BVLC_LENGTH & 0xFF);
+        out[28] = (uint8_t)(BVLC_SC_MAX_NPDU_LENGTH >> 8);
+        out[29] = (uint8_t)(BVLC_SC_MAX_NPDU_LENGTH & 0xFF);
+        this->Send(request);
+        this->doRead();
+    }
+
+    void doRead() {
+        this->ws.async_read(this->buffer, beast::bind_front_handler(&BenchmarkHubNode::onRead, shared_from_this()));
+    }
+
+    void onRead(beast::error_code errorCode, std::size_t bytesRead) {
+        if (errorCode) {
+            return;
+        }
+        const uint8_t* frame = static_cast<const uint8_t*>(this->buffer.data().data());
+        if (this->observer) {
+            this->observer(frame, bytesRead);
+        }
+        if (frame[0] == BVLC_SC_FUNCTION_CONNECT_ACCEPT) {
+            this->connected = true;
+            (*this->connectedCount)++;
+        }
+        else if (frame[0] == BVLC_SC_FUNCTION_ENCAPSULATED_NPDU) {
+            (*this->receivedCount)++;
+            if (this->received != NULL) {
+                this->received->push_back(std::string((const char*)frame, bytesRead));
+            }
+        }
+        this->buffer.consume(bytesRead);
+        this->doRead();
+    }
+
+    void onWrite(beast::error_code errorCode, std::size_t) {
+        this->writeQueue.pop_front();
+        if (errorCode || this->writeQueue.empty()) {
+            this->writePending = false;
+            return;
+        }
+        this->ws.async_write(net::buffer(this->writeQueue.front()->data(), this->writeQueue.front()->size()), beast::bind_front_handler(&BenchmarkHubNode::onWrite, shared_from_this()));
+    }
+
+public:
+    uint8_t vmac[BVLC_SC_VMAC_LENGTH];
+    bool connected;
+    size_t* connectedCount;
+    size_t* receivedCount;
+    std::vector<std::string>* received;     // Frames received are kept here when not NULL
+    std::function<void(const uint8_t* frame, size_t length)> observer;     // Called for every frame received when set
+
+    BenchmarkHubNode(net::io_context& ioc, size_t index, size_t* connectedCount, size_t* receivedCount)
+        : ws(ioc) {
+        this->writePending = false;
+        this->connected = false;
+        this->connectedCount = connectedCount;
+        this->receivedCount = receivedCount;
+        this->received = NULL;
+        // Locally administered unicast VMAC
+        this->vmac[0] = 0x02;
+        this->vmac[1] = 0x00;
+        this->vmac[2] = (uint8_t)(index >> 24);
+        this->vmac[3] = (uint8_t)(index >> 16);
+        this->vmac[4] = (uint8_t)(index >> 8);
+        this->vmac[5] = (uint8_t)(index);
+    }
+
+    void Start(const tcp::endpoint& endpoint) {
+        beast::get_lowest_layer(this->ws).async_connect(endpoint, beast::bind_front_handler(&BenchmarkHubNode::onConnect, shared_from_this()));
+    }
+
+    void Send(const WSHubFrame& frame) {
+        this->writeQueue.push_back(frame);
+        if (!this->writePending) {
+            this->writePending = true;
+            this->ws.async_write(net::buffer(frame->data(), frame->size()), beast::bind_front_handler(&BenchmarkHubNode::onWrite, shared_from_this()));
+        }
+    }
+
+    // Encapsulated-NPDU carrying a small unconfirmed request
+    static WSHubFrame EncodeNpdu(const uint8_t* destination) {
+        static const uint8_t npdu[] = { 0x01, 0x20, 0xFF, 0xFF, 0x00, 0xFF, 0x10, 0x08 }; // Who-Is
+        std::shared_ptr<std::string> frame = std::make_shared<std::string>(BVLC_SC_FIXED_HEADER_LENGTH + BVLC_SC_VMAC_LENGTH + sizeof(npdu), '\0');
+        uint8_t* out = reinterpret_cast<uint8_t*>(&(*frame)[0]);
+        out[0] = BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+        out[1] = BVLC_SC_CONTROL_DESTINATION_VMAC;
+        out[3] = 2;
+        memcpy(out + 4, destination, BVLC_SC_VMAC_LENGTH);
+        memcpy(out + 10, npdu, sizeof(npdu));
+        return frame;
+    }
+};
+
+// Run the benchmark io_context until the condition is met or the timeout expires
+template <typename Condition>
+static bool BenchmarkRunUntil(net::io_context& ioc, Condition condition, std::chrono::seconds timeout) {
+    BenchmarkClock::time_point deadline = BenchmarkClock::now() + timeout;
+    while (!condition()) {
+        if (BenchmarkClock::now() > deadline) {
+            return false;
+        }
+        ioc.run_one_for(std::chrono::milliseconds(100));
+    }
+    return true;
+}
+
+bool ExampleBenchmark::Hub(int argc, char** argv) {
+    size_t connections = BenchmarkArgument(argc, argv, 1, 1000);
+    size_t framesPerNode = BenchmarkArgument(argc, argv, 2, 100);
+    size_t broadcasts = BenchmarkArgument(argc, argv, 3, 100);
+    if (connections < 2) {
+        std::cout << "Error: need at least 2 connections" << std::endl;
+        return false;
+    }
+    BenchmarkRaiseFileLimit(connections);
+
+    const uint8_t hubVmac[BVLC_SC_VMAC_LENGTH] = { 0x02, 0xFF, 0x00, 0x00, 0x00, 0x01 };
+    const uint8_t hubUuid[BVLC_SC_UUID_LENGTH] = { 0 };
+    WSHubFunction hub;
+    if (!hub.Start("127.0.0.1", 0, hubVmac, hubUuid)) {
+        return false;
+    }
+    tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), hub.GetPort());
+
+    // Connect all the nodes
+    net::io_context ioc;
+    size_t connectedCount = 0;
+    size_t receivedCount = 0;
+    std::vector<std::shared_ptr<BenchmarkHubNode>> nodes;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t offset = 0; offset < connections; offset++) {
+        nodes.push_back(std::make_shared<BenchmarkHubNode>(ioc, offset, &connectedCount, &receivedCount));
+        nodes.back()->Start(endpoint);
+    }
+    if (!BenchmarkRunUntil(ioc, [&] { return connectedCount == connections; }, std::chrono::seconds(120))) {
+        std::cout << "Error: only " << connectedCount << " of " << connections << " nodes connected" << std::endl;
+        return false;
+    }
+    double connectSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    // Unicast: every node sends framesPerNode frames to its neighbour
+    size_t expected = connections * framesPerNode;
+    start = BenchmarkClock::now();
+    for (size_t offset = 0; offset < connections; offset++) {
+        WSHubFrame frame = BenchmarkHubNode::EncodeNpdu(nodes[(offset + 1) % connections]->vmac);
+        for (size_t count = 0; count < framesPerNode; count++) {
+            nodes[offset]->Send(frame);
+        }
+    }
+    if (!BenchmarkRunUntil(ioc, [&] { return receivedCount >= expected; }, std::chrono::seconds(300))) {
+        std::cout << "Error: unicast only received " << receivedCount << " of " << expected << std::endl;
+        return false;
+    }
+    double unicastSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    // Broadcast: one node sends, every other node receives
+    const uint8_t broadcastVmac[BVLC_SC_VMAC_LENGTH] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    WSHubFrame broadcastFrame = BenchmarkHubNode::EncodeNpdu(broadcastVmac);
+    receivedCount = 0;
+    expected = (connections - 1) * broadcasts;
+    start = BenchmarkClock::now();
+    for (size_t count = 0; count < broadcasts; count++) {
+        nodes[0]->Send(broadcastFrame);
+    }
+    if (!BenchmarkRunUntil(ioc, [&] { return receivedCount >= expected; }, std::chrono::seconds(300))) {
+        std::cout << "Error: broadcast only received " << receivedCount << " of " << expected << std::endl;
+        return false;
+    }
+    double broadcastSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Hub benchmark, connections=" << connections << std::endl;
+    std::cout << "  connect:   " << connections / connectSeconds << " connections/sec (" << connectSeconds << " s)" << std::endl;
+    std::cout << "  unicast:   " << (connections * framesPerNode) / unicastSeconds << " forwarded frames/sec (" << connections * framesPerNode << " frames)" << std::endl;
+    std::cout << "  broadcast: " << expected / broadcastSeconds << " deliveries/sec, "
+              << (broadcastSeconds * 1e9) / expected << " ns per fan-out delivery (" << broadcasts << " broadcasts)" << std::endl;
+    std::cout << "  hub: framesReceived=" << hub.framesReceived << " unicastForwarded=" << hub.unicastForwarded
+              << " broadcastDeliveries=" << hub.broadcastDeliveries << " framesDropped=" << hub.framesDropped << std::endl;
+
+    hub.Stop();
+    return true;
+}
+
+//
+// ObjectStore
+// ----------------------------------------------------------------------------
+// Builds the store with N Analog Inputs and measures the lookups done by
+// CallbackGetPropertyReal and CallbackGetPropertyCharString in random order.
+// A std::map keyed the same way is measured for comparison.
+
+bool ExampleBenchmark::ObjectStore(int argc, char** argv) {
+    std::vector<size_t> counts;
+    for (int offset = 1; offset < argc; offset++) {
+        counts.push_back((size_t)std::stoull(argv[offset]));
+    }
+    if (counts.empty()) {
+        counts = { 1000, 100000, 1000000 };
+    }
+
+    const uint16_t objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT;
+    const size_t lookups = 10000000;
+    std::mt19937 random(1234);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Object store benchmark, " << lookups << " random lookups per size" << std::endl;
+    for (size_t count : counts) {
+        // Build
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        ExampleObjectStore store;
+        store.Reserve(objectType, count, count * 24);
+        for (size_t instance = 0; instance < count; instance++) {
+            store.Add(objectType, (uint32_t)instance, "AnalogInput " + std::to_string(instance), (float)instance, 1.0f, 0);
+        }
+        double buildSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+        // Random access order, the same for both containers
+        std::vector<uint32_t> order(lookups);
+        std::uniform_int_distribution<uint32_t> distribution(0, (uint32_t)count - 1);
+        for (uint32_t& instance : order) {
+            instance = distribution(random);
+        }
+
+        // Present value: Find + read one column
+        float sum = 0;
+        start = BenchmarkClock::now();
+        for (uint32_t instance : order) {
+            ExampleObjectTable* table;
+            uint32_t row;
+            if (store.Find(objectType, instance, &table, &row)) {
+                sum += table->presentValue[row];
+            }
+        }
+        double presentValueSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+        // Object name: Find + copy out of the arena
+        char name[64];
+        size_t nameBytes = 0;
+        start = BenchmarkClock::now();
+        for (uint32_t instance : order) {
+            ExampleObjectTable* table;
+            uint32_t row;
+            if (store.Find(objectType, instance, &table, &row)) {
+                uint32_t length;
+                const char* value = store.GetObjectName(table, row, &length);
+                memcpy(name, value, length);
+                nameBytes += length;
+            }
+        }
+        double nameSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+        // Baseline: std::map from object key to present value
+        std::map<uint32_t, float> baseline;
+        for (size_t instance = 0; instance < count; instance++) {
+            baseline[ExampleObjectKey(objectType, (uint32_t)instance)] = (float)instance;
+        }
+        float baselineSum = 0;
+        start = BenchmarkClock::now();
+        for (uint32_t instance : order) {
+            auto it = baseline.find(ExampleObjectKey(objectType, instance));
+            if (it != baseline.end()) {
+                baselineSum += it->second;
+            }
+        }
+        double baselineSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+        std::cout << "  objects=" << count << std::endl;
+        std::cout << "    build:         " << (buildSeconds * 1e3) << " ms, " << (double)store.GetMemoryUsage() / count << " bytes/object" << std::endl;
+        std::cout << "    present value: " << (presentValueSeconds * 1e9) / lookups << " ns/lookup" << std::endl;
+        std::cout << "    object name:   " << (nameSeconds * 1e9) / lookups << " ns/lookup" << std::endl;
+        std::cout << "    std::map:      " << (baselineSeconds * 1e9) / lookups << " ns/lookup" << std::endl;
+        if (sum != baselineSum || nameBytes == 0) {
+            std::cout << "Error: lookup results do not match" << std::endl;
+            return false;
+        }
+    }
+
+    // Identifiers at the edges of the key space: the last type and instance
+    // is key 0xFFFFFFFF, an instance past 22 bits would alias instance 0
+    const uint16_t lastType = EXAMPLE_OBJECT_TYPE_COUNT - 1;
+    ExampleObjectStore store;
+    ExampleObjectTable* table;
+    uint32_t row;
+    bool edgesOk = !store.Find(lastType, EXAMPLE_OBJECT_INSTANCE_MASK, &table, &row);
+    edgesOk = edgesOk && store.Add(lastType, EXAMPLE_OBJECT_INSTANCE_MASK, "Last", -1.0f, 1.0f, 0);
+    edgesOk = edgesOk && !store.Add(lastType, EXAMPLE_OBJECT_INSTANCE_MASK, "Last again", -2.0f, 1.0f, 0);
+    for (uint32_t instance = 0; instance < 100; instance++) {
+        // Grows the index past its first capacity
+        edgesOk = edgesOk && store.Add(objectType, instance, "AnalogInput " + std::to_string(instance), (float)instance, 1.0f, 0);
+    }
+    edgesOk = edgesOk && !store.Add(objectType, EXAMPLE_OBJECT_INSTANCE_MASK + 1, "Aliased", -3.0f, 1.0f, 0) && store.GetObjectCount() == 101;
+    edgesOk = edgesOk && store.Find(lastType, EXAMPLE_OBJECT_INSTANCE_MASK, &table, &row) && table->presentValue[row] == -1.0f;
+    edgesOk = edgesOk && store.Find(objectType, 0, &table, &row) && table->presentValue[row] == 0.0f;
+    edgesOk = edgesOk && !store.Find(objectType, EXAMPLE_OBJECT_INSTANCE_MASK + 1, &table, &row) && !store.Find(EXAMPLE_OBJECT_TYPE_COUNT, 0, &table, &row);
+    ExampleObjectCache cache;
+    edgesOk = edgesOk && store.Find(lastType, EXAMPLE_OBJECT_INSTANCE_MASK, &cache, &table, &row) && table->presentValue[row] == -1.0f;
+    edgesOk = edgesOk && !store.Find(lastType, EXAMPLE_OBJECT_INSTANCE_MASK + 1, &cache, &table, &row);
+    std::cout << "  identifiers at the edges of the key space: " << (edgesOk ? "ok" : "wrong") << std::endl;
+    return edgesOk;
+}
+
+//
+// Properties
+// ----------------------------------------------------------------------------
+// Calls the property table the same way the Get Property callbacks do and
+// measures the cost per call, including a property that is not in the table.
+
+bool ExampleBenchmark::Properties(int argc, char** argv) {
+    const size_t count = BenchmarkArgument(argc, argv, 1, 1000);
+    const size_t calls = 10000000;
+    const uint16_t objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT;
+
+    ExampleDatabase database;
+    database.objects.Reserve(objectType, count, count * 24);
+    for (size_t instance = database.objects.GetTable(objectType)->Size(); instance < count; instance++) {
+        database.objects.Add(objectType, (uint32_t)instance, "AnalogInput " + std::to_string(instance), (float)instance, 1.0f, 0);
+    }
+
+    struct Case {
+        const char* name;
+        uint32_t propertyIdentifier;
+    };
+    const Case cases[] = {
+        { "present value", CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE },
+        { "cov increment", CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_COV_INCURMENT },
+        { "not in table ", CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_DESCRIPTION },
+    };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Property table benchmark, objects=" << count << ", " << calls << " calls per property" << std::endl;
+    ExamplePropertyRequest request = { &database, database.device.instance, objectType, 0, 0, false, 0, NULL };
+    for (const Case& test : cases) {
+        request.propertyIdentifier = test.propertyIdentifier;
+        float sum = 0;
+        size_t found = 0;
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        for (size_t call = 0; call < calls; call++) {
+            request.objectInstance = (uint32_t)(call % count);
+            float value;
+            if (ExamplePropertyTable::GetReal(request, &value)) {
+                sum += value;
+                found++;
+            }
+        }
+        double seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        std::cout << "  real " << test.name << ": " << (seconds * 1e9) / calls << " ns/call, found=" << found << " (" << sum << ")" << std::endl;
+    }
+
+    // Character string goes through the same table with a copy out of the arena
+    char name[64];
+    uint32_t nameLength = 0;
+    uint8_t encodingType = 0;
+    ExampleCharacterString characterString = { name, &nameLength, sizeof(name), &encodingType };
+    request.propertyIdentifier = CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME;
+    size_t nameBytes = 0;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t call = 0; call < calls; call++) {
+        request.objectInstance = (uint32_t)(call % count);
+        if (ExamplePropertyTable::GetCharacterString(request, &characterString)) {
+            nameBytes += nameLength;
+        }
+    }
+    double seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    std::cout << "  character string object name: " << (seconds * 1e9) / calls << " ns/call" << std::endl;
+    return nameBytes > 0;
+}
+
+//
+// Loader
+// ----------------------------------------------------------------------------
+// Writes a CSV point list, imports it to a binary point file and loads that
+// into an empty store. One by one ExampleObjectStore::Add of the same objects
+// is measured for comparison.
+
+bool ExampleBenchmark::Loader(int argc, char** argv) {
+    const size_t count = BenchmarkArgument(argc, argv, 1, 100000);
+    const std::string csvPath = "benchmark_points.csv";
+    const std::string binaryPath = "benchmark_points.bin";
+    const uint16_t objectTypes[] = {
+        CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT,
+        CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE,
+        CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_INPUT,
+        CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE,
+    };
+    const size_t typeCount = sizeof(objectTypes) / sizeof(objectTypes[0]);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Loader benchmark, objects=" << count << std::endl;
+    {
+        std::ofstream csv(csvPath.c_str());
+        csv << std::setprecision(9); // Round trip every float
+        csv << "objectType,instance,objectName,presentValue,covIncrement,reliability" << std::endl;
+        for (size_t offset = 0; offset < count; offset++) {
+            csv << objectTypes[offset % typeCount] << "," << offset / typeCount << ",\"Point " << offset << ", floor " << offset % 40 << "\"," << (float)offset * 0.5f << ",1,0\n";
+        }
+    }
+
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    size_t imported = 0;
+    bool result = ExampleDatabaseLoader::ImportCSV(csvPath, binaryPath, &imported);
+    double importSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    ExampleObjectStore store;
+    ExampleLoadReport report;
+    start = BenchmarkClock::now();
+    result = result && ExampleDatabaseLoader::Load(binaryPath, &store, &report);
+    double loadSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    remove(csvPath.c_str());
+    remove(binaryPath.c_str());
+    if (!result || imported != count || store.GetObjectCount() != count) {
+        std::cout << "Error: loaded " << store.GetObjectCount() << " of " << count << " objects" << std::endl;
+        return false;
+    }
+
+    // Spot check the last object
+    ExampleObjectTable* table;
+    uint32_t row;
+    uint32_t length;
+    size_t last = count - 1;
+    if (!store.Find(objectTypes[last % typeCount], (uint32_t)(last / typeCount), &table, &row) || table->presentValue[row] != (float)last * 0.5f) {
+        std::cout << "Error: loaded object does not match the CSV" << std::endl;
+        return false;
+    }
+    const char* name = store.GetObjectName(table, row, &length);
+    if (std::string(name, length) != "Point " + std::to_string(last) + ", floor " + std::to_string(last % 40)) {
+        std::cout << "Error: loaded object does not match the CSV" << std::endl;
+        return false;
+    }
+
+    // Baseline: one by one, as ExampleDatabase::Setup does
+    start = BenchmarkClock::now();
+    ExampleObjectStore baseline;
+    for (size_t offset = 0; offset < count; offset++) {
+        baseline.Add(objectTypes[offset % typeCount], (uint32_t)(offset / typeCount), "Point " + std::to_string(offset) + ", floor " + std::to_string(offset % 40), (float)offset * 0.5f, 1.0f, 0);
+    }
+    double baselineSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    std::cout << "  csv import:    " << importSeconds * 1e3 << " ms (offline, once)" << std::endl;
+    std::cout << "  binary load:   " << loadSeconds * 1e3 << " ms" << std::endl;
+    report.Print();
+    std::cout << "  one by one:    " << baselineSeconds * 1e3 << " ms" << std::endl;
+    return true;
+}
+
+//
+// COV
+// ----------------------------------------------------------------------------
+// Every point is written once per simulated second (1 Hz) with a random step,
+// COV increment 1.0. The main loop is simulated at 100 iterations per second,
+// each one calling Flush. Time is simulated so the run takes only as long as
+// the work itself.
+
+bool ExampleBenchmark::COV(int argc, char** argv) {
+    const size_t points = BenchmarkArgument(argc, argv, 1, 100000);
+    const size_t seconds = BenchmarkArgument(argc, argv, 2, 60);
+    const uint32_t window = (uint32_t)BenchmarkArgument(argc, argv, 3, 1000);
+    const size_t loopsPerSecond = 100;
+    const uint16_t objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT;
+
+    ExampleObjectStore store;
+    store.Reserve(objectType, points, points * 16);
+    for (size_t instance = 0; instance < points; instance++) {
+        store.Add(objectType, (uint32_t)instance, "Point " + std::to_string(instance), 0.0f, 1.0f, 0);
+    }
+    ExampleCOVEngine engine;
+    engine.Initialize(&store);
+    engine.SetWindow(window);
+
+    // Steps are generated up front so the random number generator is not timed
+    std::mt19937 random(1234);
+    std::normal_distribution<float> distribution(0.0f, 0.5f);
+    std::vector<float> steps(points * 2);
+    for (float& step : steps) {
+        step = distribution(random);
+    }
+
+    std::vector<ExampleCOVChange> changes;
+    changes.reserve(points);
+    double writeSeconds = 0;
+    double flushSeconds = 0;
+    size_t flushCalls = 0;
+    size_t changeCount = 0;
+    const ExampleObjectTable& table = store.tables[0];
+    for (size_t second = 0; second < seconds; second++) {
+        // Field updates, 1 Hz
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        size_t stepOffset = (second * 7919) % points;
+        for (uint32_t row = 0; row < points; row++) {
+            engine.Write(0, row, table.presentValue[row] + steps[stepOffset + row]);
+        }
+        writeSeconds += BenchmarkSeconds(start, BenchmarkClock::now());
+
+        // Main loop iterations
+        start = BenchmarkClock::now();
+        for (size_t loop = 0; loop < loopsPerSecond; loop++) {
+            changes.clear();
+            changeCount += engine.Flush(1000 + second * 1000 + loop * (1000 / loopsPerSecond), &changes);
+            flushCalls++;
+        }
+        flushSeconds += BenchmarkSeconds(start, BenchmarkClock::now());
+    }
+
+    // Baseline: compare every point with its last reported value on every loop
+    std::vector<float> lastReported(table.presentValue.begin(), table.presentValue.end());
+    size_t scanChanges = 0;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t loop = 0; loop < loopsPerSecond; loop++) {
+        for (uint32_t row = 0; row < points; row++) {
+            if (fabsf(table.presentValue[row] - lastReported[row]) >= table.covIncrement[row]) {
+                scanChanges++;
+            }
+        }
+    }
+    double scanSeconds = BenchmarkSeconds(start, BenchmarkClock::now()) / loopsPerSecond;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "COV benchmark, points=" << points << ", seconds=" << seconds << ", window=" << window << " ms, " << loopsPerSecond << " loops/sec" << std::endl;
+    std::cout << "  writes:        " << engine.writes << ", " << (writeSeconds * 1e9) / engine.writes << " ns/write, " << engine.writes / writeSeconds / 1e6 << " M writes/sec" << std::endl;
+    std::cout << "  marked dirty:  " << engine.marked << ", coalesced: " << engine.coalesced << std::endl;
+    std::cout << "  changes:       " << changeCount << " (" << (double)changeCount / seconds << "/sec, " << 100.0 * changeCount / engine.writes << "% of writes)" << std::endl;
+    std::cout << "  flush:         " << (flushSeconds * 1e6) / flushCalls << " us/call avg, " << (flushSeconds * 1e3) / seconds << " ms per second of load" << std::endl;
+    std::cout << "  full scan:     " << scanSeconds * 1e6 << " us/call (" << scanSeconds * loopsPerSecond * 1e3 << " ms per second at " << loopsPerSecond << " loops/sec), found " << scanChanges / loopsPerSecond << " pending" << std::endl;
+    std::cout << "  engine memory: " << engine.GetMemoryUsage() / 1024 << " KB" << std::endl;
+    return changeCount > 0 && changeCount == engine.notifications;
+}
+
+//
+// Snapshot
+// ----------------------------------------------------------------------------
+// Measures save and restore of the snapshot file, then checks that a crash at
+// each step of a save leaves a snapshot that restores to a complete earlier
+// generation. A crash is simulated by writing to the file behind the
+// snapshot's back and opening it again.
+
+// Fill the store with values that identify a generation
+static void BenchmarkSnapshotValues(ExampleObjectStore* store, const uint32_t generation, const size_t changed) {
+    ExampleObjectTable& table = store->tables[0];
+    for (size_t row = 0; row < changed && row < table.Size(); row++) {
+        table.presentValue[row] = (float)(generation * 1000000 + row);
+        table.reliability[row] = generation;
+    }
+}
+
+template <typename Column, typename Expected>
+static bool BenchmarkColumnMatches(const Column& column, const Expected& expected) {
+    if (column.size() != expected.size()) {
+        return false;
+    }
+    for (size_t row = 0; row < column.size(); row++) {
+        if (column[row] != expected[row]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename PresentValues, typename Reliabilities>
+static bool BenchmarkSnapshotMatches(const ExampleObjectStore& store, const PresentValues& presentValues, const Reliabilities& reliabilities) {
+    return BenchmarkColumnMatches(store.tables[0].presentValue, presentValues) && BenchmarkColumnMatches(store.tables[0].reliability, reliabilities);
+}
+
+bool ExampleBenchmark::Snapshot(int argc, char** argv) {
+    const size_t count = BenchmarkArgument(argc, argv, 1, 100000);
+    const std::string path = "benchmark_snapshot.bin";
+    const uint16_t objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT;
+    remove(path.c_str());
+
+    ExampleObjectStore store;
+    store.Reserve(objectType, count, count * 16);
+    for (size_t instance = 0; instance < count; instance++) {
+        store.Add(objectType, (uint32_t)instance, "Point " + std::to_string(instance), 0.0f, 1.0f, 0);
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Snapshot benchmark, objects=" << count << std::endl;
+
+    // Performance
+    ExampleSnapshot snapshot;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    if (!snapshot.Open(path, store)) {
+        return false;
+    }
+    double createSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    BenchmarkSnapshotValues(&store, 1, count);
+    snapshot.Save(store, 1);
+    double fullSaveSeconds = snapshot.lastSaveSeconds;
+    size_t fullSaveBytes = snapshot.lastSaveBytes;
+
+    // 1% of the values change between saves; the slot being written is two
+    // saves old, so it differs in the rows changed by both of them
+    const size_t changed = std::max<size_t>(1, count / 100);
+    BenchmarkSnapshotValues(&store, 2, changed);
+    snapshot.Save(store, 2);
+    BenchmarkSnapshotValues(&store, 3, changed);
+    snapshot.Save(store, 3);
+    double incrementalSaveSeconds = snapshot.lastSaveSeconds;
+    size_t incrementalSaveBytes = snapshot.lastSaveBytes;
+    snapshot.Close();
+
+    std::vector<float> generation3Values(store.tables[0].presentValue.begin(), store.tables[0].presentValue.end());
+    std::vector<uint32_t> generation3Reliability(store.tables[0].reliability.begin(), store.tables[0].reliability.end());
+    BenchmarkSnapshotValues(&store, 9, count);
+    start = BenchmarkClock::now();
+    bool restored = snapshot.Open(path, store) && snapshot.Restore(&store);
+    double restoreSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    if (!restored || snapshot.GetGeneration() != 3 || !BenchmarkSnapshotMatches(store, generation3Values, generation3Reliability)) {
+        std::cout << "Error: restored values do not match generation 3" << std::endl;
+        return false;
+    }
+
+    std::cout << "  create file:      " << createSeconds * 1e3 << " ms" << std::endl;
+    std::cout << "  full save:        " << fullSaveSeconds * 1e3 << " ms, " << fullSaveBytes / 1024 << " KB copied" << std::endl;
+    std::cout << "  incremental save: " << incrementalSaveSeconds * 1e3 << " ms, " << incrementalSaveBytes / 1024 << " KB copied (" << changed << " values changed)" << std::endl;
+    std::cout << "  open + restore:   " << restoreSeconds * 1e3 << " ms" << std::endl;
+
+    // Crash consistency. Slot headers are at slotOffset, data follows 64 bytes later.
+    // Generation 3 is newest; generation 2 is in the other slot.
+    snapshot.Close();
+    ExampleSnapshotHeader header;
+    {
+        ExampleMappedFile file;
+        file.Open(path);
+        memcpy(&header, file.GetData(), sizeof(header));
+    }
+    ExampleSnapshotSlotHeader slotHeaders[EXAMPLE_SNAPSHOT_SLOT_COUNT];
+    uint32_t newestSlot = 0;
+    std::vector<uint8_t> original;
+    {
+        ExampleMappedFile file;
+        file.Open(path);
+        original.assign(file.GetData(), file.GetData() + file.GetSize());
+        for (uint32_t slot = 0; slot < EXAMPLE_SNAPSHOT_SLOT_COUNT; slot++) {
+            memcpy(&slotHeaders[slot], file.GetData() + header.slotOffset[slot], sizeof(ExampleSnapshotSlotHeader));
+            if (slotHeaders[slot].generation == 3) {
+                newestSlot = slot;
+            }
+        }
+    }
+    const uint32_t olderSlot = 1 - newestSlot;
+
+    struct CrashCase {
+        const char* name;
+        uint32_t slot;
+        size_t offset;          // From the start of the slot
+        size_t length;
+        uint64_t expectedGeneration;
+    };
+    const size_t dataSize = count * (sizeof(float) + sizeof(uint32_t));
+    const CrashCase cases[] = {
+        // Generation 4 goes to the older slot. Crash while copying its data.
+        { "torn data write", olderSlot, 64 + dataSize / 3, dataSize / 3, 3 },
+        // Crash with the data written but before the header.
+        { "data without header", olderSlot, 64, dataSize, 3 },
+        // Crash while writing the header of generation 3 itself.
+        { "torn header write", newestSlot, 0, 16, 2 },
+        // Bit rot in the newest snapshot's data.
+        { "corrupt newest data", newestSlot, 64 + dataSize - 1, 1, 2 },
+    };
+
+    bool passed = true;
+    for (const CrashCase& test : cases) {
+        {
+            ExampleMappedFile file;
+            file.OpenWritable(path, original.size());
+            memcpy(file.GetWritableData(), original.data(), original.size());
+            uint8_t* target = file.GetWritableData() + header.slotOffset[test.slot] + test.offset;
+            for (size_t offset = 0; offset < test.length; offset++) {
+                target[offset] ^= 0x5A;
+            }
+            file.Flush(0, file.GetSize());
+        }
+
+        // Expected: the newest generation that was not damaged
+        ExampleObjectStore expected;
+        expected.Reserve(objectType, count, count * 16);
+        for (size_t instance = 0; instance < count; instance++) {
+            expected.Add(objectType, (uint32_t)instance, "Point " + std::to_string(instance), 0.0f, 1.0f, 0);
+        }
+        BenchmarkSnapshotValues(&expected, 1, count);
+        BenchmarkSnapshotValues(&expected, 2, changed);
+        if (test.expectedGeneration == 3) {
+            BenchmarkSnapshotValues(&expected, 3, changed);
+        }
+
+        BenchmarkSnapshotValues(&store, 9, count);
+        bool ok = snapshot.Open(path, store) && snapshot.Restore(&store) && snapshot.GetGeneration() == test.expectedGeneration &&
+            BenchmarkSnapshotMatches(store, expected.tables[0].presentValue, expected.tables[0].reliability);
+
+        // The next save must still work and become the newest generation
+        BenchmarkSnapshotValues(&store, 5, changed);
+        ok = ok && snapshot.Save(store, 5) && snapshot.GetGeneration() == test.expectedGeneration + 1;
+        snapshot.Close();
+        ok = ok && snapshot.Open(path, store) && snapshot.Restore(&store) && snapshot.GetGeneration() == test.expectedGeneration + 1;
+        snapshot.Close();
+
+        std::cout << "  crash check, " << test.name << ": " << (ok ? "restored generation " + std::to_string(test.expectedGeneration) : std::string("FAILED")) << std::endl;
+        passed = passed && ok;
+    }
+
+    remove(path.c_str());
+    return passed;
+}
+
+//
+// Concurrency
+// ----------------------------------------------------------------------------
+// Field I/O threads store present value and reliability while reader threads
+// load them, for 1, 2, 4 ... maxThreads writers and as many readers. Every
+// store writes a matching pair (presentValue == reliability), so a reader
+// that sees a pair that does not match has read a torn value. The main thread
+// flushes the COV engine every 10 ms meanwhile, as the example's loop does.
+// The same run without the seqlock shows what the seqlock prevents.
+
+struct BenchmarkConcurrencyCounters {
+    uint64_t operations;
+    uint64_t torn;
+    char padding[64 - 2 * sizeof(uint64_t)];    // One cache line per thread
+};
+
+static void BenchmarkConcurrencyRun(ExampleObjectTable* table, ExampleCOVEngine* engine, const size_t writers, const size_t readers, const size_t milliseconds, const bool locked, std::vector<BenchmarkConcurrencyCounters>* counters, size_t* changes) {
+    const uint32_t points = (uint32_t)table->Size();
+    std::atomic<bool> running(true);
+    counters->assign(writers + readers, BenchmarkConcurrencyCounters());
+    std::vector<std::thread> threads;
+
+    for (size_t writer = 0; writer < writers; writer++) {
+        threads.push_back(std::thread([=, &running]() {
+            // Each writer owns every writers'th point. Values stay below 2^24 so they are exact in a float.
+            uint32_t value = (uint32_t)writer;
+            uint64_t stores = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                for (uint32_t row = (uint32_t)writer; row < points; row += (uint32_t)writers) {
+                    value = (value + 1) & 0xFFFFFF;
+                    table->Store(row, (float)value, value);
+                }
+                stores += (points - writer + writers - 1) / writers;
+            }
+            (*counters)[writer].operations = stores;
+        }));
+    }
+    for (size_t reader = 0; reader < readers; reader++) {
+        threads.push_back(std::thread([=, &running]() {
+            uint32_t random = (uint32_t)reader * 2654435761u + 1;
+            uint64_t loads = 0;
+            uint64_t torn = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                for (int batch = 0; batch < 1024; batch++) {
+                    random = random * 1664525u + 1013904223u;
+                    uint32_t row = (uint32_t)(((uint64_t)random * points) >> 32);
+                    float presentValue;
+                    uint32_t reliability;
+                    if (locked) {
+                        table->Load(row, &presentValue, &reliability);
+                    }
+                    else {
+                        presentValue = table->presentValue[row];
+                        reliability = table->reliability[row];
+                    }
+                    torn += (uint32_t)presentValue != reliability;
+                }
+                loads += 1024;
+            }
+            (*counters)[writers + reader].operations = loads;
+            (*counters)[writers + reader].torn = torn;
+        }));
+    }
+
+    std::vector<ExampleCOVChange> flushed;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    uint64_t now = 0;
+    *changes = 0;
+    while (BenchmarkSeconds(start, BenchmarkClock::now()) * 1000 < milliseconds) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        flushed.clear();
+        now += 10;
+        *changes += engine->Flush(now, &flushed);
+    }
+    running = false;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+bool ExampleBenchmark::Concurrency(int argc, char** argv) {
+    const size_t points = BenchmarkArgument(argc, argv, 1, 100000);
+    const size_t milliseconds = BenchmarkArgument(argc, argv, 2, 1000);
+    const size_t maxThreads = BenchmarkArgument(argc, argv, 3, std::max<size_t>(1, std::thread::hardware_concurrency()));
+    const uint16_t objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT;
+
+    ExampleObjectStore store;
+    store.Reserve(objectType, points, points * 16);
+    for (size_t instance = 0; instance < points; instance++) {
+        store.Add(objectType, (uint32_t)instance, "Point " + std::to_string(instance), 0.0f, 1.0f, 0);
+    }
+    ExampleCOVEngine engine;
+    engine.Initialize(&store);
+    ExampleObjectTable& table = store.tables[0];
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Concurrency benchmark, points=" << points << ", " << milliseconds << " ms per run, cores=" << std::thread::hardware_concurrency() << std::endl;
+
+    bool ok = true;
+    std::vector<BenchmarkConcurrencyCounters> counters;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        for (int locked = 1; locked >= 0; locked--) {
+            size_t changes = 0;
+            BenchmarkConcurrencyRun(&table, &engine, threads, threads, milliseconds, locked != 0, &counters, &changes);
+            uint64_t stores = 0;
+            uint64_t loads = 0;
+            uint64_t torn = 0;
+            for (size_t index = 0; index < counters.size(); index++) {
+                if (index < threads) {
+                    stores += counters[index].operations;
+                }
+                else {
+                    loads += counters[index].operations;
+                }
+                torn += counters[index].torn;
+            }
+            double seconds = milliseconds / 1000.0;
+            std::cout << "  writers=" << threads << " readers=" << threads << (locked ? " seqlock:" : " no lock:") << std::endl;
+            std::cout << "    stores: " << stores / seconds / 1e6 << " M/sec, loads: " << loads / seconds / 1e6 << " M/sec, torn reads: " << torn << ", COV changes: " << changes << std::endl;
+            if (locked && (torn != 0 || stores == 0 || loads == 0 || changes == 0)) {
+                ok = false;
+            }
+        }
+    }
+    std::cout << "  rows stored by field threads and drained by flush: " << engine.updates << std::endl;
+    return ok;
+}
+
+//
+// Timers
+// ----------------------------------------------------------------------------
+// Periodic timers with random periods (100 ms to 10 s) and phases run for a
+// simulated time. The main loop is simulated with random 1 to 10 ms steps.
+// Every expiry must fall inside the step that reported it, and the number of
+// expiries must match the number of periods that fit in the run. The same
+// schedule on a binary heap (std::priority_queue) is the baseline.
+
+struct BenchmarkTimer {
+    uint64_t first;
+    uint32_t period;
+};
+
+bool ExampleBenchmark::Timers(int argc, char** argv) {
+    const size_t timerCount = BenchmarkArgument(argc, argv, 1, 100000);
+    const size_t seconds = BenchmarkArgument(argc, argv, 2, 60);
+    const uint64_t end = seconds * 1000;
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<uint32_t> periods(100, 10000);
+    std::vector<BenchmarkTimer> schedule(timerCount);
+    uint64_t expected = 0;
+    for (BenchmarkTimer& timer : schedule) {
+        timer.period = periods(random);
+        timer.first = 1 + random() % timer.period;
+        if (timer.first <= end) {
+            expected += (end - timer.first) / timer.period + 1;
+        }
+    }
+    std::vector<uint32_t> steps(4096);
+    for (uint32_t& step : steps) {
+        step = 1 + random() % 10;
+    }
+
+    // Insert
+    ExampleTimerWheel wheel;
+    wheel.Reserve(timerCount);
+    std::vector<ExampleTimerId> ids(timerCount);
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t index = 0; index < timerCount; index++) {
+        ids[index] = wheel.Add(schedule[index].first, schedule[index].period, index);
+    }
+    double addSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    // Cancel and add back every tenth timer
+    start = BenchmarkClock::now();
+    size_t cancelled = 0;
+    for (size_t index = 0; index < timerCount; index += 10) {
+        cancelled += wheel.Cancel(ids[index]);
+    }
+    double cancelSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    for (size_t index = 0; index < timerCount; index += 10) {
+        ids[index] = wheel.Add(schedule[index].first, schedule[index].period, index);
+    }
+    bool staleCancel = wheel.Cancel(ids[0] - ((uint64_t)2 << 32));
+
+    // Run
+    std::vector<ExampleTimerExpiry> expiries;
+    expiries.reserve(timerCount);
+    uint64_t now = 0;
+    uint64_t expiryCount = 0;
+    uint64_t late = 0;
+    uint64_t sleepMilliseconds = 0;
+    size_t loops = 0;
+    double advanceSeconds = 0;
+    while (now < end) {
+        uint64_t previous = now;
+        now = std::min<uint64_t>(end, now + steps[loops % steps.size()]);
+        loops++;
+        expiries.clear();
+        start = BenchmarkClock::now();
+        expiryCount += wheel.Advance(now, &expiries);
+        uint64_t nextDeadline = wheel.GetNextDeadline();
+        advanceSeconds += BenchmarkSeconds(start, BenchmarkClock::now());
+
+        for (size_t index = 0; index < expiries.size(); index++) {
+            const ExampleTimerExpiry& expiry = expiries[index];
+            const BenchmarkTimer& timer = schedule[expiry.context];
+            if (expiry.deadline <= previous || expiry.deadline > now || (expiry.deadline - timer.first) % timer.period != 0 ||
+                (index > 0 && expiries[index - 1].deadline > expiry.deadline)) {
+                late++;
+            }
+        }
+        if (nextDeadline > now + 1 && nextDeadline != ExampleTimerWheel::NO_DEADLINE) {
+            sleepMilliseconds += nextDeadline - now - 1;
+        }
+    }
+
+    // Baseline: binary heap of (deadline, timer)
+    typedef std::pair<uint64_t, uint32_t> HeapEntry;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > heap;
+    start = BenchmarkClock::now();
+    for (size_t index = 0; index < timerCount; index++) {
+        heap.push(HeapEntry(schedule[index].first, (uint32_t)index));
+    }
+    double heapAddSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    uint64_t heapExpiryCount = 0;
+    now = 0;
+    loops = 0;
+    start = BenchmarkClock::now();
+    while (now < end) {
+        now = std::min<uint64_t>(end, now + steps[loops % steps.size()]);
+        loops++;
+        while (!heap.empty() && heap.top().first <= now) {
+            HeapEntry entry = heap.top();
+            heap.pop();
+            heapExpiryCount++;
+            heap.push(HeapEntry(entry.first + schedule[entry.second].period, entry.second));
+        }
+    }
+    double heapSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Timer wheel benchmark, timers=" << timerCount << ", simulated seconds=" << seconds << ", loops=" << loops << std::endl;
+    std::cout << "  add:        " << (addSeconds * 1e9) / timerCount << " ns/timer (heap " << (heapAddSeconds * 1e9) / timerCount << ")" << std::endl;
+    std::cout << "  cancel:     " << (cancelSeconds * 1e9) / std::max<size_t>(1, cancelled) << " ns/timer, " << cancelled << " cancelled, stale id rejected: " << (staleCancel ? "no" : "yes") << std::endl;
+    std::cout << "  expiries:   " << expiryCount << " (expected " << expected << "), " << late << " outside their loop step" << std::endl;
+    std::cout << "  advance:    " << (advanceSeconds * 1e9) / std::max<uint64_t>(1, expiryCount) << " ns/expiry incl. cascades, " << (advanceSeconds * 1e3) / seconds << " ms per simulated second" << std::endl;
+    std::cout << "  heap:       " << (heapSeconds * 1e9) / std::max<uint64_t>(1, heapExpiryCount) << " ns/expiry, " << (heapSeconds * 1e3) / seconds << " ms per simulated second (" << heapExpiryCount << " expiries)" << std::endl;
+    std::cout << "  cascaded:   " << wheel.cascaded << " (" << (double)wheel.cascaded / std::max<uint64_t>(1, expiryCount) << " per expiry)" << std::endl;
+    std::cout << "  idle sleep: " << sleepMilliseconds << " ms of " << end << " ms could be slept" << std::endl;
+    std::cout << "  memory:     " << wheel.GetMemoryUsage() / 1024 << " KB" << std::endl;
+    return expiryCount == expected && heapExpiryCount == expected && late == 0 && !staleCancel && cancelled == (timerCount + 9) / 10;
+}
+
+//
+// Trend Log
+// ----------------------------------------------------------------------------
+// Logs a point every second (with a few milliseconds of jitter) and reports
+// bytes per record, then the latency of ReadRange by position, sequence and
+// time for random windows. Every query is checked against an uncompressed
+// copy. Two signals: a temperature with 0.1 resolution, and noise in every
+// bit of the mantissa, the worst case for XOR compression. Last, a smaller
+// log wraps around many times and must still answer correctly.
+
+struct BenchmarkTrendLogSample {
+    uint64_t timestamp;
+    float value;
+};
+
+// Expected result of a ReadRange on the samples still in the log
+static void BenchmarkTrendLogExpected(const std::vector<BenchmarkTrendLogSample>& samples, const size_t first, const int64_t reference, const int32_t count, size_t* begin, size_t* end) {
+    int64_t low = count > 0 ? reference : reference + count + 1;
+    int64_t high = count > 0 ? reference + count - 1 : reference;
+    low = std::max<int64_t>(low, (int64_t)first);
+    high = std::min<int64_t>(high, (int64_t)samples.size() - 1);
+    if (reference < (int64_t)first || reference >= (int64_t)samples.size() || low > high) {
+        *begin = *end = 0;
+        return;
+    }
+    *begin = (size_t)low;
+    *end = (size_t)high + 1;
+}
+
+static bool BenchmarkTrendLogMatches(const std::vector<BenchmarkTrendLogSample>& samples, const size_t begin, const size_t end, const std::vector<ExampleTrendLogRecord>& records) {
+    if (records.size() != end - begin) {
+        return false;
+    }
+    for (size_t index = 0; index < records.size(); index++) {
+        const BenchmarkTrendLogSample& sample = samples[begin + index];
+        if (records[index].timestamp != sample.timestamp || records[index].value != sample.value || records[index].sequence != (uint32_t)(begin + index + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run random queries of each kind; returns the number of wrong results
+static size_t BenchmarkTrendLogQueries(const ExampleTrendLog& log, const std::vector<BenchmarkTrendLogSample>& samples, const size_t queries, const int32_t window, double* positionSeconds, double* sequenceSeconds, double* timeSeconds) {
+    std::mt19937 random(99);
+    const size_t first = samples.size() - log.GetRecordCount();
+    std::vector<ExampleTrendLogRecord> records;
+    records.reserve(std::abs(window));
+    size_t wrong = 0;
+    *positionSeconds = *sequenceSeconds = *timeSeconds = 0;
+    for (size_t query = 0; query < queries; query++) {
+        size_t reference = first + random() % log.GetRecordCount();
+        int32_t count = (query & 1) ? -window : window;
+        size_t begin;
+        size_t end;
+        BenchmarkTrendLogExpected(samples, first, (int64_t)reference, count, &begin, &end);
+
+        records.clear();
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        log.ReadByPosition((uint32_t)(reference - first + 1), count, &records);
+        *positionSeconds += BenchmarkSeconds(start, BenchmarkClock::now());
+        wrong += !BenchmarkTrendLogMatches(samples, begin, end, records);
+
+        records.clear();
+        start = BenchmarkClock::now();
+        log.ReadBySequence((uint32_t)(reference + 1), count, &records);
+        *sequenceSeconds += BenchmarkSeconds(start, BenchmarkClock::now());
+        wrong += !BenchmarkTrendLogMatches(samples, begin, end, records);
+
+        // By time: a reference between two records, the window starts at the newer (count > 0) or older one
+        uint64_t time = samples[reference].timestamp + (count > 0 ? -1 : 1);
+        records.clear();
+        start = BenchmarkClock::now();
+        log.ReadByTime(time, count, &records);
+        *timeSeconds += BenchmarkSeconds(start, BenchmarkClock::now());
+        wrong += !BenchmarkTrendLogMatches(samples, begin, end, records);
+    }
+    *positionSeconds /= queries;
+    *sequenceSeconds /= queries;
+    *timeSeconds /= queries;
+    return wrong;
+}
+
+bool ExampleBenchmark::TrendLog(int argc, char** argv) {
+    const size_t recordCount = BenchmarkArgument(argc, argv, 1, 1000000);
+    const size_t queries = BenchmarkArgument(argc, argv, 2, 10000);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Trend Log benchmark, records=" << recordCount << ", queries=" << queries << ", block size=" << ExampleTrendLog::BLOCK_SIZE << " bytes" << std::endl;
+
+    bool ok = true;
+    for (int signal = 0; signal < 2; signal++) {
+        std::mt19937 random(1234);
+        std::normal_distribution<float> walk(0.0f, 0.05f);
+        std::uniform_real_distribution<float> noise(-10.0f, 10.0f);
+        std::vector<BenchmarkTrendLogSample> samples(recordCount);
+        uint64_t timestamp = 1700000000000ull;
+        float temperature = 21.0f;
+        for (BenchmarkTrendLogSample& sample : samples) {
+            timestamp += 998 + random() % 5;
+            temperature += walk(random);
+            sample.timestamp = timestamp;
+            sample.value = signal == 0 ? roundf(temperature * 10.0f) / 10.0f : noise(random);
+        }
+
+        // Enough blocks for every record at 8 bytes each
+        ExampleTrendLog log;
+        log.Initialize((uint32_t)((recordCount * 8 + ExampleTrendLog::BLOCK_SIZE - 1) / ExampleTrendLog::BLOCK_SIZE));
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        for (const BenchmarkTrendLogSample& sample : samples) {
+            log.Add(sample.timestamp, sample.value);
+        }
+        double addSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        if (log.GetRecordCount() != recordCount) {
+            std::cerr << "Error: The log dropped records" << std::endl;
+            return false;
+        }
+
+        std::vector<ExampleTrendLogRecord> records;
+        records.reserve(recordCount);
+        start = BenchmarkClock::now();
+        log.ReadByPosition(1, (int32_t)std::min<size_t>(recordCount, INT32_MAX), &records);
+        double scanSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        size_t wrong = !BenchmarkTrendLogMatches(samples, 0, recordCount, records);
+
+        std::cout << "  " << (signal == 0 ? "temperature (0.1 resolution):" : "noise (every bit changes):") << std::endl;
+        std::cout << "    size:       " << (double)log.GetUsedBytes() / recordCount << " bytes/record (uncompressed " << sizeof(uint64_t) + sizeof(float) << "), " << log.GetUsedBytes() / 1024 << " KB" << std::endl;
+        std::cout << "    add:        " << (addSeconds * 1e9) / recordCount << " ns/record" << std::endl;
+        std::cout << "    full read:  " << scanSeconds * 1e3 << " ms, " << (scanSeconds * 1e9) / recordCount << " ns/record" << std::endl;
+        const int32_t windows[] = { 10, 100, 1000 };
+        for (int32_t window : windows) {
+            double positionSeconds;
+            double sequenceSeconds;
+            double timeSeconds;
+            wrong += BenchmarkTrendLogQueries(log, samples, queries, window, &positionSeconds, &sequenceSeconds, &timeSeconds);
+            std::cout << "    ReadRange " << std::setw(4) << window << " records: by position " << positionSeconds * 1e6 << " us, by sequence " << sequenceSeconds * 1e6 << " us, by time " << timeSeconds * 1e6 << " us" << std::endl;
+        }
+        std::cout << "    wrong results: " << wrong << std::endl;
+        ok = ok && wrong == 0;
+    }
+
+    // A log much smaller than the records written keeps only the newest
+    {
+        std::vector<BenchmarkTrendLogSample> samples(recordCount);
+        ExampleTrendLog log;
+        log.Initialize(64);
+        for (size_t index = 0; index < recordCount; index++) {
+            samples[index].timestamp = 1000 * (uint64_t)index;
+            samples[index].value = (float)(index % 100);
+            log.Add(samples[index].timestamp, samples[index].value);
+        }
+        double positionSeconds;
+        double sequenceSeconds;
+        double timeSeconds;
+        size_t wrong = BenchmarkTrendLogQueries(log, samples, queries, 100, &positionSeconds, &sequenceSeconds, &timeSeconds);
+        std::cout << "  wrapped log, 64 blocks: " << log.GetRecordCount() << " records kept of " << log.GetTotalRecordCount() << ", wrong results: " << wrong << std::endl;
+        ok = ok && wrong == 0 && log.GetTotalRecordCount() == (uint32_t)recordCount;
+    }
+    return ok;
+}
+
+//
+// Priority
+// ----------------------------------------------------------------------------
+// Random commands and relinquishes at random priorities on many outputs,
+// each followed by reading the effective value, as a WriteProperty does.
+// Measured on the priority arrays alone, against 16 flags scanned from the
+// top, then through the Set Property callbacks of the property table.
+
+// Priority array as a flag per slot, the effective value is a scan
+struct BenchmarkPriorityArrayScan {
+    float values[ExamplePriorityArray::LENGTH];
+    bool commanded[ExamplePriorityArray::LENGTH];
+    float relinquishDefault;
+
+    float GetEffectiveValue() const {
+        for (uint8_t offset = 0; offset < ExamplePriorityArray::LENGTH; offset++) {
+            if (this->commanded[offset]) {
+                return this->values[offset];
+            }
+        }
+        return this->relinquishDefault;
+    }
+};
+
+struct BenchmarkPriorityOperation {
+    uint32_t row;
+    uint8_t priority;
+    bool relinquish;
+    float value;
+};
+
+bool ExampleBenchmark::Priority(int argc, char** argv) {
+    const size_t count = BenchmarkArgument(argc, argv, 1, 100000);
+    const size_t operationCount = BenchmarkArgument(argc, argv, 2, 10000000);
+    const uint16_t objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT;
+
+    // Most commands come from a few priorities, relinquishes at the same ones
+    std::mt19937 random(35);
+    const uint8_t priorities[] = { 1, 5, 8, 8, 10, 16, 16, 16 };
+    std::vector<BenchmarkPriorityOperation> operations(operationCount);
+    for (BenchmarkPriorityOperation& operation : operations) {
+        operation.row = (uint32_t)(random() % count);
+        operation.priority = priorities[random() % (sizeof(priorities) / sizeof(priorities[0]))];
+        operation.relinquish = random() % 5 < 2;
+        operation.value = (float)(random() % 1000);
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Priority array benchmark, outputs=" << count << ", operations=" << operationCount << " (60% command, 40% relinquish)" << std::endl;
+
+    // Priority arrays alone
+    std::vector<ExamplePriorityArray> arrays(count);
+    std::vector<BenchmarkPriorityArrayScan> scans(count);
+    for (size_t row = 0; row < count; row++) {
+        arrays[row].Initialize(-1.0f);
+        memset(&scans[row], 0, sizeof(BenchmarkPriorityArrayScan));
+        scans[row].relinquishDefault = -1.0f;
+    }
+
+    float sum = 0;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (const BenchmarkPriorityOperation& operation : operations) {
+        ExamplePriorityArray& array = arrays[operation.row];
+        if (operation.relinquish) {
+            array.Relinquish(operation.priority);
+        }
+        else {
+            array.Command(operation.priority, operation.value);
+        }
+        sum += array.GetEffectiveValue();
+    }
+    double maskSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    float scanSum = 0;
+    start = BenchmarkClock::now();
+    for (const BenchmarkPriorityOperation& operation : operations) {
+        BenchmarkPriorityArrayScan& scan = scans[operation.row];
+        scan.commanded[operation.priority - 1] = !operation.relinquish;
+        scan.values[operation.priority - 1] = operation.value;
+        scanSum += scan.GetEffectiveValue();
+    }
+    double scanSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    size_t wrong = 0;
+    for (size_t row = 0; row < count; row++) {
+        wrong += arrays[row].GetEffectiveValue() != scans[row].GetEffectiveValue();
+    }
+    std::cout << "  bitmask:  " << (maskSeconds * 1e9) / operationCount << " ns/operation, " << sizeof(ExamplePriorityArray) << " bytes/output (" << sum << ")" << std::endl;
+    std::cout << "  scan:     " << (scanSeconds * 1e9) / operationCount << " ns/operation, " << sizeof(BenchmarkPriorityArrayScan) << " bytes/output (" << scanSum << ")" << std::endl;
+
+    // WriteProperty through the property table: lookup, command, present value and COV
+    ExampleDatabase database;
+    database.objects.Reserve(objectType, count, count * 24);
+    for (size_t instance = database.objects.GetTable(objectType)->Size(); instance < count; instance++) {
+        database.objects.Add(objectType, (uint32_t)instance, "AnalogOutput " + std::to_string(instance), -1.0f, 1.0f, 0);
+    }
+    // The output created by Setup has a different Relinquish_Default
+    const size_t tableIndex = (size_t)(database.objects.GetTable(objectType) - database.objects.tables.data());
+    database.SetRelinquishDefault(tableIndex, 0, -1.0f);
+    database.cov.Initialize(&database.objects);
+    const size_t memoryBefore = database.objects.GetMemoryUsage();
+
+    ExamplePropertyRequest request = { &database, database.device.instance, objectType, 0, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, false, 0, NULL };
+    uint32_t errorCode = 0;
+    size_t rejected = 0;
+    start = BenchmarkClock::now();
+    for (const BenchmarkPriorityOperation& operation : operations) {
+        request.objectInstance = operation.row;
+        ExampleWriteValue write = { operation.value, operation.priority, &errorCode };
+        bool written = operation.relinquish ? ExamplePropertyTable::SetNull(request, &write) : ExamplePropertyTable::SetReal(request, &write);
+        rejected += !written;
+    }
+    double writeSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    // The present value and every slot of the Priority_Array must match the reference
+    for (uint32_t row = 0; row < count; row++) {
+        request.objectInstance = row;
+        request.propertyIdentifier = CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE;
+        request.useArrayIndex = false;
+        float value;
+        wrong += !ExamplePropertyTable::GetReal(request, &value) || value != scans[row].GetEffectiveValue();
+        request.propertyIdentifier = CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY;
+        request.useArrayIndex = true;
+        for (uint8_t priority = 1; priority <= ExamplePriorityArray::LENGTH; priority++) {
+            request.propertyArrayIndex = priority;
+            bool commanded = ExamplePropertyTable::GetReal(request, &value);
+            wrong += commanded != scans[row].commanded[priority - 1] || (commanded && value != scans[row].values[priority - 1]);
+        }
+    }
+    std::cout << "  WriteProperty: " << (writeSeconds * 1e9) / operationCount << " ns/write, present value changed by " << database.cov.writes << " writes, rejected=" << rejected << std::endl;
+    std::cout << "  memory grown by writes: " << database.objects.GetMemoryUsage() - memoryBefore << " bytes" << std::endl;
+    std::cout << "  wrong results: " << wrong << std::endl;
+
+    // Out of range values and priorities are rejected with an error code
+    request.propertyIdentifier = CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE;
+    request.useArrayIndex = false;
+    request.objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT;
+    request.objectInstance = 0;
+    ExampleWriteValue invalid = { 2.0f, 8, &errorCode };
+    errorCode = 0;
+    bool invalidRejected = !ExamplePropertyTable::SetEnumerated(request, &invalid) && errorCode == CASBACnetStackExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+    invalid.value = 1.0f;
+    invalid.priority = 17;
+    errorCode = 0;
+    invalidRejected = invalidRejected && !ExamplePropertyTable::SetEnumerated(request, &invalid) && errorCode == CASBACnetStackExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+    std::cout << "  invalid writes rejected: " << (invalidRejected ? "yes" : "no") << std::endl;
+    return wrong == 0 && rejected == 0 && invalidRejected;
+}
+
+//
+// RPM
+// ----------------------------------------------------------------------------
+// ReadPropertyMultiple requests of 25 random objects with 4 properties each
+// (present value, COV increment, reliability, object name), for each object
+// count. Served one property per callback without and with the object cache,
+// the way the stack calls in, then with the objects of each request looked
+// up ahead by ExamplePropertyBatch::Prepare as the received frame would be,
+// and as one ExamplePropertyBatch::Read per request. Then again with the
+// properties of each request in random order.
+
+static bool BenchmarkRPM(const size_t count, const size_t requestCount) {
+    const size_t objectsPerRequest = 25;
+    const uint16_t objectType = CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT;
+
+    ExampleDatabase database;
+    database.objects.Reserve(objectType, count, count * 24);
+    for (size_t instance = database.objects.GetTable(objectType)->Size(); instance < count; instance++) {
+        database.objects.Add(objectType, (uint32_t)instance, "AnalogInput " + std::to_string(instance), (float)instance, 1.0f, 0);
+    }
+
+    struct Property {
+        uint32_t propertyIdentifier;
+        uint8_t kind;
+    };
+    const Property properties[] = {
+        { CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, ExamplePropertyAccess::KIND_REAL },
+        { CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_COV_INCURMENT, ExamplePropertyAccess::KIND_REAL },
+        { CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, ExamplePropertyAccess::KIND_ENUMERATED },
+        { CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, ExamplePropertyAccess::KIND_CHARACTER_STRING },
+    };
+    const size_t propertyCount = sizeof(properties) / sizeof(properties[0]);
+    const size_t accessCount = objectsPerRequest * propertyCount;
+
+    // Every request lists its objects in increasing instance order, each with all its properties
+    std::mt19937 random(36);
+    std::vector<uint32_t> instances(requestCount * objectsPerRequest);
+    for (size_t request = 0; request < requestCount; request++) {
+        uint32_t* first = &instances[request * objectsPerRequest];
+        for (size_t object = 0; object < objectsPerRequest; object++) {
+            first[object] = (uint32_t)(random() % count);
+        }
+        std::sort(first, first + objectsPerRequest);
+    }
+
+    char names[accessCount][64];
+    uint32_t nameLengths[accessCount];
+    uint8_t encodingTypes[accessCount];
+    std::vector<ExamplePropertyAccess> accesses(accessCount);
+    for (size_t offset = 0; offset < accessCount; offset++) {
+        ExamplePropertyAccess& access = accesses[offset];
+        access.objectType = objectType;
+        access.propertyIdentifier = properties[offset % propertyCount].propertyIdentifier;
+        access.kind = properties[offset % propertyCount].kind;
+        access.useArrayIndex = false;
+        access.propertyArrayIndex = 0;
+        if (access.kind == ExamplePropertyAccess::KIND_CHARACTER_STRING) {
+            ExampleCharacterString characterString = { names[offset], &nameLengths[offset], sizeof(names[offset]), &encodingTypes[offset] };
+            access.characterString = characterString;
+        }
+    }
+
+    std::cout << "ReadPropertyMultiple benchmark, objects=" << count << ", requests=" << requestCount << " of " << accessCount << " properties" << std::endl;
+
+    // Each mode serves the same requests, best of three rounds
+    static const uint8_t MODE_CALLBACKS = 0;
+    static const uint8_t MODE_CACHE = 1;
+    static const uint8_t MODE_PREPARED = 2;
+    static const uint8_t MODE_BATCH = 3;
+    struct Mode {
+        const char* name;
+        uint8_t mode;
+        bool shuffled;
+    };
+    const Mode modes[] = {
+        { "callbacks, no cache:           ", MODE_CALLBACKS, false },
+        { "callbacks, object cache:       ", MODE_CACHE, false },
+        { "callbacks, prepared batch:     ", MODE_PREPARED, false },
+        { "batch:                         ", MODE_BATCH, false },
+        { "callbacks shuffled, no cache:  ", MODE_CALLBACKS, true },
+        { "callbacks shuffled, cache:     ", MODE_CACHE, true },
+        { "batch shuffled:                ", MODE_BATCH, true },
+    };
+    const size_t modeCount = sizeof(modes) / sizeof(modes[0]);
+    bool ok = true;
+    double expectedChecksum = -1;
+    double modeSeconds[modeCount];
+    std::vector<uint32_t> order(accessCount);
+    std::vector<ExamplePropertyAccess> requestAccesses(accessCount);
+    uint8_t apdu[APDU_MAX_LENGTH];
+    uint8_t frame[APDU_MAX_LENGTH + 64];
+    const uint8_t vmac[BVLC_SC_VMAC_LENGTH] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x36 };
+    for (size_t modeIndex = 0; modeIndex < modeCount; modeIndex++) {
+        const Mode& mode = modes[modeIndex];
+        for (size_t offset = 0; offset < accessCount; offset++) {
+            order[offset] = (uint32_t)offset;
+        }
+        if (mode.shuffled) {
+            std::shuffle(order.begin(), order.end(), random);
+        }
+        double bestSeconds = 0;
+        for (int round = 0; round < 3; round++) {
+            ExamplePropertyBatch batch;
+            batch.SetMinObjects(0);
+            ExampleObjectCache cache;
+            ExamplePropertyRequest request = { &database, database.device.instance, objectType, 0, 0, false, 0, mode.mode == MODE_CALLBACKS ? NULL : &cache };
+            double checksum = 0;
+            size_t found = 0;
+            size_t prepared = 0;
+            double seconds = 0;
+            for (size_t index = 0; index < requestCount; index++) {
+                for (size_t offset = 0; offset < accessCount; offset++) {
+                    requestAccesses[offset] = accesses[order[offset]];
+                    requestAccesses[offset].objectInstance = instances[index * objectsPerRequest + order[offset] / propertyCount];
+                }
+                size_t frameLength = 0;
+                if (mode.mode == MODE_PREPARED) {
+                    // The request as the stack would receive it
+                    ExampleApduWriter writer(apdu, sizeof(apdu));
+                    writer.Byte(APDU_TYPE_CONFIRMED_REQUEST << 4);
+                    writer.Byte(APDU_MAX_APDU_ACCEPTED_1476);
+                    writer.Byte((uint8_t)index);
+                    writer.Byte(APDU_SERVICE_READ_PROPERTY_MULTIPLE);
+                    for (size_t object = 0; object < objectsPerRequest; object++) {
+                        writer.ContextObjectIdentifier(0, objectType, instances[index * objectsPerRequest + object]);
+                        writer.OpeningTag(1);
+                        for (const Property& property : properties) {
+                            writer.ContextUnsigned(0, property.propertyIdentifier);
+                        }
+                        writer.ClosingTag(1);
+                    }
+                    frameLength = ExampleApdu::BuildFrame(frame, sizeof(frame), (uint16_t)index, vmac, true, apdu, writer.GetLength());
+                }
+                BenchmarkClock::time_point start = BenchmarkClock::now();
+                if (mode.mode == MODE_BATCH) {
+                    found += batch.Read(&database, requestAccesses.data(), accessCount);
+                }
+                else {
+                    if (mode.mode == MODE_PREPARED) {
+                        prepared += batch.Prepare(&database, frame, frameLength);
+                    }
+                    // One Get Property call per property, as the stack makes them
+                    for (ExamplePropertyAccess& access : requestAccesses) {
+                        request.objectInstance = access.objectInstance;
+                        request.propertyIdentifier = access.propertyIdentifier;
+                        if (mode.mode == MODE_PREPARED) {
+                            batch.Resolve(objectType, access.objectInstance, &cache);
+                        }
+                        if (access.kind == ExamplePropertyAccess::KIND_REAL) {
+                            access.found = ExamplePropertyTable::GetReal(request, &access.realValue);
+                        }
+                        else if (access.kind == ExamplePropertyAccess::KIND_ENUMERATED) {
+                            access.found = ExamplePropertyTable::GetEnumerated(request, &access.unsignedValue);
+                        }
+                        else {
+                            access.found = ExamplePropertyTable::GetCharacterString(request, &access.characterString);
+                        }
+                        found += access.found;
+                    }
+                }
+                seconds += BenchmarkSeconds(start, BenchmarkClock::now());
+                for (const ExamplePropertyAccess& access : requestAccesses) {
+                    if (access.kind == ExamplePropertyAccess::KIND_REAL) {
+                        checksum += access.realValue;
+                    }
+                    else if (access.kind == ExamplePropertyAccess::KIND_ENUMERATED) {
+                        checksum += access.unsignedValue;
+                    }
+                    else {
+                        checksum += *access.characterString.valueElementCount;
+                    }
+                }
+            }
+            if (expectedChecksum < 0) {
+                expectedChecksum = checksum;
+            }
+            ok = ok && found == requestCount * accessCount && checksum == expectedChecksum;
+            ok = ok && (mode.mode != MODE_PREPARED || prepared == requestCount * objectsPerRequest);
+            bestSeconds = round == 0 ? seconds : std::min(bestSeconds, seconds);
+        }
+        modeSeconds[modeIndex] = bestSeconds;
+        std::cout << "  " << mode.name << requestCount / bestSeconds << " requests/sec, " << (bestSeconds * 1e9) / (requestCount * accessCount) << " ns/property" << std::endl;
+    }
+    std::cout << "  prepared batch against cache: " << modeSeconds[1] / modeSeconds[2] << "x, batch against cache: " << modeSeconds[1] / modeSeconds[3] << "x";
+    std::cout << (count >= ExamplePropertyBatch::MIN_OBJECTS ? " (the stack path prepares at this size)" : " (the stack path does not prepare at this size)") << std::endl;
+    std::cout << "  results match: " << (ok ? "yes" : "no") << std::endl;
+    return ok;
+}
+
+bool ExampleBenchmark::RPM(int argc, char** argv) {
+    const size_t requestCount = BenchmarkArgument(argc, argv, 1, 100000);
+    std::vector<size_t> counts;
+    for (int offset = 2; offset < argc; offset++) {
+        counts.push_back((size_t)std::stoull(argv[offset]));
+    }
+    if (counts.empty()) {
+        counts = { 100000, 1000000 };
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    bool ok = true;
+    for (size_t count : counts) {
+        ok = BenchmarkRPM(count, requestCount) && ok;
+    }
+    return ok;
+}
+
+//
+// Metrics
+// ----------------------------------------------------------------------------
+
+// GET a target from the metrics endpoint, returns the status code
+static unsigned BenchmarkHttpGet(const uint16_t port, const std::string& target, std::string* body) {
+    net::io_context ioc;
+    beast::tcp_stream stream(ioc);
+    stream.connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port));
+    http::request<http::empty_body> request(http::verb::get, target, 11);
+    request.set(http::field::host, "127.0.0.1");
+    http::write(stream, request);
+    beast::flat_buffer buffer;
+    http::response<http::string_body> response;
+    http::read(stream, buffer, response);
+    *body = response.body();
+    return response.result_int();
+}
+
+bool ExampleBenchmark::Metrics(int argc, char** argv) {
+    const size_t operationCount = BenchmarkArgument(argc, argv, 1, 10000000);
+    const size_t threadCount = BenchmarkArgument(argc, argv, 2, 2);
+    const size_t connectionCount = BenchmarkArgument(argc, argv, 3, 100);
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Metrics benchmark, operations=" << operationCount << ", threads=" << threadCount << ", connections=" << connectionCount << std::endl;
+
+    // Bucket bounds are inclusive
+    const uint64_t bucketValues[] = { 0, 1024, 1025, 2048, (uint64_t)1 << 34, ((uint64_t)1 << 34) + 1, UINT64_MAX };
+    const uint32_t bucketIndexes[] = { 0, 0, 1, 1, 24, 25, 25 };
+    for (size_t offset = 0; offset < sizeof(bucketValues) / sizeof(bucketValues[0]); offset++) {
+        ok = ok && ExampleMetricHistogram::GetBucketIndex(bucketValues[offset]) == bucketIndexes[offset];
+    }
+    std::cout << "  histogram buckets: " << (ok ? "ok" : "wrong") << std::endl;
+
+    // One thread, what the main loop and a websocket thread pay per update
+    ExampleMetricsRegistry registry;
+    ExampleMetricCounter* counter = registry.AddCounter("benchmark_total", "Benchmark counter");
+    ExampleMetricHistogram* histogram = registry.AddHistogram("benchmark_duration_seconds", "Benchmark histogram");
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t index = 0; index < operationCount; index++) {
+        counter->Add();
+    }
+    double counterSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    start = BenchmarkClock::now();
+    for (size_t index = 0; index < operationCount; index++) {
+        histogram->Observe((uint64_t)index * 977);
+    }
+    double histogramSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    // Timing a call, as done around fpLoop()
+    const size_t timedCount = operationCount / 10;
+    start = BenchmarkClock::now();
+    for (size_t index = 0; index < timedCount; index++) {
+        BenchmarkClock::time_point callStart = BenchmarkClock::now();
+        histogram->Observe((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - callStart).count());
+    }
+    double timedSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    ok = ok && counter->Get() == operationCount && histogram->GetCount() == operationCount + timedCount;
+
+    std::cout << "  counter add:          " << (counterSeconds * 1e9) / operationCount << " ns" << std::endl;
+    std::cout << "  histogram observe:    " << (histogramSeconds * 1e9) / operationCount << " ns" << std::endl;
+    std::cout << "  timed call (2 clock reads + observe): " << (timedSeconds * 1e9) / timedCount << " ns" << std::endl;
+
+    // Several threads updating the same metrics, nothing may be lost
+    ExampleMetricCounter* shared = registry.AddCounter("benchmark_shared_total", "Benchmark counter shared by threads");
+    ExampleMetricHistogram* sharedHistogram = registry.AddHistogram("benchmark_shared_duration_seconds", "Benchmark histogram shared by threads");
+    std::vector<std::thread> threads;
+    start = BenchmarkClock::now();
+    for (size_t thread = 0; thread < threadCount; thread++) {
+        threads.emplace_back([&] {
+            for (size_t index = 0; index < operationCount / threadCount; index++) {
+                shared->Add();
+                sharedHistogram->Observe(index);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double sharedSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    const size_t sharedExpected = (operationCount / threadCount) * threadCount;
+    ok = ok && shared->Get() == sharedExpected && sharedHistogram->GetCount() == sharedExpected;
+    std::cout << "  " << threadCount << " threads, counter + observe: " << (sharedSeconds * 1e9) / sharedExpected << " ns, lost updates: " << (sharedExpected - std::min<uint64_t>(shared->Get(), sharedExpected)) << std::endl;
+
+    // Rendering, one set of metrics per connection
+    ExampleConnectionMetrics connection;
+    for (size_t offset = 0; offset < connectionCount; offset++) {
+        registry.AddConnection("wss://192.168.1." + std::to_string(offset) + ":4443/", &connection);
+        connection.framesIn->Add(offset);
+        connection.writeLatency->Observe(offset * 1000);
+    }
+    // Registering a connection again returns the same metrics
+    ExampleConnectionMetrics again;
+    registry.AddConnection("wss://192.168.1.0:4443/", &again);
+    ok = ok && again.framesIn != connection.framesIn && again.framesIn == registry.AddCounter("bacnet_sc_frames_received_total", "", ExampleMetricsRegistry::Label("uri", "wss://192.168.1.0:4443/"));
+    ok = ok && registry.AddGauge("bacnet_sc_frames_received_total", "Wrong type") == NULL;
+
+    std::string text;
+    const int renderCount = 100;
+    start = BenchmarkClock::now();
+    for (int round = 0; round < renderCount; round++) {
+        text.clear();
+        registry.Render(&text);
+    }
+    double renderSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    std::cout << "  render: " << registry.GetSeriesCount() << " series, " << text.size() << " bytes in " << (renderSeconds * 1e3) / renderCount << " ms" << std::endl;
+
+    // Scrape through the endpoint
+    ExampleMetricsServer server;
+    if (!server.Start("127.0.0.1", 0, &registry)) {
+        return false;
+    }
+    std::string body;
+    unsigned status = BenchmarkHttpGet(server.GetPort(), "/metrics", &body);
+    bool scraped = status == 200 && body.find("# TYPE bacnet_sc_write_duration_seconds histogram") != std::string::npos && body.find("benchmark_total " + std::to_string(operationCount)) != std::string::npos;
+    std::string missing;
+    bool notFound = BenchmarkHttpGet(server.GetPort(), "/other", &missing) == 404;
+    server.Stop();
+    ok = ok && scraped && notFound;
+    std::cout << "  scrape /metrics: " << (scraped ? "ok" : "failed") << " (" << body.size() << " bytes), other targets 404: " << (notFound ? "yes" : "no") << std::endl;
+    return ok;
+}
+
+//
+// Profiler
+// ----------------------------------------------------------------------------
+
+// Busy wait, so the time is spent inside the section
+static void BenchmarkSpin(const uint64_t nanoseconds) {
+    uint64_t end = ExampleProfilerClock::NowNanoseconds() + nanoseconds;
+    while (ExampleProfilerClock::NowNanoseconds() < end) {
+    }
+}
+
+bool ExampleBenchmark::Profiler(int argc, char** argv) {
+    const size_t sampleCount = BenchmarkArgument(argc, argv, 1, 1000000);
+    const size_t iterationCount = BenchmarkArgument(argc, argv, 2, 100);
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Profiler benchmark, samples=" << sampleCount << ", iterations=" << iterationCount << std::endl;
+
+    // Percentiles of a long tailed latency distribution against the exact ones
+    std::mt19937_64 random(38);
+    std::lognormal_distribution<double> latency(log(20000.0), 1.5);
+    std::vector<uint64_t> samples(sampleCount);
+    for (uint64_t& sample : samples) {
+        sample = (uint64_t)latency(random);
+    }
+    ExampleHdrHistogram histogram;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (uint64_t sample : samples) {
+        histogram.Record(sample);
+    }
+    double recordSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    std::sort(samples.begin(), samples.end());
+
+    const double percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+    double worstError = 0;
+    std::cout << "  HDR histogram, " << sizeof(uint64_t) * ExampleHdrHistogram::COUNT_LENGTH / 1024 << " KB, record " << (recordSeconds * 1e9) / sampleCount << " ns" << std::endl;
+    for (double percentile : percentiles) {
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)(percentile / 100.0 * sampleCount + 0.5));
+        uint64_t exact = samples[std::min<size_t>(rank, sampleCount) - 1];
+        uint64_t estimate = histogram.GetPercentile(percentile);
+        double error = exact == 0 ? 0.0 : fabs((double)estimate - (double)exact) / exact;
+        worstError = std::max(worstError, error);
+        std::cout << "    p" << std::setprecision(percentile < 99.9 ? 0 : 2) << percentile << std::setprecision(2) << ": exact " << exact / 1e3 << " us, histogram " << estimate / 1e3 << " us" << std::endl;
+    }
+    ok = ok && worstError <= 1.0 / ExampleHdrHistogram::SUB_BUCKET_COUNT && histogram.GetMaximum() == samples.back();
+    std::cout << "    worst relative error " << worstError * 100 << "% (bound " << 100.0 / ExampleHdrHistogram::SUB_BUCKET_COUNT << "%), max exact: " << (histogram.GetMaximum() == samples.back() ? "yes" : "no") << std::endl;
+
+    // Clock reads
+    const size_t readCount = 10000000;
+    uint64_t sum = 0;
+    start = BenchmarkClock::now();
+    for (size_t index = 0; index < readCount; index++) {
+        sum += ExampleProfilerClock::Now();
+    }
+    double tickSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    start = BenchmarkClock::now();
+    for (size_t index = 0; index < readCount; index++) {
+        sum += (uint64_t)BenchmarkClock::now().time_since_epoch().count();
+    }
+    double steadySeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+#ifdef EXAMPLE_PROFILER_TSC
+    std::cout << "  clock: time stamp counter " << (tickSeconds * 1e9) / readCount << " ns, steady_clock " << (steadySeconds * 1e9) / readCount << " ns (" << sum % 10 << ")" << std::endl;
+#else
+    std::cout << "  clock: steady_clock " << (tickSeconds * 1e9) / readCount << " ns (" << sum % 10 << ")" << std::endl;
+#endif // EXAMPLE_PROFILER_TSC
+
+    // A section around an empty call, as many times as the stack calls the property callbacks
+    const char* const names[] = { "iteration", "outer", "inner" };
+    ExampleProfiler profiler;
+    profiler.Initialize(names, 3, 1000);
+    const size_t scopeCount = 10000000;
+    for (int enabled = 1; enabled >= 0; enabled--) {
+        profiler.SetEnabled(enabled != 0);
+        start = BenchmarkClock::now();
+        for (size_t index = 0; index < scopeCount; index++) {
+            ExampleProfilerScope profile(&profiler, 2);
+        }
+        double scopeSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        std::cout << "  scope " << (enabled ? "enabled:  " : "disabled: ") << (scopeSeconds * 1e9) / scopeCount << " ns" << std::endl;
+    }
+    ok = ok && profiler.GetHistogram(2).GetCount() == scopeCount;
+
+    // Every tenth iteration is over the 1 ms threshold, the time is in the inner section
+    profiler.SetEnabled(true);
+    profiler.Reset();
+    size_t slowExpected = 0;
+    for (size_t iteration = 0; iteration < iterationCount; iteration++) {
+        bool slow = iteration % 10 == 9;
+        slowExpected += slow;
+        profiler.BeginIteration();
+        {
+            ExampleProfilerScope outer(&profiler, 1);
+            BenchmarkSpin(50000);
+            ExampleProfilerScope inner(&profiler, 2);
+            BenchmarkSpin(slow ? 2000000 : 100000);
+        }
+        profiler.EndIteration();
+    }
+    // A loaded machine may make a fast iteration slow, never the other way
+    bool slowFound = profiler.slowIterations >= slowExpected;
+    bool selfTime = profiler.GetSelfTicks(2) > profiler.GetSelfTicks(1) * 2;
+    ok = ok && slowFound && selfTime;
+    std::cout << "  slow iterations: " << profiler.slowIterations << " of " << slowExpected << " expected, inner self time > outer: " << (selfTime ? "yes" : "no") << std::endl;
+    profiler.Print();
+    return ok;
+}
+
+//
+// Trace
+// ----------------------------------------------------------------------------
+
+// Encapsulated-NPDU with a ReadProperty request from a peer, or the Complex-ACK back to it
+static size_t BenchmarkTraceNpdu(uint8_t* frame, const uint16_t messageId, const uint32_t peer, const uint8_t invokeId, const bool request) {
+    size_t length = 0;
+    frame[length++] = BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+    frame[length++] = request ? BVLC_SC_CONTROL_ORIGINATING_VMAC : BVLC_SC_CONTROL_DESTINATION_VMAC;
+    frame[length++] = (uint8_t)(messageId >> 8);
+    frame[length++] = (uint8_t)messageId;
+    WSHubFrameHeader::UnpackVmac(peer, frame + length);
+    length += BVLC_SC_VMAC_LENGTH;
+    frame[length++] = 0x01;                                 // NPDU version
+    frame[length++] = request ? 0x04 : 0x00;                // Expecting reply
+    if (request) {
+        const uint8_t apdu[] = { 0x00, 0x05, invokeId, 0x0C, 0x0C, 0x02, 0x00, 0x00, 0x01, 0x19, 0x55 };
+        memcpy(frame + length, apdu, sizeof(apdu));
+        return length + sizeof(apdu);
+    }
+    const uint8_t apdu[] = { 0x30, invokeId, 0x0C, 0x0C, 0x02, 0x00, 0x00, 0x01, 0x19, 0x55, 0x3E, 0x44, 0x42, 0x28, 0x00, 0x00, 0x3F };
+    memcpy(frame + length, apdu, sizeof(apdu));
+    return length + sizeof(apdu);
+}
+
+static size_t BenchmarkCount(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t offset = text.find(pattern); offset != std::string::npos; offset = text.find(pattern, offset + 1)) {
+        count++;
+    }
+    return count;
+}
+
+bool ExampleBenchmark::Trace(int argc, char** argv) {
+    const size_t messageCount = BenchmarkArgument(argc, argv, 1, 1000000);
+    const uint32_t sampleInterval = (uint32_t)BenchmarkArgument(argc, argv, 2, 16);
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Trace benchmark, messages=" << messageCount << ", sampleInterval=" << sampleInterval << std::endl;
+
+    // Keys: an NPDU answer gets a new message ID, a BVLC answer keeps it
+    uint8_t request[64];
+    uint8_t reply[64];
+    size_t requestLength = BenchmarkTraceNpdu(request, 100, 0x010203, 7, true);
+    size_t replyLength = BenchmarkTraceNpdu(reply, 5000, 0x010203, 7, false);
+    bool npduMatch = ExampleMessageTracer::GetRequestKey(request, requestLength) != 0 && ExampleMessageTracer::GetRequestKey(request, requestLength) == ExampleMessageTracer::GetReplyKey(reply, replyLength);
+    replyLength = BenchmarkTraceNpdu(reply, 5000, 0x040506, 7, false);
+    bool npduPeer = ExampleMessageTracer::GetRequestKey(request, requestLength) != ExampleMessageTracer::GetReplyKey(reply, replyLength);
+    const uint8_t heartbeat[] = { BVLC_SC_FUNCTION_HEARTBEAT_REQUEST, 0x00, 0x12, 0x34 };
+    const uint8_t heartbeatAck[] = { BVLC_SC_FUNCTION_HEARTBEAT_ACK, 0x00, 0x12, 0x34 };
+    bool bvlcMatch = ExampleMessageTracer::GetRequestKey(heartbeat, sizeof(heartbeat)) != 0 && ExampleMessageTracer::GetRequestKey(heartbeat, sizeof(heartbeat)) == ExampleMessageTracer::GetReplyKey(heartbeatAck, sizeof(heartbeatAck));
+    const uint8_t unconfirmed[] = { BVLC_SC_FUNCTION_ENCAPSULATED_NPDU, 0x00, 0x00, 0x01, 0x01, 0x20, 0xFF, 0xFF, 0x00, 0xFF, 0x10, 0x08 };
+    bool unconfirmedNone = ExampleMessageTracer::GetRequestKey(unconfirmed, sizeof(unconfirmed)) == 0;
+    ok = ok && npduMatch && npduPeer && bvlcMatch && unconfirmedNone;
+    std::cout << "  keys: NPDU by invoke ID " << (npduMatch ? "ok" : "failed") << ", other peer " << (npduPeer ? "ok" : "failed") << ", BVLC by message ID " << (bvlcMatch ? "ok" : "failed") << ", unconfirmed none " << (unconfirmedNone ? "ok" : "failed") << std::endl;
+
+    // Requests from 50 peers answered in order, with stage times 1, 4 and 1 us apart
+    ExampleMessageTracer tracer;
+    const uint32_t maxMessages = 10000;
+    for (int pass = 0; pass < 3; pass++) {
+        bool enabled = pass != 1;
+        tracer.Initialize(pass == 2 ? 1 : sampleInterval, maxMessages);
+        tracer.SetEnabled(enabled);
+        uint64_t ticks = ExampleProfilerClock::Now();
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        for (size_t index = 0; index < messageCount; index++) {
+            uint32_t peer = 0x100 + (uint32_t)(index % 50);
+            uint8_t invokeId = (uint8_t)(index / 50);
+            requestLength = BenchmarkTraceNpdu(request, (uint16_t)index, peer, invokeId, true);
+            replyLength = BenchmarkTraceNpdu(reply, (uint16_t)(index + 30000), peer, invokeId, false);
+            WSFrameTimes times = { ticks, ticks + 1000, 0, 0 };
+            tracer.OnReceived(request, requestLength, times);
+            times.sendStart = ticks + 5000;
+            times.written = ticks + 6000;
+            tracer.OnSent(reply, replyLength, times);
+            ticks += 10000;
+        }
+        double seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        const char* label = pass == 0 ? "sampled:  " : pass == 1 ? "disabled: " : "every:    ";
+        std::cout << "  " << label << (seconds * 1e9) / messageCount << " ns per request and reply, traced " << tracer.messagesTraced << ", replied " << tracer.messagesReplied << std::endl;
+        if (pass == 0) {
+            size_t expected = (messageCount + sampleInterval - 1) / std::max<uint32_t>(1, sampleInterval);
+            ok = ok && tracer.messagesTraced == expected && tracer.messagesReplied == expected;
+        }
+        else if (pass == 1) {
+            ok = ok && tracer.messagesTraced == 0;
+        }
+        else {
+            ok = ok && tracer.messagesReplied == messageCount && tracer.GetMessageCount() == std::min<size_t>(messageCount, maxMessages);
+        }
+    }
+
+    // The JSON of the last pass: one begin and end per message and per stage
+    std::string json;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    tracer.Render(&json);
+    double renderSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    size_t messages = tracer.GetMessageCount();
+    size_t begins = BenchmarkCount(json, "\"ph\":\"b\"");
+    size_t ends = BenchmarkCount(json, "\"ph\":\"e\"");
+    bool balanced = begins == ends && begins == messages * 4 && BenchmarkCount(json, "\"name\":\"stack\"") == messages * 2;
+    ok = ok && balanced;
+    std::cout << "  render " << messages << " messages: " << renderSeconds * 1e3 << " ms, " << json.size() / 1024 << " KB, events balanced: " << (balanced ? "yes" : "no") << std::endl;
+
+    bool written = tracer.Write("BenchmarkTrace.json");
+    ok = ok && written;
+    std::cout << "  written to BenchmarkTrace.json: " << (written ? "yes" : "no") << std::endl;
+    return ok;
+}
+
+//
+// Discovery
+// ----------------------------------------------------------------------------
+// Simulated devices behind a hub answer each Who-Is in their range after a
+// random delay. Time is simulated in milliseconds, so the sweep time is the
+// one a real hub with these devices would see; the parse and device table
+// cost is measured for real.
+
+// I-Am of a simulated device as the hub forwards it, with its originating VMAC
+static size_t BenchmarkIAmFrame(uint8_t* frame, const size_t capacity, const uint32_t instance, const uint16_t messageId) {
+    uint8_t apdu[32];
+    ExampleApduWriter writer(apdu, sizeof(apdu));
+    writer.Byte(APDU_TYPE_UNCONFIRMED_REQUEST << 4);
+    writer.Byte(APDU_SERVICE_I_AM);
+    writer.ApplicationObjectIdentifier(APDU_OBJECT_TYPE_DEVICE, instance);
+    writer.ApplicationUnsigned(1476);
+    writer.ApplicationEnumerated(3);                    // No segmentation
+    writer.ApplicationUnsigned(389);
+    size_t apduLength = writer.GetLength();
+
+    size_t length = 0;
+    frame[length++] = BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+    frame[length++] = BVLC_SC_CONTROL_ORIGINATING_VMAC;
+    frame[length++] = (uint8_t)(messageId >> 8);
+    frame[length++] = (uint8_t)messageId;
+    WSHubFrameHeader::UnpackVmac(0x020000000000ULL | instance, frame + length);
+    length += BVLC_SC_VMAC_LENGTH;
+    frame[length++] = 0x01;
+    frame[length++] = 0x00;
+    if (length + apduLength > capacity) {
+        return 0;
+    }
+    memcpy(frame + length, apdu, apduLength);
+    return length + apduLength;
+}
+
+bool ExampleBenchmark::Discovery(int argc, char** argv) {
+    const size_t deviceCount = BenchmarkArgument(argc, argv, 1, 10000);
+    const size_t clusterPercent = std::min<size_t>(BenchmarkArgument(argc, argv, 2, 80), 100);
+    const uint32_t maxDelay = (uint32_t)std::max<size_t>(BenchmarkArgument(argc, argv, 3, 200), 1);
+    const uint32_t rateBucketMilliseconds = 100;
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Discovery benchmark, devices=" << deviceCount << ", clusterPercent=" << clusterPercent << ", maxDelayMilliseconds=" << maxDelay << std::endl;
+
+    // Who-Is and I-Am encoding
+    uint8_t apdu[32];
+    uint8_t frame[64];
+    size_t apduLength = ExampleApdu::BuildWhoIs(apdu, sizeof(apdu), 1000, 70000);
+    const uint8_t whoIs[] = { 0x10, 0x08, 0x0A, 0x03, 0xE8, 0x1B, 0x01, 0x11, 0x70 };
+    bool whoIsOk = apduLength == sizeof(whoIs) && memcmp(apdu, whoIs, sizeof(whoIs)) == 0;
+    size_t frameLength = ExampleApdu::BuildFrame(frame, sizeof(frame), 1, NULL, false, apdu, apduLength);
+    WSHubFrameHeader header;
+    bool broadcastOk = frameLength > 0 && WSHubFrameHeader::Parse(frame, frameLength, &header) && WSHubFrameHeader::PackVmac(header.destinationVmac) == BVLC_SC_BROADCAST_VMAC;
+    ExampleIAm iAm;
+    frameLength = BenchmarkIAmFrame(frame, sizeof(frame), 4194302, 1);
+    bool iAmOk = ExampleApdu::ParseIAm(frame, frameLength, &iAm) && iAm.instance == 4194302 && iAm.maxApdu == 1476 && iAm.vendorId == 389 && iAm.vmac == (0x020000000000ULL | 4194302);
+    bool truncatedOk = !ExampleApdu::ParseIAm(frame, frameLength - 1, &iAm);
+    ok = ok && whoIsOk && broadcastOk && iAmOk && truncatedOk;
+    std::cout << "  encoding: Who-Is " << (whoIsOk ? "ok" : "failed") << ", broadcast frame " << (broadcastOk ? "ok" : "failed") << ", I-Am " << (iAmOk ? "ok" : "failed") << ", truncated I-Am rejected " << (truncatedOk ? "ok" : "failed") << std::endl;
+
+    // Most devices in sites numbered in blocks of 100, the rest anywhere
+    std::mt19937 random(40);
+    std::vector<uint32_t> instances;
+    size_t clustered = deviceCount * clusterPercent / 100;
+    while (instances.size() < clustered) {
+        uint32_t base = std::uniform_int_distribution<uint32_t>(0, APDU_MAX_INSTANCE / 1000 - 1)(random) * 1000;
+        for (uint32_t device = 0; device < 100 && instances.size() < clustered; device++) {
+            instances.push_back(base + device);
+        }
+    }
+    while (instances.size() < deviceCount) {
+        instances.push_back(std::uniform_int_distribution<uint32_t>(0, APDU_MAX_INSTANCE)(random));
+    }
+    std::sort(instances.begin(), instances.end());
+    instances.erase(std::unique(instances.begin(), instances.end()), instances.end());
+    std::uniform_int_distribution<uint32_t> delay(0, maxDelay);
+
+    // One global Who-Is: every device answers within maxDelay
+    std::vector<uint32_t> buckets(maxDelay / rateBucketMilliseconds + 1);
+    for (size_t index = 0; index < instances.size(); index++) {
+        buckets[delay(random) / rateBucketMilliseconds]++;
+    }
+    uint32_t globalPeak = *std::max_element(buckets.begin(), buckets.end());
+    std::cout << "  global Who-Is: " << instances.size() << " I-Am, peak " << globalPeak << " I-Am per " << rateBucketMilliseconds << " ms" << std::endl;
+
+    // Partitioned sweep
+    typedef std::pair<uint64_t, uint32_t> BenchmarkIAm;   // When, instance
+    std::priority_queue<BenchmarkIAm, std::vector<BenchmarkIAm>, std::greater<BenchmarkIAm> > pending;
+    ExampleDiscovery discovery;
+    discovery.Start(0, APDU_MAX_INSTANCE, 0);
+    std::vector<uint32_t> rate;
+    double receiveSeconds = 0;
+    uint16_t messageId = 0;
+    uint64_t now = 0;
+    const uint64_t limit = 24 * 3600 * 1000ULL;
+    for (; now < limit; now++) {
+        uint32_t low;
+        uint32_t high;
+        while (discovery.Poll(now, &low, &high)) {
+            std::vector<uint32_t>::iterator it = std::lower_bound(instances.begin(), instances.end(), low);
+            for (; it != instances.end() && *it <= high; ++it) {
+                pending.push(BenchmarkIAm(now + delay(random), *it));
+            }
+        }
+
+        while (!pending.empty() && pending.top().first <= now) {
+            frameLength = BenchmarkIAmFrame(frame, sizeof(frame), pending.top().second, messageId++);
+            pending.pop();
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            discovery.OnReceived(frame, frameLength, now);
+            receiveSeconds += BenchmarkSeconds(start, BenchmarkClock::now());
+            size_t bucket = (size_t)(now / rateBucketMilliseconds);
+            if (rate.size() <= bucket) {
+                rate.resize(bucket + 1);
+            }
+            rate[bucket]++;
+        }
+        if (!discovery.IsRunning() && pending.empty()) {
+            break;
+        }
+    }
+    uint32_t sweepPeak = rate.empty() ? 0 : *std::max_element(rate.begin(), rate.end());
+    bool found = discovery.GetDevices().Size() == instances.size();
+    ok = ok && found && now < limit && sweepPeak < globalPeak;
+    std::cout << "  sweep: " << discovery.sweepMilliseconds / 1000.0 << " s simulated, " << discovery.whoIsSent << " Who-Is, found " << discovery.GetDevices().Size() << " of " << instances.size() << " devices" << std::endl;
+    std::cout << "    peak " << sweepPeak << " I-Am per " << rateBucketMilliseconds << " ms, most I-Am for one Who-Is " << discovery.maxResponses << ", I-Am after the window " << discovery.iAmLate << std::endl;
+    std::cout << "    I-Am parse and device table update " << (receiveSeconds * 1e9) / std::max<uint64_t>(1, discovery.iAmReceived) << " ns, table " << discovery.GetDevices().GetMemoryUsage() / 1024 << " KB" << std::endl;
+
+    // Every device can be found, and only those
+    const size_t lookupCount = 10000000;
+    size_t hits = 0;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t index = 0; index < lookupCount; index++) {
+        const ExampleDiscoveredDevice* device = discovery.GetDevices().Find(instances[index % instances.size()]);
+        hits += device != NULL && device->vmac == (0x020000000000ULL | device->instance);
+    }
+    double lookupSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    bool lookupOk = hits == lookupCount && discovery.GetDevices().Find(APDU_MAX_INSTANCE + 1) == NULL;
+    ok = ok && lookupOk;
+    std::cout << "  lookup by instance: " << (lookupSeconds * 1e9) / lookupCount << " ns, all found: " << (lookupOk ? "yes" : "no") << std::endl;
+    return ok;
+}
+
+//
+// Polling
+// ----------------------------------------------------------------------------
+// Simulated devices behind a hub stand-in answer ReadPropertyMultiple
+// requests after their own delay, in simulated milliseconds. A few are slow,
+// a few drop requests, and a few advertise a max APDU larger than they can
+// answer. The same points are polled with coalesced requests and with one
+// point per request. The poller cost is measured for real.
+
+struct BenchmarkPolledDevice {
+    uint32_t maxApdu;               // What it can really answer
+    uint32_t latency;               // Milliseconds
+    uint32_t dropPercent;
+    uint64_t busyUntil;
+};
+
+struct BenchmarkPollingResult {
+    uint64_t requests;
+    uint64_t bytes;                 // Both ways through the hub
+    uint64_t pointsRead;
+    uint64_t wrong;                 // Points with a wrong value or status
+    double seconds;                 // In the poller
+};
+
+static const uint32_t BENCHMARK_POLLING_FIRST_DEVICE = 1000;
+static const uint32_t BENCHMARK_POLLING_UNKNOWN_PROPERTY = 9999;
+
+static uint64_t BenchmarkPollingVmac(const uint32_t instance) {
+    return 0x020000000000ULL | instance;
+}
+
+static float BenchmarkPollingValue(const uint32_t device, const uint32_t instance) {
+    return (float)(device % 1000) + instance * 0.5f;
+}
+
+// Frame of a simulated device as the hub forwards it, with its originating VMAC
+static size_t BenchmarkDeviceFrame(uint8_t* frame, const size_t capacity, const uint16_t messageId, const uint32_t instance, const uint8_t* apdu, const size_t apduLength) {
+    size_t length = 0;
+    if (apduLength == 0 || 4 + BVLC_SC_VMAC_LENGTH + 2 + apduLength > capacity) {
+        return 0;
+    }
+    frame[length++] = BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+    frame[length++] = BVLC_SC_CONTROL_ORIGINATING_VMAC;
+    frame[length++] = (uint8_t)(messageId >> 8);
+    frame[length++] = (uint8_t)messageId;
+    WSHubFrameHeader::UnpackVmac(BenchmarkPollingVmac(instance), frame + length);
+    length += BVLC_SC_VMAC_LENGTH;
+    frame[length++] = 0x01;
+    frame[length++] = 0x00;
+    memcpy(frame + length, apdu, apduLength);
+    return length + apduLength;
+}
+
+// Answer of a simulated device to a ReadPropertyMultiple request. The
+// present values are values[object instance], or BenchmarkPollingValue() if
+// values is NULL. 0 if the request is malformed.
+static size_t BenchmarkPollingAnswer(const uint8_t* request, const size_t requestLength, const BenchmarkPolledDevice& device, const uint32_t instance, const float* values, uint8_t* frame, const size_t capacity) {
+    WSHubFrameHeader header;
+    size_t apduLength;
+    const uint8_t* apdu = WSHubFrameHeader::Parse(request, requestLength, &header) ? header.GetApdu(request, requestLength, &apduLength) : NULL;
+    if (apdu == NULL || apduLength < 4 || apdu[0] != (APDU_TYPE_CONFIRMED_REQUEST << 4) || apdu[3] != APDU_SERVICE_READ_PROPERTY_MULTIPLE) {
+        return 0;
+    }
+
+    uint8_t answer[APDU_MAX_LENGTH * 2];
+    ExampleApduWriter writer(answer, sizeof(answer));
+    writer.Byte(APDU_TYPE_COMPLEX_ACK << 4);
+    writer.Byte(apdu[2]);
+    writer.Byte(APDU_SERVICE_READ_PROPERTY_MULTIPLE);
+    ExampleApduReader reader(apdu, apduLength, 4);
+    while (!reader.IsEnd()) {
+        uint16_t objectType;
+        uint32_t objectInstance;
+        if (!reader.ReadContextObjectIdentifier(0, &objectType, &objectInstance) || !reader.ReadOpeningTag(1)) {
+            return 0;
+        }
+        writer.ContextObjectIdentifier(0, objectType, objectInstance);
+        writer.OpeningTag(1);
+        while (!reader.IsClosingTag(1)) {
+            uint32_t property;
+            if (!reader.ReadContextUnsigned(0, &property)) {
+                return 0;
+            }
+            writer.ContextUnsigned(2, property);
+            if (property == BENCHMARK_POLLING_UNKNOWN_PROPERTY) {
+                writer.OpeningTag(5);
+                writer.ApplicationEnumerated(2);        // Property
+                writer.ApplicationEnumerated(32);       // Unknown property
+                writer.ClosingTag(5);
+                continue;
+            }
+            writer.OpeningTag(4);
+            if (property == 85) {                       // Present value
+                writer.ApplicationReal(values == NULL ? BenchmarkPollingValue(instance, objectInstance) : values[objectInstance]);
+            }
+            else {
+                writer.ApplicationEnumerated(0);
+            }
+            writer.ClosingTag(4);
+        }
+        reader.ReadClosingTag(1);
+        writer.ClosingTag(1);
+    }
+    size_t answerLength = writer.GetLength();
+    if (answerLength > device.maxApdu) {
+        answer[0] = (APDU_TYPE_ABORT << 4) | 0x01;      // From the server
+        answer[2] = APDU_ABORT_SEGMENTATION_NOT_SUPPORTED;
+        answerLength = 3;
+    }
+
+    return BenchmarkDeviceFrame(frame, capacity, (uint16_t)((request[2] << 8) | request[3]), instance, answer, answerLength);
+}
+
+static BenchmarkPollingResult BenchmarkPollingRun(const ExamplePollerSettings& settings, const std::vector<BenchmarkPolledDevice>& simulated, const size_t pointsPerDevice, const uint64_t milliseconds) {
+    BenchmarkPollingResult result = {};
+    std::mt19937 random(41);
+    std::vector<BenchmarkPolledDevice> devices = simulated;
+
+    ExamplePoller poller;
+    poller.SetSettings(settings);
+    poller.Reset(0);
+    for (size_t index = 0; index < devices.size(); index++) {
+        uint32_t instance = BENCHMARK_POLLING_FIRST_DEVICE + (uint32_t)index;
+        poller.AddDevice(instance, BenchmarkPollingVmac(instance), devices[index].maxApdu < 1476 && index % 20 != 0 ? devices[index].maxApdu : 1476);
+        // Present value and reliability of analog inputs and values, and one
+        // property the device does not have
+        for (size_t point = 0; point < pointsPerDevice; point++) {
+            uint32_t object = (uint32_t)point / 2;
+            uint32_t property = point % 2 == 0 ? 85 : 103;
+            poller.AddPoint(instance, object % 2 == 0 ? 0 : 2, object / 2, point == 7 ? BENCHMARK_POLLING_UNKNOWN_PROPERTY : property, 1000);
+        }
+    }
+
+    typedef std::pair<uint64_t, std::string> BenchmarkAnswer;     // When, frame
+    std::priority_queue<BenchmarkAnswer, std::vector<BenchmarkAnswer>, std::greater<BenchmarkAnswer> > pending;
+    uint8_t request[APDU_MAX_LENGTH + 64];
+    uint8_t answer[APDU_MAX_LENGTH * 2 + 64];
+    size_t requestLength;
+    for (uint64_t now = 0; now < milliseconds; now++) {
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        bool sent = poller.Poll(now, request, sizeof(request), &requestLength);
+        result.seconds += BenchmarkSeconds(start, BenchmarkClock::now());
+        while (sent) {
+            result.bytes += requestLength;
+            WSHubFrameHeader header;
+            WSHubFrameHeader::Parse(request, requestLength, &header);
+            uint32_t instance = (uint32_t)(WSHubFrameHeader::PackVmac(header.destinationVmac) & 0xFFFFFF);
+            BenchmarkPolledDevice& device = devices[instance - BENCHMARK_POLLING_FIRST_DEVICE];
+            if (std::uniform_int_distribution<uint32_t>(0, 99)(random) >= device.dropPercent) {
+                // Requests are handled one at a time, 20 us per property
+                size_t answerLength = BenchmarkPollingAnswer(request, requestLength, device, instance, NULL, answer, sizeof(answer));
+                device.busyUntil = std::max(device.busyUntil, now) + 1 + answerLength / 250;
+                pending.push(BenchmarkAnswer(device.busyUntil + device.latency, std::string((const char*)answer, answerLength)));
+            }
+            start = BenchmarkClock::now();
+            sent = poller.Poll(now, request, sizeof(request), &requestLength);
+            result.seconds += BenchmarkSeconds(start, BenchmarkClock::now());
+        }
+
+        while (!pending.empty() && pending.top().first <= now) {
+            const std::string& frame = pending.top().second;
+            result.bytes += frame.size();
+            start = BenchmarkClock::now();
+            poller.OnReceived((const uint8_t*)frame.data(), frame.size(), now);
+            result.seconds += BenchmarkSeconds(start, BenchmarkClock::now());
+            pending.pop();
+        }
+    }
+
+    // Every point read has the value of its device, the unknown property an error
+    for (size_t index = 0; index < poller.GetPointCount(); index++) {
+        const ExamplePolledPoint& point = poller.GetPoint(index);
+        uint32_t instance = BENCHMARK_POLLING_FIRST_DEVICE + point.device;
+        if (point.property == BENCHMARK_POLLING_UNKNOWN_PROPERTY) {
+            result.wrong += point.status != ExamplePoller::STATUS_ERROR && point.status != ExamplePoller::STATUS_NONE && point.status != ExamplePoller::STATUS_TIMEOUT;
+        }
+        else if (point.status == ExamplePoller::STATUS_OK) {
+            result.wrong += point.property == 85 ? point.value != BenchmarkPollingValue(instance, point.instance) : point.value != 0;
+        }
+        else if (point.status == ExamplePoller::STATUS_ERROR) {
+            result.wrong++;
+        }
+    }
+    result.requests = poller.requestsSent + poller.retriesSent;
+    result.pointsRead = poller.pointsRead;
+
+    double seconds = milliseconds / 1000.0;
+    std::cout << "    " << poller.requestsSent << " requests, " << poller.retriesSent << " retries, " << poller.timeoutCount << " timeouts, " << poller.aborts << " aborts, ";
+    std::cout << result.pointsRead / seconds << " values/s, hub " << result.bytes / seconds / 1024 << " KB/s" << std::endl;
+    std::cout << "    answer time p50 " << poller.latency.GetPercentile(50) << " ms, p99 " << poller.latency.GetPercentile(99) << " ms, late by p50 " << poller.lateness.GetPercentile(50);
+    std::cout << " ms, p99 " << poller.lateness.GetPercentile(99) << " ms, " << (result.seconds * 1e9) / std::max<uint64_t>(1, result.pointsRead) << " ns per value, wrong values " << result.wrong << std::endl;
+    return result;
+}
+
+bool ExampleBenchmark::Polling(int argc, char** argv) {
+    const size_t deviceCount = std::max<size_t>(BenchmarkArgument(argc, argv, 1, 1000), 1);
+    const size_t pointsPerDevice = std::max<size_t>(BenchmarkArgument(argc, argv, 2, 50), 1);
+    const uint64_t seconds = std::max<size_t>(BenchmarkArgument(argc, argv, 3, 60), 1);
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Polling benchmark, devices=" << deviceCount << ", pointsPerDevice=" << pointsPerDevice << ", seconds=" << seconds << std::endl;
+
+    // Most answer in 10 to 60 ms, 5% take about a second and 5% drop 5% of
+    // the requests. A third only take 480 byte APDUs, and some of those
+    // claim 1476 in their I-Am.
+    std::mt19937 random(41);
+    std::vector<BenchmarkPolledDevice> devices(deviceCount);
+    for (size_t index = 0; index < deviceCount; index++) {
+        BenchmarkPolledDevice& device = devices[index];
+        uint32_t kind = std::uniform_int_distribution<uint32_t>(0, 99)(random);
+        device.maxApdu = index % 3 == 0 ? 480 : 1476;
+        device.latency = kind < 5 ? std::uniform_int_distribution<uint32_t>(800, 1200)(random) : std::uniform_int_distribution<uint32_t>(10, 60)(random);
+        device.dropPercent = kind >= 95 ? 5 : 0;
+        device.busyUntil = 0;
+    }
+    const uint64_t wanted = (uint64_t)deviceCount * pointsPerDevice * seconds;
+
+    std::cout << "  one point per request:" << std::endl;
+    ExamplePollerSettings settings;
+    settings.maxPointsPerRequest = 1;
+    BenchmarkPollingResult single = BenchmarkPollingRun(settings, devices, pointsPerDevice, seconds * 1000);
+
+    std::cout << "  ReadPropertyMultiple sized to the max APDU:" << std::endl;
+    settings.maxPointsPerRequest = 0;
+    BenchmarkPollingResult coalesced = BenchmarkPollingRun(settings, devices, pointsPerDevice, seconds * 1000);
+
+    ok = ok && single.wrong == 0 && coalesced.wrong == 0 && coalesced.pointsRead > single.pointsRead;
+    std::cout << "  coalesced: " << 100.0 * coalesced.pointsRead / wanted << "% of the reads wanted (single " << 100.0 * single.pointsRead / wanted << "%), ";
+    std::cout << (double)coalesced.bytes / std::max<uint64_t>(1, coalesced.pointsRead) << " hub bytes per value (single " << (double)single.bytes / std::max<uint64_t>(1, single.pointsRead) << ")" << std::endl;
+    return ok;
+}
+
+//
+// COV Client
+// ----------------------------------------------------------------------------
+// The same simulated devices as the polling benchmark, each with objects
+// whose present value changes now and then. Their values are followed once by
+// polling every second and once with COV subscriptions, and the hub traffic
+// of both is compared. Some devices refuse SubscribeCOV, their objects are
+// polled by the COV client instead.
+
+struct BenchmarkCOVDevice {
+    BenchmarkPolledDevice device;
+    bool refuses;                           // Answers SubscribeCOV with an Error
+    std::vector<float> values;
+    std::vector<uint64_t> changed;          // When each value last changed
+    std::vector<uint64_t> subscribedUntil;  // 0 if never subscribed
+};
+
+struct BenchmarkCOVResult {
+    uint64_t frames;                        // Both ways through the hub
+    uint64_t bytes;
+    uint64_t wrong;                         // Cached values that are not the device's
+    uint64_t lapsed;                        // Subscriptions that ran out before their renewal
+    uint32_t subscribePeak;                 // Most first SubscribeCOV in a second
+    uint32_t renewalPeak;                   // Most renewals in a second
+};
+
+typedef std::pair<uint64_t, std::string> BenchmarkCOVFrame;    // When, frame
+
+static const uint32_t BENCHMARK_COV_OBJECTS_PER_DEVICE = 100;
+
+static size_t BenchmarkCOVNotification(uint8_t* frame, const size_t capacity, const uint16_t messageId, const uint32_t instance, const uint32_t object, const float value, const uint32_t timeRemaining) {
+    uint8_t apdu[64];
+    ExampleApduWriter writer(apdu, sizeof(apdu));
+    writer.Byte(APDU_TYPE_UNCONFIRMED_REQUEST << 4);
+    writer.Byte(APDU_SERVICE_UNCONFIRMED_COV_NOTIFICATION);
+    writer.ContextUnsigned(0, 1);
+    writer.ContextObjectIdentifier(1, APDU_OBJECT_TYPE_DEVICE, instance);
+    writer.ContextObjectIdentifier(2, 0, object);
+    writer.ContextUnsigned(3, timeRemaining);
+    writer.OpeningTag(4);
+    writer.ContextUnsigned(0, 85);              // Present value
+    writer.OpeningTag(2);
+    writer.ApplicationReal(value);
+    writer.ClosingTag(2);
+    writer.ContextUnsigned(0, 111);             // Status flags, a 4 bit bit string
+    writer.OpeningTag(2);
+    writer.Byte(0x82);
+    writer.Byte(0x04);
+    writer.Byte(0x00);
+    writer.ClosingTag(2);
+    writer.ClosingTag(4);
+    return BenchmarkDeviceFrame(frame, capacity, messageId, instance, apdu, writer.GetLength());
+}
+
+// Answer of a simulated device to a SubscribeCOV, and the first notification
+static void BenchmarkCOVSubscribe(const uint8_t* apdu, const size_t apduLength, BenchmarkCOVDevice& device, const uint32_t instance, const uint64_t when, uint16_t* messageId, std::priority_queue<BenchmarkCOVFrame, std::vector<BenchmarkCOVFrame>, std::greater<BenchmarkCOVFrame> >* pending, uint64_t* lapsed) {
+    uint8_t answer[16];
+    uint8_t frame[128];
+    ExampleApduReader reader(apdu, apduLength, 4);
+    uint32_t processIdentifier;
+    uint16_t objectType;
+    uint32_t object;
+    uint32_t confirmed;
+    uint32_t lifetime;
+    if (!reader.ReadContextUnsigned(0, &processIdentifier) || !reader.ReadContextObjectIdentifier(1, &objectType, &object) || !reader.ReadContextUnsigned(2, &confirmed) ||
+        !reader.ReadContextUnsigned(3, &lifetime) || object >= device.values.size()) {
+        return;
+    }
+
+    ExampleApduWriter writer(answer, sizeof(answer));
+    if (device.refuses) {
+        writer.Byte(APDU_TYPE_ERROR << 4);
+        writer.Byte(apdu[2]);
+        writer.Byte(APDU_SERVICE_SUBSCRIBE_COV);
+        writer.ApplicationEnumerated(5);        // Services
+        writer.ApplicationEnumerated(45);       // Optional functionality not supported
+    }
+    else {
+        writer.Byte(APDU_TYPE_SIMPLE_ACK << 4);
+        writer.Byte(apdu[2]);
+        writer.Byte(APDU_SERVICE_SUBSCRIBE_COV);
+        *lapsed += device.subscribedUntil[object] != 0 && device.subscribedUntil[object] < when;
+        device.subscribedUntil[object] = when + lifetime * 1000ULL;
+    }
+    size_t length = BenchmarkDeviceFrame(frame, sizeof(frame), (*messageId)++, instance, answer, writer.GetLength());
+    pending->push(BenchmarkCOVFrame(when, std::string((const char*)frame, length)));
+    if (!device.refuses) {
+        length = BenchmarkCOVNotification(frame, sizeof(frame), (*messageId)++, instance, object, device.values[object], lifetime);
+        pending->push(BenchmarkCOVFrame(when, std::string((const char*)frame, length)));
+    }
+}
+
+static BenchmarkCOVResult BenchmarkCOVRun(const bool subscribe, const std::vector<BenchmarkCOVDevice>& simulated, const uint32_t changePercent, const uint64_t milliseconds) {
+    BenchmarkCOVResult result = {};
+    std::mt19937 random(42);
+    std::vector<BenchmarkCOVDevice> devices = simulated;
+
+    ExamplePoller poller;
+    ExampleCOVClient client;
+    poller.Reset(0);
+    client.Reset(0);
+    for (size_t index = 0; index < devices.size(); index++) {
+        uint32_t instance = BENCHMARK_POLLING_FIRST_DEVICE + (uint32_t)index;
+        poller.AddDevice(instance, BenchmarkPollingVmac(instance), devices[index].device.maxApdu);
+        for (uint32_t object = 0; object < BENCHMARK_COV_OBJECTS_PER_DEVICE; object++) {
+            if (subscribe) {
+                client.Add(instance, BenchmarkPollingVmac(instance), devices[index].device.maxApdu, 0, object);
+            }
+            else {
+                poller.AddPoint(instance, 0, object, 85, 1000);
+            }
+        }
+    }
+
+    std::priority_queue<BenchmarkCOVFrame, std::vector<BenchmarkCOVFrame>, std::greater<BenchmarkCOVFrame> > pending;
+    std::vector<uint32_t> subscribes;
+    std::vector<uint32_t> renewals;
+    uint8_t request[APDU_MAX_LENGTH + 64];
+    uint8_t frame[APDU_MAX_LENGTH * 2 + 64];
+    size_t requestLength;
+    uint16_t messageId = 0;
+    for (uint64_t now = 0; now < milliseconds; now++) {
+        // Values change once a second
+        if (now % 1000 == 0) {
+            for (size_t index = 0; index < devices.size(); index++) {
+                BenchmarkCOVDevice& device = devices[index];
+                uint32_t instance = BENCHMARK_POLLING_FIRST_DEVICE + (uint32_t)index;
+                for (uint32_t object = 0; object < device.values.size(); object++) {
+                    if (std::uniform_int_distribution<uint32_t>(0, 99)(random) >= changePercent) {
+                        continue;
+                    }
+                    device.values[object] += 1;
+                    device.changed[object] = now;
+                    if (device.subscribedUntil[object] > now) {
+                        size_t length = BenchmarkCOVNotification(frame, sizeof(frame), messageId++, instance, object, device.values[object], (uint32_t)((device.subscribedUntil[object] - now) / 1000));
+                        pending.push(BenchmarkCOVFrame(now + device.device.latency, std::string((const char*)frame, length)));
+                    }
+                }
+            }
+        }
+
+        uint64_t subscribesSent = client.subscribesSent - client.renewalsSent;
+        uint64_t renewalsSent = client.renewalsSent;
+        while (subscribe ? client.Poll(now, request, sizeof(request), &requestLength) : poller.Poll(now, request, sizeof(request), &requestLength)) {
+            result.frames++;
+            result.bytes += requestLength;
+            WSHubFrameHeader header;
+            size_t apduLength;
+            WSHubFrameHeader::Parse(request, requestLength, &header);
+            const uint8_t* apdu = header.GetApdu(request, requestLength, &apduLength);
+            uint32_t instance = (uint32_t)(WSHubFrameHeader::PackVmac(header.destinationVmac) & 0xFFFFFF);
+            BenchmarkCOVDevice& device = devices[instance - BENCHMARK_POLLING_FIRST_DEVICE];
+            uint64_t when = std::max(device.device.busyUntil, now) + 1;
+            device.device.busyUntil = when;
+            if (apdu[3] == APDU_SERVICE_SUBSCRIBE_COV) {
+                BenchmarkCOVSubscribe(apdu, apduLength, device, instance, when + device.device.latency, &messageId, &pending, &result.lapsed);
+            }
+            else {
+                size_t length = BenchmarkPollingAnswer(request, requestLength, device.device, instance, device.values.data(), frame, sizeof(frame));
+                pending.push(BenchmarkCOVFrame(when + device.device.latency, std::string((const char*)frame, length)));
+            }
+        }
+        size_t second = (size_t)(now / 1000);
+        if (subscribes.size() <= second) {
+            subscribes.resize(second + 1);
+            renewals.resize(second + 1);
+        }
+        subscribes[second] += (uint32_t)(client.subscribesSent - client.renewalsSent - subscribesSent);
+        renewals[second] += (uint32_t)(client.renewalsSent - renewalsSent);
+
+        while (!pending.empty() && pending.top().first <= now) {
+            const std::string& answer = pending.top().second;
+            result.frames++;
+            result.bytes += answer.size();
+            if (subscribe) {
+                client.OnReceived((const uint8_t*)answer.data(), answer.size(), now);
+            }
+            else {
+                poller.OnReceived((const uint8_t*)answer.data(), answer.size(), now);
+            }
+            pending.pop();
+        }
+    }
+    result.subscribePeak = *std::max_element(subscribes.begin(), subscribes.end());
+    result.renewalPeak = *std::max_element(renewals.begin(), renewals.end());
+
+    // Values that have not changed for a few seconds are known
+    for (size_t index = 0; index < devices.size(); index++) {
+        const BenchmarkCOVDevice& device = devices[index];
+        for (uint32_t object = 0; object < device.values.size(); object++) {
+            size_t position = index * BENCHMARK_COV_OBJECTS_PER_DEVICE + object;
+            double value = 0;
+            uint64_t updated = 0;
+            if (subscribe) {
+                client.GetValue(position, &value, &updated);
+            }
+            else if (poller.GetPoint(position).status == ExamplePoller::STATUS_OK) {
+                value = poller.GetPoint(position).value;
+            }
+            result.wrong += device.changed[object] + 3000 < milliseconds && value != device.values[object];
+        }
+    }
+
+    double seconds = milliseconds / 1000.0;
+    std::cout << "    " << result.frames / seconds << " frames/s, hub " << result.bytes / seconds / 1024 << " KB/s, wrong values " << result.wrong << std::endl;
+    if (subscribe) {
+        std::cout << "    " << client.GetCount(ExampleCOVClient::STATE_SUBSCRIBED) << " subscribed, " << client.GetCount(ExampleCOVClient::STATE_POLLING) << " polled, " << client.notifications << " notifications, ";
+        std::cout << client.subscribesSent << " SubscribeCOV of which " << client.renewalsSent << " renewals, " << result.lapsed << " lapsed" << std::endl;
+        std::cout << "    most SubscribeCOV in a second: " << result.subscribePeak << " first, " << result.renewalPeak << " renewals" << std::endl;
+    }
+    return result;
+}
+
+// A poller and a COV client sending to one device with shared invoke IDs,
+// answered in the order of CallbackReceiveMessage: the poller first. Each
+// answer must reach the client that sent the request, and an answer with the
+// same invoke ID to a request of the stack must reach neither.
+static bool BenchmarkCOVSharedInvokeIds() {
+    const uint32_t instance = BENCHMARK_POLLING_FIRST_DEVICE;
+    ExampleInvokeIds invokeIds;
+    ExamplePoller poller;
+    ExampleCOVClient client;
+    poller.SetInvokeIds(&invokeIds);
+    client.SetInvokeIds(&invokeIds);
+    poller.Reset(0);
+    client.Reset(0);
+    poller.AddDevice(instance, BenchmarkPollingVmac(instance), APDU_MAX_LENGTH);
+    poller.AddPoint(instance, 0, 0, 85, 1000);
+    client.Add(instance, BenchmarkPollingVmac(instance), APDU_MAX_LENGTH, 0, 1);
+
+    BenchmarkCOVDevice device;
+    device.device.maxApdu = APDU_MAX_LENGTH;
+    device.device.latency = 0;
+    device.device.dropPercent = 0;
+    device.device.busyUntil = 0;
+    device.refuses = false;
+    device.values.assign(2, 1.0f);
+    device.changed.assign(2, 0);
+    device.subscribedUntil.assign(2, 0);
+
+    // One request each, the first read of the point is due within its period
+    uint8_t subscribe[128];
+    uint8_t read[APDU_MAX_LENGTH + 64];
+    size_t subscribeLength = 0;
+    size_t readLength = 0;
+    if (!client.Poll(0, subscribe, sizeof(subscribe), &subscribeLength) || !poller.Poll(1000, read, sizeof(read), &readLength)) {
+        return false;
+    }
+    WSHubFrameHeader header;
+    size_t subscribeApduLength;
+    size_t readApduLength;
+    WSHubFrameHeader::Parse(subscribe, subscribeLength, &header);
+    const uint8_t* subscribeApdu = header.GetApdu(subscribe, subscribeLength, &subscribeApduLength);
+    WSHubFrameHeader::Parse(read, readLength, &header);
+    uint8_t readInvokeId = header.GetApdu(read, readLength, &readApduLength)[2];
+    bool distinct = subscribeApdu[2] != readInvokeId;
+
+    // Answers of the stack's ReadProperty with the same invoke IDs
+    uint8_t frame[APDU_MAX_LENGTH * 2 + 64];
+    uint8_t stackAck[] = { APDU_TYPE_COMPLEX_ACK << 4, readInvokeId, APDU_SERVICE_READ_PROPERTY, 0x0C, 0x00, 0x00, 0x00, 0x00 };
+    uint8_t stackError[] = { APDU_TYPE_ERROR << 4, subscribeApdu[2], APDU_SERVICE_READ_PROPERTY, 0x91, 0x02, 0x91, 0x20 };
+    size_t length = BenchmarkDeviceFrame(frame, sizeof(frame), 0, instance, stackAck, sizeof(stackAck));
+    bool stackTaken = poller.OnReceived(frame, length, 1001) || client.OnReceived(frame, length, 1001);
+    length = BenchmarkDeviceFrame(frame, sizeof(frame), 1, instance, stackError, sizeof(stackError));
+    stackTaken = stackTaken || poller.OnReceived(frame, length, 1001) || client.OnReceived(frame, length, 1001);
+
+    std::priority_queue<BenchmarkCOVFrame, std::vector<BenchmarkCOVFrame>, std::greater<BenchmarkCOVFrame> > pending;
+    uint16_t messageId = 2;
+    uint64_t lapsed = 0;
+    BenchmarkCOVSubscribe(subscribeApdu, subscribeApduLength, device, instance, 1002, &messageId, &pending, &lapsed);
+    length = BenchmarkPollingAnswer(read, readLength, device.device, instance, device.values.data(), frame, sizeof(frame));
+    bool readTaken = poller.OnReceived(frame, length, 1002);
+    // The SimpleACK and the first notification
+    bool subscribeTaken = pending.size() == 2;
+    for (; !pending.empty(); pending.pop()) {
+        const std::string& answer = pending.top().second;
+        subscribeTaken = subscribeTaken && !poller.OnReceived((const uint8_t*)answer.data(), answer.size(), 1002) && client.OnReceived((const uint8_t*)answer.data(), answer.size(), 1002);
+    }
+
+    bool ok = distinct && !stackTaken && readTaken && subscribeTaken &&
+              poller.GetPoint(0).status == ExamplePoller::STATUS_OK && client.GetCount(ExampleCOVClient::STATE_SUBSCRIBED) == 1;
+    std::cout << "  shared invoke IDs: poller " << (int)readInvokeId << ", COV client " << (int)subscribeApdu[2] << ", answers of the stack taken: " << (stackTaken ? "yes" : "no");
+    std::cout << ", each answer taken by its client: " << (readTaken && subscribeTaken ? "yes" : "no") << (ok ? " (ok)" : " (FAILED)") << std::endl;
+    return ok;
+}
+
+bool ExampleBenchmark::COVClient(int argc, char** argv) {
+    const size_t pointCount = std::max<size_t>(BenchmarkArgument(argc, argv, 1, 10000), BENCHMARK_COV_OBJECTS_PER_DEVICE);
+    const uint32_t changePercent = (uint32_t)std::min<size_t>(BenchmarkArgument(argc, argv, 2, 1), 100);
+    const uint64_t seconds = std::max<size_t>(BenchmarkArgument(argc, argv, 3, 900), 10);
+    const size_t deviceCount = pointCount / BENCHMARK_COV_OBJECTS_PER_DEVICE;
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "COV client benchmark, points=" << deviceCount * BENCHMARK_COV_OBJECTS_PER_DEVICE << ", changePercent=" << changePercent << ", seconds=" << seconds << std::endl;
+
+    // Devices answer in 10 to 60 ms, 5% do not support COV
+    std::mt19937 random(42);
+    std::vector<BenchmarkCOVDevice> devices(deviceCount);
+    for (size_t index = 0; index < deviceCount; index++) {
+        BenchmarkCOVDevice& device = devices[index];
+        device.device.maxApdu = index % 3 == 0 ? 480 : 1476;
+        device.device.latency = std::uniform_int_distribution<uint32_t>(10, 60)(random);
+        device.device.dropPercent = 0;
+        device.device.busyUntil = 0;
+        device.refuses = index % 20 == 7;
+        device.values.assign(BENCHMARK_COV_OBJECTS_PER_DEVICE, 0.0f);
+        device.changed.assign(BENCHMARK_COV_OBJECTS_PER_DEVICE, 0);
+        device.subscribedUntil.assign(BENCHMARK_COV_OBJECTS_PER_DEVICE, 0);
+    }
+
+    ok = BenchmarkCOVSharedInvokeIds() && ok;
+
+    std::cout << "  polling every second with ReadPropertyMultiple:" << std::endl;
+    BenchmarkCOVResult polling = BenchmarkCOVRun(false, devices, changePercent, seconds * 1000);
+    std::cout << "  COV subscriptions:" << std::endl;
+    BenchmarkCOVResult subscribed = BenchmarkCOVRun(true, devices, changePercent, seconds * 1000);
+
+    ok = ok && polling.wrong == 0 && subscribed.wrong == 0 && subscribed.lapsed == 0 && subscribed.renewalPeak < subscribed.subscribePeak;
+    std::cout << "  COV: " << 100.0 * subscribed.bytes / std::max<uint64_t>(1, polling.bytes) << "% of the hub bytes and " << 100.0 * subscribed.frames / std::max<uint64_t>(1, polling.frames) << "% of the frames of polling" << std::endl;
+    return ok;
+}
+
+//
+// Command Queue
+// ----------------------------------------------------------------------------
+// Producer threads post commands to one consumer thread, the way other
+// threads hand work to the stack thread. The same load goes through a
+// std::mutex and std::deque for comparison. Every command must run once, in
+// the order of its producer.
+
+// Consumer side of the throughput test: last sequence seen per producer
+struct BenchmarkCommandState {
+    std::vector<uint64_t> next;
+    uint64_t run;
+    uint64_t outOfOrder;
+};
+
+static void BenchmarkCommand(BenchmarkCommandState* state, const size_t producer, const uint64_t sequence) {
+    state->outOfOrder += state->next[producer] != sequence;
+    state->next[producer] = sequence + 1;
+    state->run++;
+}
+
+bool ExampleBenchmark::CommandQueue(int argc, char** argv) {
+    const size_t producerCount = std::max<size_t>(BenchmarkArgument(argc, argv, 1, 4), 1);
+    const size_t commandCount = std::max<size_t>(BenchmarkArgument(argc, argv, 2, 1000000), 1);
+    const size_t roundTrips = 20000;
+    const uint64_t total = (uint64_t)producerCount * commandCount;
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Command queue benchmark, producers=" << producerCount << ", commandsPerProducer=" << commandCount << std::endl;
+
+    // Lock free queue, the consumer runs batches like the stack thread does
+    {
+        ExampleCommandQueue queue;
+        BenchmarkCommandState state;
+        state.next.assign(producerCount, 0);
+        state.run = 0;
+        state.outOfOrder = 0;
+        std::vector<double> postSeconds(producerCount);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> producers;
+        for (size_t producer = 0; producer < producerCount; producer++) {
+            producers.push_back(std::thread([&, producer] {
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                BenchmarkClock::time_point start = BenchmarkClock::now();
+                for (uint64_t sequence = 0; sequence < commandCount; sequence++) {
+                    queue.Post([&state, producer, sequence] { BenchmarkCommand(&state, producer, sequence); });
+                }
+                postSeconds[producer] = BenchmarkSeconds(start, BenchmarkClock::now());
+            }));
+        }
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        go.store(true);
+        while (state.run < total) {
+            if (queue.Run(64) == 0) {
+                queue.Wait(1);
+            }
+        }
+        double seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        for (std::thread& producer : producers) {
+            producer.join();
+        }
+        double postNanoseconds = 0;
+        for (double producerSeconds : postSeconds) {
+            postNanoseconds += producerSeconds * 1e9 / commandCount / producerCount;
+        }
+        bool queueOk = state.run == total && state.outOfOrder == 0 && queue.IsEmpty();
+        ok = ok && queueOk;
+        std::cout << "  lock free: " << total / seconds / 1e6 << " M commands/s, Post " << postNanoseconds << " ns, consumer slept " << queue.waits << " times, ";
+        std::cout << state.outOfOrder << " out of order, all run once: " << (queueOk ? "yes" : "no") << std::endl;
+    }
+
+    // Mutex and deque
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()> > queue;
+        BenchmarkCommandState state;
+        state.next.assign(producerCount, 0);
+        state.run = 0;
+        state.outOfOrder = 0;
+        std::vector<double> postSeconds(producerCount);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> producers;
+        for (size_t producer = 0; producer < producerCount; producer++) {
+            producers.push_back(std::thread([&, producer] {
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                BenchmarkClock::time_point start = BenchmarkClock::now();
+                for (uint64_t sequence = 0; sequence < commandCount; sequence++) {
+                    std::function<void()> work = [&state, producer, sequence] { BenchmarkCommand(&state, producer, sequence); };
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queue.push_back(std::move(work));
+                }
+                postSeconds[producer] = BenchmarkSeconds(start, BenchmarkClock::now());
+            }));
+        }
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        go.store(true);
+        std::vector<std::function<void()> > batch;
+        while (state.run < total) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while (!queue.empty() && batch.size() < 64) {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+            for (std::function<void()>& work : batch) {
+                work();
+            }
+            if (batch.empty()) {
+                std::this_thread::yield();
+            }
+            batch.clear();
+        }
+        double seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        for (std::thread& producer : producers) {
+            producer.join();
+        }
+        double postNanoseconds = 0;
+        for (double producerSeconds : postSeconds) {
+            postNanoseconds += producerSeconds * 1e9 / commandCount / producerCount;
+        }
+        std::cout << "  std::mutex: " << total / seconds / 1e6 << " M commands/s, Post " << postNanoseconds << " ns, " << state.outOfOrder << " out of order" << std::endl;
+    }
+
+    // Round trip through a sleeping consumer: Submit and wait for the future
+    {
+        ExampleCommandQueue queue;
+        std::atomic<bool> running(true);
+        std::thread consumer([&] {
+            while (running.load()) {
+                if (queue.Run(64) == 0) {
+                    queue.Wait(5);
+                }
+            }
+        });
+        ExampleHdrHistogram latency;
+        size_t wrong = 0;
+        for (size_t index = 0; index < roundTrips; index++) {
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            wrong += queue.Submit([index] { return index * 2; }).get() != index * 2;
+            latency.Record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - start).count());
+            if (index % 100 == 0) {
+                // Let the consumer fall asleep now and then
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+        bool thrown = false;
+        try {
+            queue.Submit([]() -> int { throw std::runtime_error("command failed"); }).get();
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        running.store(false);
+        queue.Post([] {});
+        consumer.join();
+        bool roundTripOk = wrong == 0 && thrown && latency.GetPercentile(99) < 5000000;
+        ok = ok && roundTripOk;
+        std::cout << "  Submit round trip: p50 " << latency.GetPercentile(50) / 1000.0 << " us, p99 " << latency.GetPercentile(99) / 1000.0 << " us, max " << latency.GetMaximum() / 1000.0;
+        std::cout << " us, results and exception: " << (roundTripOk ? "ok" : "failed") << std::endl;
+    }
+
+    // A frame received while the stack thread sleeps, as in RunStack with
+    // mainLoopMaxSleepMilliseconds: taken at the end of the Wait, or at once
+    // when the receive queue wakes the thread
+    for (int woken = 0; woken < 2; woken++) {
+        ExampleCommandQueue queue;
+        WSReceiveQueue frames;
+        if (woken) {
+            frames.SetOnPush([&queue] { queue.Wake(); });
+        }
+        std::atomic<bool> running(true);
+        ExampleHdrHistogram latency;
+        std::thread consumer([&] {
+            while (running.load()) {
+                WSReceivedFrame frame;
+                bool resume;
+                while (frames.Pop(&frame, &resume)) {
+                    latency.Record((uint64_t)(BenchmarkClock::now().time_since_epoch().count() - (int64_t)frame.readTicks));
+                }
+                queue.Run(64);
+                queue.Wait(5);
+            }
+        });
+        const size_t frameCount = 1000;
+        for (size_t index = 0; index < frameCount; index++) {
+            std::this_thread::sleep_for(std::chrono::microseconds(1000 + index % 7 * 300));
+            WSReceivedFrame frame = { std::string(64, '\0'), (uint64_t)BenchmarkClock::now().time_since_epoch().count() };
+            bool pause;
+            frames.Push(frame, WS_PRIORITY_BULK, &pause);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        running.store(false);
+        queue.Wake();
+        consumer.join();
+        double p50 = std::chrono::duration<double, std::micro>(BenchmarkClock::duration(latency.GetPercentile(50))).count();
+        double p99 = std::chrono::duration<double, std::micro>(BenchmarkClock::duration(latency.GetPercentile(99))).count();
+        bool frameOk = latency.GetCount() == frameCount && (!woken || p50 < 1000);
+        ok = ok && frameOk;
+        std::cout << "  frame to a sleeping stack thread, " << (woken ? "woken by the receive queue" : "sleeping up to 5 ms") << ": p50 " << p50 << " us, p99 " << p99 << " us" << (frameOk ? "" : " (FAILED)") << std::endl;
+    }
+    return ok;
+}
+
+//
+// Virtual Devices
+// ----------------------------------------------------------------------------
+// Virtual devices connect to an embedded hub over loopback, with staggered
+// connection starts on one shared io_context. A node then sends a ranged
+// Who-Is and a burst of ReadProperty requests to every device through the
+// hub. Memory per device includes the hub side of its connection.
+
+static const uint32_t BENCHMARK_VIRTUAL_FIRST_DEVICE = 100000;
+static const uint32_t BENCHMARK_VIRTUAL_ANALOG_INPUTS = 4;
+
+static float BenchmarkVirtualValue(const uint32_t device, const uint32_t object) {
+    return (float)(device % 10000) + object * 0.25f;
+}
+
+bool ExampleBenchmark::VirtualDevices(int argc, char** argv) {
+    std::vector<size_t> counts;
+    for (int offset = 1; offset < argc; offset++) {
+        counts.push_back((size_t)std::stoull(argv[offset]));
+    }
+    if (counts.empty()) {
+        counts = { 100, 1000 };
+    }
+    const size_t requestsPerDevice = 100;
+    const size_t whoIsRange = 10;
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Virtual devices benchmark, " << requestsPerDevice << " ReadProperty per device" << std::endl;
+    for (size_t count : counts) {
+        BenchmarkRaiseFileLimit(count + 1);
+        const uint8_t hubVmac[BVLC_SC_VMAC_LENGTH] = { 0x02, 0xFF, 0x00, 0x00, 0x00, 0x01 };
+        const uint8_t hubUuid[BVLC_SC_UUID_LENGTH] = { 0 };
+        WSHubFunction hub;
+        // Every answer of the burst may wait in the write queue of the benchmark node
+        WSQueueLimits hubLimits;
+        hubLimits.maxFrames = count * requestsPerDevice;
+        hubLimits.maxBytes = hubLimits.maxFrames * BVLC_SC_MAX_BVLC_LENGTH;
+        hub.SetQueueLimits(hubLimits, NULL);
+        if (!hub.Start("127.0.0.1", 0, hubVmac, hubUuid)) {
+            return false;
+        }
+        size_t residentBefore = BenchmarkResidentBytes();
+
+        WSVirtualDevices devices;
+        WSVirtualDeviceSettings settings;
+        settings.connectIntervalMilliseconds = 1;
+        devices.SetSettings(settings);
+        for (size_t index = 0; index < count; index++) {
+            uint32_t instance = BENCHMARK_VIRTUAL_FIRST_DEVICE + (uint32_t)index;
+            uint8_t vmac[BVLC_SC_VMAC_LENGTH];
+            uint8_t uuid[BVLC_SC_UUID_LENGTH] = { 0 };
+            WSHubFrameHeader::UnpackVmac(0x020100000000ULL | instance, vmac);
+            memcpy(uuid + BVLC_SC_UUID_LENGTH - BVLC_SC_VMAC_LENGTH, vmac, BVLC_SC_VMAC_LENGTH);
+            size_t position = devices.Add(instance, vmac, uuid, BENCHMARK_VIRTUAL_ANALOG_INPUTS);
+            for (uint32_t object = 0; object < BENCHMARK_VIRTUAL_ANALOG_INPUTS; object++) {
+                devices.SetPresentValue(position, object, BenchmarkVirtualValue(instance, object));
+            }
+        }
+
+        // Staggered connection starts
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        if (!devices.Start("ws://127.0.0.1:" + std::to_string(hub.GetPort()) + "/")) {
+            return false;
+        }
+        BenchmarkClock::time_point deadline = start + std::chrono::seconds(120);
+        while (devices.connectedCount < count && BenchmarkClock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        double connectSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        if (devices.connectedCount < count) {
+            std::cout << "Error: only " << devices.connectedCount << " of " << count << " virtual devices connected" << std::endl;
+            return false;
+        }
+        size_t residentAfter = BenchmarkResidentBytes();
+
+        // The node that sends the requests
+        net::io_context ioc;
+        size_t connectedCount = 0;
+        size_t receivedCount = 0;
+        std::vector<std::string> received;
+        std::shared_ptr<BenchmarkHubNode> node = std::make_shared<BenchmarkHubNode>(ioc, 0, &connectedCount, &receivedCount);
+        node->received = &received;
+        node->Start(tcp::endpoint(net::ip::make_address("127.0.0.1"), hub.GetPort()));
+        if (!BenchmarkRunUntil(ioc, [&] { return connectedCount == 1; }, std::chrono::seconds(10))) {
+            std::cout << "Error: the benchmark node did not connect" << std::endl;
+            return false;
+        }
+
+        // Who-Is for the first whoIsRange devices, only they answer
+        uint8_t apdu[64];
+        uint8_t frame[128];
+        size_t apduLength = ExampleApdu::BuildWhoIs(apdu, sizeof(apdu), BENCHMARK_VIRTUAL_FIRST_DEVICE, BENCHMARK_VIRTUAL_FIRST_DEVICE + (uint32_t)whoIsRange - 1);
+        size_t frameLength = ExampleApdu::BuildFrame(frame, sizeof(frame), 1, NULL, false, apdu, apduLength);
+        node->Send(std::make_shared<std::string>((const char*)frame, frameLength));
+        size_t expectedIAms = std::min(count, whoIsRange);
+        BenchmarkRunUntil(ioc, [&] { return receivedCount >= expectedIAms; }, std::chrono::seconds(10));
+        // Let any extra I-Am arrive
+        ioc.run_for(std::chrono::milliseconds(200));
+        size_t iAms = 0;
+        for (const std::string& answer : received) {
+            ExampleIAm iAm;
+            if (ExampleApdu::ParseIAm((const uint8_t*)answer.data(), answer.size(), &iAm) && iAm.vmac == (0x020100000000ULL | iAm.instance) && iAm.instance < BENCHMARK_VIRTUAL_FIRST_DEVICE + whoIsRange) {
+                iAms++;
+            }
+        }
+        size_t whoIsFrames = received.size();
+        bool whoIsOk = iAms == expectedIAms && whoIsFrames == expectedIAms;
+
+        // A burst of ReadProperty of a Present Value to every device
+        received.clear();
+        receivedCount = 0;
+        size_t expected = count * requestsPerDevice;
+        std::vector<WSHubFrame> requests;
+        for (size_t index = 0; index < count; index++) {
+            uint32_t instance = BENCHMARK_VIRTUAL_FIRST_DEVICE + (uint32_t)index;
+            uint8_t vmac[BVLC_SC_VMAC_LENGTH];
+            WSHubFrameHeader::UnpackVmac(0x020100000000ULL | instance, vmac);
+            for (size_t request = 0; request < requestsPerDevice; request++) {
+                ExampleApduWriter writer(apdu, sizeof(apdu));
+                writer.Byte(APDU_TYPE_CONFIRMED_REQUEST << 4);
+                writer.Byte(APDU_MAX_APDU_ACCEPTED_1476);
+                writer.Byte((uint8_t)request);
+                writer.Byte(APDU_SERVICE_READ_PROPERTY);
+                writer.ContextObjectIdentifier(0, APDU_OBJECT_TYPE_ANALOG_INPUT, (uint32_t)request % BENCHMARK_VIRTUAL_ANALOG_INPUTS);
+                writer.ContextUnsigned(1, APDU_PROPERTY_PRESENT_VALUE);
+                frameLength = ExampleApdu::BuildFrame(frame, sizeof(frame), (uint16_t)request, vmac, true, apdu, writer.GetLength());
+                requests.push_back(std::make_shared<std::string>((const char*)frame, frameLength));
+            }
+        }
+        uint64_t framesBefore = hub.framesReceived;
+        start = BenchmarkClock::now();
+        for (const WSHubFrame& request : requests) {
+            node->Send(request);
+        }
+        if (!BenchmarkRunUntil(ioc, [&] { return receivedCount >= expected; }, std::chrono::seconds(300))) {
+            std::cout << "Error: only " << receivedCount << " of " << expected << " answers" << std::endl;
+            return false;
+        }
+        double burstSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        uint64_t hubFrames = hub.framesReceived - framesBefore;
+
+        // Every answer has the value of its device and object
+        size_t wrong = 0;
+        for (const std::string& answer : received) {
+            WSHubFrameHeader header;
+            size_t answerLength = 0;
+            const uint8_t* answerApdu = WSHubFrameHeader::Parse((const uint8_t*)answer.data(), answer.size(), &header) ? header.GetApdu((const uint8_t*)answer.data(), answer.size(), &answerLength) : NULL;
+            ExampleApduReader reader(answerApdu, answerLength, 3);
+            uint16_t objectType;
+            uint32_t object;
+            uint32_t property;
+            double value;
+            if (answerApdu == NULL || header.originatingVmac == NULL || answerLength < 3 || answerApdu[0] != (APDU_TYPE_COMPLEX_ACK << 4) || answerApdu[2] != APDU_SERVICE_READ_PROPERTY ||
+                !reader.ReadContextObjectIdentifier(0, &objectType, &object) || !reader.ReadContextUnsigned(1, &property) || !reader.ReadOpeningTag(3) || !reader.ReadApplicationValue(&value) ||
+                value != BenchmarkVirtualValue((uint32_t)(WSHubFrameHeader::PackVmac(header.originatingVmac) & 0xFFFFFFFF), object) || object != answerApdu[1] % BENCHMARK_VIRTUAL_ANALOG_INPUTS) {
+                wrong++;
+            }
+        }
+        bool countOk = wrong == 0 && devices.connectFailures == 0 && devices.disconnects == 0;
+        ok = ok && whoIsOk && countOk;
+
+        std::cout << "  " << count << " devices:" << std::endl;
+        std::cout << "    connect: all connected in " << connectSeconds << " s, " << devices.connectsStarted << " connects, " << devices.connectFailures << " failed, " << settings.threads << " transport threads" << std::endl;
+        std::cout << "    memory: " << (residentAfter - std::min(residentAfter, residentBefore)) / 1024.0 / count << " KB per device" << std::endl;
+        std::cout << "    Who-Is for " << whoIsRange << " devices: " << iAms << " I-Am, " << whoIsFrames << " frames: " << (whoIsOk ? "ok" : "wrong") << std::endl;
+        std::cout << "    ReadProperty burst: " << (expected * 2) / burstSeconds << " frames/s through the hub (" << hubFrames << " frames in " << burstSeconds << " s), ";
+        std::cout << expected / burstSeconds << " answers/s, wrong answers " << wrong << std::endl;
+
+        devices.Stop();
+        hub.Stop();
+    }
+    return ok;
+}
+
+//
+// Flood
+// ----------------------------------------------------------------------------
+
+struct BenchmarkFloodResult {
+    size_t delivered;
+    size_t outOfOrder;
+    size_t peakFrames;
+    size_t peakBudgetBytes;
+    uint64_t drops[WS_DROP_REASON_COUNT];
+    size_t residentGrowth;
+    double seconds;
+    bool complete;
+};
+
+// Accept one client and write frames numbered from 0 as fast as it reads
+// them, then one frame of tooLongLength bytes if not 0
+static void BenchmarkFloodServer(tcp::acceptor* acceptor, const size_t frames, const size_t frameLength, const size_t tooLongLength) {
+    try {
+        websocket::stream<tcp::socket> ws(acceptor->accept());
+        ws.set_option(websocket::stream_base::decorator([](websocket::response_type& res) {
+            res.set(http::field::sec_websocket_protocol, "hub.bsc.bacnet.org");
+        }));
+        ws.accept();
+        ws.binary(true);
+        std::string frame(frameLength, '\0');
+        for (size_t sequence = 0; sequence < frames; sequence++) {
+            frame[0] = (char)(sequence >> 24);
+            frame[1] = (char)(sequence >> 16);
+            frame[2] = (char)(sequence >> 8);
+            frame[3] = (char)sequence;
+            ws.write(net::buffer(frame));
+        }
+        if (tooLongLength > 0) {
+            ws.write(net::buffer(std::string(tooLongLength, '\0')));
+        }
+        ws.close(websocket::close_code::normal);
+    }
+    catch (std::exception&) {
+        // The client closed first, e.g. on the frame that was too long
+    }
+}
+
+static BenchmarkFloodResult BenchmarkFloodRun(const WSQueueLimits& limits, const size_t budgetBytes, const size_t frames, const size_t frameLength, const size_t tooLongLength) {
+    BenchmarkFloodResult result = {};
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    std::thread server(BenchmarkFloodServer, &acceptor, frames, frameLength, tooLongLength);
+
+    WSMemoryBudget budget(budgetBytes);
+    size_t residentBefore = BenchmarkResidentBytes();
+    size_t residentPeak = residentBefore;
+    // The client logs every frame
+    std::streambuf* coutBuffer = std::cout.rdbuf(NULL);
+    {
+        WSClientUnsecure client;
+        client.SetQueueLimits(limits, &budget);
+        uint8_t errorCode = 0;
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        client.Connect("ws://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + "/", &errorCode);
+
+        // A stack slower than the server: a short pause every 32 frames
+        WSReceiveQueue& queue = client.GetReceiveQueue();
+        uint8_t message[BVLC_SC_MAX_BVLC_LENGTH];
+        size_t next = 0;
+        BenchmarkClock::time_point deadline = start + std::chrono::seconds(120);
+        while (BenchmarkClock::now() < deadline) {
+            uint64_t dropped = queue.drops.Get(WS_DROP_QUEUE_FULL) + queue.drops.Get(WS_DROP_MEMORY_BUDGET);
+            if (result.delivered + dropped >= frames && (tooLongLength == 0 || queue.drops.Get(WS_DROP_TOO_LONG) > 0)) {
+                result.complete = true;
+                break;
+            }
+            size_t length = client.RecvWSMessage(message, sizeof(message), &errorCode);
+            if (length == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            size_t sequence = ((size_t)message[0] << 24) | ((size_t)message[1] << 16) | ((size_t)message[2] << 8) | message[3];
+            if (sequence < next) {
+                result.outOfOrder++;
+            }
+            next = sequence + 1;
+            result.delivered++;
+            if (result.delivered % 32 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                residentPeak = std::max(residentPeak, BenchmarkResidentBytes());
+            }
+        }
+        result.seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+        result.peakFrames = queue.peakFrames;
+        result.peakBudgetBytes = budget.GetPeak();
+        for (uint8_t reason = 0; reason < WS_DROP_REASON_COUNT; reason++) {
+            result.drops[reason] = queue.drops.Get(reason);
+        }
+        client.Disconnect();
+    }
+    std::cout.rdbuf(coutBuffer);
+    std::cout.clear();
+    server.join();
+    result.residentGrowth = residentPeak - residentBefore;
+    return result;
+}
+
+bool ExampleBenchmark::Flood(int argc, char** argv) {
+    const size_t frames = BenchmarkArgument(argc, argv, 1, 100000);
+    const size_t frameLength = std::max(BenchmarkArgument(argc, argv, 2, 100), (size_t)4);
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Flood benchmark, " << frames << " frames of " << frameLength << " bytes to a client that reads slower than they are sent" << std::endl;
+
+    struct Case {
+        const char* name;
+        uint8_t policy;
+        size_t maxFrames;
+        size_t maxBytes;            // 0 for maxFrames frames of frameLength
+        size_t frameLength;         // 0 for the argument
+        size_t budgetBytes;
+        size_t tooLongLength;
+    };
+    const size_t unbounded = (size_t)-1;
+    const Case cases[] = {
+        { "unbounded", WS_QUEUE_POLICY_DROP_NEWEST, unbounded, 0, 0, unbounded, 0 },
+        { "pause reading", WS_QUEUE_POLICY_PAUSE_READING, 256, 0, 0, unbounded, 0 },
+        // Room for two frames and part of a third
+        { "pause reading, 4000 bytes of 1500 byte frames", WS_QUEUE_POLICY_PAUSE_READING, 256, 4000, 1500, unbounded, 0 },
+        { "drop newest", WS_QUEUE_POLICY_DROP_NEWEST, 256, 0, 0, unbounded, 0 },
+        { "drop oldest", WS_QUEUE_POLICY_DROP_OLDEST, 256, 0, 0, unbounded, 0 },
+        { "memory budget 64 KB", WS_QUEUE_POLICY_DROP_NEWEST, unbounded, 0, 0, 64 * 1024, 0 },
+        { "frame over the read limit", WS_QUEUE_POLICY_PAUSE_READING, 256, 0, 0, unbounded, BVLC_SC_MAX_BVLC_LENGTH + 1 },
+    };
+    for (const Case& test : cases) {
+        size_t caseFrameLength = test.frameLength != 0 ? test.frameLength : frameLength;
+        WSQueueLimits limits;
+        limits.policy = test.policy;
+        limits.maxFrames = test.maxFrames;
+        limits.maxBytes = test.maxBytes != 0 ? test.maxBytes : (test.maxFrames == unbounded ? unbounded : test.maxFrames * caseFrameLength);
+        size_t caseFrames = frames;
+        if (test.tooLongLength > 0) {
+            caseFrames = std::min(frames, (size_t)1000);
+        }
+        else if (test.maxBytes != 0) {
+            // The reader pauses after every frame or two
+            caseFrames = std::min(frames, (size_t)10000);
+        }
+        BenchmarkFloodResult result = BenchmarkFloodRun(limits, test.budgetBytes, caseFrames, caseFrameLength, test.tooLongLength);
+
+        uint64_t dropped = result.drops[WS_DROP_QUEUE_FULL] + result.drops[WS_DROP_MEMORY_BUDGET];
+        bool caseOk = result.complete && result.outOfOrder == 0 && result.delivered + dropped == caseFrames && result.drops[WS_DROP_BUFFER_TOO_SMALL] == 0;
+        if (test.maxFrames != unbounded) {
+            caseOk = caseOk && result.peakFrames <= test.maxFrames;
+        }
+        if (test.budgetBytes != unbounded) {
+            caseOk = caseOk && result.peakBudgetBytes <= test.budgetBytes && result.drops[WS_DROP_MEMORY_BUDGET] > 0;
+        }
+        if (test.maxBytes != 0) {
+            // The budget counts every byte queued
+            caseOk = caseOk && result.peakBudgetBytes <= test.maxBytes;
+        }
+        if (test.policy == WS_QUEUE_POLICY_PAUSE_READING) {
+            // Backpressure loses nothing
+            caseOk = caseOk && dropped == 0;
+        }
+        caseOk = caseOk && result.drops[WS_DROP_TOO_LONG] == (test.tooLongLength > 0 ? 1u : 0u);
+        ok = ok && caseOk;
+
+        std::cout << "  " << test.name << ": " << result.delivered << " delivered in " << result.seconds << " s (" << result.delivered / result.seconds << " frames/s), ";
+        std::cout << "peak queue " << result.peakFrames << " frames / " << result.peakBudgetBytes / 1024.0 << " KB, resident +" << result.residentGrowth / 1024.0 << " KB, drops";
+        for (uint8_t reason = 0; reason < WS_DROP_REASON_COUNT; reason++) {
+            std::cout << " " << WSDropCounters::GetReasonName(reason) << "=" << result.drops[reason];
+        }
+        std::cout << ": " << (caseOk ? "ok" : "wrong") << std::endl;
+    }
+    return ok;
+}
+
+//
+// Outbound Priority
+// ----------------------------------------------------------------------------
+// One node floods the hub with large broadcasts, so the write queue of every
+// other node grows. Meanwhile the probe node sends a Heartbeat-Request every
+// millisecond and the requester node sends it a confirmed request every
+// millisecond. The round trip of the heartbeats and the delivery time of the
+// requests are measured with one FIFO per node, and with the priority classes.
+
+struct BenchmarkOutboundResult {
+    ExampleHdrHistogram heartbeat;      // Nanoseconds
+    ExampleHdrHistogram confirmed;
+    size_t heartbeatsLost;
+    size_t confirmedLost;
+    uint64_t dropped;
+    double bulkSeconds;
+    bool complete;
+};
+
+static WSHubFrame BenchmarkOutboundFrame(const uint8_t* destination, const uint16_t messageId, const uint8_t* apdu, const size_t apduLength, const size_t length) {
+    // Encapsulated-NPDU, NPDU without addresses, then the APDU padded to length
+    const size_t headerLength = BVLC_SC_FIXED_HEADER_LENGTH + BVLC_SC_VMAC_LENGTH + 2;
+    std::shared_ptr<std::string> frame = std::make_shared<std::string>(std::max(length, headerLength + apduLength), '\0');
+    uint8_t* out = reinterpret_cast<uint8_t*>(&(*frame)[0]);
+    out[0] = BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+    out[1] = BVLC_SC_CONTROL_DESTINATION_VMAC;
+    out[2] = (uint8_t)(messageId >> 8);
+    out[3] = (uint8_t)messageId;
+    memcpy(out + 4, destination, BVLC_SC_VMAC_LENGTH);
+    out[10] = 0x01;
+    out[11] = apdu[0] >> 4 == APDU_TYPE_CONFIRMED_REQUEST ? NPDU_CONTROL_EXPECTING_REPLY : 0;
+    memcpy(out + headerLength, apdu, apduLength);
+    return frame;
+}
+
+static void BenchmarkOutboundRun(const bool prioritized, const size_t bulkFrames, const size_t receivers, BenchmarkOutboundResult* result) {
+    const uint8_t hubVmac[BVLC_SC_VMAC_LENGTH] = { 0x02, 0xFF, 0x00, 0x00, 0x00, 0x01 };
+    const uint8_t hubUuid[BVLC_SC_UUID_LENGTH] = { 0 };
+    WSHubFunction hub;
+    // Room for the whole burst, so only the order changes between the runs
+    WSQueueLimits limits;
+    limits.maxFrames = bulkFrames + 65536;
+    limits.maxBytes = (size_t)-1;
+    limits.policy = WS_QUEUE_POLICY_DROP_NEWEST;
+    limits.prioritized = prioritized;
+    limits.socketSendBufferBytes = 16 * 1024;
+    hub.SetQueueLimits(limits, NULL);
+    if (!hub.Start("127.0.0.1", 0, hubVmac, hubUuid)) {
+        return;
+    }
+    tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), hub.GetPort());
+
+    // Node 0 floods, node 1 sends confirmed requests to node 2, the probe.
+    // Every node but node 0 receives the broadcasts.
+    net::io_context ioc;
+    size_t connectedCount = 0;
+    size_t receivedCount = 0;
+    std::vector<std::shared_ptr<BenchmarkHubNode>> nodes;
+    for (size_t offset = 0; offset < receivers + 1; offset++) {
+        nodes.push_back(std::make_shared<BenchmarkHubNode>(ioc, offset, &connectedCount, &receivedCount));
+        nodes.back()->Start(endpoint);
+    }
+    if (!BenchmarkRunUntil(ioc, [&] { return connectedCount == nodes.size(); }, std::chrono::seconds(30))) {
+        hub.Stop();
+        return;
+    }
+
+    std::vector<BenchmarkClock::time_point> heartbeatsSent;
+    std::vector<BenchmarkClock::time_point> confirmedSent;
+    size_t heartbeatsAnswered = 0;
+    size_t confirmedReceived = 0;
+    size_t bulkReceived = 0;
+    nodes[2]->observer = [&](const uint8_t* frame, size_t length) {
+        uint16_t messageId = (uint16_t)((frame[2] << 8) | frame[3]);
+        uint64_t nanoseconds = 0;
+        if (frame[0] == BVLC_SC_FUNCTION_HEARTBEAT_ACK && messageId < heartbeatsSent.size()) {
+            nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - heartbeatsSent[messageId]).count();
+            result->heartbeat.Record(nanoseconds);
+            heartbeatsAnswered++;
+        }
+        // Forwarded by the hub: originating VMAC, NPDU, then the APDU
+        else if (frame[0] == BVLC_SC_FUNCTION_ENCAPSULATED_NPDU && length > 12) {
+            if (frame[12] >> 4 == APDU_TYPE_CONFIRMED_REQUEST && messageId < confirmedSent.size()) {
+                nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - confirmedSent[messageId]).count();
+                result->confirmed.Record(nanoseconds);
+                confirmedReceived++;
+            }
+            else {
+                bulkReceived++;
+            }
+        }
+    };
+
+    // The burst, as fast as node 0 can write it
+    const uint8_t broadcastVmac[BVLC_SC_VMAC_LENGTH] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    const uint8_t privateTransfer[] = { APDU_TYPE_UNCONFIRMED_REQUEST << 4, 0x04 };   // UnconfirmedPrivateTransfer
+    WSHubFrame bulk = BenchmarkOutboundFrame(broadcastVmac, 0, privateTransfer, sizeof(privateTransfer), 1400);
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t count = 0; count < bulkFrames; count++) {
+        nodes[0]->Send(bulk);
+    }
+
+    // A heartbeat and a confirmed request every millisecond until the probe has the whole burst
+    net::steady_timer timer(ioc);
+    std::function<void(beast::error_code)> tick = [&](beast::error_code errorCode) {
+        if (errorCode || bulkReceived >= bulkFrames || heartbeatsSent.size() >= 0xFFFF) {
+            return;
+        }
+        uint16_t messageId = (uint16_t)heartbeatsSent.size();
+        std::shared_ptr<std::string> heartbeat = std::make_shared<std::string>(BVLC_SC_FIXED_HEADER_LENGTH, '\0');
+        (*heartbeat)[0] = (char)BVLC_SC_FUNCTION_HEARTBEAT_REQUEST;
+        (*heartbeat)[2] = (char)(messageId >> 8);
+        (*heartbeat)[3] = (char)messageId;
+        heartbeatsSent.push_back(BenchmarkClock::now());
+        nodes[2]->Send(heartbeat);
+
+        const uint8_t readProperty[] = { APDU_TYPE_CONFIRMED_REQUEST << 4, APDU_MAX_APDU_ACCEPTED_1476, (uint8_t)messageId, APDU_SERVICE_READ_PROPERTY };
+        confirmedSent.push_back(BenchmarkClock::now());
+        nodes[1]->Send(BenchmarkOutboundFrame(nodes[2]->vmac, messageId, readProperty, sizeof(readProperty), 0));
+
+        timer.expires_after(std::chrono::milliseconds(1));
+        timer.async_wait(tick);
+    };
+    tick(beast::error_code());
+
+    const size_t expected = receivers * bulkFrames;
+    result->complete = BenchmarkRunUntil(ioc, [&] {
+        return receivedCount >= expected + confirmedSent.size() && heartbeatsAnswered == heartbeatsSent.size() && bulkReceived >= bulkFrames;
+    }, std::chrono::seconds(120));
+    result->bulkSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    result->heartbeatsLost = heartbeatsSent.size() - heartbeatsAnswered;
+    result->confirmedLost = confirmedSent.size() - confirmedReceived;
+    result->dropped = hub.GetQueueDrops().GetTotal();
+    timer.cancel();
+    hub.Stop();
+}
+
+bool ExampleBenchmark::OutboundPriority(int argc, char** argv) {
+    const size_t bulkFrames = BenchmarkArgument(argc, argv, 1, 20000);
+    const size_t receivers = std::max(BenchmarkArgument(argc, argv, 2, 8), (size_t)2);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Outbound priority benchmark, " << bulkFrames << " broadcasts of 1400 bytes to " << receivers << " nodes, a heartbeat and a confirmed request every ms" << std::endl;
+
+    BenchmarkOutboundResult results[2];
+    const char* const names[2] = { "one FIFO", "priority classes" };
+    bool ok = true;
+    for (size_t run = 0; run < 2; run++) {
+        BenchmarkOutboundResult& result = results[run];
+        result.heartbeatsLost = 0;
+        result.confirmedLost = 0;
+        result.dropped = 0;
+        result.bulkSeconds = 0;
+        result.complete = false;
+        BenchmarkOutboundRun(run == 1, bulkFrames, receivers, &result);
+
+        bool runOk = result.complete && result.heartbeatsLost == 0 && result.confirmedLost == 0 && result.dropped == 0 && result.heartbeat.GetCount() > 0;
+        ok = ok && runOk;
+        std::cout << "  " << names[run] << ": burst " << result.bulkSeconds << " s (" << receivers * bulkFrames / std::max(result.bulkSeconds, 1e-9) << " deliveries/s)" << std::endl;
+        std::cout << "    heartbeat round trip p50 " << result.heartbeat.GetPercentile(50) / 1e6 << " ms, p99 " << result.heartbeat.GetPercentile(99) / 1e6
+                  << " ms, max " << result.heartbeat.GetMaximum() / 1e6 << " ms (" << result.heartbeat.GetCount() << ")" << std::endl;
+        std::cout << "    confirmed request p50 " << result.confirmed.GetPercentile(50) / 1e6 << " ms, p99 " << result.confirmed.GetPercentile(99) / 1e6
+                  << " ms, max " << result.confirmed.GetMaximum() / 1e6 << " ms (" << result.confirmed.GetCount() << "), lost " << result.heartbeatsLost + result.confirmedLost
+                  << ", dropped " << result.dropped << ": " << (runOk ? "ok" : "wrong") << std::endl;
+    }
+
+    // Control messages no longer wait for the burst
+    bool bounded = results[1].heartbeat.GetPercentile(99) < results[0].heartbeat.GetPercentile(99);
+    std::cout << "  heartbeat p99 with priority classes below one FIFO: " << (bounded ? "ok" : "wrong") << std::endl;
+    return ok && bounded;
+}
+
+//
+// Classify
+// ----------------------------------------------------------------------------
+// Decodes the BVLC-SC header of a mix of frames, as the transport does for
+// every frame it reads, and compares it with the copy of the frame into the
+// receive queue that follows.
+
+// A broadcast ReadProperty from a hub: originating and destination VMAC, a
+// destination option with data, a data option without, then the NPDU
+static constexpr uint8_t BenchmarkClassifyFrame[] = {
+    BVLC_SC_FUNCTION_ENCAPSULATED_NPDU, 0x0F, 0x12, 0x34,
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    BVLC_SC_HEADER_OPTION_DATA, 0x00, 0x01, 0x99,
+    0x1F,
+    0x01, 0x04, 0x00, 0x05, 0x01, 0x0C, 0x0C, 0x00, 0x00, 0x00, 0x01, 0x19, 0x55
+};
+
+// The decoder runs at compile time too
+static_assert(WSFrameView(BenchmarkClassifyFrame, sizeof(BenchmarkClassifyFrame)).IsValid(), "header decodes");
+static_assert(WSFrameView(BenchmarkClassifyFrame, sizeof(BenchmarkClassifyFrame)).GetMessageId() == 0x1234, "message ID");
+static_assert(WSFrameView(BenchmarkClassifyFrame, sizeof(BenchmarkClassifyFrame)).IsBroadcast(), "broadcast");
+static_assert(WSFrameView(BenchmarkClassifyFrame, sizeof(BenchmarkClassifyFrame)).GetPayloadOffset() == 21, "options skipped");
+static_assert(WSFrameView(BenchmarkClassifyFrame, sizeof(BenchmarkClassifyFrame)).GetPriority() == WS_PRIORITY_CONFIRMED, "confirmed request");
+static_assert(!WSFrameView(BenchmarkClassifyFrame, 18).IsValid(), "option past the end");
+
+bool ExampleBenchmark::Classify(int argc, char** argv) {
+    const size_t frames = BenchmarkArgument(argc, argv, 1, 10000000);
+
+    // Frame, expected function or BVLC_SC_FUNCTION_COUNT when malformed, expected priority
+    struct Sample {
+        std::string frame;
+        uint8_t function;
+        uint8_t priority;
+    };
+    std::vector<Sample> samples;
+    const uint8_t heartbeat[] = { BVLC_SC_FUNCTION_HEARTBEAT_ACK, 0x00, 0x00, 0x07 };
+    samples.push_back({ std::string((const char*)heartbeat, sizeof(heartbeat)), BVLC_SC_FUNCTION_HEARTBEAT_ACK, WS_PRIORITY_CONTROL });
+    samples.push_back({ std::string((const char*)BenchmarkClassifyFrame, sizeof(BenchmarkClassifyFrame)), BVLC_SC_FUNCTION_ENCAPSULATED_NPDU, WS_PRIORITY_CONFIRMED });
+    uint8_t iAm[64];
+    size_t iAmLength = BenchmarkIAmFrame(iAm, sizeof(iAm), 389001, 8);
+    samples.push_back({ std::string((const char*)iAm, iAmLength), BVLC_SC_FUNCTION_ENCAPSULATED_NPDU, WS_PRIORITY_BULK });
+    // Segmented ComplexACK, 1400 bytes
+    std::string segment(1400, '\0');
+    const uint8_t segmentHeader[] = { BVLC_SC_FUNCTION_ENCAPSULATED_NPDU, BVLC_SC_CONTROL_ORIGINATING_VMAC, 0x00, 0x09, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x00, (APDU_TYPE_COMPLEX_ACK << 4) | APDU_SEGMENTED_MESSAGE, 0x01, 0x00, 0x04, 0x0E };
+    memcpy(&segment[0], segmentHeader, sizeof(segmentHeader));
+    samples.push_back({ segment, BVLC_SC_FUNCTION_ENCAPSULATED_NPDU, WS_PRIORITY_BULK });
+    // Data option longer than the frame
+    samples.push_back({ std::string((const char*)BenchmarkClassifyFrame, 18), BVLC_SC_FUNCTION_COUNT, WS_PRIORITY_BULK });
+    const uint8_t advertisement[] = { BVLC_SC_FUNCTION_ADVERTISEMENT, BVLC_SC_CONTROL_ORIGINATING_VMAC, 0x00, 0x03, 0x02, 0x00, 0x00, 0x00, 0x00, 0x03, 0x01, 0x01, 0x06, 0x40, 0x05, 0xC1 };
+    samples.push_back({ std::string((const char*)advertisement, sizeof(advertisement)), BVLC_SC_FUNCTION_ADVERTISEMENT, WS_PRIORITY_CONTROL });
+
+    bool ok = true;
+    for (const Sample& sample : samples) {
+        WSFrameView view(reinterpret_cast<const uint8_t*>(sample.frame.data()), sample.frame.size());
+        uint8_t function = view.IsValid() ? view.GetFunction() : BVLC_SC_FUNCTION_COUNT;
+        uint8_t priority = view.IsValid() ? view.GetPriority() : WS_PRIORITY_BULK;
+        ok = ok && function == sample.function && priority == sample.priority;
+    }
+
+    // Each pass walks the samples in a fixed, shuffled order, so the branches
+    // are not all predicted from the previous frame
+    std::vector<const Sample*> order;
+    std::mt19937 random(7);
+    for (size_t index = 0; index < 4096; index++) {
+        order.push_back(&samples[random() % samples.size()]);
+    }
+
+    // What onRead() does with each frame: the function counter and the priority class
+    uint64_t functions[BVLC_SC_FUNCTION_COUNT + 1] = { 0 };
+    uint64_t priorities[WS_PRIORITY_COUNT] = { 0 };
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t index = 0; index < frames; index++) {
+        const Sample& sample = *order[index & 4095];
+        WSFrameView view(reinterpret_cast<const uint8_t*>(sample.frame.data()), sample.frame.size());
+        functions[view.IsValid() ? std::min(view.GetFunction(), BVLC_SC_FUNCTION_COUNT) : BVLC_SC_FUNCTION_COUNT]++;
+        priorities[view.IsValid() ? view.GetPriority() : WS_PRIORITY_BULK]++;
+    }
+    double classifySeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    // A run of the same kind, e.g. a burst of broadcasts, the branches predicted
+    const Sample& broadcast = samples[1];
+    start = BenchmarkClock::now();
+    for (size_t index = 0; index < frames; index++) {
+        WSFrameView view(reinterpret_cast<const uint8_t*>(broadcast.frame.data()), broadcast.frame.size());
+        functions[view.IsValid() ? std::min(view.GetFunction(), BVLC_SC_FUNCTION_COUNT) : BVLC_SC_FUNCTION_COUNT]++;
+        priorities[view.IsValid() ? view.GetPriority() : WS_PRIORITY_BULK]++;
+    }
+    double sameKindSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    // The copy into the receive queue that follows, for scale
+    size_t copied = 0;
+    start = BenchmarkClock::now();
+    for (size_t index = 0; index < frames; index++) {
+        std::string copy(order[index & 4095]->frame);
+        copied += copy.size();
+    }
+    double copySeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+
+    uint64_t counted = 0;
+    for (uint8_t function = 0; function <= BVLC_SC_FUNCTION_COUNT; function++) {
+        counted += functions[function];
+    }
+    ok = ok && counted == 2 * frames;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Classify benchmark, " << frames << " frames of " << samples.size() << " kinds" << std::endl;
+    std::cout << "  header view, function and priority: " << (classifySeconds * 1e9) / frames << " ns per frame in a mixed order, "
+              << (sameKindSeconds * 1e9) / frames << " ns for a run of broadcasts with options" << std::endl;
+    std::cout << "  copy of the frame into a std::string: " << (copySeconds * 1e9) / frames << " ns per frame (" << copied / frames << " bytes on average)" << std::endl;
+    std::cout << "  by function: encapsulated_npdu " << functions[BVLC_SC_FUNCTION_ENCAPSULATED_NPDU] << ", heartbeat_ack " << functions[BVLC_SC_FUNCTION_HEARTBEAT_ACK]
+              << ", advertisement " << functions[BVLC_SC_FUNCTION_ADVERTISEMENT] << ", malformed " << functions[BVLC_SC_FUNCTION_COUNT] << std::endl;
+    std::cout << "  by priority: control " << priorities[WS_PRIORITY_CONTROL] << ", confirmed " << priorities[WS_PRIORITY_CONFIRMED] << ", bulk " << priorities[WS_PRIORITY_BULK] << std::endl;
+    std::cout << "  samples classified as expected: " << (ok ? "ok" : "wrong") << std::endl;
+    return ok;
+}
+
+//
+// Backend
+// ----------------------------------------------------------------------------
+// The unicast load of the hub benchmark, measured for the system calls, CPU
+// time and context switches it costs per forwarded frame, once without and
+// once with the frames written to a capture file. Both ends of every
+// connection are in this process and on the same backend, so the counts are
+// for a node write, the hub read and write, and the node read.
+//
+// System calls are counted by the raw_syscalls:sys_enter tracepoint through
+// perf_event_open, inherited by the threads started after it is opened. It
+// needs tracefs and perf_event_paranoid <= 1 (or CAP_PERFMON); without them
+// the count is n/a and "strace -c -f" on the benchmark gives it instead.
+
+struct BenchmarkBackendResult {
+    bool complete;
+    size_t frames;
+    double seconds;
+    int64_t syscalls;           // -1 when they cannot be counted
+    double cpuSeconds;          // User and system, every thread
+    double systemSeconds;
+    int64_t contextSwitches;    // Voluntary and involuntary
+    uint64_t captureWrites;
+    uint64_t captureBytes;
+    uint64_t captureDropped;
+};
+
+// Disabled counter of the system calls of this thread and the threads it starts, -1 when not available
+static int BenchmarkOpenSyscallCounter() {
+#ifdef __linux__
+    static const char* const paths[] = { "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id", "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id" };
+    for (const char* path : paths) {
+        std::ifstream idFile(path);
+        uint64_t id = 0;
+        if (!(idFile >> id)) {
+            continue;
+        }
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.size = sizeof(attr);
+        attr.config = id;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif // __linux__
+    return -1;
+}
+
+#ifdef __GNUC__
+static void BenchmarkUsage(double* cpuSeconds, double* systemSeconds, int64_t* contextSwitches) {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    *systemSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    *cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + *systemSeconds;
+    *contextSwitches = usage.ru_nvcsw + usage.ru_nivcsw;
+}
+#else
+static void BenchmarkUsage(double* cpuSeconds, double* systemSeconds, int64_t* contextSwitches) {
+    *cpuSeconds = 0;
+    *systemSeconds = 0;
+    *contextSwitches = 0;
+}
+#endif // __GNUC__
+
+static void BenchmarkBackendRun(const size_t connections, const size_t framesPerNode, const std::string& capturePath, BenchmarkBackendResult* result) {
+    // Before the hub and capture threads start, so they inherit it
+    int counter = BenchmarkOpenSyscallCounter();
+
+    WSCapture capture;
+    const uint8_t hubVmac[BVLC_SC_VMAC_LENGTH] = { 0x02, 0xFF, 0x00, 0x00, 0x00, 0x01 };
+    const uint8_t hubUuid[BVLC_SC_UUID_LENGTH] = { 0 };
+    WSHubFunction hub;
+    if (capturePath.size() > 0) {
+        if (!capture.Open(capturePath)) {
+            return;
+        }
+        hub.SetCapture(&capture);
+    }
+    if (!hub.Start("127.0.0.1", 0, hubVmac, hubUuid)) {
+        return;
+    }
+    tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), hub.GetPort());
+
+    net::io_context ioc;
+    size_t connectedCount = 0;
+    size_t receivedCount = 0;
+    std::vector<std::shared_ptr<BenchmarkHubNode>> nodes;
+    for (size_t offset = 0; offset < connections; offset++) {
+        nodes.push_back(std::make_shared<BenchmarkHubNode>(ioc, offset, &connectedCount, &receivedCount));
+        nodes.back()->Start(endpoint);
+    }
+    if (!BenchmarkRunUntil(ioc, [&] { return connectedCount == connections; }, std::chrono::seconds(120))) {
+        std::cout << "Error: only " << connectedCount << " of " << connections << " nodes connected" << std::endl;
+        hub.Stop();
+        return;
+    }
+
+    // Every node sends framesPerNode frames to its neighbour through the hub
+    result->frames = connections * framesPerNode;
+    double cpuStart;
+    double systemStart;
+    int64_t switchesStart;
+    BenchmarkUsage(&cpuStart, &systemStart, &switchesStart);
+#ifdef __linux__
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif // __linux__
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t offset = 0; offset < connections; offset++) {
+        WSHubFrame frame = BenchmarkHubNode::EncodeNpdu(nodes[(offset + 1) % connections]->vmac);
+        for (size_t count = 0; count < framesPerNode; count++) {
+            nodes[offset]->Send(frame);
+        }
+    }
+    result->complete = BenchmarkRunUntil(ioc, [&] { return receivedCount >= result->frames; }, std::chrono::seconds(300));
+    result->seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    result->syscalls = -1;
+#ifdef __linux__
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        int64_t count = 0;
+        if (read(counter, &count, sizeof(count)) == (ssize_t)sizeof(count)) {
+            result->syscalls = count;
+        }
+        close(counter);
+    }
+#endif // __linux__
+    double cpuEnd;
+    double systemEnd;
+    int64_t switchesEnd;
+    BenchmarkUsage(&cpuEnd, &systemEnd, &switchesEnd);
+    result->cpuSeconds = cpuEnd - cpuStart;
+    result->systemSeconds = systemEnd - systemStart;
+    result->contextSwitches = switchesEnd - switchesStart;
+
+    hub.Stop();
+    capture.Close();
+    result->captureWrites = capture.writes;
+    result->captureBytes = capture.bytesWritten;
+    result->captureDropped = capture.dropped;
+}
+
+bool ExampleBenchmark::Backend(int argc, char** argv) {
+    const size_t connections = std::max(BenchmarkArgument(argc, argv, 1, 100), (size_t)2);
+    const size_t framesPerNode = BenchmarkArgument(argc, argv, 2, 200);
+    BenchmarkRaiseFileLimit(connections);
+    const std::string capturePath = "benchmark_capture.pcap";
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Backend benchmark, backend=" << WSGetNetworkBackend() << ", " << connections << " connections, "
+              << connections * framesPerNode << " unicast frames through the hub over loopback" << std::endl;
+
+    const char* const names[2] = { "no capture", "capture" };
+    bool ok = true;
+    for (size_t run = 0; run < 2; run++) {
+        BenchmarkBackendResult result;
+        memset(&result, 0, sizeof(result));
+        BenchmarkBackendRun(connections, framesPerNode, run == 1 ? capturePath : std::string(), &result);
+        if (!result.complete) {
+            std::cout << "  " << names[run] << ": did not complete" << std::endl;
+            ok = false;
+            continue;
+        }
+
+        double frames = (double)result.frames;
+        std::cout << "  " << names[run] << ": " << frames / result.seconds << " frames/s, syscalls/frame ";
+        if (result.syscalls >= 0) {
+            std::cout << result.syscalls / frames;
+        }
+        else {
+            std::cout << "n/a";
+        }
+        std::cout << ", CPU " << (result.cpuSeconds * 1e6) / frames << " us/frame (system " << (result.systemSeconds * 1e6) / frames
+                  << "), context switches/frame " << result.contextSwitches / frames << std::endl;
+        if (run == 1) {
+            // Every forwarded frame is recorded twice, received and sent by the
+            // hub, with a 16 byte record header and the direction byte
+            const uint8_t anyVmac[BVLC_SC_VMAC_LENGTH] = { 0 };
+            uint64_t forwardedBytes = 2 * result.frames * (16 + 1 + BenchmarkHubNode::EncodeNpdu(anyVmac)->size());
+            std::ifstream file(capturePath, std::ios::binary | std::ios::ate);
+            uint64_t fileBytes = file ? (uint64_t)file.tellg() : 0;
+            bool captured = result.captureDropped == 0 && result.captureBytes >= forwardedBytes && fileBytes == 24 + result.captureBytes;
+            ok = ok && captured;
+            std::cout << "    capture: " << result.captureBytes / 1e6 << " MB in " << result.captureWrites << " writes, "
+                      << (double)result.captureWrites / frames << " writes/frame, dropped " << result.captureDropped << ": " << (captured ? "ok" : "wrong") << std::endl;
+        }
+    }
+    remove(capturePath.c_str());
+    return ok;
+}
+
+//
+// Kernel TLS
+// ----------------------------------------------------------------------------
+// The websocket stream of WSClientSecureAsync sends frames to a local TLS
+// websocket server, then the server sends as many back, once with TLS in user
+// space (the Beast SSL stream) and once with kernel TLS requested. The client
+// runs on the main thread, its CPU time is the one of that thread. The
+// WSClientSecure logging around the stream is left out, it would hide the TLS
+// cost. Where the kernel does not offload a direction, the kTLS run shows
+// OpenSSL working on the socket directly.
+
+// Self-signed certificate and its key for the TLS benchmarks, ECDSA P-256, or
+// RSA when rsaBits is not 0
+static bool BenchmarkWriteCertificate(const std::string& certPath, const std::string& keyPath, const int rsaBits = 0) {
+    EVP_PKEY* key = NULL;
+    EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id(rsaBits != 0 ? EVP_PKEY_RSA : EVP_PKEY_EC, NULL);
+    bool ok = keyCtx != NULL && EVP_PKEY_keygen_init(keyCtx) > 0 &&
+        (rsaBits != 0 ? EVP_PKEY_CTX_set_rsa_keygen_bits(keyCtx, rsaBits) : EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtx, NID_X9_62_prime256v1)) > 0 &&
+        EVP_PKEY_keygen(keyCtx, &key) > 0;
+    EVP_PKEY_CTX_free(keyCtx);
+
+    X509* cert = ok ? X509_new() : NULL;
+    if (cert != NULL) {
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        ok = X509_sign(cert, key, EVP_sha256()) > 0;
+    }
+
+    FILE* certFile = ok ? fopen(certPath.c_str(), "wb") : NULL;
+    FILE* keyFile = ok ? fopen(keyPath.c_str(), "wb") : NULL;
+    ok = certFile != NULL && keyFile != NULL && PEM_write_X509(certFile, cert) == 1 && PEM_write_PrivateKey(keyFile, key, NULL, NULL, 0, NULL, NULL) == 1;
+    if (certFile != NULL) {
+        fclose(certFile);
+    }
+    if (keyFile != NULL) {
+        fclose(keyFile);
+    }
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+// CPU time of the calling thread, 0 where it is not known
+static double BenchmarkThreadCpuSeconds() {
+#ifdef __linux__
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#else
+    return 0;
+#endif // __linux__
+}
+
+struct BenchmarkKtlsServer {
+    size_t frames;
+    size_t frameLength;
+    std::atomic<size_t> received;
+    std::atomic<bool> sendStart;
+    std::atomic<bool> done;
+    std::atomic<size_t> outOfOrder;
+};
+
+// Accept one client, read server->frames frames, then write as many
+static void BenchmarkKtlsServe(tcp::acceptor* acceptor, ssl::context* ctx, BenchmarkKtlsServer* server) {
+    try {
+        websocket::stream<ssl::stream<tcp::socket>> ws(acceptor->accept(), *ctx);
+        ws.next_layer().handshake(ssl::stream_base::server);
+        ws.set_option(websocket::stream_base::decorator([](websocket::response_type& res) {
+            res.set(http::field::sec_websocket_protocol, "hub.bsc.bacnet.org");
+        }));
+        ws.accept();
+        ws.binary(true);
+
+        beast::flat_buffer buffer;
+        for (size_t sequence = 0; sequence < server->frames; sequence++) {
+            ws.read(buffer);
+            const uint8_t* frame = static_cast<const uint8_t*>(buffer.data().data());
+            size_t received = ((size_t)frame[4] << 24) | ((size_t)frame[5] << 16) | ((size_t)frame[6] << 8) | frame[7];
+            if (received != sequence) {
+                server->outOfOrder++;
+            }
+            buffer.consume(buffer.size());
+            server->received++;
+        }
+
+        while (!server->sendStart) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::string frame(server->frameLength, '\0');
+        frame[0] = (char)BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+        for (size_t sequence = 0; sequence < server->frames; sequence++) {
+            frame[4] = (char)(sequence >> 24);
+            frame[5] = (char)(sequence >> 16);
+            frame[6] = (char)(sequence >> 8);
+            frame[7] = (char)sequence;
+            ws.write(net::buffer(frame));
+        }
+        // Until the client closes
+        ws.read(buffer);
+    }
+    catch (std::exception&) {
+    }
+    server->done = true;
+}
+
+struct BenchmarkKtlsResult {
+    bool complete;
+    bool ktlsSend;
+    bool ktlsReceive;
+    double sendSeconds;
+    double sendCpuSeconds;
+    double receiveSeconds;
+    double receiveCpuSeconds;
+    size_t outOfOrder;
+};
+
+static void BenchmarkKtlsRun(const bool ktls, const size_t frames, const size_t frameLength, const std::string& certPath, const std::string& keyPath, BenchmarkKtlsResult* result) {
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    ssl::context serverCtx(ssl::context::tlsv13_server);
+    serverCtx.use_certificate_chain_file(certPath);
+    serverCtx.use_private_key_file(keyPath, ssl::context::pem);
+    BenchmarkKtlsServer server;
+    server.frames = frames;
+    server.frameLength = frameLength;
+    server.received = 0;
+    server.sendStart = false;
+    server.done = false;
+    server.outOfOrder = 0;
+    std::thread serverThread(BenchmarkKtlsServe, &acceptor, &serverCtx, &server);
+
+    // The websocket of WSClientSecureAsync, run on this thread
+    ssl::context clientCtx(ssl::context::tlsv13_client);
+    websocket::stream<WSTlsStream> ws(net::make_strand(ioc), clientCtx);
+    ws.next_layer().SetKtls(ktls, clientCtx);
+    beast::error_code errorCode;
+    beast::get_lowest_layer(ws).connect(acceptor.local_endpoint(), errorCode);
+    if (!errorCode) {
+        ws.next_layer().async_handshake(ssl::stream_base::client, [&](beast::error_code handshakeError) { errorCode = handshakeError; });
+        ioc.run();
+        ioc.restart();
+    }
+    if (!errorCode) {
+        ws.set_option(websocket::stream_base::decorator([](websocket::request_type& req) {
+            req.set(http::field::sec_websocket_protocol, "hub.bsc.bacnet.org");
+        }));
+        ws.async_handshake("127.0.0.1", "/", [&](beast::error_code handshakeError) { errorCode = handshakeError; });
+        ioc.run();
+        ioc.restart();
+    }
+    if (errorCode) {
+        std::cout << "Error: benchmark client connect failed errorCode=" << errorCode << std::endl;
+        acceptor.close();
+        beast::get_lowest_layer(ws).close();
+        serverThread.join();
+        return;
+    }
+    ws.binary(true);
+    result->ktlsSend = ws.next_layer().IsKtlsSend();
+    result->ktlsReceive = ws.next_layer().IsKtlsReceive();
+    BenchmarkClock::time_point deadline = BenchmarkClock::now() + std::chrono::seconds(120);
+
+    // Client to server
+    std::vector<uint8_t> frame(frameLength, 0);
+    frame[0] = BVLC_SC_FUNCTION_ENCAPSULATED_NPDU;
+    size_t sequence = 0;
+    std::function<void(beast::error_code, size_t)> onWrite = [&](beast::error_code writeError, size_t) {
+        if (writeError || sequence == frames) {
+            errorCode = writeError;
+            return;
+        }
+        frame[4] = (uint8_t)(sequence >> 24);
+        frame[5] = (uint8_t)(sequence >> 16);
+        frame[6] = (uint8_t)(sequence >> 8);
+        frame[7] = (uint8_t)sequence;
+        sequence++;
+        ws.async_write(net::buffer(frame), onWrite);
+    };
+    double cpuStart = BenchmarkThreadCpuSeconds();
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    onWrite(beast::error_code(), 0);
+    ioc.run();
+    ioc.restart();
+    double cpuSent = BenchmarkThreadCpuSeconds();
+    while (server.received < frames && !server.done && BenchmarkClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    result->sendSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    result->sendCpuSeconds = cpuSent - cpuStart;
+    bool sent = !errorCode && server.received == frames;
+
+    // Server to client
+    size_t received = 0;
+    beast::flat_buffer buffer;
+    std::function<void(beast::error_code, size_t)> onRead = [&](beast::error_code readError, size_t) {
+        if (readError) {
+            errorCode = readError;
+            return;
+        }
+        if (buffer.size() > 0) {
+            const uint8_t* message = static_cast<const uint8_t*>(buffer.data().data());
+            size_t messageSequence = ((size_t)message[4] << 24) | ((size_t)message[5] << 16) | ((size_t)message[6] << 8) | message[7];
+            if (messageSequence != received) {
+                result->outOfOrder++;
+            }
+            buffer.consume(buffer.size());
+            received++;
+        }
+        if (received < frames) {
+            ws.async_read(buffer, onRead);
+        }
+    };
+    cpuStart = BenchmarkThreadCpuSeconds();
+    start = BenchmarkClock::now();
+    server.sendStart = true;
+    onRead(beast::error_code(), 0);
+    ioc.run();
+    ioc.restart();
+    result->receiveSeconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    result->receiveCpuSeconds = BenchmarkThreadCpuSeconds() - cpuStart;
+    result->complete = sent && !errorCode && received == frames;
+    result->outOfOrder += server.outOfOrder;
+
+    ws.async_close(websocket::close_code::normal, [](beast::error_code) {});
+    ioc.run();
+    acceptor.close();
+    serverThread.join();
+}
+
+bool ExampleBenchmark::Ktls(int argc, char** argv) {
+    const size_t frames = BenchmarkArgument(argc, argv, 1, 20000);
+    const size_t frameLength = std::min(std::max(BenchmarkArgument(argc, argv, 2, 1400), (size_t)8), (size_t)BVLC_SC_MAX_BVLC_LENGTH);
+    const std::string certPath = "benchmark_cert.pem";
+    const std::string keyPath = "benchmark_key.pem";
+    if (!BenchmarkWriteCertificate(certPath, keyPath)) {
+        std::cout << "Error: could not create the benchmark certificate" << std::endl;
+        return false;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Kernel TLS benchmark, " << frames << " frames of " << frameLength << " bytes each way over TLS 1.3 on loopback";
+#if defined(WS_TLS_HAS_KTLS)
+    std::cout << std::endl;
+#else
+    std::cout << ", kTLS not available in this build" << std::endl;
+#endif
+
+    const char* const names[2] = { "user space TLS", "kernel TLS" };
+    bool ok = true;
+    for (size_t run = 0; run < 2; run++) {
+        BenchmarkKtlsResult result;
+        memset(&result, 0, sizeof(result));
+        BenchmarkKtlsRun(run == 1, frames, frameLength, certPath, keyPath, &result);
+        bool runOk = result.complete && result.outOfOrder == 0;
+        ok = ok && runOk;
+
+        double megabytes = (double)(frames * frameLength) / 1e6;
+        std::cout << "  " << names[run];
+        if (run == 1) {
+            std::cout << " (kernel send " << (result.ktlsSend ? "on" : "off") << ", receive " << (result.ktlsReceive ? "on" : "off") << ")";
+        }
+        std::cout << ":" << std::endl;
+        std::cout << "    send:    " << megabytes / result.sendSeconds << " MB/s, " << frames / result.sendSeconds << " frames/s, client CPU "
+                  << (result.sendCpuSeconds * 1e6) / megabytes << " us/MB" << std::endl;
+        std::cout << "    receive: " << megabytes / result.receiveSeconds << " MB/s, " << frames / result.receiveSeconds << " frames/s, client CPU "
+                  << (result.receiveCpuSeconds * 1e6) / megabytes << " us/MB: " << (runOk ? "ok" : "wrong") << std::endl;
+        if (run == 1 && !result.ktlsSend && !result.ktlsReceive) {
+            std::cout << "    the kernel took neither direction, this run is OpenSSL on the socket in user space, not kernel TLS" << std::endl;
+        }
+    }
+    remove(certPath.c_str());
+    remove(keyPath.c_str());
+    return ok;
+}
+
+//
+// TLS handshake
+// ----------------------------------------------------------------------------
+// The websocket stream of WSClientSecureAsync connects to a local
+// WSHubFunction over wss://, one connection after the other, for each
+// configuration of WSTlsSettings (applied to both sides, as on a site) and
+// certificate key type: a TCP connect, the TLS 1.3 handshake, the websocket
+// upgrade and a close. The client CPU time is the one of the main thread, the
+// hub CPU time the rest of the process, so each side gives the connects one
+// core can take, e.g. when a hub restarts and every node reconnects at once.
+
+struct BenchmarkHandshakeConfiguration {
+    const char* name;
+    int rsaBits;                // Certificate key, 0 for ECDSA P-256
+    const char* groups;         // WSTlsSettings, "" for the OpenSSL default
+    const char* ciphersuites;
+};
+
+struct BenchmarkHandshakeResult {
+    size_t handshakes;
+    double seconds;
+    double clientCpuSeconds;
+    double hubCpuSeconds;
+    std::string group;          // Negotiated by the first connection
+    std::string cipher;
+};
+
+static void BenchmarkHandshakeRun(const WSTlsSettings& settings, const size_t handshakes, const std::string& certPath, const std::string& keyPath, BenchmarkHandshakeResult* result) {
+    const uint8_t hubVmac[BVLC_SC_VMAC_LENGTH] = { 0x02, 0xFF, 0x00, 0x00, 0x00, 0x01 };
+    const uint8_t hubUuid[BVLC_SC_UUID_LENGTH] = { 0 };
+    WSHubFunction hub;
+    hub.SetTlsSettings(settings);
+    if (!hub.Start("127.0.0.1", 0, hubVmac, hubUuid, certPath, keyPath)) {
+        return;
+    }
+    tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), hub.GetPort());
+
+    net::io_context ioc;
+    ssl::context clientCtx(ssl::context::tlsv13_client);
+    try {
+        settings.Apply(clientCtx);
+    }
+    catch (std::exception const& e) {
+        std::cout << "Error: benchmark client - " << e.what() << std::endl;
+        hub.Stop();
+        return;
+    }
+
+    double cpuStart = 0;
+    double systemStart = 0;
+    int64_t switchesStart = 0;
+    BenchmarkUsage(&cpuStart, &systemStart, &switchesStart);
+    double clientCpuStart = BenchmarkThreadCpuSeconds();
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (size_t handshake = 0; handshake < handshakes; handshake++) {
+        websocket::stream<WSTlsStream> ws(net::make_strand(ioc), clientCtx);
+        ws.set_option(websocket::stream_base::decorator([](websocket::request_type& req) {
+            req.set(http::field::sec_websocket_protocol, "hub.bsc.bacnet.org");
+        }));
+        beast::error_code errorCode;
+        bool upgraded = false;
+        beast::get_lowest_layer(ws).async_connect(endpoint, [&](beast::error_code connectError) {
+            if (connectError) {
+                errorCode = connectError;
+                return;
+            }
+            ws.next_layer().async_handshake(ssl::stream_base::client, [&](beast::error_code handshakeError) {
+                if (handshakeError) {
+                    errorCode = handshakeError;
+                    return;
+                }
+                ws.async_handshake("127.0.0.1", "/", [&](beast::error_code upgradeError) {
+                    if (upgradeError) {
+                        errorCode = upgradeError;
+                        return;
+                    }
+                    upgraded = true;
+                    if (result->handshakes == 0) {
+                        SSL* ssl = ws.next_layer().native_handle();
+                        result->cipher = SSL_get_cipher_name(ssl);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+                        const char* group = SSL_group_to_name(ssl, SSL_get_negotiated_group(ssl));
+                        result->group = group != NULL ? group : "unknown";
+#else
+                        result->group = "n/a";
+#endif
+                    }
+                    ws.async_close(websocket::close_code::normal, [](beast::error_code) {});
+                });
+            });
+        });
+        ioc.run();
+        ioc.restart();
+        if (!upgraded) {
+            std::cout << "Error: benchmark client connect failed errorCode=" << errorCode << std::endl;
+            break;
+        }
+        result->handshakes++;
+    }
+    result->seconds = BenchmarkSeconds(start, BenchmarkClock::now());
+    result->clientCpuSeconds = BenchmarkThreadCpuSeconds() - clientCpuStart;
+    double cpuEnd = 0;
+    double systemEnd = 0;
+    int64_t switchesEnd = 0;
+    BenchmarkUsage(&cpuEnd, &systemEnd, &switchesEnd);
+    result->hubCpuSeconds = std::max((cpuEnd - cpuStart) - result->clientCpuSeconds, 0.0);
+    hub.Stop();
+}
+
+bool ExampleBenchmark::Handshake(int argc, char** argv) {
+    const size_t handshakes = std::max(BenchmarkArgument(argc, argv, 1, 300), (size_t)1);
+    const std::string certPaths[2] = { "benchmark_ecdsa_cert.pem", "benchmark_rsa_cert.pem" };
+    const std::string keyPaths[2] = { "benchmark_ecdsa_key.pem", "benchmark_rsa_key.pem" };
+    if (!BenchmarkWriteCertificate(certPaths[0], keyPaths[0]) || !BenchmarkWriteCertificate(certPaths[1], keyPaths[1], 2048)) {
+        std::cout << "Error: could not create the benchmark certificates" << std::endl;
+        return false;
+    }
+
+    const BenchmarkHandshakeConfiguration configurations[] = {
+        { "OpenSSL defaults, RSA-2048", 2048, "", "" },
+        { "OpenSSL defaults, ECDSA P-256", 0, "", "" },
+        { "X25519, AES-128-GCM, ECDSA P-256", 0, "X25519", "TLS_AES_128_GCM_SHA256" },
+        { "P-256, AES-128-GCM, ECDSA P-256", 0, "P-256", "TLS_AES_128_GCM_SHA256" },
+        { "P-384, AES-256-GCM, ECDSA P-256", 0, "P-384", "TLS_AES_256_GCM_SHA384" },
+        { "X25519, AES-128-GCM, RSA-2048", 2048, "X25519", "TLS_AES_128_GCM_SHA256" },
+    };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "TLS handshake benchmark, " << handshakes << " wss:// connects to a local hub function per configuration, TLS 1.3 on loopback" << std::endl;
+    bool ok = true;
+    for (const BenchmarkHandshakeConfiguration& configuration : configurations) {
+        WSTlsSettings settings;
+        settings.groups = configuration.groups;
+        settings.ciphersuites = configuration.ciphersuites;
+        BenchmarkHandshakeResult result;
+        result.handshakes = 0;
+        result.seconds = 0;
+        result.clientCpuSeconds = 0;
+        result.hubCpuSeconds = 0;
+        size_t file = configuration.rsaBits != 0 ? 1 : 0;
+        BenchmarkHandshakeRun(settings, handshakes, certPaths[file], keyPaths[file], &result);
+        bool runOk = result.handshakes == handshakes;
+        ok = ok && runOk;
+
+        double clientMicroseconds = (result.clientCpuSeconds * 1e6) / std::max(result.handshakes, (size_t)1);
+        double hubMicroseconds = (result.hubCpuSeconds * 1e6) / std::max(result.handshakes, (size_t)1);
+        std::cout << "  " << configuration.name << " (" << result.group << ", " << result.cipher << "):" << std::endl;
+        std::cout << "    " << result.handshakes / std::max(result.seconds, 1e-9) << " connects/s, client CPU " << clientMicroseconds << " us ("
+                  << 1e6 / std::max(clientMicroseconds, 1e-3) << "/s per core), hub CPU " << hubMicroseconds << " us ("
+                  << 1e6 / std::max(hubMicroseconds, 1e-3) << "/s per core): " << (runOk ? "ok" : "wrong") << std::endl;
+    }
+    for (size_t file = 0; file < 2; file++) {
+        remove(certPaths[file].c_str());
+        remove(keyPaths[file].c_str());
+    }
+    return ok;
+}
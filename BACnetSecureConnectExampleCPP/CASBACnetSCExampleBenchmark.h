@@ -0,0 +1,91 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleBenchmark.h
+ *
+ * Benchmarks for the parts of this example that need to scale to a large site.
+ * They do not need a hub or the CAS BACnet Stack and are started with:
+ *
+ *	BACnetSCExampleCPP --benchmark <name> [arguments]
+ *
+ * Run with no name to list the available benchmarks.
+ */
+
+#ifndef __CASBACnetSCExampleBenchmark_h__
+#define __CASBACnetSCExampleBenchmark_h__
+
+class ExampleBenchmark {
+public:
+    // argc/argv start at the benchmark name. Returns the process exit code.
+    static int Run(int argc, char** argv);
+
+private:
+    static void PrintUsage();
+
+    // Embedded hub function, see WSHubFunction.h
+    static bool Hub(int argc, char** argv);
+
+    // Object store lookups, see CASBACnetSCExampleObjectStore.h
+    static bool ObjectStore(int argc, char** argv);
+
+    // Get Property dispatch, see CASBACnetSCExamplePropertyTable.h
+    static bool Properties(int argc, char** argv);
+
+    // Point file bulk load, see CASBACnetSCExampleLoader.h
+    static bool Loader(int argc, char** argv);
+
+    // Change of value dirty tracking, see CASBACnetSCExampleCOV.h
+    static bool COV(int argc, char** argv);
+
+    // Warm restart snapshot and its crash consistency, see CASBACnetSCExampleSnapshot.h
+    static bool Snapshot(int argc, char** argv);
+
+    // Field I/O thread stores against concurrent reads, see CASBACnetSCExampleSeqLock.h
+    static bool Concurrency(int argc, char** argv);
+
+    // Periodic timers, see CASBACnetSCExampleTimerWheel.h
+    static bool Timers(int argc, char** argv);
+
+    // Compressed Trend Log buffers and ReadRange, see CASBACnetSCExampleTrendLog.h
+    static bool TrendLog(int argc, char** argv);
+
+    // Commandable object writes and relinquishes, see CASBACnetSCExamplePriorityArray.h
+    static bool Priority(int argc, char** argv);
+
+    // ReadPropertyMultiple through the property callbacks and in batches, see CASBACnetSCExamplePropertyTable.h
+    static bool RPM(int argc, char** argv);
+
+    // Metrics recording overhead and the Prometheus endpoint, see CASBACnetSCExampleMetrics.h
+    static bool Metrics(int argc, char** argv);
+
+    // HDR histogram accuracy and the cost of timing a section, see CASBACnetSCExampleProfiler.h
+    static bool Profiler(int argc, char** argv);
+
+    // Request and reply correlation and the cost of tracing a message, see CASBACnetSCExampleTrace.h
+    static bool Trace(int argc, char** argv);
+
+    // Who-Is sweep of simulated devices and the I-Am rate the hub sees, see CASBACnetSCExampleDiscovery.h
+    static bool Discovery(int argc, char** argv);
+    // Coalesced and windowed polling of simulated devices, see CASBACnetSCExamplePolling.h
+    static bool Polling(int argc, char** argv);
+    // Hub traffic of COV subscriptions against polling, see CASBACnetSCExampleCOVClient.h
+    static bool COVClient(int argc, char** argv);
+    // Producers handing work to a consumer thread, see CASBACnetSCExampleCommandQueue.h
+    static bool CommandQueue(int argc, char** argv);
+    // Virtual devices connected to a local hub, see WSVirtualDevices.h
+    static bool VirtualDevices(int argc, char** argv);
+    // A local server floods a client with frames, see WSQueue.h
+    static bool Flood(int argc, char** argv);
+    // Heartbeats and confirmed requests through a hub saturated with broadcasts, see WSQueue.h
+    static bool OutboundPriority(int argc, char** argv);
+    // Cost of decoding the BVLC-SC header of each frame, see WSFrameView.h
+    static bool Classify(int argc, char** argv);
+    // System calls, CPU and frames/sec of the transport on the network backend of this build, see WSBackend.h
+    static bool Backend(int argc, char** argv);
+    // Throughput and CPU of a wss:// client with TLS in user space and with kernel TLS, see WSTlsStream.h
+    static bool Ktls(int argc, char** argv);
+    // wss:// connects per second and per core for each set of WSTlsSettings and certificate key type, see WSTlsSettings.h
+    static bool Handshake(int argc, char** argv);
+};
+
+#endif // __CASBACnetSCExampleBenchmark_h__
@@ -0,0 +1,72 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleBits.h
+ *
+ * Bit scans for the bitmaps and histograms of the example: the index of the
+ * lowest or highest set bit of a word, one instruction on x86 and ARM. The
+ * value must not be 0.
+ *
+ * MSVC has the 64 bit intrinsics only when building for 64 bit targets. On
+ * Win32 (and 32 bit ARM) the 64 bit scans are two 32 bit scans.
+ */
+
+#ifndef __CASBACnetSCExampleBits_h__
+#define __CASBACnetSCExampleBits_h__
+
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+static inline uint32_t ExampleLowestBit32(const uint32_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(value);
+#endif // _MSC_VER
+}
+
+static inline uint32_t ExampleHighestBit32(const uint32_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return (uint32_t)index;
+#else
+    return (uint32_t)(31 - __builtin_clz(value));
+#endif // _MSC_VER
+}
+
+static inline uint32_t ExampleLowestBit64(const uint64_t value) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (uint32_t)index;
+#elif defined(_MSC_VER)
+    if ((uint32_t)value != 0) {
+        return ExampleLowestBit32((uint32_t)value);
+    }
+    return 32 + ExampleLowestBit32((uint32_t)(value >> 32));
+#else
+    return (uint32_t)__builtin_ctzll(value);
+#endif // _MSC_VER
+}
+
+static inline uint32_t ExampleHighestBit64(const uint64_t value) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (uint32_t)index;
+#elif defined(_MSC_VER)
+    if ((uint32_t)(value >> 32) != 0) {
+        return 32 + ExampleHighestBit32((uint32_t)(value >> 32));
+    }
+    return ExampleHighestBit32((uint32_t)value);
+#else
+    return (uint32_t)(63 - __builtin_clzll(value));
+#endif // _MSC_VER
+}
+
+#endif // __CASBACnetSCExampleBits_h__
@@ -0,0 +1,169 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleCOV.cpp
+ *
+ * See CASBACnetSCExampleCOV.h
+ */
+
+#include "CASBACnetSCExampleCOV.h"
+#include "CASBACnetSCExampleBits.h"
+
+#include <math.h>
+
+// A change of exactly the increment is reported. A zero increment reports
+// every change.
+static inline bool COVExceeds(const float value, const float lastReported, const float covIncrement) {
+    float delta = fabsf(value - lastReported);
+    return delta > 0.0f && delta >= covIncrement;
+}
+
+ExampleCOVEngine::ExampleCOVEngine() {
+    this->store = NULL;
+    this->windowMilliseconds = 0;
+    this->lastFlush = 0;
+    this->writes = 0;
+    this->updates = 0;
+    this->marked = 0;
+    this->coalesced = 0;
+    this->notifications = 0;
+}
+
+void ExampleCOVEngine::Initialize(ExampleObjectStore* store) {
+    this->store = store;
+    this->states.clear();
+    for (size_t tableIndex = 0; tableIndex < store->tables.size(); tableIndex++) {
+        this->sync(tableIndex);
+    }
+}
+
+ExampleCOVEngine::TableState& ExampleCOVEngine::sync(const size_t tableIndex) {
+    if (tableIndex >= this->states.size()) {
+        TableState empty;
+        empty.dirtyCount = 0;
+        this->states.resize(tableIndex + 1, empty);
+    }
+    TableState& state = this->states[tableIndex];
+    const ExampleObjectTable& table = this->store->tables[tableIndex];
+    if (state.lastReported.size() < table.Size()) {
+        state.lastReported.insert(state.lastReported.end(), table.presentValue.begin() + state.lastReported.size(), table.presentValue.end());
+        state.dirty.resize((table.Size() + 63) / 64, 0);
+        state.dirtySummary.resize((state.dirty.size() + 63) / 64, 0);
+    }
+    return state;
+}
+
+void ExampleCOVEngine::Write(const size_t tableIndex, const uint32_t row, const float presentValue) {
+    // Sync first, so a new row starts from its value before this write
+    TableState& state = this->sync(tableIndex);
+    ExampleObjectTable& table = this->store->tables[tableIndex];
+    table.StorePresentValue(row, presentValue);
+    this->writes++;
+
+    if (!COVExceeds(presentValue, state.lastReported[row], table.covIncrement[row])) {
+        return;
+    }
+    this->mark(state, row);
+}
+
+void ExampleCOVEngine::drain(const size_t tableIndex) {
+    TableState& state = this->sync(tableIndex);
+    ExampleObjectTable& table = this->store->tables[tableIndex];
+    for (size_t summaryIndex = 0; summaryIndex < table.updatedSummary.size(); summaryIndex++) {
+        std::atomic<uint64_t>& summary = table.updatedSummary[summaryIndex].Get();
+        if (summary.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        // Clear the summary before the words, a word set after this marks it again
+        uint64_t words = summary.exchange(0, std::memory_order_acquire);
+        while (words != 0) {
+            size_t wordIndex = summaryIndex * 64 + ExampleLowestBit64(words);
+            words &= words - 1;
+            uint64_t word = table.updated[wordIndex].Get().exchange(0, std::memory_order_acquire);
+            while (word != 0) {
+                uint32_t row = (uint32_t)(wordIndex * 64) + ExampleLowestBit64(word);
+                word &= word - 1;
+                this->updates++;
+                if (COVExceeds(table.presentValue[row], state.lastReported[row], table.covIncrement[row])) {
+                    this->mark(state, row);
+                }
+            }
+        }
+    }
+}
+
+void ExampleCOVEngine::mark(TableState& state, const uint32_t row) {
+    uint64_t& word = state.dirty[row >> 6];
+    const uint64_t bit = (uint64_t)1 << (row & 63);
+    if (word & bit) {
+        this->coalesced++;
+        return;
+    }
+    word |= bit;
+    state.dirtySummary[row >> 12] |= (uint64_t)1 << ((row >> 6) & 63);
+    state.dirtyCount++;
+    this->marked++;
+}
+
+size_t ExampleCOVEngine::Flush(const uint64_t nowMilliseconds, std::vector<ExampleCOVChange>* changes) {
+    if (this->store == NULL || nowMilliseconds - this->lastFlush < this->windowMilliseconds) {
+        return 0;
+    }
+    this->lastFlush = nowMilliseconds;
+
+    for (size_t tableIndex = 0; tableIndex < this->store->tables.size(); tableIndex++) {
+        this->drain(tableIndex);
+    }
+
+    size_t count = 0;
+    for (size_t tableIndex = 0; tableIndex < this->states.size(); tableIndex++) {
+        TableState& state = this->states[tableIndex];
+        if (state.dirtyCount == 0) {
+            continue;
+        }
+        const ExampleObjectTable& table = this->store->tables[tableIndex];
+        for (size_t summaryIndex = 0; summaryIndex < state.dirtySummary.size() && state.dirtyCount > 0; summaryIndex++) {
+            uint64_t words = state.dirtySummary[summaryIndex];
+            state.dirtySummary[summaryIndex] = 0;
+            while (words != 0) {
+                size_t wordIndex = summaryIndex * 64 + ExampleLowestBit64(words);
+                words &= words - 1;
+                uint64_t word = state.dirty[wordIndex];
+                state.dirty[wordIndex] = 0;
+                while (word != 0) {
+                    uint32_t row = (uint32_t)(wordIndex * 64) + ExampleLowestBit64(word);
+                    word &= word - 1;
+                    state.dirtyCount--;
+
+                    // The value may have moved back inside the increment since it was marked
+                    float presentValue = table.presentValue[row];
+                    if (!COVExceeds(presentValue, state.lastReported[row], table.covIncrement[row])) {
+                        continue;
+                    }
+                    state.lastReported[row] = presentValue;
+                    ExampleCOVChange change = { table.objectType, table.instance[row], presentValue };
+                    changes->push_back(change);
+                    count++;
+                }
+            }
+        }
+    }
+    this->notifications += count;
+    return count;
+}
+
+size_t ExampleCOVEngine::GetDirtyCount() const {
+    size_t count = 0;
+    for (const TableState& state : this->states) {
+        count += state.dirtyCount;
+    }
+    return count;
+}
+
+size_t ExampleCOVEngine::GetMemoryUsage() const {
+    size_t bytes = 0;
+    for (const TableState& state : this->states) {
+        bytes += state.lastReported.capacity() * sizeof(float) + (state.dirty.capacity() + state.dirtySummary.capacity()) * sizeof(uint64_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,90 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleCOV.h
+ *
+ * Change of value (COV) engine for the object store.
+ *
+ * Present values are written through the engine. It keeps the last value
+ * reported to the CAS BACnet Stack for every object and sets a bit in a
+ * per-table dirty bitset when a write moves the value by at least the
+ * object's COV increment. Each bitset has a summary with one bit per word
+ * that has bits, and Flush walks only the set bits of both, so the cost per
+ * flush follows the number of changed objects, not the number of objects:
+ * one summary word covers 4096 objects.
+ *
+ * Field I/O threads write with ExampleObjectTable::Store instead, which only
+ * sets the row's updated bit and its summary bit. Flush drains those bits
+ * through the summary on the stack thread and applies the same increment
+ * check, so the threads never touch engine state.
+ *
+ * Flush does nothing until the coalescing window has passed since the last
+ * flush. Several writes to one object inside the window give one change,
+ * and an object that moves back within its increment gives none.
+ */
+
+#ifndef __CASBACnetSCExampleCOV_h__
+#define __CASBACnetSCExampleCOV_h__
+
+#include "CASBACnetSCExampleObjectStore.h"
+
+#include <stdint.h>
+#include <vector>
+
+// One object to report to the CAS BACnet Stack with fpValueUpdated
+struct ExampleCOVChange {
+    uint16_t objectType;
+    uint32_t instance;
+    float presentValue;
+};
+
+class ExampleCOVEngine {
+private:
+    struct TableState {
+        std::vector<float> lastReported;
+        std::vector<uint64_t> dirty;    // One bit per row
+        std::vector<uint64_t> dirtySummary; // One bit per dirty word that has bits
+        size_t dirtyCount;
+    };
+
+    ExampleObjectStore* store;
+    std::vector<TableState> states;
+    uint32_t windowMilliseconds;
+    uint64_t lastFlush;
+
+    // Size the state for rows added to the table since the last call
+    TableState& sync(const size_t tableIndex);
+
+    // Mark the rows stored by field I/O threads since the last call
+    void drain(const size_t tableIndex);
+    void mark(TableState& state, const uint32_t row);
+
+public:
+    // Statistics
+    uint64_t writes;
+    uint64_t updates;       // Rows stored by field I/O threads, per flush
+    uint64_t marked;        // Writes that made a clean object dirty
+    uint64_t coalesced;     // Writes to an object that was already dirty
+    uint64_t notifications;
+
+    ExampleCOVEngine();
+
+    // Start tracking every object in the store. The current present values
+    // become the last reported values. Call again after the store is reloaded.
+    void Initialize(ExampleObjectStore* store);
+
+    void SetWindow(const uint32_t milliseconds) { this->windowMilliseconds = milliseconds; }
+    uint32_t GetWindow() const { return this->windowMilliseconds; }
+
+    // Set the present value of a row of ExampleObjectStore::tables[tableIndex]
+    void Write(const size_t tableIndex, const uint32_t row, const float presentValue);
+
+    // Append the objects to report to changes and clear them. Returns the
+    // number of changes appended, 0 while still inside the window.
+    size_t Flush(const uint64_t nowMilliseconds, std::vector<ExampleCOVChange>* changes);
+
+    size_t GetDirtyCount() const;
+    size_t GetMemoryUsage() const;
+};
+
+#endif // __CASBACnetSCExampleCOV_h__
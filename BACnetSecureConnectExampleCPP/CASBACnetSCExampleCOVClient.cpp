@@ -0,0 +1,302 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleCOVClient.cpp
+ *
+ * See CASBACnetSCExampleCOVClient.h
+ */
+
+#include "CASBACnetSCExampleCOVClient.h"
+#include "CASBACnetSCExampleConstants.h"
+#include "WSHubFunction.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+// Values printed by ExampleCOVClient::Print()
+static const size_t COV_CLIENT_PRINT_VALUES = 20;
+
+ExampleCOVClient::ExampleCOVClient() {
+    this->messageId = 0;
+    this->subscribesSent = 0;
+    this->renewalsSent = 0;
+    this->subscribeFailures = 0;
+    this->notifications = 0;
+    this->notificationsUnknown = 0;
+}
+
+void ExampleCOVClient::SetSettings(const ExampleCOVClientSettings& settings) {
+    this->settings = settings;
+    ExamplePollerSettings pollerSettings = this->poller.GetSettings();
+    pollerSettings.timeoutMilliseconds = settings.timeoutMilliseconds;
+    this->poller.SetSettings(pollerSettings);
+}
+
+void ExampleCOVClient::Reset(const uint64_t nowMilliseconds) {
+    for (const std::pair<const uint64_t, Pending>& request : this->pending) {
+        this->poller.GetInvokeIds().Release(request.first >> 8, (uint8_t)request.first);
+    }
+    this->values.clear();
+    this->index.clear();
+    this->timers.Reset(nowMilliseconds);
+    this->waiting.clear();
+    this->pending.clear();
+    this->timeouts.clear();
+    this->poller.Reset(nowMilliseconds);
+}
+
+void ExampleCOVClient::Add(const uint32_t device, const uint64_t vmac, const uint32_t maxApdu, const uint16_t objectType, const uint32_t instance) {
+    uint64_t key = getKey(device, objectType, instance);
+    std::unordered_map<uint64_t, uint32_t>::const_iterator found = this->index.find(key);
+    if (found != this->index.end()) {
+        this->values[found->second].vmac = vmac;
+        this->values[found->second].maxApdu = maxApdu;
+        return;
+    }
+
+    ExampleCOVValue entry;
+    entry.device = device;
+    entry.objectType = objectType;
+    entry.instance = instance;
+    entry.vmac = vmac;
+    entry.maxApdu = maxApdu;
+    entry.value = 0;
+    entry.updatedMilliseconds = 0;
+    entry.state = STATE_WAITING;
+    entry.pollPoint = UINT32_MAX;
+    entry.timer = ExampleTimerWheel::INVALID_TIMER;
+    this->index[key] = (uint32_t)this->values.size();
+    this->waiting.push_back((uint32_t)this->values.size());
+    this->values.push_back(entry);
+}
+
+const ExampleCOVValue* ExampleCOVClient::Find(const uint32_t device, const uint16_t objectType, const uint32_t instance) const {
+    std::unordered_map<uint64_t, uint32_t>::const_iterator found = this->index.find(getKey(device, objectType, instance));
+    return found == this->index.end() ? NULL : &this->values[found->second];
+}
+
+bool ExampleCOVClient::GetValue(const size_t position, double* value, uint64_t* updatedMilliseconds) const {
+    const ExampleCOVValue& entry = this->values[position];
+    *value = entry.value;
+    *updatedMilliseconds = entry.updatedMilliseconds;
+    if (entry.pollPoint != UINT32_MAX) {
+        const ExamplePolledPoint& point = this->poller.GetPoint(entry.pollPoint);
+        if (point.status == ExamplePoller::STATUS_OK && point.updatedMilliseconds > *updatedMilliseconds) {
+            *value = point.value;
+            *updatedMilliseconds = point.updatedMilliseconds;
+        }
+    }
+    return *updatedMilliseconds != 0;
+}
+
+size_t ExampleCOVClient::GetCount(const uint8_t state) const {
+    size_t count = 0;
+    for (const ExampleCOVValue& entry : this->values) {
+        count += entry.state == state;
+    }
+    return count;
+}
+
+void ExampleCOVClient::fail(const uint32_t position) {
+    ExampleCOVValue& entry = this->values[position];
+    this->subscribeFailures++;
+    entry.state = STATE_POLLING;
+    if (entry.pollPoint == UINT32_MAX) {
+        this->poller.AddDevice(entry.device, entry.vmac, entry.maxApdu);
+        if (this->poller.AddPoint(entry.device, entry.objectType, entry.instance, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, this->settings.pollPeriodMilliseconds)) {
+            entry.pollPoint = (uint32_t)this->poller.GetPointCount() - 1;
+        }
+    }
+    else {
+        this->poller.SetPointPaused(entry.pollPoint, false);
+    }
+    entry.timer = this->timers.Add(this->settings.retryMilliseconds, 0, position);
+}
+
+bool ExampleCOVClient::Poll(const uint64_t nowMilliseconds, uint8_t* frame, const size_t capacity, size_t* length) {
+    // Renewals and next tries that are due
+    this->expiries.clear();
+    this->timers.Advance(nowMilliseconds, &this->expiries);
+    for (const ExampleTimerExpiry& expiry : this->expiries) {
+        this->values[(size_t)expiry.context].timer = ExampleTimerWheel::INVALID_TIMER;
+        this->waiting.push_back((uint32_t)expiry.context);
+    }
+
+    // SubscribeCOV without an answer. Entries of answered requests are skipped.
+    while (!this->timeouts.empty() && this->timeouts.front().first <= nowMilliseconds) {
+        std::unordered_map<uint64_t, Pending>::iterator found = this->pending.find(this->timeouts.front().second);
+        if (found != this->pending.end() && found->second.deadline == this->timeouts.front().first) {
+            uint32_t position = found->second.entry;
+            this->poller.GetInvokeIds().Release(found->first >> 8, (uint8_t)found->first);
+            this->pending.erase(found);
+            this->fail(position);
+        }
+        this->timeouts.pop_front();
+    }
+
+    uint8_t invokeId;
+    if (!this->waiting.empty() && this->pending.size() < this->settings.maxOutstanding && this->poller.GetInvokeIds().Allocate(this->values[this->waiting.front()].vmac, &invokeId)) {
+        uint32_t position = this->waiting.front();
+        this->waiting.pop_front();
+        ExampleCOVValue& entry = this->values[position];
+        uint64_t key = (entry.vmac << 8) | invokeId;
+
+        uint8_t apdu[32];
+        ExampleApduWriter writer(apdu, sizeof(apdu));
+        writer.Byte(APDU_TYPE_CONFIRMED_REQUEST << 4);
+        writer.Byte(APDU_MAX_APDU_ACCEPTED_1476);
+        writer.Byte((uint8_t)key);
+        writer.Byte(APDU_SERVICE_SUBSCRIBE_COV);
+        writer.ContextUnsigned(0, this->settings.processIdentifier);
+        writer.ContextObjectIdentifier(1, entry.objectType, entry.instance);
+        writer.ContextBoolean(2, false);                            // Unconfirmed notifications
+        writer.ContextUnsigned(3, this->settings.lifetimeSeconds);
+        uint8_t vmac[BVLC_SC_VMAC_LENGTH];
+        WSHubFrameHeader::UnpackVmac(entry.vmac, vmac);
+        *length = ExampleApdu::BuildFrame(frame, capacity, this->messageId++, vmac, true, apdu, writer.GetLength());
+
+        Pending request;
+        request.entry = position;
+        request.sent = nowMilliseconds;
+        request.deadline = nowMilliseconds + this->settings.timeoutMilliseconds;
+        this->pending[key] = request;
+        this->timeouts.push_back(std::make_pair(request.deadline, key));
+        if (entry.state == STATE_WAITING) {
+            entry.state = STATE_PENDING;
+        }
+        else if (entry.state == STATE_SUBSCRIBED) {
+            this->renewalsSent++;
+        }
+        this->subscribesSent++;
+        return *length != 0;
+    }
+
+    // Objects that could not be subscribed
+    return this->poller.Poll(nowMilliseconds, frame, capacity, length);
+}
+
+uint64_t ExampleCOVClient::GetNextDeadline() const {
+    if (!this->waiting.empty() && this->pending.size() < this->settings.maxOutstanding) {
+        return 0;
+    }
+    uint64_t deadline = std::min(this->timers.GetNextDeadline(), this->poller.GetNextDeadline());
+    if (!this->timeouts.empty()) {
+        deadline = std::min(deadline, this->timeouts.front().first);
+    }
+    return deadline;
+}
+
+bool ExampleCOVClient::OnReceived(const uint8_t* frame, const size_t length, const uint64_t nowMilliseconds) {
+    WSHubFrameHeader header;
+    if (!WSHubFrameHeader::Parse(frame, length, &header) || header.originatingVmac == NULL) {
+        return false;
+    }
+    size_t apduLength;
+    const uint8_t* apdu = header.GetApdu(frame, length, &apduLength);
+    if (apdu == NULL || apduLength < 2) {
+        return false;
+    }
+
+    uint8_t type = apdu[0] >> 4;
+    if (type == APDU_TYPE_UNCONFIRMED_REQUEST && apdu[1] == APDU_SERVICE_UNCONFIRMED_COV_NOTIFICATION) {
+        ExampleApduReader reader(apdu, apduLength, 2);
+        this->onNotification(reader, nowMilliseconds);
+        return true;
+    }
+
+    // An Error to another service has the invoke ID of a request of the stack
+    uint8_t service;
+    bool subscribeAnswer = type == APDU_TYPE_REJECT || type == APDU_TYPE_ABORT ||
+                           ((type == APDU_TYPE_SIMPLE_ACK || type == APDU_TYPE_ERROR) && ExampleApdu::GetAnswerService(apdu, apduLength, &service) && service == APDU_SERVICE_SUBSCRIBE_COV);
+    if (subscribeAnswer) {
+        std::unordered_map<uint64_t, Pending>::iterator found = this->pending.find((WSHubFrameHeader::PackVmac(header.originatingVmac) << 8) | apdu[1]);
+        if (found != this->pending.end()) {
+            uint32_t position = found->second.entry;
+            this->latency.Record(nowMilliseconds - found->second.sent);
+            this->poller.GetInvokeIds().Release(found->first >> 8, (uint8_t)found->first);
+            this->pending.erase(found);
+            if (type != APDU_TYPE_SIMPLE_ACK) {
+                this->fail(position);
+                return true;
+            }
+
+            ExampleCOVValue& entry = this->values[position];
+            entry.state = STATE_SUBSCRIBED;
+            if (entry.pollPoint != UINT32_MAX) {
+                this->poller.SetPointPaused(entry.pollPoint, true);
+            }
+            // Renew between 50% and 75% of the lifetime, the same point for an entry
+            uint32_t spread = (position * 0x9E3779B1u) >> 22;          // 0 - 1023
+            uint64_t lifetime = this->settings.lifetimeSeconds * 1000ULL;
+            entry.timer = this->timers.Add(lifetime / 2 + lifetime * spread / 4096, 0, position);
+            return true;
+        }
+    }
+
+    return this->poller.OnReceived(frame, length, nowMilliseconds);
+}
+
+void ExampleCOVClient::onNotification(ExampleApduReader& reader, const uint64_t nowMilliseconds) {
+    uint32_t processIdentifier;
+    uint16_t deviceType;
+    uint32_t device;
+    uint16_t objectType;
+    uint32_t instance;
+    uint32_t timeRemaining;
+    if (!reader.ReadContextUnsigned(0, &processIdentifier) || !reader.ReadContextObjectIdentifier(1, &deviceType, &device) ||
+        !reader.ReadContextObjectIdentifier(2, &objectType, &instance) || !reader.ReadContextUnsigned(3, &timeRemaining) || !reader.ReadOpeningTag(4)) {
+        return;
+    }
+    std::unordered_map<uint64_t, uint32_t>::const_iterator found = this->index.find(getKey(device, objectType, instance));
+    if (processIdentifier != this->settings.processIdentifier || found == this->index.end()) {
+        this->notificationsUnknown++;
+        return;
+    }
+    ExampleCOVValue& entry = this->values[found->second];
+    this->notifications++;
+
+    // List of values: property, optional array index, value, optional priority
+    while (!reader.IsClosingTag(4)) {
+        uint32_t property;
+        uint32_t unused;
+        if (!reader.ReadContextUnsigned(0, &property) || (!reader.IsOpeningTag(2) && !reader.ReadContextUnsigned(1, &unused)) || !reader.ReadOpeningTag(2)) {
+            return;
+        }
+        double value;
+        if (property == CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE && reader.ReadApplicationValue(&value) && reader.IsClosingTag(2)) {
+            entry.value = value;
+            entry.updatedMilliseconds = nowMilliseconds;
+        }
+        if (!reader.SkipToClosing(2)) {
+            return;
+        }
+        ExampleApduTag tag;
+        if (reader.PeekTag(&tag) && tag.context && !tag.opening && !tag.closing && tag.number == 3 && !reader.ReadContextUnsigned(3, &unused)) {
+            return;
+        }
+    }
+}
+
+void ExampleCOVClient::Print() const {
+    static const char* STATE_NAMES[] = { "waiting", "pending", "subscribed", "polling" };
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "COV client: " << this->values.size() << " objects, " << this->GetCount(STATE_SUBSCRIBED) << " subscribed, " << this->GetCount(STATE_POLLING) << " polled, " << this->pending.size() << " SubscribeCOV pending" << std::endl;
+    std::cout << "  " << this->subscribesSent << " SubscribeCOV (" << this->renewalsSent << " renewals), " << this->subscribeFailures << " failed, " << this->notifications << " notifications (" << this->notificationsUnknown << " unknown), ";
+    std::cout << "answer time p50 " << this->latency.GetPercentile(50) << " ms, p99 " << this->latency.GetPercentile(99) << " ms" << std::endl;
+    for (size_t position = 0; position < std::min(this->values.size(), COV_CLIENT_PRINT_VALUES); position++) {
+        const ExampleCOVValue& entry = this->values[position];
+        double value;
+        uint64_t updated;
+        std::cout << "  device " << entry.device << ", object " << entry.objectType << ":" << entry.instance << " (" << STATE_NAMES[entry.state] << ")";
+        if (this->GetValue(position, &value, &updated)) {
+            std::cout << " = " << value;
+        }
+        std::cout << std::endl;
+    }
+    if (this->values.size() > COV_CLIENT_PRINT_VALUES) {
+        std::cout << "  ... " << this->values.size() - COV_CLIENT_PRINT_VALUES << " more" << std::endl;
+    }
+    std::cout.flags(flags);
+}
@@ -0,0 +1,142 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleCOVClient.h
+ *
+ * Client side COV subscriptions to objects in remote devices, the
+ * counterpart of the COV reporting in CASBACnetSCExampleCOV.h.
+ *
+ * Each object is subscribed with SubscribeCOV for unconfirmed notifications
+ * of lifetimeSeconds. The Present Value of each UnconfirmedCOVNotification
+ * is written into a value cache indexed by device, object type and instance,
+ * so a value that does not change costs no hub traffic at all.
+ *
+ * A subscription is renewed between 50% and 75% of its lifetime, at a point
+ * picked per object, so the renewals of objects subscribed together are
+ * spread over a quarter of the lifetime instead of all being sent at once.
+ * At most maxOutstanding SubscribeCOV wait for their answer.
+ *
+ * When a device refuses a subscription (Error, Reject, Abort) or does not
+ * answer, the object is polled instead, by an ExamplePoller owned by the
+ * client, and subscribing is tried again after retryMilliseconds. Polling
+ * stops once the subscription succeeds.
+ *
+ * The SubscribeCOV and the requests of that poller take their invoke IDs from
+ * one ExampleInvokeIds, shared with the other clients of the hub connection
+ * with SetInvokeIds.
+ *
+ * Not thread safe, called from the main loop and CallbackReceiveMessage.
+ */
+
+#ifndef __CASBACnetSCExampleCOVClient_h__
+#define __CASBACnetSCExampleCOVClient_h__
+
+#include "CASBACnetSCExamplePolling.h"
+
+#include <deque>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+struct ExampleCOVClientSettings {
+    uint32_t processIdentifier;         // Subscriber process identifier
+    uint32_t lifetimeSeconds;
+    uint32_t maxOutstanding;            // SubscribeCOV waiting for an answer
+    uint32_t timeoutMilliseconds;
+    uint32_t retryMilliseconds;         // After a failed subscription, until the next try
+    uint32_t pollPeriodMilliseconds;    // Of the objects that could not be subscribed
+
+    ExampleCOVClientSettings() :
+        processIdentifier(1),
+        lifetimeSeconds(300),
+        maxOutstanding(32),
+        timeoutMilliseconds(3000),
+        retryMilliseconds(60000),
+        pollPeriodMilliseconds(1000) {}
+};
+
+struct ExampleCOVValue {
+    uint32_t device;
+    uint16_t objectType;
+    uint32_t instance;
+    uint64_t vmac;                      // Of the device, packed by WSHubFrameHeader::PackVmac
+    uint32_t maxApdu;                   // Of the device, for polling
+    double value;                       // Present Value from the last notification
+    uint64_t updatedMilliseconds;       // 0 if no notification yet
+    uint8_t state;                      // ExampleCOVClient::STATE_*
+    uint32_t pollPoint;                 // In the fallback poller, UINT32_MAX if never polled
+    ExampleTimerId timer;               // Renewal or next try
+};
+
+class ExampleCOVClient {
+public:
+    static const uint8_t STATE_WAITING = 0;     // To be sent
+    static const uint8_t STATE_PENDING = 1;     // SubscribeCOV sent
+    static const uint8_t STATE_SUBSCRIBED = 2;
+    static const uint8_t STATE_POLLING = 3;     // Refused or no answer, polled until the next try
+
+private:
+    struct Pending {
+        uint32_t entry;
+        uint64_t sent;
+        uint64_t deadline;
+    };
+
+    ExampleCOVClientSettings settings;
+    std::vector<ExampleCOVValue> values;
+    std::unordered_map<uint64_t, uint32_t> index;       // getKey() to position in values
+    ExampleTimerWheel timers;
+    std::vector<ExampleTimerExpiry> expiries;
+    std::deque<uint32_t> waiting;                       // Entries to send a SubscribeCOV for
+    std::unordered_map<uint64_t, Pending> pending;      // VMAC << 8 | invoke ID
+    std::deque<std::pair<uint64_t, uint64_t> > timeouts; // Deadline and pending key, in deadline order
+    ExamplePoller poller;                               // Also hands out the invoke IDs of the SubscribeCOV
+    uint16_t messageId;
+
+    static uint64_t getKey(const uint32_t device, const uint16_t objectType, const uint32_t instance) {
+        return ((uint64_t)device << 32) | ((uint32_t)objectType << 22) | instance;
+    }
+    void fail(const uint32_t entry);
+    void onNotification(ExampleApduReader& reader, const uint64_t nowMilliseconds);
+
+public:
+    // Statistics
+    uint64_t subscribesSent;
+    uint64_t renewalsSent;              // Part of subscribesSent
+    uint64_t subscribeFailures;         // Refused or no answer
+    uint64_t notifications;
+    uint64_t notificationsUnknown;      // For no object in the cache
+    ExampleHdrHistogram latency;        // SubscribeCOV answer time, milliseconds
+
+    ExampleCOVClient();
+
+    void SetSettings(const ExampleCOVClientSettings& settings);
+    const ExampleCOVClientSettings& GetSettings() const { return this->settings; }
+    // Drop every subscription and start the schedule at nowMilliseconds
+    void Reset(const uint64_t nowMilliseconds);
+    // Invoke IDs shared with the other clients of the hub connection, NULL
+    // for the client's own. Before the first request.
+    void SetInvokeIds(ExampleInvokeIds* invokeIds) { this->poller.SetInvokeIds(invokeIds); }
+
+    // Subscribe to an object of a device, maxApdu is used when it is polled
+    void Add(const uint32_t device, const uint64_t vmac, const uint32_t maxApdu, const uint16_t objectType, const uint32_t instance);
+
+    // Next SubscribeCOV or polling request to send. Call until it returns false.
+    bool Poll(const uint64_t nowMilliseconds, uint8_t* frame, const size_t capacity, size_t* length);
+    uint64_t GetNextDeadline() const;
+
+    // A frame received from the hub, true if it was a COV notification or
+    // the answer to one of our requests
+    bool OnReceived(const uint8_t* frame, const size_t length, const uint64_t nowMilliseconds);
+
+    size_t Size() const { return this->values.size(); }
+    const ExampleCOVValue& Get(const size_t position) const { return this->values[position]; }
+    const ExampleCOVValue* Find(const uint32_t device, const uint16_t objectType, const uint32_t instance) const;
+    // Latest value of an entry, from a notification or from polling. False if there is none yet.
+    bool GetValue(const size_t position, double* value, uint64_t* updatedMilliseconds) const;
+    const ExamplePoller& GetPoller() const { return this->poller; }
+    size_t GetCount(const uint8_t state) const;
+    void Print() const;
+};
+
+#endif // __CASBACnetSCExampleCOVClient_h__
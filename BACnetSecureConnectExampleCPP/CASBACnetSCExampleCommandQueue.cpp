@@ -0,0 +1,115 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleCommandQueue.cpp
+ *
+ * See CASBACnetSCExampleCommandQueue.h
+ */
+
+#include "CASBACnetSCExampleCommandQueue.h"
+
+#include <chrono>
+
+ExampleCommandQueue::ExampleCommandQueue() {
+    this->stub.next.store(NULL, std::memory_order_relaxed);
+    this->head.store(&this->stub, std::memory_order_relaxed);
+    this->tail = &this->stub;
+    this->sleeping.store(false, std::memory_order_relaxed);
+    this->woken.store(false, std::memory_order_relaxed);
+    this->commandsRun = 0;
+    this->waits = 0;
+}
+
+ExampleCommandQueue::~ExampleCommandQueue() {
+    // Commands never run are dropped, their futures report a broken promise
+    Node* node;
+    while ((node = this->pop()) != NULL) {
+        delete node;
+    }
+}
+
+void ExampleCommandQueue::push(Node* node) {
+    node->next.store(NULL, std::memory_order_relaxed);
+    // Until the second store the consumer sees the list end at previous
+    Node* previous = this->head.exchange(node, std::memory_order_seq_cst);
+    previous->next.store(node, std::memory_order_release);
+}
+
+ExampleCommandQueue::Node* ExampleCommandQueue::pop() {
+    Node* tail = this->tail;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &this->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        this->tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != NULL) {
+        this->tail = next;
+        return tail;
+    }
+    if (tail != this->head.load(std::memory_order_acquire)) {
+        // A producer has swapped the head but not linked its node yet
+        return NULL;
+    }
+    // tail is the last node, put the stub behind it so it can be taken
+    this->push(&this->stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != NULL) {
+        this->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+void ExampleCommandQueue::Post(std::function<void()> work) {
+    Node* node = new Node;
+    node->work = std::move(work);
+    this->push(node);
+    if (this->sleeping.load(std::memory_order_seq_cst) && this->sleeping.exchange(false)) {
+        this->wake.notify_one();
+    }
+}
+
+void ExampleCommandQueue::Wake() {
+    this->woken.store(true, std::memory_order_seq_cst);
+    if (this->sleeping.load(std::memory_order_seq_cst) && this->sleeping.exchange(false)) {
+        this->wake.notify_one();
+    }
+}
+
+size_t ExampleCommandQueue::Run(const size_t maxCommands) {
+    size_t count = 0;
+    Node* node;
+    while (count < maxCommands && (node = this->pop()) != NULL) {
+        node->work();
+        delete node;
+        count++;
+    }
+    this->commandsRun += count;
+    return count;
+}
+
+bool ExampleCommandQueue::IsEmpty() {
+    return this->tail == &this->stub && this->head.load(std::memory_order_seq_cst) == &this->stub;
+}
+
+void ExampleCommandQueue::Wait(const uint32_t timeoutMilliseconds) {
+    if (timeoutMilliseconds == 0) {
+        this->woken.store(false, std::memory_order_relaxed);
+        return;
+    }
+    // Flag first, then look at the queue: a producer either sees the flag or
+    // its command is seen here
+    this->sleeping.store(true, std::memory_order_seq_cst);
+    if (this->IsEmpty() && !this->woken.load(std::memory_order_seq_cst)) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->waits++;
+        this->wake.wait_for(lock, std::chrono::milliseconds(timeoutMilliseconds));
+    }
+    this->sleeping.store(false, std::memory_order_relaxed);
+    // The work of a Wake() before this point is done by the loop that follows
+    this->woken.store(false, std::memory_order_relaxed);
+}
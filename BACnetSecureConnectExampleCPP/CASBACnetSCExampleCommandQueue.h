@@ -0,0 +1,91 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleCommandQueue.h
+ *
+ * Multi producer, single consumer command queue that hands work to the
+ * thread that owns the CAS BACnet Stack.
+ *
+ * The stack is not thread safe: every fp* call, and everything the stack
+ * calls back, has to run on one thread. Other threads (a UI, field drivers,
+ * a REST API, the keyboard in this example) Post() a command, or Submit()
+ * one and get a std::future for its result. The stack thread runs the
+ * commands between two fpLoop() calls with Run().
+ *
+ * The queue is an intrusive linked list (Dmitry Vyukov's MPSC queue). Post is
+ * wait free, one atomic exchange, so a producer never waits for the stack or
+ * for another producer. Run never waits either: a command whose producer is
+ * between its two stores is left for the next Run. Commands of one producer
+ * run in the order they were posted.
+ *
+ * Wait() lets the stack thread sleep until a command is posted or its next
+ * timer is due. Wake() ends the Wait early without a command, for work the
+ * stack finds on its own, such as a frame for fpLoop() in a receive queue. A
+ * producer only wakes it when it is asleep; a wake-up lost to the race with
+ * falling asleep costs at most the timeout of the Wait.
+ */
+
+#ifndef __CASBACnetSCExampleCommandQueue_h__
+#define __CASBACnetSCExampleCommandQueue_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <type_traits>
+
+class ExampleCommandQueue {
+private:
+    struct Node {
+        std::atomic<Node*> next;
+        std::function<void()> work;
+    };
+
+    std::atomic<Node*> head;            // Last posted, producers
+    Node* tail;                         // Next to run, consumer only
+    Node stub;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> woken;            // Wake() since the last Wait()
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    void push(Node* node);
+    Node* pop();
+
+public:
+    // Statistics, consumer thread only
+    uint64_t commandsRun;
+    uint64_t waits;                     // Times Wait() went to sleep
+
+    ExampleCommandQueue();
+    ~ExampleCommandQueue();
+
+    // Any thread. The work runs on the consumer thread.
+    void Post(std::function<void()> work);
+
+    // Any thread. The next or current Wait() returns, without a command.
+    void Wake();
+
+    // Any thread. The future is ready once the work has run on the consumer
+    // thread, with its result or the exception it threw.
+    template <typename Function>
+    std::future<typename std::result_of<Function()>::type> Submit(Function work) {
+        typedef typename std::result_of<Function()>::type Result;
+        std::shared_ptr<std::packaged_task<Result()> > task = std::make_shared<std::packaged_task<Result()> >(work);
+        std::future<Result> result = task->get_future();
+        this->Post([task] { (*task)(); });
+        return result;
+    }
+
+    // Consumer thread only. Run up to maxCommands commands, returns how many ran.
+    size_t Run(const size_t maxCommands);
+    // Consumer thread only. Sleep until a command is posted, at most timeoutMilliseconds.
+    void Wait(const uint32_t timeoutMilliseconds);
+    // Consumer thread only
+    bool IsEmpty();
+};
+
+#endif // __CASBACnetSCExampleCommandQueue_h__
@@ -101,11 +101,13 @@ public:
 	static const uint32_t PROPERTY_IDENTIFIER_PRESENT_VALUE = 85;
 	static const uint32_t PROPERTY_IDENTIFIER_PRIORITY_ARRAY = 87;
 	static const uint32_t PROPERTY_IDENTIFIER_RELIABILITY = 103;
+	static const uint32_t PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT = 104;
 	static const uint32_t PROPERTY_IDENTIFIER_STATE_TEXT = 110;
 	static const uint32_t PROPERTY_IDENTIFIER_STATUS_FLAGS = 111;
 	static const uint32_t PROPERTY_IDENTIFIER_SYSTEM_STATUS = 112;
 	static const uint32_t PROPERTY_IDENTIFIER_UTC_OFFSET = 119;
 	static const uint32_t PROPERTY_IDENTIFIER_BIT_TEXT = 343;
+	static const uint32_t PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY = 431;
 	
 
 	static const uint32_t PROPERTY_IDENTIFIER_MAX_PRES_VALUE = 65;
@@ -9,8 +9,11 @@
  */
 
 #include "CASBACnetSCExampleDatabase.h"
+#include "CASBACnetSCExampleConstants.h"
+
+#include <algorithm>
+#include <chrono>
 
-#include <time.h> // time()
 #ifdef _WIN32
 #include <winsock2.h>
 #include <iphlpapi.h>
@@ -25,7 +28,8 @@ ExampleDatabase::ExampleDatabase() {
 }
 
 ExampleDatabase::~ExampleDatabase() {
-    this->Setup();
+    // The members free themselves. Setup() here would rebuild every table,
+    // timer and Trend Log during static destruction.
 }
 
 const std::string ExampleDatabase::GetColorName() {
@@ -47,21 +51,103 @@ void ExampleDatabase::Setup() {
     this->device.systemStatus = 0; // operational (0), non-operational (4)
 
     // Set the object name properites.
-    this->analogInput.instance = 0;
-    this->analogInput.objectName = "AnalogInput " + ExampleDatabase::GetColorName();
-    this->analogInput.presentValue = 1.001f;
-    this->analogInput.covIncurment = 2.0f;
-    this->analogInput.reliability = 0; // no-fault-detected (0), unreliable-other (7)
+    this->objects.Clear();
+    this->objects.Reserve(CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, ANALOG_INPUT_COUNT, ANALOG_INPUT_COUNT * 24);
+    for (uint32_t instance = 0; instance < ANALOG_INPUT_COUNT; instance++) {
+        // reliability: no-fault-detected (0), unreliable-other (7)
+        this->objects.Add(CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, instance, "AnalogInput " + ExampleDatabase::GetColorName(), 1.001f, 2.0f, 0);
+    }
+
+    // Commandable objects, the present value given here is the Relinquish_Default
+    for (uint32_t instance = 0; instance < COMMANDABLE_COUNT; instance++) {
+        this->objects.Add(CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, instance, "AnalogOutput " + ExampleDatabase::GetColorName(), 0.0f, 1.0f, 0);
+        this->objects.Add(CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, instance, "AnalogValue " + ExampleDatabase::GetColorName(), 0.0f, 1.0f, 0);
+        // Binary: inactive (0), active (1)
+        this->objects.Add(CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, instance, "BinaryOutput " + ExampleDatabase::GetColorName(), 0.0f, 0.0f, 0);
+        this->objects.Add(CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, instance, "BinaryValue " + ExampleDatabase::GetColorName(), 0.0f, 0.0f, 0);
+        // Multi-state: 1 to MULTI_STATE_NUMBER_OF_STATES
+        this->objects.Add(CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, instance, "MultiStateOutput " + ExampleDatabase::GetColorName(), 1.0f, 0.0f, 0);
+        this->objects.Add(CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, instance, "MultiStateValue " + ExampleDatabase::GetColorName(), 1.0f, 0.0f, 0);
+    }
+    this->cov.Initialize(&this->objects);
+    this->ScheduleUpdates(0);
+}
+
+void ExampleDatabase::ScheduleUpdates(const uint64_t nowMilliseconds) {
+    this->timers.Reset(nowMilliseconds);
+    this->trendLogs.clear();
+    this->trendLogs.reserve(TREND_LOG_MAX_COUNT);
+    for (size_t tableIndex = 0; tableIndex < this->objects.tables.size(); tableIndex++) {
+        const ExampleObjectTable& table = this->objects.tables[tableIndex];
+        if (table.objectType != CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT) {
+            continue;
+        }
+        this->timers.Reserve(this->timers.GetCount() + table.Size());
+        for (uint32_t row = 0; row < table.Size(); row++) {
+            // Spread the first updates over one period so the objects are not all written in the same loop
+            uint64_t context = ((uint64_t)tableIndex << 32) | row;
+            this->timers.Add(1 + (uint64_t)row * ANALOG_INPUT_UPDATE_MILLISECONDS / table.Size(), ANALOG_INPUT_UPDATE_MILLISECONDS, context);
+        }
+
+        // Trend Logs, logging at the same offset in the interval as the update
+        uint32_t logCount = (uint32_t)std::min<size_t>(table.Size(), TREND_LOG_MAX_COUNT - this->trendLogs.size());
+        for (uint32_t row = 0; row < logCount; row++) {
+            ExampleDatabaseTrendLog trendLog;
+            trendLog.instance = (uint32_t)this->trendLogs.size();
+            trendLog.objectName = "TrendLog " + std::to_string(table.instance[row]);
+            trendLog.tableIndex = (uint32_t)tableIndex;
+            trendLog.row = row;
+            this->trendLogs.push_back(trendLog);
+            this->trendLogs.back().buffer.Initialize(TREND_LOG_BLOCK_COUNT);
+            this->timers.Add(1 + (uint64_t)row * TREND_LOG_INTERVAL_MILLISECONDS / table.Size(), TREND_LOG_INTERVAL_MILLISECONDS, TIMER_TREND_LOG | trendLog.instance);
+        }
+    }
 }
 
-void ExampleDatabase::Loop() {
+void ExampleDatabase::Loop(const uint64_t nowMilliseconds) {
+    this->timerExpiries.clear();
+    if (this->timers.Advance(nowMilliseconds, &this->timerExpiries) == 0) {
+        return;
+    }
+    uint64_t unixMilliseconds = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    for (const ExampleTimerExpiry& expiry : this->timerExpiries) {
+        if (expiry.context & TIMER_TREND_LOG) {
+            ExampleDatabaseTrendLog& trendLog = this->trendLogs[(size_t)(expiry.context & ~TIMER_TREND_LOG)];
+            trendLog.buffer.Add(unixMilliseconds, this->objects.tables[trendLog.tableIndex].presentValue[trendLog.row]);
+            continue;
+        }
+        size_t tableIndex = (size_t)(expiry.context >> 32);
+        uint32_t row = (uint32_t)expiry.context;
+        this->cov.Write(tableIndex, row, this->objects.tables[tableIndex].presentValue[row] + 1.001f);
+    }
+}
 
-    time_t currentTime = time(0);
+bool ExampleDatabase::Command(const size_t tableIndex, const uint32_t row, const uint8_t priority, const float value) {
+    if (!this->objects.tables[tableIndex].priorityArray[row].Command(priority, value)) {
+        return false;
+    }
+    this->updateEffectiveValue(tableIndex, row);
+    return true;
+}
 
-    static time_t updateOnceASecondTimer = 0;
-    if (updateOnceASecondTimer + 1 <= currentTime) {
-        updateOnceASecondTimer = currentTime;
+bool ExampleDatabase::Relinquish(const size_t tableIndex, const uint32_t row, const uint8_t priority) {
+    if (!this->objects.tables[tableIndex].priorityArray[row].Relinquish(priority)) {
+        return false;
+    }
+    this->updateEffectiveValue(tableIndex, row);
+    return true;
+}
+
+void ExampleDatabase::SetRelinquishDefault(const size_t tableIndex, const uint32_t row, const float value) {
+    this->objects.tables[tableIndex].priorityArray[row].relinquishDefault = value;
+    this->updateEffectiveValue(tableIndex, row);
+}
 
-        this->analogInput.presentValue += 1.001f;
+void ExampleDatabase::updateEffectiveValue(const size_t tableIndex, const uint32_t row) {
+    ExampleObjectTable& table = this->objects.tables[tableIndex];
+    float effective = table.priorityArray[row].GetEffectiveValue();
+    // Most commands are at a lower priority than the one in control
+    if (effective != table.presentValue[row].Load()) {
+        this->cov.Write(tableIndex, row, effective);
     }
 }
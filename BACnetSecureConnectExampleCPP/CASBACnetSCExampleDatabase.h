@@ -6,12 +6,15 @@
  * The CASBACnetStackExampleDatabase is a data store that contains
  * some example data used in the BACnetStackDLLExample.
  * This data is represented by BACnet objects for this server example.
- * There will be one object of each type currently supported by the CASBACnetStack.
+ * The objects live in an ExampleObjectStore, one column table per object
+ * type with any number of objects each: ANALOG_INPUT_COUNT Analog Inputs and
+ * COMMANDABLE_COUNT of each commandable type by default, more when a point
+ * file is loaded. Trend Logs follow the first Analog Inputs.
  *
  * The database will include the following:
- *	- present value
- *	- name
- *	- for outputs priority array (bool and value)
+ *	- present value, name, COV increment and reliability of each object
+ *	- for commandable objects the priority array and relinquish default
+ *	- the timers of the periodic updates and the Trend Log buffers
  *
  * Created by: Steven Smethurst
  */
@@ -19,6 +22,11 @@
 #ifndef __CASBACnetStackExampleDatabase_h__
 #define __CASBACnetStackExampleDatabase_h__
 
+#include "CASBACnetSCExampleObjectStore.h"
+#include "CASBACnetSCExampleCOV.h"
+#include "CASBACnetSCExampleTimerWheel.h"
+#include "CASBACnetSCExampleTrendLog.h"
+
 #include <map>
 #include <stdint.h>
 #include <string.h>
@@ -36,24 +44,56 @@ public:
     uint32_t instance;
 };
 
-class ExampleDatabaseAnalogInput : public ExampleDatabaseBaseObject {
+class ExampleDatabaseDevice : public ExampleDatabaseBaseObject {
 public:
-    float presentValue;
-    float covIncurment;
-    uint32_t reliability;
+    uint32_t systemStatus;
 };
 
-class ExampleDatabaseDevice : public ExampleDatabaseBaseObject {
+class ExampleDatabaseTrendLog : public ExampleDatabaseBaseObject {
 public:
-    uint32_t systemStatus;
+    // Logged object, a row of ExampleDatabase::objects
+    uint32_t tableIndex;
+    uint32_t row;
+
+    // See CASBACnetSCExampleTrendLog.h
+    ExampleTrendLog buffer;
 };
 
 class ExampleDatabase {
 
 public:
-    ExampleDatabaseAnalogInput analogInput;
+    // Number of Analog Input objects created by Setup()
+    static const uint32_t ANALOG_INPUT_COUNT = 1;
+    // Every Analog Input is incremented once per period, each on its own timer
+    static const uint32_t ANALOG_INPUT_UPDATE_MILLISECONDS = 1000;
+
+    // The present value of the first TREND_LOG_MAX_COUNT Analog Inputs is
+    // logged every TREND_LOG_INTERVAL_MILLISECONDS. Each log keeps the
+    // newest records that fit in TREND_LOG_BLOCK_COUNT blocks (about 14,000).
+    static const uint32_t TREND_LOG_MAX_COUNT = 1000;
+    static const uint32_t TREND_LOG_INTERVAL_MILLISECONDS = 1000;
+    static const uint32_t TREND_LOG_BLOCK_COUNT = 64;
+
+    // Number of objects of each commandable type (Analog, Binary and
+    // Multi-state Output and Value) created by Setup()
+    static const uint32_t COMMANDABLE_COUNT = 1;
+    // Number_Of_States of the Multi-state Outputs and Values
+    static const uint32_t MULTI_STATE_NUMBER_OF_STATES = 4;
+
     ExampleDatabaseDevice device;
-    
+
+    // All the objects of the device. See CASBACnetSCExampleObjectStore.h
+    ExampleObjectStore objects;
+
+    // Present value writes go through here so changes can be reported. See CASBACnetSCExampleCOV.h
+    ExampleCOVEngine cov;
+
+    // Periodic point updates. See CASBACnetSCExampleTimerWheel.h
+    ExampleTimerWheel timers;
+
+    // Trend Log instance is the index
+    std::vector<ExampleDatabaseTrendLog> trendLogs;
+
     // Constructor / Deconstructor
     ExampleDatabase();
     ~ExampleDatabase();
@@ -61,10 +101,28 @@ public:
     // Set all the objects to have a default value.
     void Setup();
 
-    // Update the values as needed
-    void Loop();
+    // Create the Trend Logs and start the update and logging timers of the
+    // objects in the store. Call again after the store is reloaded.
+    void ScheduleUpdates(const uint64_t nowMilliseconds);
+
+    // Update the values that are due
+    void Loop(const uint64_t nowMilliseconds);
+
+    // Priority_Array of a commandable row of objects.tables[tableIndex]. The
+    // present value follows the effective value and changes are reported to
+    // the COV engine. Return false for a priority out of range.
+    bool Command(const size_t tableIndex, const uint32_t row, const uint8_t priority, const float value);
+    bool Relinquish(const size_t tableIndex, const uint32_t row, const uint8_t priority);
+    void SetRelinquishDefault(const size_t tableIndex, const uint32_t row, const float value);
 
 private:
+    // Timer context: a table and row to update, or this bit and a Trend Log instance
+    static const uint64_t TIMER_TREND_LOG = (uint64_t)1 << 63;
+
+    std::vector<ExampleTimerExpiry> timerExpiries;
+
+    void updateEffectiveValue(const size_t tableIndex, const uint32_t row);
+
     const std::string GetColorName();
 };
 
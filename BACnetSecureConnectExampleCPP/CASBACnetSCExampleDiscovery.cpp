@@ -0,0 +1,225 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleDiscovery.cpp
+ *
+ * See CASBACnetSCExampleDiscovery.h
+ */
+
+#include "CASBACnetSCExampleDiscovery.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+// Devices printed by ExampleDiscovery::Print()
+static const size_t DISCOVERY_PRINT_DEVICES = 20;
+
+//
+// ExampleDeviceTable
+// ----------------------------------------------------------------------------
+
+bool ExampleDeviceTable::Update(const ExampleIAm& iAm, const uint64_t nowMilliseconds) {
+    uint32_t position;
+    if (this->index.Find(iAm.instance, &position)) {
+        ExampleDiscoveredDevice& device = this->devices[position];
+        device.maxApdu = iAm.maxApdu;
+        device.vmac = iAm.vmac;
+        device.vendorId = iAm.vendorId;
+        device.segmentation = iAm.segmentation;
+        device.lastSeenMilliseconds = nowMilliseconds;
+        return false;
+    }
+
+    ExampleDiscoveredDevice device;
+    device.instance = iAm.instance;
+    device.maxApdu = iAm.maxApdu;
+    device.vmac = iAm.vmac;
+    device.vendorId = iAm.vendorId;
+    device.segmentation = iAm.segmentation;
+    device.lastSeenMilliseconds = nowMilliseconds;
+    this->index.Insert(iAm.instance, (uint32_t)this->devices.size());
+    this->devices.push_back(device);
+    return true;
+}
+
+const ExampleDiscoveredDevice* ExampleDeviceTable::Find(const uint32_t instance) const {
+    uint32_t position;
+    if (!this->index.Find(instance, &position)) {
+        return NULL;
+    }
+    return &this->devices[position];
+}
+
+void ExampleDeviceTable::Clear() {
+    this->devices.clear();
+    this->index.Clear();
+}
+
+size_t ExampleDeviceTable::GetMemoryUsage() const {
+    return this->devices.capacity() * sizeof(ExampleDiscoveredDevice) + this->index.GetMemoryUsage();
+}
+
+//
+// ExampleDiscovery
+// ----------------------------------------------------------------------------
+
+ExampleDiscovery::ExampleDiscovery() {
+    this->running = false;
+    this->low = 0;
+    this->high = 0;
+    this->next = 0;
+    this->rangeSize = this->settings.initialRangeSize;
+    this->shrinks = 0;
+    this->nextWhoIs = 0;
+    this->startMilliseconds = 0;
+    this->whoIsSent = 0;
+    this->iAmReceived = 0;
+    this->iAmLate = 0;
+    this->maxResponses = 0;
+    this->sweepMilliseconds = 0;
+}
+
+void ExampleDiscovery::Start(const uint32_t low, const uint32_t high, const uint64_t nowMilliseconds) {
+    this->running = true;
+    this->low = low;
+    this->high = std::min(high, APDU_MAX_INSTANCE);
+    this->next = low;
+    this->rangeSize = this->settings.initialRangeSize;
+    this->nextWhoIs = nowMilliseconds;
+    this->startMilliseconds = nowMilliseconds;
+}
+
+void ExampleDiscovery::Stop() {
+    this->running = false;
+}
+
+double ExampleDiscovery::GetProgress() const {
+    if (this->high < this->low) {
+        return 100.0;
+    }
+    return 100.0 * (std::min(this->next, this->high + 1) - this->low) / ((double)this->high - this->low + 1);
+}
+
+bool ExampleDiscovery::Poll(const uint64_t nowMilliseconds, uint32_t* low, uint32_t* high) {
+    // Ranges are sent in order with the same window, the oldest closes first
+    while (!this->outstanding.empty() && this->outstanding.front().deadline <= nowMilliseconds) {
+        this->close(this->outstanding.front());
+        this->outstanding.pop_front();
+    }
+    if (!this->running) {
+        return false;
+    }
+
+    if (this->next > this->high) {
+        if (this->outstanding.empty()) {
+            this->running = false;
+            this->sweepMilliseconds = nowMilliseconds - this->startMilliseconds;
+            std::cout << "Discovery: sweep done in " << this->sweepMilliseconds << " ms, " << this->devices.Size() << " devices, " << this->whoIsSent << " Who-Is" << std::endl;
+        }
+        return false;
+    }
+    if (this->outstanding.size() >= this->settings.maxOutstanding || nowMilliseconds < this->nextWhoIs) {
+        return false;
+    }
+
+    Range range;
+    range.low = this->next;
+    range.high = (uint32_t)std::min<uint64_t>((uint64_t)this->next + this->rangeSize - 1, this->high);
+    range.responses = 0;
+    range.shrinks = this->shrinks;
+    range.deadline = nowMilliseconds + this->settings.responseWindowMilliseconds;
+    this->outstanding.push_back(range);
+    this->next = range.high + 1;
+    this->nextWhoIs = nowMilliseconds + this->settings.whoIsIntervalMilliseconds;
+    this->whoIsSent++;
+
+    *low = range.low;
+    *high = range.high;
+    return true;
+}
+
+uint64_t ExampleDiscovery::GetNextDeadline() const {
+    uint64_t deadline = this->outstanding.empty() ? UINT64_MAX : this->outstanding.front().deadline;
+    if (this->running) {
+        if (this->next > this->high) {
+            return this->outstanding.empty() ? 0 : deadline;
+        }
+        if (this->outstanding.size() < this->settings.maxOutstanding) {
+            deadline = std::min(deadline, this->nextWhoIs);
+        }
+    }
+    return deadline;
+}
+
+void ExampleDiscovery::adapt(const uint32_t size, const uint32_t responses) {
+    // Ranges of the same size should get about targetResponses I-Am
+    uint64_t wanted = responses == 0 ? (uint64_t)size * 2 : (uint64_t)size * this->settings.targetResponses / responses;
+    wanted = std::max<uint64_t>(this->settings.minRangeSize, std::min<uint64_t>(wanted, this->settings.maxRangeSize));
+    if (wanted < this->rangeSize) {
+        this->rangeSize = (uint32_t)wanted;
+        this->shrinks++;
+    }
+    else {
+        // Grow slowly, the next part of the instance space may be denser
+        this->rangeSize = (uint32_t)std::min<uint64_t>(wanted, (uint64_t)size * 2);
+    }
+}
+
+void ExampleDiscovery::close(const Range& range) {
+    this->maxResponses = std::max(this->maxResponses, range.responses);
+    if (range.responses > this->settings.targetResponses || range.shrinks == this->shrinks) {
+        this->adapt(range.high - range.low + 1, range.responses);
+    }
+    // Otherwise a newer range already found denser devices, do not grow over it
+}
+
+bool ExampleDiscovery::OnReceived(const uint8_t* frame, const size_t length, const uint64_t nowMilliseconds) {
+    ExampleIAm iAm;
+    if (!ExampleApdu::ParseIAm(frame, length, &iAm)) {
+        return false;
+    }
+    this->OnIAm(iAm, nowMilliseconds);
+    return true;
+}
+
+void ExampleDiscovery::OnIAm(const ExampleIAm& iAm, const uint64_t nowMilliseconds) {
+    this->devices.Update(iAm, nowMilliseconds);
+    this->iAmReceived++;
+
+    for (Range& range : this->outstanding) {
+        if (iAm.instance < range.low || iAm.instance > range.high) {
+            continue;
+        }
+        // Too dense, shrink the next ranges now instead of when this one closes
+        if (++range.responses > this->settings.targetResponses) {
+            uint32_t size = range.high - range.low + 1;
+            uint32_t wanted = std::max<uint32_t>(this->settings.minRangeSize, (uint32_t)((uint64_t)size * this->settings.targetResponses / range.responses));
+            if (wanted < this->rangeSize) {
+                this->rangeSize = wanted;
+                this->shrinks++;
+            }
+        }
+        return;
+    }
+    this->iAmLate++;    // From an unranged Who-Is, or after the window
+}
+
+void ExampleDiscovery::Print() const {
+    std::ios::fmtflags flags = std::cout.flags();
+    char fill = std::cout.fill();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Discovery: " << (this->running ? "running " : "idle ") << this->GetProgress() << "%, " << this->devices.Size() << " devices, ";
+    std::cout << this->whoIsSent << " Who-Is, " << this->iAmReceived << " I-Am (" << this->iAmLate << " outside a range), ";
+    std::cout << "range size " << this->rangeSize << ", most I-Am for one Who-Is " << this->maxResponses << std::endl;
+    for (size_t position = 0; position < std::min(this->devices.Size(), DISCOVERY_PRINT_DEVICES); position++) {
+        const ExampleDiscoveredDevice& device = this->devices.Get(position);
+        std::cout << "  device " << std::dec << device.instance << ", vmac " << std::hex << std::setfill('0') << std::setw(12) << device.vmac << std::setfill(fill) << std::dec;
+        std::cout << ", vendor " << device.vendorId << ", maxApdu " << device.maxApdu << std::endl;
+    }
+    if (this->devices.Size() > DISCOVERY_PRINT_DEVICES) {
+        std::cout << "  ... " << this->devices.Size() - DISCOVERY_PRINT_DEVICES << " more" << std::endl;
+    }
+    std::cout.fill(fill);
+    std::cout.flags(flags);
+}
@@ -0,0 +1,147 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleDiscovery.h
+ *
+ * Device discovery by partitioned Who-Is sweeps.
+ *
+ * A Who-Is without a range is answered by every device on the network at
+ * once. On a hub with thousands of devices that I-Am storm fills the hub and
+ * the receive queue of this device. ExampleDiscovery instead walks the
+ * instance space in ranges, one Who-Is every whoIsIntervalMilliseconds and
+ * no more than maxOutstanding ranges waiting for their I-Am at a time.
+ *
+ * The range size follows the density of the devices: when a range gets more
+ * than targetResponses I-Am the next ranges shrink to match, as soon as the
+ * I-Am arrive; when a range closes with fewer they grow, at most doubling
+ * each time. Sparse parts of the instance space are crossed in a few large
+ * ranges and dense ones in many small ones, so the I-Am rate seen by the hub
+ * stays near targetResponses per Who-Is.
+ *
+ * Every I-Am is recorded in an ExampleDeviceTable, indexed by instance, with
+ * the VMAC it came from, its vendor and max APDU length.
+ *
+ * Not thread safe, called from the main loop and CallbackReceiveMessage.
+ */
+
+#ifndef __CASBACnetSCExampleDiscovery_h__
+#define __CASBACnetSCExampleDiscovery_h__
+
+#include "CASBACnetSCExampleApdu.h"
+#include "CASBACnetSCExampleObjectStore.h"
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+//
+// ExampleDeviceTable
+// ----------------------------------------------------------------------------
+struct ExampleDiscoveredDevice {
+    uint32_t instance;
+    uint32_t maxApdu;
+    uint64_t vmac;
+    uint16_t vendorId;
+    uint8_t segmentation;
+    uint64_t lastSeenMilliseconds;
+};
+
+class ExampleDeviceTable {
+private:
+    std::vector<ExampleDiscoveredDevice> devices;   // In discovery order
+    ExampleObjectIndex index;                       // Instance to position in devices
+
+public:
+    // Add or refresh a device, true if it is new
+    bool Update(const ExampleIAm& iAm, const uint64_t nowMilliseconds);
+    const ExampleDiscoveredDevice* Find(const uint32_t instance) const;
+    void Clear();
+
+    size_t Size() const { return this->devices.size(); }
+    const ExampleDiscoveredDevice& Get(const size_t position) const { return this->devices[position]; }
+    size_t GetMemoryUsage() const;
+};
+
+//
+// ExampleDiscovery
+// ----------------------------------------------------------------------------
+struct ExampleDiscoverySettings {
+    uint32_t whoIsIntervalMilliseconds;     // Between two Who-Is
+    uint32_t responseWindowMilliseconds;    // I-Am expected within this time of the Who-Is
+    uint32_t maxOutstanding;                // Ranges waiting for their I-Am
+    uint32_t targetResponses;               // I-Am wanted per Who-Is
+    uint32_t initialRangeSize;
+    uint32_t minRangeSize;
+    uint32_t maxRangeSize;
+
+    ExampleDiscoverySettings() :
+        whoIsIntervalMilliseconds(100),
+        responseWindowMilliseconds(1000),
+        maxOutstanding(4),
+        targetResponses(50),
+        initialRangeSize(1024),
+        minRangeSize(16),
+        maxRangeSize(65536) {}
+};
+
+class ExampleDiscovery {
+private:
+    struct Range {
+        uint32_t low;
+        uint32_t high;
+        uint32_t responses;
+        uint32_t shrinks;               // ExampleDiscovery::shrinks when the Who-Is was sent
+        uint64_t deadline;
+    };
+
+    ExampleDiscoverySettings settings;
+    ExampleDeviceTable devices;
+    std::deque<Range> outstanding;      // In instance order
+    bool running;
+    uint32_t low;
+    uint32_t high;
+    uint32_t next;                      // First instance not asked for yet
+    uint32_t rangeSize;
+    uint32_t shrinks;                   // Times rangeSize was made smaller
+    uint64_t nextWhoIs;
+    uint64_t startMilliseconds;
+
+    void close(const Range& range);
+    void adapt(const uint32_t size, const uint32_t responses);
+
+public:
+    // Statistics
+    uint64_t whoIsSent;
+    uint64_t iAmReceived;
+    uint64_t iAmLate;                   // I-Am in no outstanding range
+    uint32_t maxResponses;              // Most I-Am for one Who-Is
+    uint64_t sweepMilliseconds;         // Duration of the last complete sweep
+
+    ExampleDiscovery();
+
+    void SetSettings(const ExampleDiscoverySettings& settings) { this->settings = settings; }
+    const ExampleDiscoverySettings& GetSettings() const { return this->settings; }
+
+    // Sweep the instances low to high. The device table is kept.
+    void Start(const uint32_t low, const uint32_t high, const uint64_t nowMilliseconds);
+    void Stop();
+    bool IsRunning() const { return this->running; }
+    // Percent of the instance space asked for
+    double GetProgress() const;
+
+    // Close the ranges past their window and get the next Who-Is to send, if
+    // one is due. Call until it returns false.
+    bool Poll(const uint64_t nowMilliseconds, uint32_t* low, uint32_t* high);
+    // When Poll() next has something to do, UINT64_MAX if not running
+    uint64_t GetNextDeadline() const;
+
+    // A frame received from the hub, true if it was an I-Am
+    bool OnReceived(const uint8_t* frame, const size_t length, const uint64_t nowMilliseconds);
+    void OnIAm(const ExampleIAm& iAm, const uint64_t nowMilliseconds);
+
+    const ExampleDeviceTable& GetDevices() const { return this->devices; }
+    uint32_t GetRangeSize() const { return this->rangeSize; }
+    void Print() const;
+};
+
+#endif // __CASBACnetSCExampleDiscovery_h__
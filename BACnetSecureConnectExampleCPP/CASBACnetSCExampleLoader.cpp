@@ -0,0 +1,326 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleLoader.cpp
+ *
+ * See CASBACnetSCExampleLoader.h
+ */
+
+#include "CASBACnetSCExampleLoader.h"
+#include "CASBACnetSCExampleMappedFile.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+static_assert(sizeof(ExamplePointFileHeader) == 32, "Point file header must be 32 bytes");
+static_assert(sizeof(ExamplePointFileRecord) == 24, "Point file record must be 24 bytes");
+
+// Below this many records per thread, starting a thread costs more than it saves
+static const size_t LOADER_MIN_RECORDS_PER_THREAD = 16384;
+
+typedef std::chrono::steady_clock LoaderClock;
+
+static double LoaderSeconds(LoaderClock::time_point start) {
+    return std::chrono::duration<double>(LoaderClock::now() - start).count();
+}
+
+// Run function(chunk) for every chunk, the last one on the calling thread
+template <typename Function>
+static void LoaderRunParallel(const unsigned int chunks, Function function) {
+    std::vector<std::thread> threads;
+    for (unsigned int chunk = 0; chunk + 1 < chunks; chunk++) {
+        threads.push_back(std::thread(function, chunk));
+    }
+    function(chunks - 1);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+//
+// ExampleLoadReport
+// ----------------------------------------------------------------------------
+
+ExampleLoadReport::ExampleLoadReport() {
+    this->objectCount = 0;
+    this->fileBytes = 0;
+    this->threads = 0;
+    this->mapSeconds = 0;
+    this->scanSeconds = 0;
+    this->fillSeconds = 0;
+    this->indexSeconds = 0;
+}
+
+void ExampleLoadReport::Print() const {
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  objects: " << this->objectCount << ", file: " << this->fileBytes / 1024 << " KB, threads: " << this->threads << std::endl;
+    std::cout << "  map:     " << this->mapSeconds * 1e3 << " ms" << std::endl;
+    std::cout << "  scan:    " << this->scanSeconds * 1e3 << " ms" << std::endl;
+    std::cout << "  fill:    " << this->fillSeconds * 1e3 << " ms" << std::endl;
+    std::cout << "  index:   " << this->indexSeconds * 1e3 << " ms" << std::endl;
+    std::cout.flags(flags);
+}
+
+//
+// ExampleDatabaseLoader
+// ----------------------------------------------------------------------------
+
+bool ExampleDatabaseLoader::Load(const std::string& path, ExampleObjectStore* store, ExampleLoadReport* report) {
+    ExampleLoadReport unused;
+    if (report == NULL) {
+        report = &unused;
+    }
+
+    // Map
+    LoaderClock::time_point start = LoaderClock::now();
+    ExampleMappedFile file;
+    if (!file.Open(path)) {
+        std::cerr << "Error: Could not open point file [" << path << "]" << std::endl;
+        return false;
+    }
+    report->fileBytes = file.GetSize();
+    report->mapSeconds = LoaderSeconds(start);
+
+    ExamplePointFileHeader header;
+    if (file.GetSize() < sizeof(header)) {
+        std::cerr << "Error: Point file is too small [" << path << "]" << std::endl;
+        return false;
+    }
+    memcpy(&header, file.GetData(), sizeof(header));
+    if (memcmp(header.magic, EXAMPLE_POINT_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != EXAMPLE_POINT_FILE_VERSION || header.recordSize < sizeof(ExamplePointFileRecord)) {
+        std::cerr << "Error: Not a version " << EXAMPLE_POINT_FILE_VERSION << " point file [" << path << "]" << std::endl;
+        return false;
+    }
+    const uint64_t namesStart = sizeof(header) + (uint64_t)header.recordCount * header.recordSize;
+    if (namesStart + header.namesSize > file.GetSize()) {
+        std::cerr << "Error: Point file is truncated [" << path << "]" << std::endl;
+        return false;
+    }
+    const uint8_t* records = file.GetData() + sizeof(header);
+    const size_t recordCount = header.recordCount;
+    const size_t recordSize = header.recordSize;
+
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = (unsigned int)std::min<size_t>(threads, recordCount / LOADER_MIN_RECORDS_PER_THREAD + 1);
+    report->threads = threads;
+    const size_t chunkSize = (recordCount + threads - 1) / threads;
+
+    // Scan: validate every record and count the objects of each type per chunk
+    start = LoaderClock::now();
+    std::vector<std::vector<uint32_t> > counts(threads, std::vector<uint32_t>(EXAMPLE_OBJECT_TYPE_COUNT, 0));
+    std::vector<size_t> badRecord(threads, SIZE_MAX);
+    LoaderRunParallel(threads, [&](unsigned int chunk) {
+        size_t end = std::min(recordCount, (chunk + 1) * chunkSize);
+        for (size_t offset = chunk * chunkSize; offset < end; offset++) {
+            ExamplePointFileRecord record;
+            memcpy(&record, records + offset * recordSize, sizeof(record));
+            if (record.objectType >= EXAMPLE_OBJECT_TYPE_COUNT || record.instance > EXAMPLE_OBJECT_INSTANCE_MASK || (uint64_t)record.nameOffset + record.nameLength > header.namesSize) {
+                badRecord[chunk] = offset;
+                return;
+            }
+            counts[chunk][record.objectType]++;
+        }
+    });
+    for (size_t offset : badRecord) {
+        if (offset != SIZE_MAX) {
+            std::cerr << "Error: Invalid record " << offset << " in point file [" << path << "]" << std::endl;
+            return false;
+        }
+    }
+    report->scanSeconds = LoaderSeconds(start);
+
+    // Fill: size every table once, then each chunk writes its records into
+    // rows no other chunk touches, so the threads need no locking
+    start = LoaderClock::now();
+    std::vector<uint16_t> objectTypes;
+    std::vector<uint32_t> firstRow(EXAMPLE_OBJECT_TYPE_COUNT, 0);
+    for (uint16_t objectType = 0; objectType < EXAMPLE_OBJECT_TYPE_COUNT; objectType++) {
+        size_t total = 0;
+        for (unsigned int chunk = 0; chunk < threads; chunk++) {
+            total += counts[chunk][objectType];
+        }
+        if (total == 0) {
+            continue;
+        }
+        ExampleObjectTable* table = store->GetOrCreateTable(objectType);
+        if (table == NULL || table->Size() + total > (size_t)EXAMPLE_OBJECT_INSTANCE_MASK + 1) {
+            std::cerr << "Error: Too many objects of objectType=[" << objectType << "] in point file [" << path << "]" << std::endl;
+            return false;
+        }
+        objectTypes.push_back(objectType);
+        firstRow[objectType] = (uint32_t)table->Size();
+        store->Reserve(objectType, total, 0);
+        table->Resize(table->Size() + total);
+    }
+
+    // Tables are not created past this point, so the pointers stay valid
+    std::vector<ExampleObjectTable*> tables(EXAMPLE_OBJECT_TYPE_COUNT, NULL);
+    std::vector<std::vector<uint32_t> > nextRow(threads, std::vector<uint32_t>(EXAMPLE_OBJECT_TYPE_COUNT, 0));
+    for (uint16_t objectType : objectTypes) {
+        tables[objectType] = store->GetTable(objectType);
+        uint32_t row = firstRow[objectType];
+        for (unsigned int chunk = 0; chunk < threads; chunk++) {
+            nextRow[chunk][objectType] = row;
+            row += counts[chunk][objectType];
+        }
+    }
+
+    const uint32_t namesBase = store->names.Add((const char*)file.GetData() + namesStart, header.namesSize);
+    LoaderRunParallel(threads, [&](unsigned int chunk) {
+        std::vector<uint32_t>& rows = nextRow[chunk];
+        size_t end = std::min(recordCount, (chunk + 1) * chunkSize);
+        for (size_t offset = chunk * chunkSize; offset < end; offset++) {
+            ExamplePointFileRecord record;
+            memcpy(&record, records + offset * recordSize, sizeof(record));
+            ExampleObjectTable* table = tables[record.objectType];
+            uint32_t row = rows[record.objectType]++;
+            table->instance[row] = record.instance;
+            table->presentValue[row] = record.presentValue;
+            table->covIncrement[row] = record.covIncrement;
+            table->reliability[row] = record.reliability;
+            table->nameOffset[row] = namesBase + record.nameOffset;
+            table->nameLength[row] = record.nameLength;
+            if (table->commandable) {
+                table->priorityArray[row].Initialize(record.presentValue);
+            }
+        }
+    });
+    report->fillSeconds = LoaderSeconds(start);
+
+    // Index
+    start = LoaderClock::now();
+    for (uint16_t objectType : objectTypes) {
+        if (!store->IndexRows(objectType, firstRow[objectType])) {
+            std::cerr << "Error: Duplicate object of objectType=[" << objectType << "] in point file [" << path << "]" << std::endl;
+            return false;
+        }
+    }
+    report->indexSeconds = LoaderSeconds(start);
+    report->objectCount = recordCount;
+    return true;
+}
+
+bool ExampleDatabaseLoader::Save(const std::string& path, const ExampleObjectStore& store) {
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error: Could not create point file [" << path << "]" << std::endl;
+        return false;
+    }
+
+    ExamplePointFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EXAMPLE_POINT_FILE_MAGIC, sizeof(header.magic));
+    header.version = EXAMPLE_POINT_FILE_VERSION;
+    header.recordCount = (uint32_t)store.GetObjectCount();
+    header.recordSize = sizeof(ExamplePointFileRecord);
+    header.namesSize = (uint32_t)store.names.GetSize();
+    file.write((const char*)&header, sizeof(header));
+
+    // Name offsets in the store are already offsets into the arena
+    for (const ExampleObjectTable& table : store.tables) {
+        for (size_t row = 0; row < table.Size(); row++) {
+            ExamplePointFileRecord record;
+            record.objectType = table.objectType;
+            record.nameLength = table.nameLength[row];
+            record.instance = table.instance[row];
+            record.presentValue = table.presentValue[row];
+            record.covIncrement = table.covIncrement[row];
+            record.reliability = table.reliability[row];
+            record.nameOffset = table.nameOffset[row];
+            file.write((const char*)&record, sizeof(record));
+        }
+    }
+    if (header.namesSize > 0) {
+        file.write(store.names.Get(0), header.namesSize);
+    }
+    return (bool)file;
+}
+
+// Split one CSV line. Fields may be quoted, "" is a quote inside a quoted field.
+static void LoaderSplitCSV(const std::string& line, std::vector<std::string>* fields) {
+    fields->clear();
+    std::string field;
+    bool quoted = false;
+    for (size_t offset = 0; offset < line.size(); offset++) {
+        char c = line[offset];
+        if (quoted) {
+            if (c == '"' && offset + 1 < line.size() && line[offset + 1] == '"') {
+                field += '"';
+                offset++;
+            }
+            else if (c == '"') {
+                quoted = false;
+            }
+            else {
+                field += c;
+            }
+        }
+        else if (c == '"') {
+            quoted = true;
+        }
+        else if (c == ',') {
+            fields->push_back(field);
+            field.clear();
+        }
+        else if (c != '\r') {
+            field += c;
+        }
+    }
+    fields->push_back(field);
+}
+
+bool ExampleDatabaseLoader::ImportCSV(const std::string& csvPath, const std::string& binaryPath, size_t* objectCount) {
+    std::ifstream csv(csvPath.c_str());
+    if (!csv) {
+        std::cerr << "Error: Could not open CSV file [" << csvPath << "]" << std::endl;
+        return false;
+    }
+
+    ExampleObjectStore store;
+    std::string line;
+    std::vector<std::string> fields;
+    size_t lineNumber = 0;
+    while (std::getline(csv, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#' || line[0] == '\r') {
+            continue;
+        }
+        LoaderSplitCSV(line, &fields);
+        if (lineNumber == 1 && !fields.empty() && (fields[0].empty() || !isdigit((unsigned char)fields[0][0]))) {
+            continue; // Column names
+        }
+        if (fields.size() != 6) {
+            std::cerr << "Error: Expected 6 columns on line " << lineNumber << " of [" << csvPath << "]" << std::endl;
+            return false;
+        }
+        try {
+            unsigned long objectType = std::stoul(fields[0]);
+            unsigned long instance = std::stoul(fields[1]);
+            if (objectType >= EXAMPLE_OBJECT_TYPE_COUNT || instance > EXAMPLE_OBJECT_INSTANCE_MASK) {
+                std::cerr << "Error: Invalid object identifier on line " << lineNumber << " of [" << csvPath << "]" << std::endl;
+                return false;
+            }
+            if (!store.Add((uint16_t)objectType, (uint32_t)instance, fields[2], std::stof(fields[3]), std::stof(fields[4]), (uint32_t)std::stoul(fields[5]))) {
+                std::cerr << "Error: Duplicate object on line " << lineNumber << " of [" << csvPath << "]" << std::endl;
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Error: Invalid number on line " << lineNumber << " of [" << csvPath << "]" << std::endl;
+            return false;
+        }
+    }
+
+    if (objectCount != NULL) {
+        *objectCount = store.GetObjectCount();
+    }
+    return ExampleDatabaseLoader::Save(binaryPath, store);
+}
@@ -0,0 +1,78 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleLoader.h
+ *
+ * Bulk load of the point database at startup.
+ *
+ * Points are kept in a compact binary file that is memory mapped and parsed
+ * straight into the object store columns by several threads. A CSV file can
+ * be converted to the binary format once with ImportCSV.
+ *
+ * Binary file layout (little endian):
+ *	ExamplePointFileHeader
+ *	ExamplePointFileRecord x recordCount, recordSize bytes each
+ *	Object names, namesSize bytes, referenced by record nameOffset
+ *
+ * CSV columns, one object per line, lines starting with # are skipped:
+ *	objectType,instance,objectName,presentValue,covIncrement,reliability
+ */
+
+#ifndef __CASBACnetSCExampleLoader_h__
+#define __CASBACnetSCExampleLoader_h__
+
+#include "CASBACnetSCExampleObjectStore.h"
+
+#include <stdint.h>
+#include <string>
+
+static const char EXAMPLE_POINT_FILE_MAGIC[8] = { 'C', 'A', 'S', 'P', 'O', 'I', 'N', 'T' };
+static const uint32_t EXAMPLE_POINT_FILE_VERSION = 1;
+
+struct ExamplePointFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t recordSize;    // Newer versions may append fields to a record
+    uint32_t namesSize;
+    uint64_t reserved;
+};
+
+struct ExamplePointFileRecord {
+    uint16_t objectType;
+    uint16_t nameLength;
+    uint32_t instance;
+    float presentValue;
+    float covIncrement;
+    uint32_t reliability;
+    uint32_t nameOffset;    // Offset into the names section
+};
+
+// Time spent in each phase of a load
+struct ExampleLoadReport {
+    size_t objectCount;
+    size_t fileBytes;
+    unsigned int threads;
+    double mapSeconds;      // Open and map the file
+    double scanSeconds;     // Validate records and count objects per type (parallel)
+    double fillSeconds;     // Copy records into the table columns (parallel)
+    double indexSeconds;    // Insert every object into the hash index
+
+    ExampleLoadReport();
+    void Print() const;
+};
+
+class ExampleDatabaseLoader {
+public:
+    // Add every object in a binary point file to the store.
+    // On failure the store may hold some of the objects and should be cleared.
+    static bool Load(const std::string& path, ExampleObjectStore* store, ExampleLoadReport* report);
+
+    // Write every object in the store to a binary point file
+    static bool Save(const std::string& path, const ExampleObjectStore& store);
+
+    // Convert a CSV file to a binary point file
+    static bool ImportCSV(const std::string& csvPath, const std::string& binaryPath, size_t* objectCount);
+};
+
+#endif // __CASBACnetSCExampleLoader_h__
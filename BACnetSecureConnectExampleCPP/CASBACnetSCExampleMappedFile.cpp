@@ -0,0 +1,171 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleMappedFile.cpp
+ *
+ * See CASBACnetSCExampleMappedFile.h
+ */
+
+#include "CASBACnetSCExampleMappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+ExampleMappedFile::ExampleMappedFile() {
+    this->data = NULL;
+    this->size = 0;
+    this->writable = false;
+#ifdef _WIN32
+    this->fileHandle = INVALID_HANDLE_VALUE;
+    this->mappingHandle = NULL;
+#else
+    this->fileDescriptor = -1;
+#endif // _WIN32
+}
+
+ExampleMappedFile::~ExampleMappedFile() {
+    this->Close();
+}
+
+bool ExampleMappedFile::Open(const std::string& path) {
+    this->Close();
+
+#ifdef _WIN32
+    this->fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (this->fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(this->fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        this->Close();
+        return false;
+    }
+    this->mappingHandle = CreateFileMappingA(this->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (this->mappingHandle == NULL) {
+        this->Close();
+        return false;
+    }
+    this->data = (uint8_t*)MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (this->data == NULL) {
+        this->Close();
+        return false;
+    }
+    this->size = (size_t)fileSize.QuadPart;
+#else
+    this->fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (this->fileDescriptor < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(this->fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+        this->Close();
+        return false;
+    }
+    void* mapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, this->fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        this->Close();
+        return false;
+    }
+    // The whole file is about to be read, start reading ahead now
+    madvise(mapping, (size_t)fileStat.st_size, MADV_WILLNEED);
+    this->data = (uint8_t*)mapping;
+    this->size = (size_t)fileStat.st_size;
+#endif // _WIN32
+    return true;
+}
+
+bool ExampleMappedFile::OpenWritable(const std::string& path, const size_t size) {
+    this->Close();
+    if (size == 0) {
+        return false;
+    }
+
+#ifdef _WIN32
+    this->fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (this->fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx(this->fileHandle, fileSize, NULL, FILE_BEGIN) || !SetEndOfFile(this->fileHandle)) {
+        this->Close();
+        return false;
+    }
+    this->mappingHandle = CreateFileMappingA(this->fileHandle, NULL, PAGE_READWRITE, 0, 0, NULL);
+    if (this->mappingHandle == NULL) {
+        this->Close();
+        return false;
+    }
+    this->data = (uint8_t*)MapViewOfFile(this->mappingHandle, FILE_MAP_WRITE, 0, 0, 0);
+    if (this->data == NULL) {
+        this->Close();
+        return false;
+    }
+#else
+    this->fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (this->fileDescriptor < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(this->fileDescriptor, &fileStat) != 0 || ((size_t)fileStat.st_size != size && ftruncate(this->fileDescriptor, (off_t)size) != 0)) {
+        this->Close();
+        return false;
+    }
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        this->Close();
+        return false;
+    }
+    this->data = (uint8_t*)mapping;
+#endif // _WIN32
+    this->size = size;
+    this->writable = true;
+    return true;
+}
+
+bool ExampleMappedFile::Flush(const size_t offset, const size_t length) {
+    if (!this->writable || offset + length > this->size) {
+        return false;
+    }
+#ifdef _WIN32
+    return FlushViewOfFile(this->data + offset, length) && FlushFileBuffers(this->fileHandle);
+#else
+    // msync needs a page aligned start
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset - offset % pageSize;
+    return msync(this->data + start, length + (offset - start), MS_SYNC) == 0;
+#endif // _WIN32
+}
+
+void ExampleMappedFile::Close() {
+#ifdef _WIN32
+    if (this->data != NULL) {
+        UnmapViewOfFile(this->data);
+    }
+    if (this->mappingHandle != NULL) {
+        CloseHandle(this->mappingHandle);
+    }
+    if (this->fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(this->fileHandle);
+    }
+    this->fileHandle = INVALID_HANDLE_VALUE;
+    this->mappingHandle = NULL;
+#else
+    if (this->data != NULL) {
+        munmap((void*)this->data, this->size);
+    }
+    if (this->fileDescriptor >= 0) {
+        close(this->fileDescriptor);
+    }
+    this->fileDescriptor = -1;
+#endif // _WIN32
+    this->data = NULL;
+    this->size = 0;
+    this->writable = false;
+}
@@ -0,0 +1,57 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleMappedFile.h
+ *
+ * Memory mapping of a whole file, for Windows and POSIX.
+ * Pages are loaded by the OS on first access, so opening a large file is
+ * cheap and several threads can read it at once without copying.
+ * A writable mapping is shared with the file; Flush writes changed pages
+ * back to disk and waits for them.
+ */
+
+#ifndef __CASBACnetSCExampleMappedFile_h__
+#define __CASBACnetSCExampleMappedFile_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class ExampleMappedFile {
+private:
+    uint8_t* data;
+    size_t size;
+    bool writable;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif // _WIN32
+
+    // Not copyable, the mapping is released in the destructor
+    ExampleMappedFile(const ExampleMappedFile&);
+    ExampleMappedFile& operator=(const ExampleMappedFile&);
+
+public:
+    ExampleMappedFile();
+    ~ExampleMappedFile();
+
+    // Map an existing file read only
+    bool Open(const std::string& path);
+
+    // Map a file read/write, creating it or changing its size to size bytes
+    bool OpenWritable(const std::string& path, const size_t size);
+
+    // Write the pages of [offset, offset + length) to disk and wait for them
+    bool Flush(const size_t offset, const size_t length);
+
+    void Close();
+
+    const uint8_t* GetData() const { return this->data; }
+    uint8_t* GetWritableData() const { return this->writable ? this->data : NULL; }
+    size_t GetSize() const { return this->size; }
+    bool IsOpen() const { return this->data != NULL; }
+};
+
+#endif // __CASBACnetSCExampleMappedFile_h__
@@ -0,0 +1,266 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleMetrics.cpp
+ *
+ * See CASBACnetSCExampleMetrics.h
+ */
+
+#include "CASBACnetSCExampleMetrics.h"
+#include "CASBACnetSCExampleBits.h"
+
+#include <stdio.h>
+
+static void MetricsAppendNumber(std::string* text, const double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.12g", value);
+    text->append(buffer);
+}
+
+static void MetricsAppendNumber(std::string* text, const uint64_t value) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)value);
+    text->append(buffer);
+}
+
+// name{labels} or name{labels,extra}
+static void MetricsAppendName(std::string* text, const std::string& name, const char* suffix, const std::string& labels, const std::string& extra) {
+    text->append(name);
+    text->append(suffix);
+    if (labels.empty() && extra.empty()) {
+        text->push_back(' ');
+        return;
+    }
+    text->push_back('{');
+    text->append(labels);
+    if (!labels.empty() && !extra.empty()) {
+        text->push_back(',');
+    }
+    text->append(extra);
+    text->append("} ");
+}
+
+//
+// ExampleMetricHistogram
+// ----------------------------------------------------------------------------
+
+ExampleMetricHistogram::ExampleMetricHistogram() : sum(0) {
+    for (uint32_t index = 0; index < BUCKET_COUNT; index++) {
+        this->buckets[index].store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t ExampleMetricHistogram::GetCount() const {
+    uint64_t count = 0;
+    for (uint32_t index = 0; index < BUCKET_COUNT; index++) {
+        count += this->GetBucket(index);
+    }
+    return count;
+}
+
+uint32_t ExampleMetricHistogram::GetBucketIndex(const uint64_t nanoseconds) {
+    if (nanoseconds <= ((uint64_t)1 << MIN_SHIFT)) {
+        return 0;
+    }
+    // Round up to the next power of two, so a value equal to a bound is counted in that bucket
+    uint32_t shift = ExampleHighestBit64(nanoseconds - 1) + 1;
+    return shift - MIN_SHIFT < BUCKET_COUNT - 1 ? shift - MIN_SHIFT : BUCKET_COUNT - 1;
+}
+
+double ExampleMetricHistogram::GetUpperBound(const uint32_t index) {
+    return (double)((uint64_t)1 << (MIN_SHIFT + index)) / 1e9;
+}
+
+//
+// ExampleMetricsRegistry
+// ----------------------------------------------------------------------------
+
+ExampleMetricsRegistry::Series* ExampleMetricsRegistry::find(const std::string& name, const std::string& help, const uint8_t type, const std::string& labels, bool* created) {
+    *created = false;
+    Family* family = NULL;
+    for (Family& existing : this->families) {
+        if (existing.name == name) {
+            family = &existing;
+            break;
+        }
+    }
+    if (family == NULL) {
+        this->families.push_back(Family());
+        family = &this->families.back();
+        family->name = name;
+        family->help = help;
+        family->type = type;
+    }
+    else if (family->type != type) {
+        return NULL;
+    }
+    for (Series& series : family->series) {
+        if (series.labels == labels) {
+            return &series;
+        }
+    }
+    Series series;
+    series.labels = labels;
+    series.metric = NULL;
+    family->series.push_back(series);
+    *created = true;
+    return &family->series.back();
+}
+
+ExampleMetricCounter* ExampleMetricsRegistry::AddCounter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    bool created;
+    Series* series = this->find(name, help, TYPE_COUNTER, labels, &created);
+    if (series == NULL) {
+        return NULL;
+    }
+    if (created) {
+        this->counters.emplace_back();
+        series->metric = &this->counters.back();
+    }
+    return (ExampleMetricCounter*)series->metric;
+}
+
+ExampleMetricGauge* ExampleMetricsRegistry::AddGauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    bool created;
+    Series* series = this->find(name, help, TYPE_GAUGE, labels, &created);
+    if (series == NULL) {
+        return NULL;
+    }
+    if (created) {
+        this->gauges.emplace_back();
+        series->metric = &this->gauges.back();
+    }
+    return (ExampleMetricGauge*)series->metric;
+}
+
+ExampleMetricHistogram* ExampleMetricsRegistry::AddHistogram(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    bool created;
+    Series* series = this->find(name, help, TYPE_HISTOGRAM, labels, &created);
+    if (series == NULL) {
+        return NULL;
+    }
+    if (created) {
+        this->histograms.emplace_back();
+        series->metric = &this->histograms.back();
+    }
+    return (ExampleMetricHistogram*)series->metric;
+}
+
+bool ExampleMetricsRegistry::AddFunction(const std::string& name, const std::string& help, const uint8_t type, const std::function<double()>& function, const std::string& labels) {
+    if (type == TYPE_HISTOGRAM) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    bool created;
+    Series* series = this->find(name, help, type, labels, &created);
+    if (series == NULL || series->metric != NULL) {
+        return false;
+    }
+    series->function = function;
+    return true;
+}
+
+void ExampleMetricsRegistry::AddConnection(const std::string& uri, ExampleConnectionMetrics* metrics) {
+    std::string labels = Label("uri", uri);
+    metrics->framesIn = this->AddCounter("bacnet_sc_frames_received_total", "Websocket frames received", labels);
+    metrics->framesOut = this->AddCounter("bacnet_sc_frames_sent_total", "Websocket frames sent", labels);
+    metrics->bytesIn = this->AddCounter("bacnet_sc_bytes_received_total", "Bytes of the websocket frames received", labels);
+    metrics->bytesOut = this->AddCounter("bacnet_sc_bytes_sent_total", "Bytes of the websocket frames sent", labels);
+    metrics->connects = this->AddCounter("bacnet_sc_connects_total", "Successful websocket connects", labels);
+    metrics->reconnects = this->AddCounter("bacnet_sc_reconnects_total", "Websocket connects after the first one", labels);
+    metrics->errors = this->AddCounter("bacnet_sc_errors_total", "Failed websocket connects, reads and writes", labels);
+    metrics->receiveQueueDepth = this->AddGauge("bacnet_sc_receive_queue_depth", "Frames received and not yet read by the CAS BACnet Stack", labels);
+    metrics->writeLatency = this->AddHistogram("bacnet_sc_write_duration_seconds", "Time to write one websocket frame", labels);
+    for (uint8_t reason = 0; reason < WS_DROP_REASON_COUNT; reason++) {
+        metrics->framesDropped[reason] = this->AddCounter("bacnet_sc_frames_dropped_total", "Frames received and dropped, by reason", labels + "," + Label("reason", WSDropCounters::GetReasonName(reason)));
+    }
+    for (uint8_t function = 0; function < BVLC_SC_FUNCTION_COUNT; function++) {
+        std::string functionLabels = labels + "," + Label("function", WSFrameView::GetFunctionName(function));
+        metrics->messagesIn[function] = this->AddCounter("bacnet_sc_bvlc_messages_received_total", "BVLC-SC messages received, by function", functionLabels);
+        metrics->messagesOut[function] = this->AddCounter("bacnet_sc_bvlc_messages_sent_total", "BVLC-SC messages sent, by function", functionLabels);
+    }
+    metrics->malformedIn = this->AddCounter("bacnet_sc_malformed_frames_received_total", "Frames received whose BVLC-SC header does not decode", labels);
+}
+
+void ExampleMetricsRegistry::Render(std::string* text) const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    static const char* const TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+    for (const Family& family : this->families) {
+        text->append("# HELP ");
+        text->append(family.name);
+        text->push_back(' ');
+        text->append(family.help);
+        text->append("\n# TYPE ");
+        text->append(family.name);
+        text->push_back(' ');
+        text->append(TYPE_NAMES[family.type]);
+        text->push_back('\n');
+
+        for (const Series& series : family.series) {
+            if (series.metric == NULL) {
+                MetricsAppendName(text, family.name, "", series.labels, "");
+                MetricsAppendNumber(text, series.function());
+            }
+            else if (family.type == TYPE_COUNTER) {
+                MetricsAppendName(text, family.name, "", series.labels, "");
+                MetricsAppendNumber(text, ((const ExampleMetricCounter*)series.metric)->Get());
+            }
+            else if (family.type == TYPE_GAUGE) {
+                MetricsAppendName(text, family.name, "", series.labels, "");
+                MetricsAppendNumber(text, (double)((const ExampleMetricGauge*)series.metric)->Get());
+            }
+            else {
+                // Buckets are cumulative in the text format
+                const ExampleMetricHistogram* histogram = (const ExampleMetricHistogram*)series.metric;
+                uint64_t count = 0;
+                for (uint32_t index = 0; index < ExampleMetricHistogram::BUCKET_COUNT; index++) {
+                    count += histogram->GetBucket(index);
+                    std::string bound = "+Inf";
+                    if (index < ExampleMetricHistogram::BUCKET_COUNT - 1) {
+                        bound.clear();
+                        MetricsAppendNumber(&bound, ExampleMetricHistogram::GetUpperBound(index));
+                    }
+                    MetricsAppendName(text, family.name, "_bucket", series.labels, Label("le", bound));
+                    MetricsAppendNumber(text, count);
+                    text->push_back('\n');
+                }
+                MetricsAppendName(text, family.name, "_sum", series.labels, "");
+                MetricsAppendNumber(text, (double)histogram->GetSum() / 1e9);
+                text->push_back('\n');
+                MetricsAppendName(text, family.name, "_count", series.labels, "");
+                MetricsAppendNumber(text, count);
+            }
+            text->push_back('\n');
+        }
+    }
+}
+
+size_t ExampleMetricsRegistry::GetSeriesCount() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    size_t count = 0;
+    for (const Family& family : this->families) {
+        count += family.series.size();
+    }
+    return count;
+}
+
+std::string ExampleMetricsRegistry::Label(const std::string& name, const std::string& value) {
+    std::string label = name + "=\"";
+    for (char character : value) {
+        if (character == '\\' || character == '"') {
+            label.push_back('\\');
+            label.push_back(character);
+        }
+        else if (character == '\n') {
+            label.append("\\n");
+        }
+        else {
+            label.push_back(character);
+        }
+    }
+    label.push_back('"');
+    return label;
+}
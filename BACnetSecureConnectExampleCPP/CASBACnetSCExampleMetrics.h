@@ -0,0 +1,156 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleMetrics.h
+ *
+ * Metrics registry for the transport and the main loop, rendered in the
+ * Prometheus text format by ExampleMetricsServer.
+ *
+ * Counters, gauges and histograms are plain atomics updated with relaxed
+ * operations, so recording a value from the main loop or a websocket thread
+ * never takes a lock. The registry lock is only taken to register a metric
+ * and to render the text, which happens when the endpoint is scraped.
+ *
+ * Histograms have fixed power of two buckets on a nanosecond scale, from
+ * about 1 microsecond to 17 seconds. Finding the bucket is one bit scan and
+ * an observation is two atomic adds, the count is the sum of the buckets.
+ */
+
+#ifndef __CASBACnetSCExampleMetrics_h__
+#define __CASBACnetSCExampleMetrics_h__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "WSFrameView.h"
+#include "WSQueue.h"
+
+class ExampleMetricCounter {
+private:
+    std::atomic<uint64_t> value;
+
+public:
+    ExampleMetricCounter() : value(0) {}
+
+    void Add(const uint64_t count = 1) { this->value.fetch_add(count, std::memory_order_relaxed); }
+    uint64_t Get() const { return this->value.load(std::memory_order_relaxed); }
+};
+
+class ExampleMetricGauge {
+private:
+    std::atomic<int64_t> value;
+
+public:
+    ExampleMetricGauge() : value(0) {}
+
+    void Set(const int64_t value) { this->value.store(value, std::memory_order_relaxed); }
+    void Add(const int64_t delta) { this->value.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t Get() const { return this->value.load(std::memory_order_relaxed); }
+};
+
+class ExampleMetricHistogram {
+public:
+    // Bucket 0 holds values up to 2^MIN_SHIFT nanoseconds, bucket n up to
+    // 2^(MIN_SHIFT + n). The last bucket is +Inf.
+    static const uint32_t MIN_SHIFT = 10;
+    static const uint32_t BUCKET_COUNT = 26;
+
+private:
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> sum;      // Nanoseconds
+
+public:
+    ExampleMetricHistogram();
+
+    void Observe(const uint64_t nanoseconds) {
+        this->buckets[GetBucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        this->sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    uint64_t GetBucket(const uint32_t index) const { return this->buckets[index].load(std::memory_order_relaxed); }
+    uint64_t GetCount() const;
+    uint64_t GetSum() const { return this->sum.load(std::memory_order_relaxed); }
+
+    static uint32_t GetBucketIndex(const uint64_t nanoseconds);
+    // Upper bound of a bucket in seconds, the le label
+    static double GetUpperBound(const uint32_t index);
+};
+
+// The metrics of one websocket connection, labeled with its uri. They are
+// kept when the connection is removed, so the counters continue over a reconnect.
+struct ExampleConnectionMetrics {
+    ExampleMetricCounter* framesIn;
+    ExampleMetricCounter* framesOut;
+    ExampleMetricCounter* bytesIn;
+    ExampleMetricCounter* bytesOut;
+    ExampleMetricCounter* connects;
+    ExampleMetricCounter* reconnects;
+    ExampleMetricCounter* errors;
+    ExampleMetricGauge* receiveQueueDepth;      // Messages received but not yet read by the CAS BACnet Stack
+    ExampleMetricHistogram* writeLatency;       // SendWSMessage until the write completed
+    ExampleMetricCounter* framesDropped[WS_DROP_REASON_COUNT];     // By WS_DROP_* reason
+    ExampleMetricCounter* messagesIn[BVLC_SC_FUNCTION_COUNT];     // By BVLC-SC function, see WSFrameView
+    ExampleMetricCounter* messagesOut[BVLC_SC_FUNCTION_COUNT];
+    ExampleMetricCounter* malformedIn;          // Header that does not decode, or an unknown function
+};
+
+class ExampleMetricsRegistry {
+public:
+    static const uint8_t TYPE_COUNTER = 0;
+    static const uint8_t TYPE_GAUGE = 1;
+    static const uint8_t TYPE_HISTOGRAM = 2;
+
+private:
+    struct Series {
+        std::string labels;     // Rendered, e.g. uri="wss://host:4443/"
+        void* metric;
+        std::function<double()> function;   // Sampled when rendered, when metric is NULL
+    };
+    struct Family {
+        std::string name;
+        std::string help;
+        uint8_t type;
+        std::vector<Series> series;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Family> families;
+
+    // Deques so the metrics do not move when more are registered
+    std::deque<ExampleMetricCounter> counters;
+    std::deque<ExampleMetricGauge> gauges;
+    std::deque<ExampleMetricHistogram> histograms;
+
+    // Returns the series, NULL if the name is registered with another type
+    Series* find(const std::string& name, const std::string& help, const uint8_t type, const std::string& labels, bool* created);
+
+public:
+    // Register a metric, or return the one already registered with this name
+    // and labels. Labels are name/value pairs, see Label(). Returns NULL if
+    // the name is already used by a metric of another type.
+    ExampleMetricCounter* AddCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+    ExampleMetricGauge* AddGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    ExampleMetricHistogram* AddHistogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    // A counter or gauge owned by someone else, read when rendered. The
+    // function is called on the thread that renders and must be thread safe.
+    bool AddFunction(const std::string& name, const std::string& help, const uint8_t type, const std::function<double()>& function, const std::string& labels = "");
+
+    // Per-connection metrics, see ExampleConnectionMetrics
+    void AddConnection(const std::string& uri, ExampleConnectionMetrics* metrics);
+
+    // Append all the metrics in the Prometheus text exposition format (version 0.0.4)
+    void Render(std::string* text) const;
+
+    size_t GetSeriesCount() const;
+
+    // name="value" with the value escaped
+    static std::string Label(const std::string& name, const std::string& value);
+};
+
+#endif // __CASBACnetSCExampleMetrics_h__
@@ -0,0 +1,154 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleMetricsServer.cpp
+ *
+ * See CASBACnetSCExampleMetricsServer.h
+ */
+
+#include "CASBACnetSCExampleMetricsServer.h"
+
+// Time allowed for a client to send its request and read the response
+static const uint32_t METRICS_SESSION_TIMEOUT_SECONDS = 10;
+
+//
+// ExampleMetricsSession
+// ----------------------------------------------------------------------------
+// One scrape: read the request, write the response, close.
+class ExampleMetricsSession : public std::enable_shared_from_this<ExampleMetricsSession> {
+private:
+    ExampleMetricsServer* server;
+    beast::tcp_stream stream;
+    beast::flat_buffer buffer;
+    http::request<http::string_body> request;
+    http::response<http::string_body> response;
+
+    void onRead(beast::error_code errorCode, std::size_t) {
+        if (errorCode) {
+            return; // Closed or timed out, the stream closes with the session
+        }
+        this->server->requests.fetch_add(1, std::memory_order_relaxed);
+
+        this->response.version(this->request.version());
+        this->response.keep_alive(false);
+        if (this->request.method() != http::verb::get && this->request.method() != http::verb::head) {
+            this->response.result(http::status::method_not_allowed);
+        }
+        else if (this->server->Handle(std::string(this->request.target()), &this->response.body())) {
+            this->response.result(http::status::ok);
+            this->response.set(http::field::content_type, "text/plain; version=0.0.4; charset=utf-8");
+        }
+        else {
+            this->response.result(http::status::not_found);
+        }
+        this->response.prepare_payload();
+        if (this->request.method() == http::verb::head) {
+            this->response.body().clear();
+        }
+
+        http::async_write(this->stream, this->response, beast::bind_front_handler(&ExampleMetricsSession::onWrite, shared_from_this()));
+    }
+
+    void onWrite(beast::error_code, std::size_t) {
+        beast::error_code ignored;
+        this->stream.socket().shutdown(tcp::socket::shutdown_send, ignored);
+    }
+
+public:
+    ExampleMetricsSession(ExampleMetricsServer* server, tcp::socket&& socket) : server(server), stream(std::move(socket)) {}
+
+    void run() {
+        this->stream.expires_after(std::chrono::seconds(METRICS_SESSION_TIMEOUT_SECONDS));
+        http::async_read(this->stream, this->buffer, this->request, beast::bind_front_handler(&ExampleMetricsSession::onRead, shared_from_this()));
+    }
+};
+
+//
+// ExampleMetricsServer
+// ----------------------------------------------------------------------------
+
+ExampleMetricsServer::ExampleMetricsServer() {
+    this->registry = NULL;
+    this->requests = 0;
+}
+
+ExampleMetricsServer::~ExampleMetricsServer() {
+    this->Stop();
+}
+
+bool ExampleMetricsServer::Start(const std::string& address, const uint16_t port, const ExampleMetricsRegistry* registry) {
+    this->registry = registry;
+    try {
+        tcp::endpoint endpoint(net::ip::make_address(address), port);
+        this->acceptor = std::make_shared<tcp::acceptor>(net::make_strand(this->ioc));
+        this->acceptor->open(endpoint.protocol());
+        this->acceptor->set_option(net::socket_base::reuse_address(true));
+        this->acceptor->bind(endpoint);
+        this->acceptor->listen(net::socket_base::max_listen_connections);
+    }
+    catch (std::exception const& e) {
+        std::cout << "Error: ExampleMetricsServer::Start() - " << e.what() << std::endl;
+        return false;
+    }
+
+    this->doAccept();
+    this->thread = std::thread([this] {
+        try {
+            this->ioc.run();
+        }
+        catch (std::exception& e) {
+            std::cout << "DEBUG: ExampleMetricsServer ioc.run() EXCEPTION - " << e.what() << std::endl;
+        }
+    });
+    return true;
+}
+
+void ExampleMetricsServer::Stop() {
+    if (!this->thread.joinable()) {
+        return;
+    }
+
+    net::post(this->ioc, [this] {
+        beast::error_code errorCode;
+        if (this->acceptor) {
+            this->acceptor->close(errorCode);
+        }
+        this->ioc.stop();
+    });
+    this->thread.join();
+}
+
+uint16_t ExampleMetricsServer::GetPort() {
+    if (!this->acceptor) {
+        return 0;
+    }
+    return this->acceptor->local_endpoint().port();
+}
+
+bool ExampleMetricsServer::Handle(const std::string& target, std::string* body) {
+    // Ignore a query string, Prometheus may add one
+    if (target.compare(0, target.find('?'), "/metrics") != 0 || this->registry == NULL) {
+        return false;
+    }
+    body->reserve(this->registry->GetSeriesCount() * 128);
+    this->registry->Render(body);
+    return true;
+}
+
+void ExampleMetricsServer::doAccept() {
+    this->acceptor->async_accept(net::make_strand(this->ioc), beast::bind_front_handler(&ExampleMetricsServer::onAccept, this));
+}
+
+void ExampleMetricsServer::onAccept(beast::error_code errorCode, tcp::socket socket) {
+    if (errorCode) {
+        if (errorCode == net::error::operation_aborted) {
+            return; // Server stopped
+        }
+        std::cout << "ExampleMetricsServer: accept failed errorCode=" << errorCode << std::endl;
+    }
+    else {
+        std::make_shared<ExampleMetricsSession>(this, std::move(socket))->run();
+    }
+
+    this->doAccept();
+}
@@ -0,0 +1,53 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleMetricsServer.h
+ *
+ * Serves an ExampleMetricsRegistry over HTTP for Prometheus to scrape.
+ * GET /metrics returns the text format, anything else a 404. Each request
+ * is answered on its own connection, which is then closed.
+ *
+ * Like WSHubFunction, the server runs on one io_context thread of its own,
+ * so a scrape never waits on the main loop or a websocket connection.
+ * Rendering holds the registry lock but never blocks the metrics updates.
+ */
+
+#ifndef __CASBACnetSCExampleMetricsServer_h__
+#define __CASBACnetSCExampleMetricsServer_h__
+
+#include "CASBACnetSCExampleMetrics.h"
+#include "WSClient.h"
+
+#include <boost/beast/http.hpp>
+
+#include <memory>
+#include <thread>
+
+class ExampleMetricsServer {
+private:
+    net::io_context ioc;
+    net::executor_work_guard<boost::asio::io_context::executor_type> iocWorkGuard = boost::asio::make_work_guard(ioc);
+    std::shared_ptr<tcp::acceptor> acceptor;
+    std::thread thread;
+    const ExampleMetricsRegistry* registry;
+
+    void doAccept();
+    void onAccept(beast::error_code errorCode, tcp::socket socket);
+
+public:
+    // Statistics
+    std::atomic<uint64_t> requests;
+
+    ExampleMetricsServer();
+    ~ExampleMetricsServer();
+
+    // Start listening. Use port 0 for any free port, see GetPort().
+    bool Start(const std::string& address, const uint16_t port, const ExampleMetricsRegistry* registry);
+    void Stop();
+    uint16_t GetPort();
+
+    // Response body for a request target, false for a 404. Called on the server thread.
+    bool Handle(const std::string& target, std::string* body);
+};
+
+#endif // __CASBACnetSCExampleMetricsServer_h__
@@ -0,0 +1,389 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleObjectStore.cpp
+ *
+ * See CASBACnetSCExampleObjectStore.h
+ */
+
+#include "CASBACnetSCExampleObjectStore.h"
+
+#include <algorithm>
+#include <string.h>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EXAMPLE_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define EXAMPLE_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define EXAMPLE_PREFETCH(address)
+#endif
+
+//
+// ExampleStringArena
+// ----------------------------------------------------------------------------
+
+uint32_t ExampleStringArena::Add(const char* value, const uint32_t length) {
+    uint32_t offset = (uint32_t)this->data.size();
+    this->data.insert(this->data.end(), value, value + length);
+    return offset;
+}
+
+//
+// ExampleObjectTable
+// ----------------------------------------------------------------------------
+
+ExampleObjectTable::ExampleObjectTable(const uint16_t objectType) {
+    this->objectType = objectType;
+    this->commandable = ExampleIsCommandable(objectType);
+}
+
+uint32_t ExampleObjectTable::Add(const uint32_t instance, const uint32_t nameOffset, const uint16_t nameLength) {
+    uint32_t row = (uint32_t)this->instance.size();
+    this->instance.push_back(instance);
+    this->presentValue.push_back(0.0f);
+    this->reliability.push_back(0);
+    this->covIncrement.push_back(0.0f);
+    this->nameOffset.push_back(nameOffset);
+    this->nameLength.push_back(nameLength);
+    if (this->commandable) {
+        ExamplePriorityArray priorityArray;
+        priorityArray.Initialize(0.0f);
+        this->priorityArray.push_back(priorityArray);
+    }
+    if (row % ROWS_PER_LOCK == 0) {
+        this->sequence.push_back(ExampleSeqLock());
+    }
+    if (row % 64 == 0) {
+        this->updated.push_back(0);
+    }
+    if (row % (64 * 64) == 0) {
+        this->updatedSummary.push_back(0);
+    }
+    return row;
+}
+
+void ExampleObjectTable::Store(const uint32_t row, const float presentValue, const uint32_t reliability) {
+    ExampleSeqLock& lock = this->sequence[row / ROWS_PER_LOCK];
+    lock.WriteLock();
+    this->presentValue[row].Store(presentValue);
+    this->reliability[row].Store(reliability);
+    lock.WriteUnlock();
+
+    // Only write the bit if it is not set yet, a set bit leaves the cache line shared
+    std::atomic<uint64_t>& word = this->updated[row >> 6].Get();
+    const uint64_t bit = (uint64_t)1 << (row & 63);
+    if ((word.load(std::memory_order_relaxed) & bit) == 0) {
+        // The first bit since the last drain also marks the word in the
+        // summary. A drain that cleared the summary before this still finds
+        // the word on the next flush.
+        if (word.fetch_or(bit, std::memory_order_release) == 0) {
+            std::atomic<uint64_t>& summary = this->updatedSummary[row >> 12].Get();
+            summary.fetch_or((uint64_t)1 << ((row >> 6) & 63), std::memory_order_release);
+        }
+    }
+}
+
+void ExampleObjectTable::StorePresentValue(const uint32_t row, const float presentValue) {
+    ExampleSeqLock& lock = this->sequence[row / ROWS_PER_LOCK];
+    lock.WriteLock();
+    this->presentValue[row].Store(presentValue);
+    lock.WriteUnlock();
+}
+
+void ExampleObjectTable::Load(const uint32_t row, float* presentValue, uint32_t* reliability) const {
+    const ExampleSeqLock& lock = this->sequence[row / ROWS_PER_LOCK];
+    uint32_t begin;
+    do {
+        begin = lock.ReadBegin();
+        *presentValue = this->presentValue[row].Load();
+        *reliability = this->reliability[row].Load();
+    } while (lock.ReadRetry(begin));
+}
+
+void ExampleObjectTable::Prefetch(const uint32_t row) const {
+    EXAMPLE_PREFETCH(&this->presentValue[row]);
+    EXAMPLE_PREFETCH(&this->reliability[row]);
+    EXAMPLE_PREFETCH(&this->covIncrement[row]);
+    EXAMPLE_PREFETCH(&this->nameOffset[row]);
+    EXAMPLE_PREFETCH(&this->nameLength[row]);
+    EXAMPLE_PREFETCH(&this->sequence[row / ROWS_PER_LOCK]);
+}
+
+void ExampleObjectTable::Reserve(const size_t count) {
+    this->instance.reserve(count);
+    this->presentValue.reserve(count);
+    this->reliability.reserve(count);
+    this->covIncrement.reserve(count);
+    this->nameOffset.reserve(count);
+    this->nameLength.reserve(count);
+    if (this->commandable) {
+        this->priorityArray.reserve(count);
+    }
+    this->sequence.reserve((count + ROWS_PER_LOCK - 1) / ROWS_PER_LOCK);
+    this->updated.reserve((count + 63) / 64);
+    this->updatedSummary.reserve((count + 64 * 64 - 1) / (64 * 64));
+}
+
+void ExampleObjectTable::Resize(const size_t count) {
+    this->instance.resize(count);
+    this->presentValue.resize(count);
+    this->reliability.resize(count);
+    this->covIncrement.resize(count);
+    this->nameOffset.resize(count);
+    this->nameLength.resize(count);
+    if (this->commandable) {
+        ExamplePriorityArray priorityArray;
+        priorityArray.Initialize(0.0f);
+        this->priorityArray.resize(count, priorityArray);
+    }
+    this->sequence.resize((count + ROWS_PER_LOCK - 1) / ROWS_PER_LOCK);
+    this->updated.resize((count + 63) / 64);
+    this->updatedSummary.resize((count + 64 * 64 - 1) / (64 * 64));
+}
+
+size_t ExampleObjectTable::GetMemoryUsage() const {
+    return this->instance.capacity() * sizeof(uint32_t) +
+        this->presentValue.capacity() * sizeof(ExampleAtomicFloat) +
+        this->reliability.capacity() * sizeof(ExampleAtomicUInt32) +
+        this->covIncrement.capacity() * sizeof(float) +
+        this->nameOffset.capacity() * sizeof(uint32_t) +
+        this->nameLength.capacity() * sizeof(uint16_t) +
+        this->priorityArray.capacity() * sizeof(ExamplePriorityArray) +
+        this->sequence.capacity() * sizeof(ExampleSeqLock) +
+        this->updated.capacity() * sizeof(ExampleAtomicUInt64) +
+        this->updatedSummary.capacity() * sizeof(ExampleAtomicUInt64);
+}
+
+//
+// ExampleObjectIndex
+// ----------------------------------------------------------------------------
+
+ExampleObjectIndex::ExampleObjectIndex() {
+    this->count = 0;
+    this->mask = 0;
+    this->shift = 32;
+    this->Reserve(16);
+}
+
+void ExampleObjectIndex::Reserve(const size_t count) {
+    // Keep the load factor at or below 0.5
+    size_t capacity = 16;
+    uint8_t bits = 4;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+        bits++;
+    }
+    if (capacity <= this->slots.size()) {
+        return;
+    }
+
+    std::vector<Slot> previous;
+    previous.swap(this->slots);
+    Slot empty = { 0, EMPTY_LOCATION };
+    this->slots.assign(capacity, empty);
+    this->mask = (uint32_t)(capacity - 1);
+    this->shift = (uint8_t)(32 - bits);
+    this->count = 0;
+
+    for (const Slot& slot : previous) {
+        if (slot.location != EMPTY_LOCATION) {
+            this->Insert(slot.key, slot.location);
+        }
+    }
+}
+
+void ExampleObjectIndex::grow() {
+    this->Reserve(this->slots.size());
+}
+
+bool ExampleObjectIndex::Insert(const uint32_t key, const uint32_t location) {
+    if (location == EMPTY_LOCATION) {
+        return false;
+    }
+    if ((this->count + 1) * 2 > this->slots.size()) {
+        this->grow();
+    }
+
+    uint32_t position = this->hash(key);
+    for (;;) {
+        Slot& slot = this->slots[position];
+        if (slot.location == EMPTY_LOCATION) {
+            slot.key = key;
+            slot.location = location;
+            this->count++;
+            return true;
+        }
+        if (slot.key == key) {
+            return false; // Already exists
+        }
+        position = (position + 1) & this->mask;
+    }
+}
+
+bool ExampleObjectIndex::Find(const uint32_t key, uint32_t* location) const {
+    uint32_t position = this->hash(key);
+    for (;;) {
+        const Slot& slot = this->slots[position];
+        if (slot.location == EMPTY_LOCATION) {
+            return false;
+        }
+        if (slot.key == key) {
+            *location = slot.location;
+            return true;
+        }
+        position = (position + 1) & this->mask;
+    }
+}
+
+void ExampleObjectIndex::Clear() {
+    Slot empty = { 0, EMPTY_LOCATION };
+    std::fill(this->slots.begin(), this->slots.end(), empty);
+    this->count = 0;
+}
+
+//
+// ExampleObjectStore
+// ----------------------------------------------------------------------------
+
+ExampleObjectStore::ExampleObjectStore() {
+    memset(this->tableForType, NO_TABLE, sizeof(this->tableForType));
+    this->generation = 1;
+}
+
+ExampleObjectTable* ExampleObjectStore::GetTable(const uint16_t objectType) {
+    if (objectType >= EXAMPLE_OBJECT_TYPE_COUNT || this->tableForType[objectType] == NO_TABLE) {
+        return NULL;
+    }
+    return &this->tables[this->tableForType[objectType]];
+}
+
+ExampleObjectTable* ExampleObjectStore::GetOrCreateTable(const uint16_t objectType) {
+    if (objectType >= EXAMPLE_OBJECT_TYPE_COUNT) {
+        return NULL;
+    }
+    if (this->tableForType[objectType] == NO_TABLE) {
+        if (this->tables.size() >= NO_TABLE) {
+            return NULL; // Out of table slots
+        }
+        this->tableForType[objectType] = (uint8_t)this->tables.size();
+        this->tables.push_back(ExampleObjectTable(objectType));
+    }
+    return &this->tables[this->tableForType[objectType]];
+}
+
+void ExampleObjectStore::Reserve(const uint16_t objectType, const size_t count, const size_t nameBytes) {
+    ExampleObjectTable* table = this->GetOrCreateTable(objectType);
+    if (table == NULL) {
+        return;
+    }
+    table->Reserve(table->Size() + count);
+    this->index.Reserve(this->index.Size() + count);
+    this->names.Reserve(this->names.GetSize() + nameBytes);
+}
+
+bool ExampleObjectStore::Add(const uint16_t objectType, const uint32_t instance, const std::string& objectName, const float presentValue, const float covIncrement, const uint32_t reliability) {
+    if (instance > EXAMPLE_OBJECT_INSTANCE_MASK) {
+        return false; // Would alias another object, the key keeps 22 bits
+    }
+    ExampleObjectTable* table = this->GetOrCreateTable(objectType);
+    if (table == NULL || table->Size() > ROW_MASK) {
+        return false;
+    }
+
+    uint32_t row = (uint32_t)table->Size();
+    uint32_t location = ((uint32_t)this->tableForType[objectType] << 24) | row;
+    if (!this->index.Insert(ExampleObjectKey(objectType, instance), location)) {
+        return false; // Already exists
+    }
+
+    this->generation++;
+    uint16_t nameLength = (uint16_t)std::min<size_t>(objectName.size(), 0xFFFF);
+    uint32_t nameOffset = this->names.Add(objectName.c_str(), nameLength);
+    table->Add(instance, nameOffset, nameLength);
+    table->presentValue[row] = presentValue;
+    table->covIncrement[row] = covIncrement;
+    table->reliability[row] = reliability;
+    if (table->commandable) {
+        // Nothing commanded yet, so the present value is the Relinquish_Default
+        table->priorityArray[row].Initialize(presentValue);
+    }
+    return true;
+}
+
+bool ExampleObjectStore::IndexRows(const uint16_t objectType, const uint32_t firstRow) {
+    ExampleObjectTable* table = this->GetTable(objectType);
+    if (table == NULL || table->Size() > (size_t)ROW_MASK + 1) {
+        return false;
+    }
+    uint32_t location = (uint32_t)this->tableForType[objectType] << 24;
+    this->generation++;
+    this->index.Reserve(this->index.Size() + (table->Size() - firstRow));
+    for (uint32_t row = firstRow; row < table->Size(); row++) {
+        if (table->instance[row] > EXAMPLE_OBJECT_INSTANCE_MASK) {
+            return false;
+        }
+        if (!this->index.Insert(ExampleObjectKey(objectType, table->instance[row]), location | row)) {
+            return false; // Already exists
+        }
+    }
+    return true;
+}
+
+bool ExampleObjectStore::Find(const uint16_t objectType, const uint32_t instance, ExampleObjectTable** table, uint32_t* row) {
+    uint32_t location;
+    if (objectType >= EXAMPLE_OBJECT_TYPE_COUNT || instance > EXAMPLE_OBJECT_INSTANCE_MASK || !this->index.Find(ExampleObjectKey(objectType, instance), &location)) {
+        return false;
+    }
+    *table = &this->tables[location >> 24];
+    *row = location & ROW_MASK;
+    return true;
+}
+
+bool ExampleObjectStore::Find(const uint16_t objectType, const uint32_t instance, ExampleObjectCache* cache, ExampleObjectTable** table, uint32_t* row) {
+    if (objectType >= EXAMPLE_OBJECT_TYPE_COUNT || instance > EXAMPLE_OBJECT_INSTANCE_MASK) {
+        return false;
+    }
+    const uint32_t key = ExampleObjectKey(objectType, instance);
+    if (cache->key != key || cache->generation != this->generation) {
+        uint32_t location;
+        if (!this->index.Find(key, &location)) {
+            return false;
+        }
+        cache->key = key;
+        cache->location = location;
+        cache->generation = this->generation;
+    }
+    *table = &this->tables[cache->location >> 24];
+    *row = cache->location & ROW_MASK;
+    return true;
+}
+
+const char* ExampleObjectStore::GetObjectName(const ExampleObjectTable* table, const uint32_t row, uint32_t* length) const {
+    *length = table->nameLength[row];
+    return this->names.Get(table->nameOffset[row]);
+}
+
+void ExampleObjectStore::PrefetchName(const ExampleObjectCache& cache) const {
+    if (cache.generation != this->generation) {
+        return; // Not found, or found before the store changed
+    }
+    const ExampleObjectTable& table = this->tables[cache.location >> 24];
+    EXAMPLE_PREFETCH(this->names.Get(table.nameOffset[cache.location & ROW_MASK]));
+}
+
+size_t ExampleObjectStore::GetMemoryUsage() const {
+    size_t bytes = this->index.GetMemoryUsage() + this->names.GetSize();
+    for (const ExampleObjectTable& table : this->tables) {
+        bytes += table.GetMemoryUsage();
+    }
+    return bytes;
+}
+
+void ExampleObjectStore::Clear() {
+    this->tables.clear();
+    this->names.Clear();
+    this->index.Clear();
+    this->generation++;
+    memset(this->tableForType, NO_TABLE, sizeof(this->tableForType));
+}
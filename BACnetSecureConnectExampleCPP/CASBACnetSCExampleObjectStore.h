@@ -0,0 +1,217 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleObjectStore.h
+ *
+ * The ExampleObjectStore holds the point database for large sites.
+ *
+ * Objects of one type are stored in an ExampleObjectTable, one dense array per
+ * property (struct-of-arrays), so scanning a single property touches only that
+ * property's memory. Object names are stored back to back in a string arena.
+ *
+ * Lookups by (objectType, instance) go through an open addressing hash index
+ * that maps the BACnet object identifier to a (table, row) location, so the
+ * property callbacks take the same time for 1 or 1,000,000 objects.
+ *
+ * Commandable object types (outputs and values) also have a Priority_Array
+ * column; their present value is the effective value of that array, kept up
+ * to date by whoever commands it. See CASBACnetSCExamplePriorityArray.h
+ *
+ * Present value and reliability may be written by field I/O threads with
+ * ExampleObjectTable::Store while the stack thread reads them, see
+ * CASBACnetSCExampleSeqLock.h. Names, instances and the index are only
+ * changed before those threads start.
+ */
+
+#ifndef __CASBACnetSCExampleObjectStore_h__
+#define __CASBACnetSCExampleObjectStore_h__
+
+#include "CASBACnetSCExamplePriorityArray.h"
+#include "CASBACnetSCExampleSeqLock.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// BACnet object identifier: 10 bit object type, 22 bit instance
+static const uint32_t EXAMPLE_OBJECT_INSTANCE_MASK = 0x3FFFFF;
+static const uint16_t EXAMPLE_OBJECT_TYPE_COUNT = 1024;
+
+inline uint32_t ExampleObjectKey(const uint16_t objectType, const uint32_t instance) {
+    return ((uint32_t)objectType << 22) | (instance & EXAMPLE_OBJECT_INSTANCE_MASK);
+}
+
+//
+// ExampleStringArena
+// ----------------------------------------------------------------------------
+// All strings in one contiguous buffer, referenced by offset.
+class ExampleStringArena {
+private:
+    std::vector<char> data;
+
+public:
+    uint32_t Add(const char* value, const uint32_t length);
+    const char* Get(const uint32_t offset) const { return this->data.data() + offset; }
+    void Reserve(const size_t bytes) { this->data.reserve(bytes); }
+    void Clear() { this->data.clear(); }
+    size_t GetSize() const { return this->data.size(); }
+};
+
+//
+// ExampleObjectTable
+// ----------------------------------------------------------------------------
+// Dense, struct-of-arrays storage for all objects of one type.
+// A row is the position of an object in every one of the arrays.
+class ExampleObjectTable {
+public:
+    // One seqlock per cache line of present values
+    static const uint32_t ROWS_PER_LOCK = 16;
+
+    uint16_t objectType;
+    bool commandable;
+
+    std::vector<uint32_t> instance;
+    std::vector<ExampleAtomicFloat> presentValue;
+    std::vector<ExampleAtomicUInt32> reliability;   // no-fault-detected (0), unreliable-other (7)
+    std::vector<float> covIncrement;
+    std::vector<uint32_t> nameOffset;               // Offset into ExampleObjectStore::names
+    std::vector<uint16_t> nameLength;
+    std::vector<ExamplePriorityArray> priorityArray;    // Empty unless commandable
+
+    // Guards presentValue and reliability of ROWS_PER_LOCK rows
+    std::vector<ExampleSeqLock> sequence;
+    // One bit per row, set by Store. Drained by ExampleCOVEngine::Flush.
+    std::vector<ExampleAtomicUInt64> updated;
+    // One bit per updated word, set when Store sets the first bit of the word,
+    // so Flush reads only the words that have bits
+    std::vector<ExampleAtomicUInt64> updatedSummary;
+
+    explicit ExampleObjectTable(const uint16_t objectType);
+
+    uint32_t Add(const uint32_t instance, const uint32_t nameOffset, const uint16_t nameLength);
+
+    // Thread safe write of a row's values, for field I/O threads. Sets the
+    // row's updated bit so the COV engine checks it on the next flush.
+    void Store(const uint32_t row, const float presentValue, const uint32_t reliability);
+
+    // Thread safe write of the present value only, for the stack thread, which
+    // reports its own writes through ExampleCOVEngine::Write
+    void StorePresentValue(const uint32_t row, const float presentValue);
+
+    // Thread safe read of a row's values, never a mix of two Store calls
+    void Load(const uint32_t row, float* presentValue, uint32_t* reliability) const;
+
+    // Start loading a row's values into the cache, for a batch of reads
+    // that would otherwise wait for each row in turn
+    void Prefetch(const uint32_t row) const;
+
+    void Reserve(const size_t count);
+    // Grow every column to count rows. New rows are zero and not indexed yet.
+    void Resize(const size_t count);
+    size_t Size() const { return this->instance.size(); }
+    size_t GetMemoryUsage() const;
+};
+
+//
+// ExampleObjectIndex
+// ----------------------------------------------------------------------------
+// Open addressing (linear probing) hash index from object key to location.
+// The capacity is a power of two and kept at most half full.
+class ExampleObjectIndex {
+private:
+    struct Slot {
+        uint32_t key;
+        uint32_t location;
+    };
+
+    // Every key is a possible object identifier, 0xFFFFFFFF included, so an
+    // empty slot is marked by its location. Table 0xFF is never used (see
+    // ExampleObjectStore::NO_TABLE), so no object is ever at this one.
+    static const uint32_t EMPTY_LOCATION = 0xFFFFFFFF;
+
+    std::vector<Slot> slots;
+    uint32_t mask;
+    uint8_t shift;
+    size_t count;
+
+    uint32_t hash(const uint32_t key) const { return (key * 0x9E3779B1u) >> this->shift; }
+    void grow();
+
+public:
+    ExampleObjectIndex();
+
+    // location is (table << 24) | row, see ExampleObjectStore. False if the
+    // key is already there, or for EMPTY_LOCATION.
+    bool Insert(const uint32_t key, const uint32_t location);
+    bool Find(const uint32_t key, uint32_t* location) const;
+    void Reserve(const size_t count);
+    void Clear();
+    size_t Size() const { return this->count; }
+    size_t GetMemoryUsage() const { return this->slots.size() * sizeof(Slot); }
+};
+
+//
+// ExampleObjectCache
+// ----------------------------------------------------------------------------
+// The last object found through ExampleObjectStore::Find. A ReadPropertyMultiple
+// asks for the properties of one object one after the other, so all but the
+// first skip the index. Valid until objects are added or the store is cleared.
+struct ExampleObjectCache {
+    uint32_t key;
+    uint32_t location;
+    uint32_t generation;    // ExampleObjectStore generation the entry was found in
+
+    ExampleObjectCache() : key(0xFFFFFFFF), location(0), generation(0) {}
+};
+
+//
+// ExampleObjectStore
+// ----------------------------------------------------------------------------
+class ExampleObjectStore {
+private:
+    static const uint8_t NO_TABLE = 0xFF;
+    static const uint32_t ROW_MASK = 0xFFFFFF;
+
+    uint8_t tableForType[EXAMPLE_OBJECT_TYPE_COUNT];
+    ExampleObjectIndex index;
+    // Changes whenever a location may change or stop being valid, see ExampleObjectCache
+    uint32_t generation;
+
+public:
+    std::vector<ExampleObjectTable> tables;
+    ExampleStringArena names;
+
+    ExampleObjectStore();
+
+    // Returns the table for this object type, creating it if needed
+    ExampleObjectTable* GetOrCreateTable(const uint16_t objectType);
+    ExampleObjectTable* GetTable(const uint16_t objectType);
+
+    // Size the table, index and name arena before a bulk load
+    void Reserve(const uint16_t objectType, const size_t count, const size_t nameBytes);
+
+    // Add an object. Returns false if it already exists, or if the type or
+    // instance is out of range.
+    bool Add(const uint16_t objectType, const uint32_t instance, const std::string& objectName, const float presentValue, const float covIncrement, const uint32_t reliability);
+
+    // Index rows [firstRow, Size()) of a table that were filled directly,
+    // see ExampleObjectTable::Resize. Returns false on a duplicate object or an
+    // instance out of range.
+    bool IndexRows(const uint16_t objectType, const uint32_t firstRow);
+
+    // Find an object. O(1), independent of the number of objects. False for a
+    // type or instance out of range, which ExampleObjectKey would alias.
+    bool Find(const uint16_t objectType, const uint32_t instance, ExampleObjectTable** table, uint32_t* row);
+    // Same, trying the object cached first
+    bool Find(const uint16_t objectType, const uint32_t instance, ExampleObjectCache* cache, ExampleObjectTable** table, uint32_t* row);
+
+    const char* GetObjectName(const ExampleObjectTable* table, const uint32_t row, uint32_t* length) const;
+    // Start loading the name of an object found through a cache, see ExampleObjectTable::Prefetch
+    void PrefetchName(const ExampleObjectCache& cache) const;
+
+    size_t GetObjectCount() const { return this->index.Size(); }
+    size_t GetMemoryUsage() const;
+    void Clear();
+};
+
+#endif // __CASBACnetSCExampleObjectStore_h__
@@ -0,0 +1,508 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExamplePolling.cpp
+ *
+ * See CASBACnetSCExamplePolling.h
+ */
+
+#include "CASBACnetSCExamplePolling.h"
+#include "WSHubFunction.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+// Points printed by ExamplePoller::Print()
+static const size_t POLLING_PRINT_POINTS = 20;
+
+// Worst case size of a ReadPropertyMultiple answer, used to fill a request up
+// to the max APDU length of the peer; the request itself is always shorter.
+// An object identifier and opening and closing tags per object, and per
+// property its identifier, opening and closing tags and a value of up to 9
+// bytes (a Double), or an Error of about the same size.
+static const uint32_t POLLING_ACK_HEADER_LENGTH = 3;
+static const uint32_t POLLING_ACK_OBJECT_LENGTH = 7;
+static const uint32_t POLLING_ACK_PROPERTY_LENGTH = 14;
+
+// Adaptation of the poll rate to the answer time
+static const double POLLING_LATENCY_WEIGHT = 0.125;
+static const double POLLING_SLOWDOWN_STEP = 1.25;
+
+ExamplePoller::ExamplePoller() {
+    this->outstanding = 0;
+    this->messageId = 0;
+    this->invokeIds = NULL;
+    this->requestsSent = 0;
+    this->retriesSent = 0;
+    this->answers = 0;
+    this->timeoutCount = 0;
+    this->aborts = 0;
+    this->pointsRead = 0;
+    this->pointErrors = 0;
+}
+
+void ExamplePoller::Reset(const uint64_t nowMilliseconds) {
+    for (const Request& request : this->requests) {
+        if (request.active) {
+            this->GetInvokeIds().Release(request.vmac, request.invokeId);
+        }
+    }
+    this->devices.clear();
+    this->deviceByInstance.Clear();
+    this->deviceByVmac.clear();
+    this->points.clear();
+    this->timers.Reset(nowMilliseconds);
+    this->requests.clear();
+    this->freeRequests.clear();
+    this->timeouts.clear();
+    this->retryQueue.clear();
+    this->ready.clear();
+    this->outstanding = 0;
+}
+
+void ExamplePoller::AddDevice(const uint32_t instance, const uint64_t vmac, const uint32_t maxApdu) {
+    uint32_t position;
+    if (this->deviceByInstance.Find(instance, &position)) {
+        Device& device = this->devices[position];
+        this->deviceByVmac.erase(device.vmac);
+        device.vmac = vmac;
+        device.maxApdu = maxApdu;
+        this->deviceByVmac[vmac] = position;
+        return;
+    }
+
+    Device device;
+    device.instance = instance;
+    device.vmac = vmac;
+    device.maxApdu = maxApdu;
+    device.maxPoints = this->settings.maxPointsPerRequest == 0 ? UINT32_MAX : this->settings.maxPointsPerRequest;
+    device.window = 1;
+    device.latency = 0;
+    device.slowdown = 1;
+    device.ready = false;
+    position = (uint32_t)this->devices.size();
+    this->deviceByInstance.Insert(instance, position);
+    this->deviceByVmac[vmac] = position;
+    this->devices.push_back(device);
+}
+
+bool ExamplePoller::AddPoint(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t instance, const uint32_t property, const uint32_t periodMilliseconds) {
+    uint32_t device;
+    if (!this->deviceByInstance.Find(deviceInstance, &device) || periodMilliseconds == 0) {
+        return false;
+    }
+
+    ExamplePolledPoint point;
+    point.device = device;
+    point.objectType = objectType;
+    point.instance = instance;
+    point.property = property;
+    point.periodMilliseconds = periodMilliseconds;
+    point.value = 0;
+    point.status = STATUS_NONE;
+    point.updatedMilliseconds = 0;
+    point.reading = false;
+    point.paused = false;
+
+    // Spread the first reads over the period. The points of one device get
+    // the same offset, so points with the same period are due together and
+    // are read in one request.
+    uint64_t offset = (deviceInstance * 0x9E3779B1u) % periodMilliseconds;
+    point.dueMilliseconds = this->timers.GetTime() + offset;
+    point.timer = this->timers.Add(offset, 0, this->points.size());
+    this->points.push_back(point);
+    return true;
+}
+
+void ExamplePoller::setReady(const uint32_t device) {
+    Device& entry = this->devices[device];
+    if (!entry.ready && !entry.due.empty()) {
+        entry.ready = true;
+        this->ready.push_back(device);
+    }
+}
+
+void ExamplePoller::schedule(const uint32_t point) {
+    ExamplePolledPoint& entry = this->points[point];
+    const Device& device = this->devices[entry.device];
+    entry.reading = false;
+    if (entry.paused) {
+        return;
+    }
+
+    // From when the point was due rather than when it was read, so the
+    // period does not drift by the answer time
+    uint64_t next = entry.dueMilliseconds + (uint64_t)(entry.periodMilliseconds * device.slowdown);
+    uint64_t now = this->timers.GetTime();
+    entry.timer = this->timers.Add(next > now ? next - now : 0, 0, point);
+}
+
+void ExamplePoller::adapt(Device& device, const double milliseconds) {
+    device.latency = device.latency == 0 ? milliseconds : device.latency + POLLING_LATENCY_WEIGHT * (milliseconds - device.latency);
+    if (device.latency > this->settings.targetLatencyMilliseconds) {
+        device.slowdown = std::min<double>(device.slowdown * POLLING_SLOWDOWN_STEP, this->settings.maxSlowdown);
+    }
+    else if (device.latency < this->settings.targetLatencyMilliseconds / 2.0) {
+        device.slowdown = std::max(device.slowdown / POLLING_SLOWDOWN_STEP, 1.0);
+    }
+}
+
+void ExamplePoller::SetPointPaused(const size_t point, const bool paused) {
+    ExamplePolledPoint& entry = this->points[point];
+    if (entry.paused == paused) {
+        return;
+    }
+    entry.paused = paused;
+    if (paused) {
+        this->timers.Cancel(entry.timer);
+        entry.timer = ExampleTimerWheel::INVALID_TIMER;
+    }
+    else if (!entry.reading) {
+        entry.timer = this->timers.Add(0, 0, point);
+    }
+}
+
+uint32_t ExamplePoller::startRequest(const uint32_t device, const uint64_t nowMilliseconds) {
+    Device& entry = this->devices[device];
+
+    uint32_t index;
+    if (this->freeRequests.empty()) {
+        index = (uint32_t)this->requests.size();
+        this->requests.push_back(Request());
+    }
+    else {
+        index = this->freeRequests.back();
+        this->freeRequests.pop_back();
+    }
+    Request& request = this->requests[index];
+    request.device = device;
+    request.retries = 0;
+    request.active = true;
+    request.sent = nowMilliseconds;
+    request.deadline = nowMilliseconds + this->settings.timeoutMilliseconds;
+    request.points.clear();
+
+    // Poll checked that the device has a free invoke ID
+    request.vmac = entry.vmac;
+    this->GetInvokeIds().Allocate(entry.vmac, &request.invokeId);
+
+    // As many due points as the answer has room for
+    uint32_t limit = std::min(entry.maxApdu, APDU_MAX_LENGTH);
+    uint32_t length = POLLING_ACK_HEADER_LENGTH;
+    while (!entry.due.empty() && request.points.size() < entry.maxPoints) {
+        const ExamplePolledPoint& point = this->points[entry.due.front()];
+        const ExamplePolledPoint* last = request.points.empty() ? NULL : &this->points[request.points.back()];
+        uint32_t added = POLLING_ACK_PROPERTY_LENGTH;
+        if (last == NULL || last->objectType != point.objectType || last->instance != point.instance) {
+            added += POLLING_ACK_OBJECT_LENGTH;
+        }
+        if (length + added > limit && !request.points.empty()) {
+            break;
+        }
+        length += added;
+        this->lateness.Record(nowMilliseconds - point.dueMilliseconds);
+        request.points.push_back(entry.due.front());
+        entry.due.pop_front();
+    }
+
+    entry.active.push_back(index);
+    this->outstanding++;
+    this->timeouts.push_back(std::make_pair(request.deadline, index));
+    this->requestsSent++;
+    return index;
+}
+
+size_t ExamplePoller::encodeRequest(const Request& request, uint8_t* frame, const size_t capacity) {
+    uint8_t apdu[APDU_MAX_LENGTH];
+    ExampleApduWriter writer(apdu, sizeof(apdu));
+    writer.Byte(APDU_TYPE_CONFIRMED_REQUEST << 4);
+    writer.Byte(APDU_MAX_APDU_ACCEPTED_1476);
+    writer.Byte(request.invokeId);
+    writer.Byte(APDU_SERVICE_READ_PROPERTY_MULTIPLE);
+
+    // Consecutive points of the same object share its read access specification
+    for (size_t position = 0; position < request.points.size(); position++) {
+        const ExamplePolledPoint& point = this->points[request.points[position]];
+        if (position == 0 || this->points[request.points[position - 1]].objectType != point.objectType || this->points[request.points[position - 1]].instance != point.instance) {
+            if (position != 0) {
+                writer.ClosingTag(1);
+            }
+            writer.ContextObjectIdentifier(0, point.objectType, point.instance);
+            writer.OpeningTag(1);
+        }
+        writer.ContextUnsigned(0, point.property);
+    }
+    writer.ClosingTag(1);
+    if (writer.IsOverflow()) {
+        return 0;
+    }
+
+    uint8_t vmac[BVLC_SC_VMAC_LENGTH];
+    WSHubFrameHeader::UnpackVmac(this->devices[request.device].vmac, vmac);
+    return ExampleApdu::BuildFrame(frame, capacity, this->messageId++, vmac, true, apdu, writer.GetLength());
+}
+
+bool ExamplePoller::Poll(const uint64_t nowMilliseconds, uint8_t* frame, const size_t capacity, size_t* length) {
+    // Points that are due join the queue of their device
+    this->expiries.clear();
+    this->timers.Advance(nowMilliseconds, &this->expiries);
+    for (const ExampleTimerExpiry& expiry : this->expiries) {
+        ExamplePolledPoint& point = this->points[(size_t)expiry.context];
+        point.timer = ExampleTimerWheel::INVALID_TIMER;
+        point.dueMilliseconds = expiry.deadline;
+        point.reading = true;
+        this->devices[point.device].due.push_back((uint32_t)expiry.context);
+        this->setReady(point.device);
+    }
+
+    // Requests without an answer, in deadline order. Entries of requests
+    // answered or sent again since are skipped.
+    while (!this->timeouts.empty() && this->timeouts.front().first <= nowMilliseconds) {
+        uint32_t index = this->timeouts.front().second;
+        uint64_t deadline = this->timeouts.front().first;
+        this->timeouts.pop_front();
+        if (this->requests[index].active && this->requests[index].deadline == deadline) {
+            this->onTimeout(index);
+        }
+    }
+
+    // Retries first, they already count as outstanding
+    while (!this->retryQueue.empty()) {
+        uint32_t index = this->retryQueue.front();
+        this->retryQueue.pop_front();
+        Request& request = this->requests[index];
+        if (!request.active || request.deadline != 0) {
+            continue;
+        }
+        request.sent = nowMilliseconds;
+        request.deadline = nowMilliseconds + this->settings.timeoutMilliseconds;
+        this->timeouts.push_back(std::make_pair(request.deadline, index));
+        this->retriesSent++;
+        *length = this->encodeRequest(request, frame, capacity);
+        return *length != 0;
+    }
+
+    // One request per ready device in turn. A device at its window leaves
+    // the queue until one of its requests completes.
+    while (!this->ready.empty() && this->outstanding < this->settings.maxOutstandingPerConnection) {
+        uint32_t device = this->ready.front();
+        this->ready.pop_front();
+        Device& entry = this->devices[device];
+        if (entry.due.empty() || entry.active.size() >= (size_t)entry.window) {
+            entry.ready = false;
+            continue;
+        }
+        if (this->GetInvokeIds().IsFull(entry.vmac)) {
+            // Every invoke ID of the device waits for an answer to another
+            // client, tried again on the next call
+            this->ready.push_front(device);
+            break;
+        }
+        uint32_t index = this->startRequest(device, nowMilliseconds);
+        if (entry.due.empty()) {
+            entry.ready = false;
+        }
+        else {
+            this->ready.push_back(device);
+        }
+        *length = this->encodeRequest(this->requests[index], frame, capacity);
+        return *length != 0;
+    }
+    return false;
+}
+
+uint64_t ExamplePoller::GetNextDeadline() const {
+    if (!this->retryQueue.empty() || (!this->ready.empty() && this->outstanding < this->settings.maxOutstandingPerConnection)) {
+        return 0;
+    }
+    uint64_t deadline = this->timers.GetNextDeadline();
+    if (!this->timeouts.empty()) {
+        deadline = std::min(deadline, this->timeouts.front().first);
+    }
+    return deadline;
+}
+
+void ExamplePoller::onTimeout(const uint32_t index) {
+    Request& request = this->requests[index];
+    Device& device = this->devices[request.device];
+    device.window = std::max(device.window / 2, 1.0);
+    this->adapt(device, this->settings.timeoutMilliseconds);
+
+    if (request.retries < this->settings.retries) {
+        // Sent again by Poll with the same invoke ID, a late answer to the
+        // first one still completes it
+        request.retries++;
+        request.deadline = 0;
+        this->retryQueue.push_back(index);
+        return;
+    }
+
+    this->timeoutCount++;
+    for (uint32_t point : request.points) {
+        this->points[point].status = STATUS_TIMEOUT;
+        this->pointErrors++;
+        this->schedule(point);
+    }
+    this->release(index);
+}
+
+void ExamplePoller::release(const uint32_t index) {
+    Request& request = this->requests[index];
+    Device& device = this->devices[request.device];
+    device.active.erase(std::find(device.active.begin(), device.active.end(), index));
+    request.active = false;
+    this->GetInvokeIds().Release(request.vmac, request.invokeId);
+    this->outstanding--;
+    this->freeRequests.push_back(index);
+    this->setReady(request.device);
+}
+
+void ExamplePoller::readAck(const Request& request, ExampleApduReader& reader, const uint64_t nowMilliseconds) {
+    // The results are in the order of the request, grouped the same way
+    size_t position = 0;
+    bool valid = true;
+    for (; valid && position < request.points.size(); position++) {
+        ExamplePolledPoint& point = this->points[request.points[position]];
+        const ExamplePolledPoint* previous = position == 0 ? NULL : &this->points[request.points[position - 1]];
+        if (previous == NULL || previous->objectType != point.objectType || previous->instance != point.instance) {
+            uint16_t objectType;
+            uint32_t instance;
+            valid = (previous == NULL || reader.ReadClosingTag(1)) &&
+                    reader.ReadContextObjectIdentifier(0, &objectType, &instance) && objectType == point.objectType && instance == point.instance &&
+                    reader.ReadOpeningTag(1);
+        }
+        uint32_t property;
+        valid = valid && reader.ReadContextUnsigned(2, &property) && property == point.property;
+        if (!valid) {
+            break;
+        }
+        uint32_t arrayIndex;
+        if (!reader.IsOpeningTag(4) && !reader.IsOpeningTag(5) && !reader.ReadContextUnsigned(3, &arrayIndex)) {
+            valid = false;
+            break;
+        }
+
+        if (reader.IsOpeningTag(4)) {
+            reader.ReadOpeningTag(4);
+            double value;
+            if (reader.ReadApplicationValue(&value) && reader.IsClosingTag(4)) {
+                reader.ReadClosingTag(4);
+                point.value = value;
+                point.status = STATUS_OK;
+                point.updatedMilliseconds = nowMilliseconds;
+                this->pointsRead++;
+                continue;
+            }
+            // A list or a value that is not a number
+            valid = reader.SkipToClosing(4);
+        }
+        else {
+            valid = reader.ReadOpeningTag(5) && reader.SkipToClosing(5);
+        }
+        point.status = STATUS_ERROR;
+        this->pointErrors++;
+    }
+
+    // The rest of a malformed answer
+    for (; position < request.points.size(); position++) {
+        this->points[request.points[position]].status = STATUS_ERROR;
+        this->pointErrors++;
+    }
+}
+
+bool ExamplePoller::OnReceived(const uint8_t* frame, const size_t length, const uint64_t nowMilliseconds) {
+    WSHubFrameHeader header;
+    if (!WSHubFrameHeader::Parse(frame, length, &header) || header.originatingVmac == NULL) {
+        return false;
+    }
+    size_t apduLength;
+    const uint8_t* apdu = header.GetApdu(frame, length, &apduLength);
+    if (apdu == NULL || apduLength < 3) {
+        return false;
+    }
+    uint8_t type = apdu[0] >> 4;
+    if (type != APDU_TYPE_COMPLEX_ACK && type != APDU_TYPE_ERROR && type != APDU_TYPE_REJECT && type != APDU_TYPE_ABORT) {
+        return false;
+    }
+    // The CAS BACnet Stack numbers its own confirmed requests, an answer to
+    // one of them can have the invoke ID of one of ours. A Reject or Abort
+    // has no service to tell them apart.
+    uint8_t service;
+    if (ExampleApdu::GetAnswerService(apdu, apduLength, &service) && service != APDU_SERVICE_READ_PROPERTY_MULTIPLE) {
+        return false;
+    }
+    std::unordered_map<uint64_t, uint32_t>::const_iterator found = this->deviceByVmac.find(WSHubFrameHeader::PackVmac(header.originatingVmac));
+    if (found == this->deviceByVmac.end()) {
+        return false;
+    }
+
+    // No other client of the invoke IDs waits for this one
+    Device& device = this->devices[found->second];
+    uint32_t index = UINT32_MAX;
+    for (uint32_t active : device.active) {
+        if (this->requests[active].invokeId == apdu[1]) {
+            index = active;
+        }
+    }
+    if (index == UINT32_MAX) {
+        return false;
+    }
+    Request& request = this->requests[index];
+
+    this->answers++;
+    this->latency.Record(nowMilliseconds - request.sent);
+    this->adapt(device, (double)(nowMilliseconds - request.sent));
+
+    if (type == APDU_TYPE_ABORT && (apdu[2] == APDU_ABORT_BUFFER_OVERFLOW || apdu[2] == APDU_ABORT_SEGMENTATION_NOT_SUPPORTED || apdu[2] == APDU_ABORT_APDU_TOO_LONG) && request.points.size() > 1) {
+        // The answer did not fit, ask again for the points in smaller requests
+        this->aborts++;
+        device.maxPoints = std::max<uint32_t>((uint32_t)request.points.size() / 2, 1);
+        for (size_t position = request.points.size(); position > 0; position--) {
+            device.due.push_front(request.points[position - 1]);
+        }
+        this->release(index);
+        return true;
+    }
+
+    if (type == APDU_TYPE_COMPLEX_ACK && (apdu[0] & 0x08) == 0 && apdu[2] == APDU_SERVICE_READ_PROPERTY_MULTIPLE) {
+        ExampleApduReader reader(apdu, apduLength, 3);
+        this->readAck(request, reader, nowMilliseconds);
+        device.window = std::min<double>(device.window + 1 / device.window, this->settings.maxOutstandingPerDevice);
+    }
+    else {
+        // Error, Reject, another Abort or a segmented answer
+        if (type == APDU_TYPE_ABORT) {
+            this->aborts++;
+        }
+        for (uint32_t point : request.points) {
+            this->points[point].status = STATUS_ERROR;
+            this->pointErrors++;
+        }
+    }
+    for (uint32_t point : request.points) {
+        this->schedule(point);
+    }
+    this->release(index);
+    return true;
+}
+
+void ExamplePoller::Print() const {
+    static const char* STATUS_NAMES[] = { "none", "ok", "error", "timeout" };
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Polling: " << this->devices.size() << " devices, " << this->points.size() << " points, " << this->outstanding << " requests outstanding" << std::endl;
+    std::cout << "  " << this->requestsSent << " requests, " << this->retriesSent << " retries, " << this->answers << " answers, " << this->timeoutCount << " timeouts, " << this->aborts << " aborts" << std::endl;
+    std::cout << "  " << this->pointsRead << " values read, " << this->pointErrors << " errors, answer time p50 " << this->latency.GetPercentile(50) << " ms, p99 " << this->latency.GetPercentile(99);
+    std::cout << " ms, late by p99 " << this->lateness.GetPercentile(99) << " ms" << std::endl;
+    for (size_t position = 0; position < std::min(this->points.size(), POLLING_PRINT_POINTS); position++) {
+        const ExamplePolledPoint& point = this->points[position];
+        const Device& device = this->devices[point.device];
+        std::cout << "  device " << device.instance << " (" << device.latency << " ms, x" << device.slowdown << "), object " << point.objectType << ":" << point.instance;
+        std::cout << ", property " << point.property << " = " << point.value << " (" << STATUS_NAMES[point.status] << ")" << std::endl;
+    }
+    if (this->points.size() > POLLING_PRINT_POINTS) {
+        std::cout << "  ... " << this->points.size() - POLLING_PRINT_POINTS << " more" << std::endl;
+    }
+    std::cout.flags(flags);
+}
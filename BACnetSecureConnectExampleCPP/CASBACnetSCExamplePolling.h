@@ -0,0 +1,187 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExamplePolling.h
+ *
+ * Client side polling of points in remote devices over the hub.
+ *
+ * Each point has its own period and is scheduled on an ExampleTimerWheel.
+ * When a point is due it joins the queue of its device. The points due in a
+ * device are read together, in one ReadPropertyMultiple request sized so the
+ * answer fits the max APDU length of the peer. Points of the same object
+ * share one object in the request.
+ *
+ * Confirmed requests are windowed. A device has at most window requests
+ * waiting for an answer, and the hub connection at most
+ * maxOutstandingPerConnection. The window of a device grows by one request
+ * per window of answers, up to maxOutstandingPerDevice, and is halved on a
+ * timeout. A request that times out is sent again with the same invoke ID,
+ * up to retries times. An Abort because the answer would not fit halves the
+ * points per request of the device, and its points are asked for again.
+ *
+ * The poll rate follows the response time of each device. While its average
+ * answer takes longer than targetLatencyMilliseconds the periods of its points
+ * are stretched, up to maxSlowdown times, and shrink back once it is fast
+ * again. A point is scheduled again only once it has been read, so a device
+ * that cannot keep up gets fewer requests, never a backlog.
+ *
+ * Invoke IDs come from an ExampleInvokeIds, the poller's own or one shared
+ * with the other clients of the hub connection (SetInvokeIds), so an answer
+ * is never taken for the request of another client.
+ *
+ * Not thread safe, called from the main loop and CallbackReceiveMessage.
+ */
+
+#ifndef __CASBACnetSCExamplePolling_h__
+#define __CASBACnetSCExamplePolling_h__
+
+#include "CASBACnetSCExampleApdu.h"
+#include "CASBACnetSCExampleObjectStore.h"
+#include "CASBACnetSCExampleProfiler.h"
+#include "CASBACnetSCExampleTimerWheel.h"
+
+#include <deque>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+struct ExamplePollerSettings {
+    uint32_t maxOutstandingPerDevice;       // Largest window of a device
+    uint32_t maxOutstandingPerConnection;   // Requests waiting for an answer on the hub connection
+    uint32_t timeoutMilliseconds;           // APDU timeout
+    uint32_t retries;                       // Times a request is sent again after a timeout
+    uint32_t targetLatencyMilliseconds;     // Average answer time above which a device is polled slower
+    uint32_t maxSlowdown;                   // Most a period is stretched
+    uint32_t maxPointsPerRequest;           // 0 for as many as the max APDU length allows
+
+    ExamplePollerSettings() :
+        maxOutstandingPerDevice(4),
+        maxOutstandingPerConnection(64),
+        timeoutMilliseconds(3000),
+        retries(2),
+        targetLatencyMilliseconds(500),
+        maxSlowdown(8),
+        maxPointsPerRequest(0) {}
+};
+
+struct ExamplePolledPoint {
+    uint32_t device;                // Position in the devices of the poller
+    uint16_t objectType;
+    uint32_t instance;
+    uint32_t property;
+    uint32_t periodMilliseconds;
+    double value;
+    uint8_t status;                 // ExamplePoller::STATUS_*
+    uint64_t dueMilliseconds;       // When the current read was due
+    uint64_t updatedMilliseconds;   // When value was read
+    ExampleTimerId timer;           // INVALID_TIMER while due, being read or paused
+    bool reading;                   // Due or being read
+    bool paused;                    // Not scheduled again until resumed
+};
+
+class ExamplePoller {
+public:
+    static const uint8_t STATUS_NONE = 0;       // Not read yet
+    static const uint8_t STATUS_OK = 1;
+    static const uint8_t STATUS_ERROR = 2;      // Error, Reject or Abort, or a value type that is not a number
+    static const uint8_t STATUS_TIMEOUT = 3;
+
+private:
+    struct Device {
+        uint32_t instance;
+        uint64_t vmac;                  // Packed by WSHubFrameHeader::PackVmac
+        uint32_t maxApdu;
+        uint32_t maxPoints;             // Halved on an Abort for a too long answer
+        double window;                  // Requests allowed at once
+        double latency;                 // Average answer time, milliseconds
+        double slowdown;                // Periods are stretched by this much
+        bool ready;                     // In the ready queue
+        std::vector<uint32_t> active;   // Requests waiting for an answer
+        std::deque<uint32_t> due;       // Points due
+    };
+    struct Request {
+        uint32_t device;
+        uint64_t vmac;                  // The invoke ID was allocated for, the device may move
+        uint8_t invokeId;
+        uint8_t retries;
+        bool active;
+        uint64_t sent;
+        uint64_t deadline;
+        std::vector<uint32_t> points;   // In request order
+    };
+
+    ExamplePollerSettings settings;
+    std::vector<Device> devices;
+    ExampleObjectIndex deviceByInstance;
+    std::unordered_map<uint64_t, uint32_t> deviceByVmac;
+    std::vector<ExamplePolledPoint> points;
+    ExampleTimerWheel timers;
+    std::vector<ExampleTimerExpiry> expiries;
+
+    std::vector<Request> requests;
+    std::vector<uint32_t> freeRequests;
+    std::deque<std::pair<uint64_t, uint32_t> > timeouts;    // Deadline and request, in deadline order
+    std::deque<uint32_t> retryQueue;
+    std::deque<uint32_t> ready;         // Devices with points due
+    uint32_t outstanding;
+    uint16_t messageId;
+    ExampleInvokeIds ownInvokeIds;
+    ExampleInvokeIds* invokeIds;        // NULL for ownInvokeIds
+
+    uint32_t startRequest(const uint32_t device, const uint64_t nowMilliseconds);
+    size_t encodeRequest(const Request& request, uint8_t* frame, const size_t capacity);
+    void readAck(const Request& request, ExampleApduReader& reader, const uint64_t nowMilliseconds);
+    void onTimeout(const uint32_t request);
+    void release(const uint32_t request);
+    void adapt(Device& device, const double milliseconds);
+    void schedule(const uint32_t point);
+    void setReady(const uint32_t device);
+
+public:
+    // Statistics
+    uint64_t requestsSent;
+    uint64_t retriesSent;
+    uint64_t answers;
+    uint64_t timeoutCount;          // Requests that got no answer after every retry
+    uint64_t aborts;
+    uint64_t pointsRead;
+    uint64_t pointErrors;
+    ExampleHdrHistogram latency;    // Answer time, milliseconds
+    ExampleHdrHistogram lateness;   // From a point being due to its request, milliseconds
+
+    ExamplePoller();
+
+    void SetSettings(const ExamplePollerSettings& settings) { this->settings = settings; }
+    const ExamplePollerSettings& GetSettings() const { return this->settings; }
+    // Start the schedule at nowMilliseconds, before adding points
+    void Reset(const uint64_t nowMilliseconds);
+    // Invoke IDs shared with the other clients of the hub connection, NULL
+    // for the poller's own. Before the first request.
+    void SetInvokeIds(ExampleInvokeIds* invokeIds) { this->invokeIds = invokeIds; }
+    ExampleInvokeIds& GetInvokeIds() { return this->invokeIds != NULL ? *this->invokeIds : this->ownInvokeIds; }
+
+    // Add a device or update its address. vmac is packed by WSHubFrameHeader::PackVmac.
+    void AddDevice(const uint32_t instance, const uint64_t vmac, const uint32_t maxApdu);
+    // The first read is spread over the period. False if the device is unknown,
+    // the point is GetPointCount() - 1 otherwise.
+    bool AddPoint(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t instance, const uint32_t property, const uint32_t periodMilliseconds);
+
+    // Stop reading a point, or start again. A read in progress still completes.
+    void SetPointPaused(const size_t point, const bool paused);
+
+    // Next request to send, retries first. Call until it returns false.
+    bool Poll(const uint64_t nowMilliseconds, uint8_t* frame, const size_t capacity, size_t* length);
+    // When Poll() next has something to do, ExampleTimerWheel::NO_DEADLINE if nothing is scheduled
+    uint64_t GetNextDeadline() const;
+
+    // A frame received from the hub, true if it answered one of our requests
+    bool OnReceived(const uint8_t* frame, const size_t length, const uint64_t nowMilliseconds);
+
+    size_t GetDeviceCount() const { return this->devices.size(); }
+    size_t GetPointCount() const { return this->points.size(); }
+    const ExamplePolledPoint& GetPoint(const size_t point) const { return this->points[point]; }
+    uint32_t GetOutstanding() const { return this->outstanding; }
+    void Print() const;
+};
+
+#endif // __CASBACnetSCExamplePolling_h__
@@ -0,0 +1,72 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExamplePriorityArray.cpp
+ *
+ * See CASBACnetSCExamplePriorityArray.h
+ */
+
+#include "CASBACnetSCExamplePriorityArray.h"
+#include "CASBACnetSCExampleConstants.h"
+#include "CASBACnetSCExampleBits.h"
+
+void ExamplePriorityArray::Initialize(const float relinquishDefault) {
+    for (uint8_t offset = 0; offset < LENGTH; offset++) {
+        this->values[offset] = 0.0f;
+    }
+    this->relinquishDefault = relinquishDefault;
+    this->mask = 0;
+}
+
+bool ExamplePriorityArray::Command(const uint8_t priority, const float value) {
+    if (priority < 1 || priority > LENGTH) {
+        return false;
+    }
+    this->values[priority - 1] = value;
+    this->mask |= (uint16_t)(1u << (priority - 1));
+    return true;
+}
+
+bool ExamplePriorityArray::Relinquish(const uint8_t priority) {
+    if (priority < 1 || priority > LENGTH) {
+        return false;
+    }
+    this->mask &= (uint16_t)~(1u << (priority - 1));
+    return true;
+}
+
+bool ExamplePriorityArray::Get(const uint8_t priority, float* value) const {
+    if (priority < 1 || priority > LENGTH || (this->mask & (1u << (priority - 1))) == 0) {
+        return false;
+    }
+    *value = this->values[priority - 1];
+    return true;
+}
+
+float ExamplePriorityArray::GetEffectiveValue() const {
+    if (this->mask == 0) {
+        return this->relinquishDefault;
+    }
+    return this->values[ExampleLowestBit32(this->mask)];
+}
+
+uint8_t ExamplePriorityArray::GetActivePriority() const {
+    if (this->mask == 0) {
+        return 0;
+    }
+    return (uint8_t)(ExampleLowestBit32(this->mask) + 1);
+}
+
+bool ExampleIsCommandable(const uint16_t objectType) {
+    switch (objectType) {
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT:
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE:
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT:
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT:
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+        return true;
+    default:
+        return false;
+    }
+}
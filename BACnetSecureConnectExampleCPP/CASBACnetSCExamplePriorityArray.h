@@ -0,0 +1,52 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExamplePriorityArray.h
+ *
+ * Priority_Array of the commandable objects (Analog, Binary and Multi-state
+ * Output and Value).
+ *
+ * The 16 command slots are a value array and a 16 bit mask with one bit per
+ * slot that holds a value; a slot without its bit is NULL. The slot in
+ * control is the lowest set bit, so commanding, relinquishing and finding
+ * the effective value are a few instructions each instead of a scan of 16
+ * flags, and none of them allocate.
+ *
+ * Values of every object type are kept as float: Binary objects use 0 and 1,
+ * Multi-state objects the state number.
+ */
+
+#ifndef __CASBACnetSCExamplePriorityArray_h__
+#define __CASBACnetSCExamplePriorityArray_h__
+
+#include <stdint.h>
+
+struct ExamplePriorityArray {
+    static const uint8_t LENGTH = 16;
+
+    float values[LENGTH];   // values[priority - 1], only valid if its bit is set
+    float relinquishDefault;
+    uint16_t mask;          // Bit priority - 1 is set if the slot holds a value
+
+    void Initialize(const float relinquishDefault);
+
+    // Priority is 1 (highest) to 16. Both return false for a priority out of
+    // range and leave the array unchanged.
+    bool Command(const uint8_t priority, const float value);
+    bool Relinquish(const uint8_t priority);
+
+    // Value of a slot. Returns false if the slot is NULL.
+    bool Get(const uint8_t priority, float* value) const;
+
+    // Present value: the value of the highest priority slot that is not
+    // NULL, or the Relinquish_Default if every slot is NULL
+    float GetEffectiveValue() const;
+
+    // Current_Command_Priority, 0 if every slot is NULL
+    uint8_t GetActivePriority() const;
+};
+
+// True for the object types that have a Priority_Array
+bool ExampleIsCommandable(const uint16_t objectType);
+
+#endif // __CASBACnetSCExamplePriorityArray_h__
@@ -0,0 +1,227 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleProfiler.cpp
+ *
+ * See CASBACnetSCExampleProfiler.h
+ */
+
+#include "CASBACnetSCExampleProfiler.h"
+#include "CASBACnetSCExampleBits.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+//
+// ExampleProfilerClock
+// ----------------------------------------------------------------------------
+
+uint64_t ExampleProfilerClock::NowNanoseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double ExampleProfilerClock::Calibrate(const uint32_t milliseconds) {
+#ifdef EXAMPLE_PROFILER_TSC
+    uint64_t startNanoseconds = NowNanoseconds();
+    uint64_t startTicks = Now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+    uint64_t ticks = Now() - startTicks;
+    uint64_t nanoseconds = NowNanoseconds() - startNanoseconds;
+    if (nanoseconds == 0 || ticks == 0) {
+        return 1.0;
+    }
+    return (double)ticks / nanoseconds;
+#else
+    (void)milliseconds;
+    return 1.0;
+#endif // EXAMPLE_PROFILER_TSC
+}
+
+//
+// ExampleHdrHistogram
+// ----------------------------------------------------------------------------
+
+ExampleHdrHistogram::ExampleHdrHistogram() {
+    this->counts.resize(COUNT_LENGTH);
+    this->Reset();
+}
+
+void ExampleHdrHistogram::Reset() {
+    std::fill(this->counts.begin(), this->counts.end(), 0);
+    this->count = 0;
+    this->total = 0;
+    this->maximum = 0;
+}
+
+uint32_t ExampleHdrHistogram::GetIndex(const uint64_t value) {
+    if (value < 2 * SUB_BUCKET_COUNT) {
+        return (uint32_t)value;
+    }
+    uint32_t highestBit = value >> MAX_BITS ? MAX_BITS - 1 : ExampleHighestBit64(value);
+    uint32_t shift = highestBit - SUB_BUCKET_BITS;
+    uint64_t subBucket = value >> MAX_BITS ? 2 * SUB_BUCKET_COUNT - 1 : value >> shift;
+    return shift * SUB_BUCKET_COUNT + (uint32_t)subBucket;
+}
+
+uint64_t ExampleHdrHistogram::GetHighestValue(const uint32_t index) {
+    if (index < 2 * SUB_BUCKET_COUNT) {
+        return index;
+    }
+    uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t subBucket = index - shift * SUB_BUCKET_COUNT;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+uint64_t ExampleHdrHistogram::GetPercentile(const double percentile) const {
+    if (this->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * this->count + 0.5);
+    rank = std::max<uint64_t>(1, std::min<uint64_t>(rank, this->count));
+    uint64_t seen = 0;
+    for (uint32_t index = 0; index < COUNT_LENGTH; index++) {
+        seen += this->counts[index];
+        if (seen >= rank) {
+            return std::min(GetHighestValue(index), this->maximum);
+        }
+    }
+    return this->maximum;
+}
+
+//
+// ExampleProfiler
+// ----------------------------------------------------------------------------
+
+ExampleProfiler::ExampleProfiler() {
+    this->enabled = false;
+    this->ticksPerNanosecond = 1.0;
+    this->slowIterationTicks = UINT64_MAX;
+    this->depth = 0;
+    this->iterationStart = 0;
+    this->iterationTicks = 0;
+    this->slowIterations = 0;
+}
+
+void ExampleProfiler::Initialize(const char* const* names, const uint32_t count, const uint32_t slowIterationMicroseconds) {
+    this->ticksPerNanosecond = ExampleProfilerClock::Calibrate(20);
+    this->slowIterationTicks = (uint64_t)(slowIterationMicroseconds * 1000.0 * this->ticksPerNanosecond);
+    this->sections.resize(count);
+    for (uint32_t section = 0; section < count; section++) {
+        this->sections[section].name = names[section];
+    }
+    this->touched.reserve(count);
+    this->Reset();
+    this->enabled = true;
+}
+
+void ExampleProfiler::Reset() {
+    for (Section& section : this->sections) {
+        section.histogram.Reset();
+        section.selfTicks = 0;
+        section.iterationSelfTicks = 0;
+        section.iterationCalls = 0;
+    }
+    this->touched.clear();
+    this->iterations.Reset();
+    this->iterationTicks = 0;
+    this->slowIterations = 0;
+}
+
+void ExampleProfiler::Leave() {
+    uint64_t now = ExampleProfilerClock::Now();
+    Frame& frame = this->stack[--this->depth];
+    uint64_t ticks = now - frame.start;
+    uint64_t selfTicks = ticks - std::min(ticks, frame.childTicks);
+    if (this->depth > 0) {
+        this->stack[this->depth - 1].childTicks += ticks;
+    }
+
+    Section& section = this->sections[frame.section];
+    section.histogram.Record(ticks);
+    section.selfTicks += selfTicks;
+    if (section.iterationCalls == 0) {
+        this->touched.push_back(frame.section);
+    }
+    section.iterationSelfTicks += selfTicks;
+    section.iterationCalls++;
+}
+
+void ExampleProfiler::BeginIteration() {
+    // Sections timed outside an iteration are not part of the next breakdown
+    for (uint32_t section : this->touched) {
+        this->sections[section].iterationSelfTicks = 0;
+        this->sections[section].iterationCalls = 0;
+    }
+    this->touched.clear();
+    this->iterationStart = this->enabled ? ExampleProfilerClock::Now() : 0;
+}
+
+void ExampleProfiler::EndIteration() {
+    if (!this->enabled || this->iterationStart == 0) {
+        return;
+    }
+    uint64_t ticks = ExampleProfilerClock::Now() - this->iterationStart;
+    this->iterations.Record(ticks);
+    this->iterationTicks += ticks;
+    if (ticks >= this->slowIterationTicks) {
+        this->slowIterations++;
+        this->printSlowIteration(ticks);
+    }
+    this->iterationStart = 0;
+}
+
+void ExampleProfiler::printSlowIteration(const uint64_t ticks) {
+    std::sort(this->touched.begin(), this->touched.end(), [this](uint32_t a, uint32_t b) {
+        return this->sections[a].iterationSelfTicks > this->sections[b].iterationSelfTicks;
+    });
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Slow iteration: " << this->ToNanoseconds(ticks) / 1e6 << " ms";
+    for (uint32_t index : this->touched) {
+        const Section& section = this->sections[index];
+        std::cout << ", " << section.name << " " << this->ToNanoseconds(section.iterationSelfTicks) / 1e6 << " ms";
+        if (section.iterationCalls > 1) {
+            std::cout << " (" << section.iterationCalls << " calls)";
+        }
+    }
+    std::cout << std::endl;
+    std::cout.flags(flags);
+}
+
+void ExampleProfiler::Print() {
+    std::vector<uint32_t> order;
+    for (uint32_t section = 0; section < this->sections.size(); section++) {
+        if (this->sections[section].histogram.GetCount() > 0) {
+            order.push_back(section);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return this->sections[a].selfTicks > this->sections[b].selfTicks;
+    });
+
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Profiler: " << this->iterations.GetCount() << " iterations, " << this->slowIterations << " slow, ";
+    std::cout << "p50 " << this->ToNanoseconds(this->iterations.GetPercentile(50)) / 1e3 << " us, ";
+    std::cout << "p99 " << this->ToNanoseconds(this->iterations.GetPercentile(99)) / 1e3 << " us, ";
+    std::cout << "max " << this->ToNanoseconds(this->iterations.GetMaximum()) / 1e3 << " us" << std::endl;
+    std::cout << "  " << std::left << std::setw(36) << "section" << std::right << std::setw(10) << "calls" << std::setw(8) << "self%"
+              << std::setw(12) << "self ms" << std::setw(10) << "mean us" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"
+              << std::setw(10) << "p99.9 us" << std::setw(10) << "max us" << std::endl;
+    for (uint32_t index : order) {
+        const Section& section = this->sections[index];
+        const ExampleHdrHistogram& histogram = section.histogram;
+        double share = this->iterationTicks == 0 ? 0.0 : 100.0 * section.selfTicks / this->iterationTicks;
+        std::cout << "  " << std::left << std::setw(36) << section.name << std::right << std::setw(10) << histogram.GetCount() << std::setw(8) << share
+                  << std::setw(12) << this->ToNanoseconds(section.selfTicks) / 1e6
+                  << std::setw(10) << this->ToNanoseconds((uint64_t)histogram.GetMean()) / 1e3
+                  << std::setw(10) << this->ToNanoseconds(histogram.GetPercentile(50)) / 1e3
+                  << std::setw(10) << this->ToNanoseconds(histogram.GetPercentile(99)) / 1e3
+                  << std::setw(10) << this->ToNanoseconds(histogram.GetPercentile(99.9)) / 1e3
+                  << std::setw(10) << this->ToNanoseconds(histogram.GetMaximum()) / 1e3 << std::endl;
+    }
+    std::cout.flags(flags);
+}
@@ -0,0 +1,196 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleProfiler.h
+ *
+ * Latency profiler for the main loop and the callbacks of the CAS BACnet Stack.
+ *
+ * The main loop is split into sections (fpLoop, each callback, fpDecodeAsXML,
+ * ...). An ExampleProfilerScope at the top of a section records its duration
+ * in that section's HDR histogram. Sections nest: a callback runs inside
+ * fpLoop, so each section also keeps its self time, without the sections it
+ * called, and the report ranks the sections by self time.
+ *
+ * An iteration that takes longer than the slow threshold is logged with the
+ * self time and calls of every section it ran.
+ *
+ * Durations are read from the time stamp counter where there is one (a few
+ * nanoseconds per read, against tens for steady_clock) and converted to
+ * nanoseconds only for the report. The profiler is meant to be left on;
+ * when disabled a scope costs one branch.
+ *
+ * The profiler is not thread safe. It is used from the main loop only, which
+ * is also the thread the stack makes its callbacks on.
+ */
+
+#ifndef __CASBACnetSCExampleProfiler_h__
+#define __CASBACnetSCExampleProfiler_h__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define EXAMPLE_PROFILER_TSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define EXAMPLE_PROFILER_TSC
+#endif
+
+//
+// ExampleProfilerClock
+// ----------------------------------------------------------------------------
+// Monotonic ticks, the time stamp counter or steady_clock nanoseconds
+class ExampleProfilerClock {
+public:
+    static inline uint64_t Now() {
+#ifdef EXAMPLE_PROFILER_TSC
+        return __rdtsc();
+#else
+        return NowNanoseconds();
+#endif // EXAMPLE_PROFILER_TSC
+    }
+
+    static uint64_t NowNanoseconds();
+
+    // Measure the tick rate against steady_clock. Blocks for about milliseconds.
+    static double Calibrate(const uint32_t milliseconds);
+};
+
+//
+// ExampleHdrHistogram
+// ----------------------------------------------------------------------------
+// High dynamic range histogram: values below 128 are counted exactly, larger
+// ones in 64 linear sub-buckets per power of two, so any recorded value is
+// within 1/64 (1.6%) of its bucket. Up to 2^40 without clamping, about 18 KB.
+class ExampleHdrHistogram {
+public:
+    static const uint32_t SUB_BUCKET_BITS = 6;
+    static const uint32_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const uint32_t MAX_BITS = 40;
+    static const uint32_t COUNT_LENGTH = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t count;
+    uint64_t total;
+    uint64_t maximum;
+
+public:
+    ExampleHdrHistogram();
+
+    void Record(const uint64_t value) {
+        this->counts[GetIndex(value)]++;
+        this->count++;
+        this->total += value;
+        this->maximum = value > this->maximum ? value : this->maximum;
+    }
+    void Reset();
+
+    uint64_t GetCount() const { return this->count; }
+    uint64_t GetTotal() const { return this->total; }
+    uint64_t GetMaximum() const { return this->maximum; }
+    double GetMean() const { return this->count == 0 ? 0.0 : (double)this->total / this->count; }
+
+    // Value at a percentile (0 - 100), the highest value of its bucket
+    uint64_t GetPercentile(const double percentile) const;
+
+    static uint32_t GetIndex(const uint64_t value);
+    static uint64_t GetHighestValue(const uint32_t index);
+};
+
+//
+// ExampleProfiler
+// ----------------------------------------------------------------------------
+class ExampleProfiler {
+public:
+    static const uint32_t MAX_DEPTH = 16;
+
+private:
+    struct Section {
+        std::string name;
+        ExampleHdrHistogram histogram;      // Duration of each call, ticks
+        uint64_t selfTicks;                 // Without the sections called from this one
+        uint64_t iterationSelfTicks;        // In the current iteration
+        uint32_t iterationCalls;
+    };
+    struct Frame {
+        uint32_t section;
+        uint64_t start;
+        uint64_t childTicks;
+    };
+
+    bool enabled;
+    double ticksPerNanosecond;
+    uint64_t slowIterationTicks;
+
+    std::vector<Section> sections;
+    std::vector<uint32_t> touched;      // Sections called in the current iteration
+    Frame stack[MAX_DEPTH];
+    uint32_t depth;
+
+    ExampleHdrHistogram iterations;
+    uint64_t iterationStart;            // 0 if the profiler was disabled at the start of the iteration
+    uint64_t iterationTicks;            // Sum of the iterations, for the share of each section
+
+    void printSlowIteration(const uint64_t ticks);
+
+public:
+    // Statistics
+    uint64_t slowIterations;
+
+    ExampleProfiler();
+
+    // One name per section id, ids are the positions in the list. Calibrates the clock.
+    void Initialize(const char* const* names, const uint32_t count, const uint32_t slowIterationMicroseconds);
+    void SetEnabled(const bool enabled) { this->enabled = enabled; }
+    bool IsEnabled() const { return this->enabled; }
+    void Reset();
+
+    // Around each iteration of the main loop. Iterations slower than the
+    // threshold are printed with their breakdown.
+    void BeginIteration();
+    void EndIteration();
+
+    // Use ExampleProfilerScope. Enter returns false if the section is not
+    // recorded, and Leave must not be called.
+    bool Enter(const uint32_t section) {
+        if (!this->enabled || this->depth >= MAX_DEPTH) {
+            return false;
+        }
+        Frame& frame = this->stack[this->depth++];
+        frame.section = section;
+        frame.childTicks = 0;
+        frame.start = ExampleProfilerClock::Now();
+        return true;
+    }
+    void Leave();
+
+    // Sections by self time with their call percentiles
+    void Print();
+
+    double ToNanoseconds(const uint64_t ticks) const { return ticks / this->ticksPerNanosecond; }
+    const ExampleHdrHistogram& GetHistogram(const uint32_t section) const { return this->sections[section].histogram; }
+    const ExampleHdrHistogram& GetIterations() const { return this->iterations; }
+    uint64_t GetSelfTicks(const uint32_t section) const { return this->sections[section].selfTicks; }
+};
+
+// Times the rest of the enclosing block as one call of a section
+class ExampleProfilerScope {
+private:
+    ExampleProfiler* profiler;
+    bool active;
+
+public:
+    ExampleProfilerScope(ExampleProfiler* profiler, const uint32_t section) : profiler(profiler) {
+        this->active = profiler->Enter(section);
+    }
+    ~ExampleProfilerScope() {
+        if (this->active) {
+            this->profiler->Leave();
+        }
+    }
+};
+
+#endif // __CASBACnetSCExampleProfiler_h__
@@ -0,0 +1,643 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExamplePropertyTable.cpp
+ *
+ * Property accessors and the declarative property lists.
+ * See CASBACnetSCExamplePropertyTable.h
+ */
+
+#include "CASBACnetSCExamplePropertyTable.h"
+#include "CASBACnetSCExampleApdu.h"
+#include "CASBACnetSCExampleConstants.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <time.h>
+
+// Accessors
+// ===========================================================================
+
+// Resolve the object of the request in the object store
+static bool FindObject(const ExamplePropertyRequest& request, ExampleObjectTable** table, uint32_t* row) {
+    if (request.cache != NULL) {
+        return request.database->objects.Find(request.objectType, request.objectInstance, request.cache, table, row);
+    }
+    return request.database->objects.Find(request.objectType, request.objectInstance, table, row);
+}
+
+static bool IsDevice(const ExamplePropertyRequest& request) {
+    return request.objectInstance == request.database->device.instance;
+}
+
+static bool CopyCharacterString(const ExamplePropertyRequest& request, const char* source, const uint32_t length, ExampleCharacterString* value) {
+    if (length > value->maxElementCount) {
+        std::cerr << "Error - not enough space to store full name of objectType=[" << request.objectType << "], objectInstance=[" << request.objectInstance << " ]" << std::endl;
+        return false;
+    }
+    memcpy(value->value, source, length);
+    *value->valueElementCount = length;
+    return true;
+}
+
+static bool GetLocalTime(struct tm* local) {
+    time_t currentTime = time(0);
+#ifdef _WIN32
+    return localtime_s(local, &currentTime) == 0;
+#else
+    return localtime_r(&currentTime, local) != NULL;
+#endif // _WIN32
+}
+
+// Object Name of objects in the object store
+static bool GetObjectName(const ExamplePropertyRequest& request, ExampleCharacterString* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindObject(request, &table, &row)) {
+        return false;
+    }
+    uint32_t length;
+    const char* name = request.database->objects.GetObjectName(table, row, &length);
+    return CopyCharacterString(request, name, length, value);
+}
+
+static bool GetPresentValue(const ExamplePropertyRequest& request, float* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindObject(request, &table, &row)) {
+        return false;
+    }
+    *value = table->presentValue[row];
+    return true;
+}
+
+static bool GetCovIncrement(const ExamplePropertyRequest& request, float* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindObject(request, &table, &row)) {
+        return false;
+    }
+    *value = table->covIncrement[row];
+    return true;
+}
+
+static bool GetReliability(const ExamplePropertyRequest& request, uint32_t* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindObject(request, &table, &row)) {
+        return false;
+    }
+    *value = table->reliability[row];
+    return true;
+}
+
+static bool GetDeviceObjectName(const ExamplePropertyRequest& request, ExampleCharacterString* value) {
+    if (!IsDevice(request)) {
+        return false;
+    }
+    const std::string& name = request.database->device.objectName;
+    return CopyCharacterString(request, name.c_str(), (uint32_t)name.size(), value);
+}
+
+static bool GetDeviceSystemStatus(const ExamplePropertyRequest& request, uint32_t* value) {
+    if (!IsDevice(request)) {
+        return false;
+    }
+    *value = request.database->device.systemStatus;
+    return true;
+}
+
+static bool GetDeviceLocalDate(const ExamplePropertyRequest& request, ExampleDate* value) {
+    struct tm local;
+    if (!IsDevice(request) || !GetLocalTime(&local)) {
+        return false;
+    }
+    *value->year = (uint8_t)local.tm_year;
+    *value->month = (uint8_t)(local.tm_mon + 1);
+    *value->day = (uint8_t)local.tm_mday;
+    *value->weekday = (uint8_t)(local.tm_wday == 0 ? 7 : local.tm_wday);
+    return true;
+}
+
+static bool GetDeviceLocalTime(const ExamplePropertyRequest& request, ExampleTime* value) {
+    struct tm local;
+    if (!IsDevice(request) || !GetLocalTime(&local)) {
+        return false;
+    }
+    *value->hour = (uint8_t)local.tm_hour;
+    *value->minute = (uint8_t)local.tm_min;
+    *value->second = (uint8_t)local.tm_sec;
+    *value->hundrethSeconds = 0;
+    return true;
+}
+
+// Minutes to add to local time to get UTC, so west of Greenwich is positive
+static bool GetDeviceUtcOffset(const ExamplePropertyRequest& request, int32_t* value) {
+    struct tm local;
+    if (!IsDevice(request) || !GetLocalTime(&local)) {
+        return false;
+    }
+    time_t currentTime = time(0);
+    struct tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &currentTime);
+#else
+    gmtime_r(&currentTime, &utc);
+#endif // _WIN32
+    utc.tm_isdst = local.tm_isdst;
+    *value = (int32_t)(difftime(mktime(&utc), mktime(&local)) / 60);
+    return true;
+}
+
+static bool GetDeviceDaylightSavingsStatus(const ExamplePropertyRequest& request, bool* value) {
+    struct tm local;
+    if (!IsDevice(request) || !GetLocalTime(&local)) {
+        return false;
+    }
+    *value = local.tm_isdst > 0;
+    return true;
+}
+
+// Commandable objects
+// ---------------------------------------------------------------------------
+// Binary and Multi-state values are stored as float, see CASBACnetSCExamplePriorityArray.h
+
+static bool FindCommandable(const ExamplePropertyRequest& request, ExampleObjectTable** table, uint32_t* row) {
+    return FindObject(request, table, row) && (*table)->commandable;
+}
+
+static bool GetPresentValueInteger(const ExamplePropertyRequest& request, uint32_t* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindObject(request, &table, &row)) {
+        return false;
+    }
+    *value = (uint32_t)table->presentValue[row];
+    return true;
+}
+
+// One slot of the Priority_Array, false for a NULL slot
+template <typename Value>
+static bool GetPriorityArray(const ExamplePropertyRequest& request, Value* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    float slot;
+    if (!request.useArrayIndex || request.propertyArrayIndex > ExamplePriorityArray::LENGTH || !FindCommandable(request, &table, &row) ||
+        !table->priorityArray[row].Get((uint8_t)request.propertyArrayIndex, &slot)) {
+        return false;
+    }
+    *value = (Value)slot;
+    return true;
+}
+
+template <typename Value>
+static bool GetRelinquishDefault(const ExamplePropertyRequest& request, Value* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindCommandable(request, &table, &row)) {
+        return false;
+    }
+    *value = (Value)table->priorityArray[row].relinquishDefault;
+    return true;
+}
+
+// NULL (false) while every slot is NULL
+static bool GetCurrentCommandPriority(const ExamplePropertyRequest& request, uint32_t* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindCommandable(request, &table, &row) || table->priorityArray[row].GetActivePriority() == 0) {
+        return false;
+    }
+    *value = table->priorityArray[row].GetActivePriority();
+    return true;
+}
+
+static bool GetNumberOfStates(const ExamplePropertyRequest& request, uint32_t* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindCommandable(request, &table, &row)) {
+        return false;
+    }
+    *value = ExampleDatabase::MULTI_STATE_NUMBER_OF_STATES;
+    return true;
+}
+
+// Binary objects take inactive (0) or active (1), Multi-state objects 1 to Number_Of_States
+static bool IsValidCommandValue(const uint16_t objectType, const float value) {
+    switch (objectType) {
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT:
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+        return value == 0.0f || value == 1.0f;
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT:
+    case CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+        return value >= 1.0f && value <= (float)ExampleDatabase::MULTI_STATE_NUMBER_OF_STATES;
+    default:
+        return true;
+    }
+}
+
+// Command the slot of the write's priority. A write without a priority is at the lowest (16).
+static bool SetPresentValue(const ExamplePropertyRequest& request, ExampleWriteValue* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindCommandable(request, &table, &row)) {
+        return false;
+    }
+    uint8_t priority = value->priority == 0 ? ExamplePriorityArray::LENGTH : value->priority;
+    if (!IsValidCommandValue(request.objectType, value->value) ||
+        !request.database->Command((size_t)(table - request.database->objects.tables.data()), row, priority, value->value)) {
+        *value->errorCode = CASBACnetStackExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+        return false;
+    }
+    return true;
+}
+
+// Writing NULL relinquishes the slot
+static bool RelinquishPresentValue(const ExamplePropertyRequest& request, ExampleWriteValue* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindCommandable(request, &table, &row)) {
+        return false;
+    }
+    uint8_t priority = value->priority == 0 ? ExamplePriorityArray::LENGTH : value->priority;
+    if (!request.database->Relinquish((size_t)(table - request.database->objects.tables.data()), row, priority)) {
+        *value->errorCode = CASBACnetStackExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+        return false;
+    }
+    return true;
+}
+
+static bool SetRelinquishDefault(const ExamplePropertyRequest& request, ExampleWriteValue* value) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (!FindCommandable(request, &table, &row)) {
+        return false;
+    }
+    if (!IsValidCommandValue(request.objectType, value->value)) {
+        *value->errorCode = CASBACnetStackExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+        return false;
+    }
+    request.database->SetRelinquishDefault((size_t)(table - request.database->objects.tables.data()), row, value->value);
+    return true;
+}
+
+// Property Lists
+// ===========================================================================
+// One list per callback kind. The stack asks for a property through the
+// callback of the property's datatype, so each property is listed once.
+
+static constexpr ExamplePropertyEntry<ExampleCharacterString> characterStringProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_DEVICE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetDeviceObjectName },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetObjectName },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetObjectName },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetObjectName },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetObjectName },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetObjectName },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetObjectName },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, &GetObjectName },
+};
+
+static constexpr ExamplePropertyEntry<float> realProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &GetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_COV_INCURMENT, &GetCovIncrement },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &GetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, &GetPriorityArray<float> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &GetRelinquishDefault<float> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &GetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, &GetPriorityArray<float> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &GetRelinquishDefault<float> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_COV_INCURMENT, &GetCovIncrement },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_COV_INCURMENT, &GetCovIncrement },
+};
+
+static constexpr ExamplePropertyEntry<uint32_t> enumeratedProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_INPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, &GetReliability },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, &GetReliability },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, &GetReliability },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, &GetReliability },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, &GetReliability },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, &GetReliability },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, &GetReliability },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_DEVICE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_SYSTEM_STATUS, &GetDeviceSystemStatus },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &GetPresentValueInteger },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, &GetPriorityArray<uint32_t> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &GetRelinquishDefault<uint32_t> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &GetPresentValueInteger },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, &GetPriorityArray<uint32_t> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &GetRelinquishDefault<uint32_t> },
+};
+
+static constexpr ExamplePropertyEntry<ExampleDate> dateProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_DEVICE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_LOCAL_DATE, &GetDeviceLocalDate },
+};
+
+static constexpr ExamplePropertyEntry<ExampleTime> timeProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_DEVICE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_LOCAL_TIME, &GetDeviceLocalTime },
+};
+
+static constexpr ExamplePropertyEntry<bool> boolProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_DEVICE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_DAY_LIGHT_SAVINGS_STATUS, &GetDeviceDaylightSavingsStatus },
+};
+
+static constexpr ExamplePropertyEntry<int32_t> signedIntegerProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_DEVICE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_UTC_OFFSET, &GetDeviceUtcOffset },
+};
+
+static constexpr ExamplePropertyEntry<uint32_t> unsignedIntegerProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &GetPresentValueInteger },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, &GetPriorityArray<uint32_t> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &GetRelinquishDefault<uint32_t> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_NUMBER_OF_STATES, &GetNumberOfStates },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &GetPresentValueInteger },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, &GetPriorityArray<uint32_t> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &GetRelinquishDefault<uint32_t> },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_NUMBER_OF_STATES, &GetNumberOfStates },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY, &GetCurrentCommandPriority },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY, &GetCurrentCommandPriority },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY, &GetCurrentCommandPriority },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY, &GetCurrentCommandPriority },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY, &GetCurrentCommandPriority },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_CURRENT_COMMAND_PRIORITY, &GetCurrentCommandPriority },
+};
+
+// Writable properties. Each Set Property callback has its own list.
+
+static constexpr ExamplePropertyEntry<ExampleWriteValue> realWriteProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &SetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &SetRelinquishDefault },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &SetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &SetRelinquishDefault },
+};
+
+static constexpr ExamplePropertyEntry<ExampleWriteValue> enumeratedWriteProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &SetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &SetRelinquishDefault },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &SetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &SetRelinquishDefault },
+};
+
+static constexpr ExamplePropertyEntry<ExampleWriteValue> unsignedIntegerWriteProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &SetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &SetRelinquishDefault },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &SetPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, &SetRelinquishDefault },
+};
+
+static constexpr ExamplePropertyEntry<ExampleWriteValue> nullWriteProperties[] = {
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &RelinquishPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_ANALOG_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &RelinquishPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &RelinquishPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_BINARY_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &RelinquishPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_OUTPUT, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &RelinquishPresentValue },
+    { CASBACnetStackExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, CASBACnetStackExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, &RelinquishPresentValue },
+};
+
+// Dispatch Tables
+// ===========================================================================
+// Built by the compiler from the lists above. Kinds without any properties
+// yet use an empty table.
+#define EXAMPLE_PROPERTY_COUNT(list) (sizeof(list) / sizeof(list[0]))
+
+static constexpr ExamplePropertyDispatch<ExampleCharacterString, EXAMPLE_PROPERTY_COUNT(characterStringProperties)> characterStringDispatch(characterStringProperties);
+static constexpr ExamplePropertyDispatch<float, EXAMPLE_PROPERTY_COUNT(realProperties)> realDispatch(realProperties);
+static constexpr ExamplePropertyDispatch<uint32_t, EXAMPLE_PROPERTY_COUNT(enumeratedProperties)> enumeratedDispatch(enumeratedProperties);
+static constexpr ExamplePropertyDispatch<ExampleDate, EXAMPLE_PROPERTY_COUNT(dateProperties)> dateDispatch(dateProperties);
+static constexpr ExamplePropertyDispatch<ExampleTime, EXAMPLE_PROPERTY_COUNT(timeProperties)> timeDispatch(timeProperties);
+static constexpr ExamplePropertyDispatch<bool, EXAMPLE_PROPERTY_COUNT(boolProperties)> boolDispatch(boolProperties);
+static constexpr ExamplePropertyDispatch<ExampleBitString, 0> bitStringDispatch(nullptr);
+static constexpr ExamplePropertyDispatch<double, 0> doubleDispatch(nullptr);
+static constexpr ExamplePropertyDispatch<ExampleOctetString, 0> octetStringDispatch(nullptr);
+static constexpr ExamplePropertyDispatch<int32_t, EXAMPLE_PROPERTY_COUNT(signedIntegerProperties)> signedIntegerDispatch(signedIntegerProperties);
+static constexpr ExamplePropertyDispatch<uint32_t, EXAMPLE_PROPERTY_COUNT(unsignedIntegerProperties)> unsignedIntegerDispatch(unsignedIntegerProperties);
+static constexpr ExamplePropertyDispatch<ExampleWriteValue, EXAMPLE_PROPERTY_COUNT(enumeratedWriteProperties)> enumeratedWriteDispatch(enumeratedWriteProperties);
+static constexpr ExamplePropertyDispatch<ExampleWriteValue, EXAMPLE_PROPERTY_COUNT(nullWriteProperties)> nullWriteDispatch(nullWriteProperties);
+static constexpr ExamplePropertyDispatch<ExampleWriteValue, EXAMPLE_PROPERTY_COUNT(realWriteProperties)> realWriteDispatch(realWriteProperties);
+static constexpr ExamplePropertyDispatch<ExampleWriteValue, EXAMPLE_PROPERTY_COUNT(unsignedIntegerWriteProperties)> unsignedIntegerWriteDispatch(unsignedIntegerWriteProperties);
+
+// Look up the accessor and call it
+template <typename Dispatch, typename Value>
+static bool ExamplePropertyCall(const Dispatch& dispatch, const ExamplePropertyRequest& request, Value* value) {
+    typename Dispatch::Function function = dispatch.Find(request.objectType, request.propertyIdentifier);
+    if (function == nullptr) {
+        return false;
+    }
+    return function(request, value);
+}
+
+//
+// ExamplePropertyTable
+// ----------------------------------------------------------------------------
+
+bool ExamplePropertyTable::GetBitString(const ExamplePropertyRequest& request, ExampleBitString* value) {
+    return ExamplePropertyCall(bitStringDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetBool(const ExamplePropertyRequest& request, bool* value) {
+    return ExamplePropertyCall(boolDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetCharacterString(const ExamplePropertyRequest& request, ExampleCharacterString* value) {
+    return ExamplePropertyCall(characterStringDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetDate(const ExamplePropertyRequest& request, ExampleDate* value) {
+    return ExamplePropertyCall(dateDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetDouble(const ExamplePropertyRequest& request, double* value) {
+    return ExamplePropertyCall(doubleDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetEnumerated(const ExamplePropertyRequest& request, uint32_t* value) {
+    return ExamplePropertyCall(enumeratedDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetOctetString(const ExamplePropertyRequest& request, ExampleOctetString* value) {
+    return ExamplePropertyCall(octetStringDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetSignedInteger(const ExamplePropertyRequest& request, int32_t* value) {
+    return ExamplePropertyCall(signedIntegerDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetReal(const ExamplePropertyRequest& request, float* value) {
+    return ExamplePropertyCall(realDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetTime(const ExamplePropertyRequest& request, ExampleTime* value) {
+    return ExamplePropertyCall(timeDispatch, request, value);
+}
+
+bool ExamplePropertyTable::GetUnsignedInteger(const ExamplePropertyRequest& request, uint32_t* value) {
+    return ExamplePropertyCall(unsignedIntegerDispatch, request, value);
+}
+
+bool ExamplePropertyTable::SetEnumerated(const ExamplePropertyRequest& request, ExampleWriteValue* value) {
+    return ExamplePropertyCall(enumeratedWriteDispatch, request, value);
+}
+
+bool ExamplePropertyTable::SetNull(const ExamplePropertyRequest& request, ExampleWriteValue* value) {
+    return ExamplePropertyCall(nullWriteDispatch, request, value);
+}
+
+bool ExamplePropertyTable::SetReal(const ExamplePropertyRequest& request, ExampleWriteValue* value) {
+    return ExamplePropertyCall(realWriteDispatch, request, value);
+}
+
+bool ExamplePropertyTable::SetUnsignedInteger(const ExamplePropertyRequest& request, ExampleWriteValue* value) {
+    return ExamplePropertyCall(unsignedIntegerWriteDispatch, request, value);
+}
+
+//
+// ExamplePropertyBatch
+// ----------------------------------------------------------------------------
+
+ExamplePropertyBatch::ExamplePropertyBatch() {
+    this->next = 0;
+    this->minObjects = MIN_OBJECTS;
+}
+
+void ExamplePropertyBatch::fetch(ExampleObjectStore& store, const uint16_t objectType, const uint32_t instance, ExampleObjectCache* entry) {
+    ExampleObjectTable* table;
+    uint32_t row;
+    if (store.Find(objectType, instance, entry, &table, &row)) {
+        table->Prefetch(row);
+    }
+}
+
+bool ExamplePropertyBatch::read(ExamplePropertyRequest* request, ExamplePropertyAccess* access) {
+    request->objectType = access->objectType;
+    request->objectInstance = access->objectInstance;
+    request->propertyIdentifier = access->propertyIdentifier;
+    request->useArrayIndex = access->useArrayIndex;
+    request->propertyArrayIndex = access->propertyArrayIndex;
+    switch (access->kind) {
+    case ExamplePropertyAccess::KIND_BOOL:
+        return ExamplePropertyTable::GetBool(*request, &access->boolValue);
+    case ExamplePropertyAccess::KIND_CHARACTER_STRING:
+        return ExamplePropertyTable::GetCharacterString(*request, &access->characterString);
+    case ExamplePropertyAccess::KIND_DOUBLE:
+        return ExamplePropertyTable::GetDouble(*request, &access->doubleValue);
+    case ExamplePropertyAccess::KIND_ENUMERATED:
+        return ExamplePropertyTable::GetEnumerated(*request, &access->unsignedValue);
+    case ExamplePropertyAccess::KIND_REAL:
+        return ExamplePropertyTable::GetReal(*request, &access->realValue);
+    case ExamplePropertyAccess::KIND_SIGNED_INTEGER:
+        return ExamplePropertyTable::GetSignedInteger(*request, &access->signedIntegerValue);
+    case ExamplePropertyAccess::KIND_UNSIGNED_INTEGER:
+        return ExamplePropertyTable::GetUnsignedInteger(*request, &access->unsignedValue);
+    default:
+        return false;
+    }
+}
+
+size_t ExamplePropertyBatch::Read(ExampleDatabase* database, ExamplePropertyAccess* accesses, const size_t count) {
+    ExampleObjectStore& objects = database->objects;
+    ExamplePropertyRequest request = { database, database->device.instance, 0, 0, 0, false, 0, &this->cache };
+    size_t found = 0;
+
+    // Put the accesses in object order, unless they already are
+    size_t offset = 0;
+    uint32_t previous = 0;
+    for (; offset < count; offset++) {
+        uint32_t key = ExampleObjectKey(accesses[offset].objectType, accesses[offset].objectInstance);
+        if (key < previous) {
+            break;
+        }
+        previous = key;
+    }
+    const bool ordered = offset == count;
+    if (!ordered) {
+        // The access index keeps the order of the properties of one object
+        this->order.clear();
+        for (offset = 0; offset < count; offset++) {
+            this->order.push_back(((uint64_t)ExampleObjectKey(accesses[offset].objectType, accesses[offset].objectInstance) << 32) | offset);
+        }
+        std::sort(this->order.begin(), this->order.end());
+    }
+
+    // Look every object up once and start loading its row, then its name, so
+    // the cache misses of all the objects overlap instead of each property
+    // waiting for its own. Any key is a valid object, so the first access
+    // starts an object whatever previous holds.
+    this->objects.clear();
+    for (offset = 0; offset < count; offset++) {
+        const ExamplePropertyAccess& access = accesses[ordered ? offset : (uint32_t)this->order[offset]];
+        uint32_t key = ExampleObjectKey(access.objectType, access.objectInstance);
+        if (offset != 0 && key == previous) {
+            continue;
+        }
+        previous = key;
+        this->objects.push_back(ExampleObjectCache());
+        this->fetch(objects, access.objectType, access.objectInstance, &this->objects.back());
+    }
+    for (const ExampleObjectCache& object : this->objects) {
+        objects.PrefetchName(object);
+    }
+
+    // Read, each object from its entry so it is not looked up again
+    size_t object = 0;
+    for (offset = 0; offset < count; offset++) {
+        ExamplePropertyAccess& access = accesses[ordered ? offset : (uint32_t)this->order[offset]];
+        uint32_t key = ExampleObjectKey(access.objectType, access.objectInstance);
+        if (offset == 0 || key != previous) {
+            this->cache = this->objects[object++];
+            previous = key;
+        }
+        access.found = this->read(&request, &access);
+        found += access.found;
+    }
+    return found;
+}
+
+size_t ExamplePropertyBatch::Prepare(ExampleDatabase* database, const uint8_t* frame, const size_t length) {
+    ExampleObjectStore& objects = database->objects;
+    this->prepared.clear();
+    this->next = 0;
+    if (objects.GetObjectCount() < this->minObjects) {
+        return 0;
+    }
+
+    // A read access specification takes at least 9 bytes
+    const size_t capacity = length / 9 + 1;
+    this->preparedTypes.resize(capacity);
+    this->preparedInstances.resize(capacity);
+    size_t count = ExampleApdu::ParseReadPropertyMultiple(frame, length, this->preparedTypes.data(), this->preparedInstances.data(), capacity);
+    if (count == 0) {
+        return 0;
+    }
+
+    // Look the objects up in object identifier order, then start loading
+    // their names, as Read does. The entries stay in request order, the
+    // order the stack reads them in.
+    this->order.clear();
+    for (size_t offset = 0; offset < count; offset++) {
+        this->order.push_back(((uint64_t)ExampleObjectKey(this->preparedTypes[offset], this->preparedInstances[offset]) << 32) | offset);
+    }
+    std::sort(this->order.begin(), this->order.end());
+    this->prepared.resize(count);
+    for (const uint64_t entry : this->order) {
+        const uint32_t offset = (uint32_t)entry;
+        this->fetch(objects, this->preparedTypes[offset], this->preparedInstances[offset], &this->prepared[offset]);
+    }
+    for (const ExampleObjectCache& object : this->prepared) {
+        objects.PrefetchName(object);
+    }
+    return count;
+}
+
+void ExamplePropertyBatch::Resolve(const uint16_t objectType, const uint32_t instance, ExampleObjectCache* cache) {
+    const uint32_t key = ExampleObjectKey(objectType, instance);
+    if (cache->key == key) {
+        return; // Another property of the object in cache
+    }
+    // Usually the next one, objects the stack skips are passed over
+    for (size_t offset = this->next; offset < this->prepared.size(); offset++) {
+        if (this->prepared[offset].key == key) {
+            *cache = this->prepared[offset];
+            this->next = offset + 1;
+            return;
+        }
+    }
+}
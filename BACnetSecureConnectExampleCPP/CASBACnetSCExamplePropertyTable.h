@@ -0,0 +1,296 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExamplePropertyTable.h
+ *
+ * Table driven dispatch for the CAS BACnet Stack Get Property and Set
+ * Property callbacks.
+ *
+ * Each callback kind (Real, Enumerated, CharacterString, ...) has a declarative
+ * list of (objectType, propertyIdentifier, accessor) entries in
+ * CASBACnetSCExamplePropertyTable.cpp. At compile time every list is turned
+ * into a collision free hash table, so a property read is one multiply, one
+ * compare and one call no matter how many properties are in the list.
+ *
+ * To serve a new property add one line to the list for its datatype.
+ * Writable properties have their own lists, one per Set Property callback.
+ *
+ * ExamplePropertyBatch serves many properties at once, e.g. all of a
+ * ReadPropertyMultiple, looking each object up only once. For the requests
+ * the stack serves, it looks the objects up ahead of the Get Property
+ * callbacks and hands each one to the object cache in turn.
+ */
+
+#ifndef __CASBACnetSCExamplePropertyTable_h__
+#define __CASBACnetSCExamplePropertyTable_h__
+
+#include "CASBACnetSCExampleDatabase.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Arguments shared by every Get Property callback
+struct ExamplePropertyRequest {
+    ExampleDatabase* database;
+    uint32_t deviceInstance;
+    uint16_t objectType;
+    uint32_t objectInstance;
+    uint32_t propertyIdentifier;
+    bool useArrayIndex;
+    uint32_t propertyArrayIndex;
+    // Optional, NULL looks every object up in the index. See ExampleObjectCache.
+    ExampleObjectCache* cache;
+};
+
+// Value of a Set Property callback, converted to float for every datatype.
+// See CASBACnetSCExamplePriorityArray.h
+struct ExampleWriteValue {
+    float value;            // Not used by SetNull
+    uint8_t priority;       // 1 - 16, 0 if the request has none
+    uint32_t* errorCode;    // Set when the write is rejected
+};
+
+// Output buffers for the callback kinds that return more than one value
+struct ExampleCharacterString {
+    char* value;
+    uint32_t* valueElementCount;
+    uint32_t maxElementCount;
+    uint8_t* encodingType;
+};
+
+struct ExampleOctetString {
+    uint8_t* value;
+    uint32_t* valueElementCount;
+    uint32_t maxElementCount;
+};
+
+struct ExampleBitString {
+    bool* value;
+    uint32_t* valueElementCount;
+    uint32_t maxElementCount;
+};
+
+struct ExampleDate {
+    uint8_t* year;      // Years since 1900
+    uint8_t* month;     // 1 - 12
+    uint8_t* day;       // 1 - 31
+    uint8_t* weekday;   // 1 (Monday) - 7 (Sunday)
+};
+
+struct ExampleTime {
+    uint8_t* hour;
+    uint8_t* minute;
+    uint8_t* second;
+    uint8_t* hundrethSeconds;
+};
+
+// One property of an ExamplePropertyBatch, read through the Get Property
+// callback kind of its datatype
+struct ExamplePropertyAccess {
+    static const uint8_t KIND_BOOL = 0;
+    static const uint8_t KIND_CHARACTER_STRING = 1;
+    static const uint8_t KIND_DOUBLE = 2;
+    static const uint8_t KIND_ENUMERATED = 3;
+    static const uint8_t KIND_REAL = 4;
+    static const uint8_t KIND_SIGNED_INTEGER = 5;
+    static const uint8_t KIND_UNSIGNED_INTEGER = 6;
+
+    uint16_t objectType;
+    uint32_t objectInstance;
+    uint32_t propertyIdentifier;
+    bool useArrayIndex;
+    uint32_t propertyArrayIndex;
+    uint8_t kind;
+    bool found;     // Set by ExamplePropertyBatch::Read
+
+    union {
+        bool boolValue;
+        double doubleValue;
+        float realValue;
+        int32_t signedIntegerValue;
+        uint32_t unsignedValue;                     // Enumerated and Unsigned Integer
+        ExampleCharacterString characterString;     // Buffers given by the caller
+    };
+};
+
+// Property identifier is 22 bits, the same split as a BACnet object identifier
+constexpr uint32_t ExamplePropertyKey(const uint16_t objectType, const uint32_t propertyIdentifier) {
+    return ((uint32_t)objectType << 22) | (propertyIdentifier & 0x3FFFFF);
+}
+
+// Smallest power of two that is at least four times the number of entries
+constexpr size_t ExamplePropertyDispatchSize(const size_t count) {
+    size_t size = 4;
+    while (size < count * 4) {
+        size <<= 1;
+    }
+    return size;
+}
+
+constexpr uint8_t ExamplePropertyDispatchBits(const size_t size) {
+    uint8_t bits = 0;
+    while (((size_t)1 << bits) < size) {
+        bits++;
+    }
+    return bits;
+}
+
+template <typename Value>
+struct ExamplePropertyEntry {
+    typedef bool (*Function)(const ExamplePropertyRequest& request, Value* value);
+
+    uint16_t objectType;
+    uint32_t propertyIdentifier;
+    Function function;
+};
+
+//
+// ExamplePropertyDispatch
+// ----------------------------------------------------------------------------
+// Perfect hash of (objectType, propertyIdentifier) -> accessor, built by the
+// compiler from a constexpr list of ExamplePropertyEntry.
+// The constructor searches for a multiplier that maps every key to its own
+// slot. A duplicate entry in the list is a compile error.
+template <typename Value, size_t COUNT>
+class ExamplePropertyDispatch {
+public:
+    typedef typename ExamplePropertyEntry<Value>::Function Function;
+
+    static constexpr size_t SIZE = ExamplePropertyDispatchSize(COUNT);
+    static constexpr uint32_t EMPTY_KEY = 0xFFFFFFFF;
+
+    uint32_t keys[SIZE];
+    Function functions[SIZE];
+    uint32_t multiplier;
+    uint8_t shift;
+
+    constexpr explicit ExamplePropertyDispatch(const ExamplePropertyEntry<Value>* entries)
+        : keys()
+        , functions()
+        , multiplier(0x9E3779B1u)
+        , shift((uint8_t)(32 - ExamplePropertyDispatchBits(SIZE))) {
+        for (size_t first = 0; first < COUNT; first++) {
+            for (size_t second = first + 1; second < COUNT; second++) {
+                if (ExamplePropertyKey(entries[first].objectType, entries[first].propertyIdentifier) == ExamplePropertyKey(entries[second].objectType, entries[second].propertyIdentifier)) {
+                    throw "Duplicate entry in property list";
+                }
+            }
+        }
+
+        for (;;) {
+            for (size_t slot = 0; slot < SIZE; slot++) {
+                this->keys[slot] = EMPTY_KEY;
+                this->functions[slot] = nullptr;
+            }
+
+            bool collision = false;
+            for (size_t offset = 0; offset < COUNT && !collision; offset++) {
+                uint32_t key = ExamplePropertyKey(entries[offset].objectType, entries[offset].propertyIdentifier);
+                uint32_t slot = (uint32_t)(key * this->multiplier) >> this->shift;
+                if (this->keys[slot] != EMPTY_KEY) {
+                    collision = true;
+                }
+                else {
+                    this->keys[slot] = key;
+                    this->functions[slot] = entries[offset].function;
+                }
+            }
+            if (!collision) {
+                return;
+            }
+            // Next odd multiplier. A small step would barely move the top bits.
+            this->multiplier = (this->multiplier * 1664525u + 1013904223u) | 1u;
+        }
+    }
+
+    Function Find(const uint16_t objectType, const uint32_t propertyIdentifier) const {
+        uint32_t key = ExamplePropertyKey(objectType, propertyIdentifier);
+        uint32_t slot = (uint32_t)(key * this->multiplier) >> this->shift;
+        return this->keys[slot] == key ? this->functions[slot] : nullptr;
+    }
+};
+
+//
+// ExamplePropertyTable
+// ----------------------------------------------------------------------------
+// One entry point per Get Property callback kind. Each returns false if the
+// property is not in the table or the object does not exist, which lets the
+// CAS BACnet Stack fall back to its own value.
+class ExamplePropertyTable {
+public:
+    static bool GetBitString(const ExamplePropertyRequest& request, ExampleBitString* value);
+    static bool GetBool(const ExamplePropertyRequest& request, bool* value);
+    static bool GetCharacterString(const ExamplePropertyRequest& request, ExampleCharacterString* value);
+    static bool GetDate(const ExamplePropertyRequest& request, ExampleDate* value);
+    static bool GetDouble(const ExamplePropertyRequest& request, double* value);
+    static bool GetEnumerated(const ExamplePropertyRequest& request, uint32_t* value);
+    static bool GetOctetString(const ExamplePropertyRequest& request, ExampleOctetString* value);
+    static bool GetSignedInteger(const ExamplePropertyRequest& request, int32_t* value);
+    static bool GetReal(const ExamplePropertyRequest& request, float* value);
+    static bool GetTime(const ExamplePropertyRequest& request, ExampleTime* value);
+    static bool GetUnsignedInteger(const ExamplePropertyRequest& request, uint32_t* value);
+
+    // Set Property callbacks. Return false if the property is not writable
+    // or the value is rejected.
+    static bool SetEnumerated(const ExamplePropertyRequest& request, ExampleWriteValue* value);
+    static bool SetNull(const ExamplePropertyRequest& request, ExampleWriteValue* value);
+    static bool SetReal(const ExamplePropertyRequest& request, ExampleWriteValue* value);
+    static bool SetUnsignedInteger(const ExamplePropertyRequest& request, ExampleWriteValue* value);
+};
+
+//
+// ExamplePropertyBatch
+// ----------------------------------------------------------------------------
+// Reads many properties at once. The accesses are visited grouped by object,
+// in object identifier order, so the tables are walked forward. Accesses that
+// are already in that order, as a ReadPropertyMultiple usually lists them,
+// are not sorted. Every object is looked up and its row prefetched before
+// the first property is read.
+//
+// The stack reads the properties of a ReadPropertyMultiple itself, one Get
+// Property callback at a time. Prepare looks the objects of the request up
+// the same way when the frame is received, and Resolve then puts each one in
+// the cache of the callbacks when they get to it, so they do not go through
+// the index. Below MIN_OBJECTS objects the rows stay in the CPU cache and the
+// extra pass costs more than it saves, so Prepare does nothing there.
+class ExamplePropertyBatch {
+private:
+    ExampleObjectCache cache;
+    std::vector<uint64_t> order;    // Object key << 32 | access index
+    std::vector<ExampleObjectCache> objects;    // Each object of the batch, in read order
+
+    // Objects of the request prepared, in request order
+    std::vector<uint16_t> preparedTypes;
+    std::vector<uint32_t> preparedInstances;
+    std::vector<ExampleObjectCache> prepared;
+    size_t next;                    // First prepared object not resolved yet
+    size_t minObjects;
+
+    bool read(ExamplePropertyRequest* request, ExamplePropertyAccess* access);
+    // Look an object up and start loading its row
+    void fetch(ExampleObjectStore& store, const uint16_t objectType, const uint32_t instance, ExampleObjectCache* entry);
+
+public:
+    // See the rpm benchmark: at 100k objects the batch is slower than the
+    // cached callbacks, at 1M objects faster
+    static const size_t MIN_OBJECTS = 500000;
+
+    ExamplePropertyBatch();
+
+    // Prepare requests from this many objects on, MIN_OBJECTS by default
+    void SetMinObjects(const size_t count) { this->minObjects = count; }
+
+    // Sets found of every access. Returns how many were found.
+    size_t Read(ExampleDatabase* database, ExamplePropertyAccess* accesses, const size_t count);
+
+    // Look up the objects of a received ReadPropertyMultiple request, before
+    // the stack reads them. Any other frame clears the objects prepared.
+    // Returns how many objects were prepared.
+    size_t Prepare(ExampleDatabase* database, const uint8_t* frame, const size_t length);
+    // From a Get Property callback, before ExampleObjectStore::Find: when the
+    // object is not the one in cache, put it there if it was prepared
+    void Resolve(const uint16_t objectType, const uint32_t instance, ExampleObjectCache* cache);
+};
+
+#endif // __CASBACnetSCExamplePropertyTable_h__
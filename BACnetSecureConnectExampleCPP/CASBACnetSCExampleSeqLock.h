@@ -0,0 +1,116 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleSeqLock.h
+ *
+ * Lock free building blocks for values that field I/O threads write while
+ * the CAS BACnet Stack reads them on the stack thread.
+ *
+ * ExampleAtomic is a value slot that is never torn. Loads and stores are
+ * relaxed single instructions on x86 and ARM, as cheap as a plain variable.
+ * It can be copied so it can be stored in a std::vector column.
+ *
+ * ExampleSeqLock guards a group of slots that must be read together (e.g. a
+ * present value and its reliability). Writers never wait for readers; a
+ * reader that overlaps a write retries. Several writers may share a lock,
+ * they take turns.
+ */
+
+#ifndef __CASBACnetSCExampleSeqLock_h__
+#define __CASBACnetSCExampleSeqLock_h__
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EXAMPLE_SPIN_PAUSE() _mm_pause()
+#else
+#define EXAMPLE_SPIN_PAUSE() std::this_thread::yield()
+#endif
+
+// Wait in a spin loop. After a few pauses give the core away instead, the
+// thread holding the lock may have been preempted and cannot finish until
+// it runs again.
+inline void ExampleSpinWait(uint32_t* spins) {
+    if (++*spins < 64) {
+        EXAMPLE_SPIN_PAUSE();
+    }
+    else {
+        std::this_thread::yield();
+    }
+}
+
+template <typename Value>
+class ExampleAtomic {
+private:
+    std::atomic<Value> value;
+
+public:
+    ExampleAtomic() : value(Value()) {}
+    ExampleAtomic(const Value value) : value(value) {}
+    ExampleAtomic(const ExampleAtomic& other) : value(other.Load()) {}
+
+    ExampleAtomic& operator=(const ExampleAtomic& other) {
+        this->Store(other.Load());
+        return *this;
+    }
+    ExampleAtomic& operator=(const Value value) {
+        this->Store(value);
+        return *this;
+    }
+    operator Value() const { return this->Load(); }
+
+    Value Load(const std::memory_order order = std::memory_order_relaxed) const { return this->value.load(order); }
+    void Store(const Value value, const std::memory_order order = std::memory_order_relaxed) { this->value.store(value, order); }
+    std::atomic<Value>& Get() { return this->value; }
+};
+
+typedef ExampleAtomic<float> ExampleAtomicFloat;
+typedef ExampleAtomic<uint32_t> ExampleAtomicUInt32;
+typedef ExampleAtomic<uint64_t> ExampleAtomicUInt64;
+
+class ExampleSeqLock {
+private:
+    // Odd while a write is in progress
+    std::atomic<uint32_t> sequence;
+
+public:
+    ExampleSeqLock() : sequence(0) {}
+    ExampleSeqLock(const ExampleSeqLock&) : sequence(0) {}
+    ExampleSeqLock& operator=(const ExampleSeqLock&) { return *this; }
+
+    // Reader: begin, load the values, then retry from the start if ReadRetry is true
+    uint32_t ReadBegin() const {
+        uint32_t spins = 0;
+        for (;;) {
+            uint32_t value = this->sequence.load(std::memory_order_acquire);
+            if ((value & 1) == 0) {
+                return value;
+            }
+            ExampleSpinWait(&spins);
+        }
+    }
+    bool ReadRetry(const uint32_t begin) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return this->sequence.load(std::memory_order_relaxed) != begin;
+    }
+
+    // Writer: lock, store the values, unlock
+    void WriteLock() {
+        uint32_t spins = 0;
+        for (;;) {
+            uint32_t value = this->sequence.load(std::memory_order_relaxed);
+            if ((value & 1) == 0 && this->sequence.compare_exchange_weak(value, value + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                break;
+            }
+            ExampleSpinWait(&spins);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void WriteUnlock() {
+        this->sequence.store(this->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+#endif // __CASBACnetSCExampleSeqLock_h__
@@ -0,0 +1,269 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleSnapshot.cpp
+ *
+ * See CASBACnetSCExampleSnapshot.h
+ */
+
+#include "CASBACnetSCExampleSnapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stddef.h>
+#include <string.h>
+
+static_assert(sizeof(ExampleSnapshotHeader) == 64, "Snapshot header must be 64 bytes");
+static_assert(sizeof(ExampleSnapshotSlotHeader) == 32, "Snapshot slot header must be 32 bytes");
+
+static const size_t SNAPSHOT_PAGE_SIZE = 4096;
+static const size_t SNAPSHOT_SLOT_HEADER_SIZE = 64;
+// Rows compared at a time when saving, one page of floats
+static const size_t SNAPSHOT_BLOCK_ROWS = 1024;
+
+static size_t SnapshotAlign(const size_t value) {
+    return (value + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE * SNAPSHOT_PAGE_SIZE;
+}
+
+static size_t SnapshotObjectCount(const ExampleObjectStore& store) {
+    size_t count = 0;
+    for (const ExampleObjectTable& table : store.tables) {
+        count += table.Size();
+    }
+    return count;
+}
+
+// CRC-32 (IEEE 802.3), slicing by 4: four table lookups per 32 bit word
+struct SnapshotCRCTable {
+    uint32_t entries[4][256];
+
+    SnapshotCRCTable() {
+        for (uint32_t value = 0; value < 256; value++) {
+            uint32_t entry = value;
+            for (int bit = 0; bit < 8; bit++) {
+                entry = (entry & 1) ? (entry >> 1) ^ 0xEDB88320u : entry >> 1;
+            }
+            this->entries[0][value] = entry;
+        }
+        for (uint32_t value = 0; value < 256; value++) {
+            for (int slice = 1; slice < 4; slice++) {
+                uint32_t previous = this->entries[slice - 1][value];
+                this->entries[slice][value] = (previous >> 8) ^ this->entries[0][previous & 0xFF];
+            }
+        }
+    }
+};
+
+static uint32_t SnapshotCRC(uint32_t crc, const uint8_t* data, const size_t length) {
+    static const SnapshotCRCTable table;
+    crc = ~crc;
+    size_t offset = 0;
+    for (; offset + 4 <= length; offset += 4) {
+        crc ^= (uint32_t)data[offset] | ((uint32_t)data[offset + 1] << 8) | ((uint32_t)data[offset + 2] << 16) | ((uint32_t)data[offset + 3] << 24);
+        crc = table.entries[3][crc & 0xFF] ^ table.entries[2][(crc >> 8) & 0xFF] ^ table.entries[1][(crc >> 16) & 0xFF] ^ table.entries[0][crc >> 24];
+    }
+    for (; offset < length; offset++) {
+        crc = table.entries[0][(crc ^ data[offset]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Copy the rows of source that differ from destination, one block at a time.
+// The source slots may be written by field I/O threads, so each block is
+// loaded into a local buffer first. Returns the number of bytes copied.
+template <typename Value>
+static size_t SnapshotCopyChanged(Value* destination, const ExampleAtomic<Value>* source, const size_t count) {
+    Value block[SNAPSHOT_BLOCK_ROWS];
+    size_t copied = 0;
+    for (size_t first = 0; first < count; first += SNAPSHOT_BLOCK_ROWS) {
+        size_t rows = std::min(SNAPSHOT_BLOCK_ROWS, count - first);
+        for (size_t row = 0; row < rows; row++) {
+            block[row] = source[first + row].Load();
+        }
+        if (memcmp(destination + first, block, rows * sizeof(Value)) != 0) {
+            memcpy(destination + first, block, rows * sizeof(Value));
+            copied += rows * sizeof(Value);
+        }
+    }
+    return copied;
+}
+
+ExampleSnapshot::ExampleSnapshot() {
+    memset(&this->header, 0, sizeof(this->header));
+    this->generation = 0;
+    this->newestSlot = -1;
+    this->lastSaveBytes = 0;
+    this->lastSaveSeconds = 0;
+}
+
+uint64_t ExampleSnapshot::GetLayoutHash(const ExampleObjectStore& store) {
+    // FNV-1a over the object identifiers in row order
+    uint64_t hash = 14695981039346656037ull;
+    for (const ExampleObjectTable& table : store.tables) {
+        for (uint32_t instance : table.instance) {
+            uint32_t key = ExampleObjectKey(table.objectType, instance);
+            for (int shift = 0; shift < 32; shift += 8) {
+                hash = (hash ^ ((key >> shift) & 0xFF)) * 1099511628211ull;
+            }
+        }
+    }
+    return hash;
+}
+
+uint8_t* ExampleSnapshot::getSlot(const uint32_t slot) const {
+    return this->file.GetWritableData() + this->header.slotOffset[slot];
+}
+
+bool ExampleSnapshot::isSlotValid(const uint32_t slot, uint64_t* generation) const {
+    const uint8_t* data = this->getSlot(slot);
+    ExampleSnapshotSlotHeader slotHeader;
+    memcpy(&slotHeader, data, sizeof(slotHeader));
+    if (slotHeader.generation == 0 || slotHeader.layoutHash != this->header.layoutHash || slotHeader.objectCount != this->header.objectCount) {
+        return false;
+    }
+    uint32_t crc = SnapshotCRC(0, data, offsetof(ExampleSnapshotSlotHeader, crc));
+    crc = SnapshotCRC(crc, data + SNAPSHOT_SLOT_HEADER_SIZE, (size_t)this->header.objectCount * (sizeof(float) + sizeof(uint32_t)));
+    if (crc != slotHeader.crc) {
+        return false;
+    }
+    *generation = slotHeader.generation;
+    return true;
+}
+
+int32_t ExampleSnapshot::getNewestSlot(uint64_t* generation) const {
+    // Check the slot with the higher generation first, the other one is only
+    // needed when that fails its CRC
+    uint64_t generations[EXAMPLE_SNAPSHOT_SLOT_COUNT];
+    for (uint32_t slot = 0; slot < EXAMPLE_SNAPSHOT_SLOT_COUNT; slot++) {
+        memcpy(&generations[slot], this->getSlot(slot) + offsetof(ExampleSnapshotSlotHeader, generation), sizeof(uint64_t));
+    }
+    uint32_t first = generations[1] > generations[0] ? 1 : 0;
+    uint32_t order[EXAMPLE_SNAPSHOT_SLOT_COUNT] = { first, 1 - first };
+    for (uint32_t slot : order) {
+        if (this->isSlotValid(slot, generation)) {
+            return (int32_t)slot;
+        }
+    }
+    *generation = 0;
+    return -1;
+}
+
+bool ExampleSnapshot::Open(const std::string& path, const ExampleObjectStore& store) {
+    this->Close();
+
+    const size_t objectCount = SnapshotObjectCount(store);
+    const uint64_t layoutHash = ExampleSnapshot::GetLayoutHash(store);
+    const size_t slotSize = SnapshotAlign(SNAPSHOT_SLOT_HEADER_SIZE + objectCount * (sizeof(float) + sizeof(uint32_t)));
+    if (!this->file.OpenWritable(path, SNAPSHOT_PAGE_SIZE + EXAMPLE_SNAPSHOT_SLOT_COUNT * slotSize)) {
+        std::cerr << "Error: Could not map snapshot file [" << path << "]" << std::endl;
+        return false;
+    }
+
+    uint8_t* data = this->file.GetWritableData();
+    memcpy(&this->header, data, sizeof(this->header));
+    if (memcmp(this->header.magic, EXAMPLE_SNAPSHOT_MAGIC, sizeof(this->header.magic)) != 0 || this->header.version != EXAMPLE_SNAPSHOT_VERSION ||
+        this->header.objectCount != objectCount || this->header.layoutHash != layoutHash || this->header.slotSize != slotSize) {
+        // New file, or a snapshot of other objects. Start with both slots empty.
+        memset(&this->header, 0, sizeof(this->header));
+        memcpy(this->header.magic, EXAMPLE_SNAPSHOT_MAGIC, sizeof(this->header.magic));
+        this->header.version = EXAMPLE_SNAPSHOT_VERSION;
+        this->header.objectCount = (uint32_t)objectCount;
+        this->header.layoutHash = layoutHash;
+        this->header.slotSize = slotSize;
+        for (uint32_t slot = 0; slot < EXAMPLE_SNAPSHOT_SLOT_COUNT; slot++) {
+            this->header.slotOffset[slot] = SNAPSHOT_PAGE_SIZE + slot * slotSize;
+            memset(data + this->header.slotOffset[slot], 0, SNAPSHOT_SLOT_HEADER_SIZE);
+        }
+        memcpy(data, &this->header, sizeof(this->header));
+        if (!this->file.Flush(0, this->file.GetSize())) {
+            std::cerr << "Error: Could not write snapshot file [" << path << "]" << std::endl;
+            this->Close();
+            return false;
+        }
+    }
+
+    this->newestSlot = this->getNewestSlot(&this->generation);
+    return true;
+}
+
+void ExampleSnapshot::Close() {
+    this->file.Close();
+    memset(&this->header, 0, sizeof(this->header));
+    this->generation = 0;
+    this->newestSlot = -1;
+}
+
+bool ExampleSnapshot::Restore(ExampleObjectStore* store) {
+    if (!this->file.IsOpen() || SnapshotObjectCount(*store) != this->header.objectCount) {
+        return false;
+    }
+    if (this->newestSlot < 0) {
+        return false;
+    }
+
+    const uint8_t* data = this->getSlot((uint32_t)this->newestSlot) + SNAPSHOT_SLOT_HEADER_SIZE;
+    const float* presentValues = (const float*)data;
+    const uint32_t* reliabilities = (const uint32_t*)(data + (size_t)this->header.objectCount * sizeof(float));
+    size_t first = 0;
+    for (ExampleObjectTable& table : store->tables) {
+        for (uint32_t row = 0; row < table.Size(); row++) {
+            table.presentValue[row].Store(presentValues[first + row]);
+            table.reliability[row].Store(reliabilities[first + row]);
+            if (table.commandable) {
+                // The commands are not saved, the restored value holds until the next one
+                table.priorityArray[row].Initialize(presentValues[first + row]);
+            }
+        }
+        first += table.Size();
+    }
+    return true;
+}
+
+bool ExampleSnapshot::Save(const ExampleObjectStore& store, const uint64_t savedTime) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!this->file.IsOpen() || SnapshotObjectCount(store) != this->header.objectCount) {
+        return false;
+    }
+
+    // Overwrite the slot that does not hold the newest snapshot
+    uint32_t slot = this->newestSlot == 0 ? 1 : 0;
+    uint8_t* slotData = this->getSlot(slot);
+    uint8_t* data = slotData + SNAPSHOT_SLOT_HEADER_SIZE;
+    float* presentValues = (float*)data;
+    uint32_t* reliabilities = (uint32_t*)(data + (size_t)this->header.objectCount * sizeof(float));
+
+    size_t copied = 0;
+    size_t first = 0;
+    for (const ExampleObjectTable& table : store.tables) {
+        copied += SnapshotCopyChanged(presentValues + first, table.presentValue.data(), table.Size());
+        copied += SnapshotCopyChanged(reliabilities + first, table.reliability.data(), table.Size());
+        first += table.Size();
+    }
+
+    // 1. Data on disk before the header that makes it valid
+    const size_t dataSize = (size_t)this->header.objectCount * (sizeof(float) + sizeof(uint32_t));
+    if (!this->file.Flush((size_t)this->header.slotOffset[slot] + SNAPSHOT_SLOT_HEADER_SIZE, dataSize)) {
+        return false;
+    }
+
+    // 2. Header with the next generation. The CRC covers the header and data.
+    ExampleSnapshotSlotHeader slotHeader;
+    memset(&slotHeader, 0, sizeof(slotHeader));
+    slotHeader.generation = this->generation + 1;
+    slotHeader.savedTime = savedTime;
+    slotHeader.layoutHash = this->header.layoutHash;
+    slotHeader.objectCount = this->header.objectCount;
+    slotHeader.crc = SnapshotCRC(0, (const uint8_t*)&slotHeader, offsetof(ExampleSnapshotSlotHeader, crc));
+    slotHeader.crc = SnapshotCRC(slotHeader.crc, data, dataSize);
+    memcpy(slotData, &slotHeader, sizeof(slotHeader));
+    if (!this->file.Flush((size_t)this->header.slotOffset[slot], sizeof(slotHeader))) {
+        return false;
+    }
+
+    this->generation = slotHeader.generation;
+    this->newestSlot = (int32_t)slot;
+    this->lastSaveBytes = copied;
+    this->lastSaveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
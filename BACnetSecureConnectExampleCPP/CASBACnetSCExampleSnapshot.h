@@ -0,0 +1,98 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleSnapshot.h
+ *
+ * Memory mapped snapshot of the object store values for warm restarts.
+ *
+ * The present value and reliability of every object are kept in a mapped
+ * file, so a restart restores the previous state with one pass per column
+ * instead of waiting for the field side to report every value again.
+ *
+ * Crash consistency: the file has two slots. Save writes the older slot,
+ * flushes the data, then writes and flushes that slot's header with the next
+ * generation number and a CRC of the header and data. A crash before the
+ * header reaches the disk leaves a slot whose CRC does not match, and
+ * Restore uses the other slot, which holds the previous complete snapshot.
+ *
+ * Save only copies the blocks of a column that differ from what the slot
+ * already holds, so only the pages that changed are written back.
+ *
+ * File layout (little endian):
+ *	ExampleSnapshotHeader, padded to one page
+ *	Slot 0: ExampleSnapshotSlotHeader, presentValue[objectCount], reliability[objectCount]
+ *	Slot 1: same as slot 0
+ * Values are in object store row order, tables one after the other. The
+ * layout hash identifies that order; a snapshot of a different set of
+ * objects is not restored.
+ */
+
+#ifndef __CASBACnetSCExampleSnapshot_h__
+#define __CASBACnetSCExampleSnapshot_h__
+
+#include "CASBACnetSCExampleMappedFile.h"
+#include "CASBACnetSCExampleObjectStore.h"
+
+#include <stdint.h>
+#include <string>
+
+static const char EXAMPLE_SNAPSHOT_MAGIC[8] = { 'C', 'A', 'S', 'S', 'N', 'A', 'P', 'S' };
+static const uint32_t EXAMPLE_SNAPSHOT_VERSION = 1;
+static const uint32_t EXAMPLE_SNAPSHOT_SLOT_COUNT = 2;
+
+struct ExampleSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t objectCount;
+    uint64_t layoutHash;
+    uint64_t slotOffset[EXAMPLE_SNAPSHOT_SLOT_COUNT];
+    uint64_t slotSize;
+    uint64_t reserved[2];
+};
+
+struct ExampleSnapshotSlotHeader {
+    uint64_t generation;    // 0 is an empty slot
+    uint64_t savedTime;     // Unix time
+    uint64_t layoutHash;
+    uint32_t objectCount;
+    uint32_t crc;           // CRC-32 of the fields above and the slot data
+};
+
+class ExampleSnapshot {
+private:
+    ExampleMappedFile file;
+    ExampleSnapshotHeader header;
+    uint64_t generation;    // Newest valid generation in the file
+    int32_t newestSlot;     // Slot holding it, -1 if none
+
+    uint8_t* getSlot(const uint32_t slot) const;
+    bool isSlotValid(const uint32_t slot, uint64_t* generation) const;
+    int32_t getNewestSlot(uint64_t* generation) const;
+
+public:
+    // Statistics of the last Save
+    size_t lastSaveBytes;   // Bytes that differed and were copied
+    double lastSaveSeconds;
+
+    ExampleSnapshot();
+
+    // Map the snapshot file for this set of objects. A missing file, or one
+    // for a different set of objects, is started empty.
+    bool Open(const std::string& path, const ExampleObjectStore& store);
+    void Close();
+
+    // Copy the newest complete snapshot into the store. Returns false if the
+    // file holds none.
+    bool Restore(ExampleObjectStore* store);
+
+    // Write the store values as the next generation
+    bool Save(const ExampleObjectStore& store, const uint64_t savedTime);
+
+    uint64_t GetGeneration() const { return this->generation; }
+    bool IsOpen() const { return this->file.IsOpen(); }
+
+    // Identifies the objects and their order in the store
+    static uint64_t GetLayoutHash(const ExampleObjectStore& store);
+};
+
+#endif // __CASBACnetSCExampleSnapshot_h__
@@ -0,0 +1,229 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleTimerWheel.cpp
+ *
+ * See CASBACnetSCExampleTimerWheel.h
+ */
+
+#include "CASBACnetSCExampleTimerWheel.h"
+#include "CASBACnetSCExampleBits.h"
+
+#include <algorithm>
+#include <string.h>
+
+// Pool entries 0 .. TIMER_HEAD_COUNT - 1 are the slot list heads
+static const uint32_t TIMER_HEAD_COUNT = ExampleTimerWheel::LEVEL_COUNT * ExampleTimerWheel::SLOT_COUNT;
+static const uint32_t TIMER_NONE = UINT32_MAX;
+static const uint32_t TIMER_SLOT_MASK = ExampleTimerWheel::SLOT_COUNT - 1;
+// Deadlines further away than the top level can hold wait in its last slot
+static const uint64_t TIMER_MAX_DELTA = ((uint64_t)1 << (ExampleTimerWheel::LEVEL_COUNT * ExampleTimerWheel::SLOT_BITS)) - 1;
+
+ExampleTimerWheel::ExampleTimerWheel() {
+    this->expired = 0;
+    this->cascaded = 0;
+    this->Reset(0);
+}
+
+void ExampleTimerWheel::Reset(const uint64_t nowMilliseconds) {
+    if (this->pool.size() < TIMER_HEAD_COUNT) {
+        this->pool.resize(TIMER_HEAD_COUNT);
+    }
+    for (uint32_t head = 0; head < TIMER_HEAD_COUNT; head++) {
+        this->pool[head].next = head;
+        this->pool[head].prev = head;
+    }
+    // Keep the generations of released timers, so their old ids stay invalid
+    this->freeList = TIMER_NONE;
+    for (uint32_t index = (uint32_t)this->pool.size() - 1; index >= TIMER_HEAD_COUNT; index--) {
+        if (this->pool[index].generation & 1) {
+            this->pool[index].generation++;
+        }
+        this->pool[index].next = this->freeList;
+        this->freeList = index;
+    }
+    memset(this->occupied, 0, sizeof(this->occupied));
+    this->count = 0;
+    this->now = nowMilliseconds;
+}
+
+void ExampleTimerWheel::Reserve(const size_t timerCount) {
+    this->pool.reserve(TIMER_HEAD_COUNT + timerCount);
+}
+
+uint32_t ExampleTimerWheel::allocate() {
+    uint32_t index = this->freeList;
+    if (index != TIMER_NONE) {
+        this->freeList = this->pool[index].next;
+    }
+    else {
+        index = (uint32_t)this->pool.size();
+        Timer timer;
+        memset(&timer, 0, sizeof(timer));
+        this->pool.push_back(timer);
+    }
+    this->pool[index].generation++;
+    this->count++;
+    return index;
+}
+
+void ExampleTimerWheel::link(const uint32_t index) {
+    Timer& timer = this->pool[index];
+    uint64_t delta = timer.deadline > this->now ? timer.deadline - this->now : 0;
+    uint64_t key = this->now + std::min(delta, TIMER_MAX_DELTA);
+
+    uint32_t level = 0;
+    while (level + 1 < LEVEL_COUNT && delta >= ((uint64_t)1 << ((level + 1) * SLOT_BITS))) {
+        level++;
+    }
+    uint32_t slot = (uint32_t)(key >> (level * SLOT_BITS)) & TIMER_SLOT_MASK;
+    uint32_t head = level * SLOT_COUNT + slot;
+
+    // Append, timers with the same deadline expire in the order they were added
+    timer.next = head;
+    timer.prev = this->pool[head].prev;
+    this->pool[timer.prev].next = index;
+    this->pool[head].prev = index;
+    this->occupied[level][slot >> 6] |= (uint64_t)1 << (slot & 63);
+}
+
+void ExampleTimerWheel::unlink(const uint32_t index) {
+    Timer& timer = this->pool[index];
+    this->pool[timer.prev].next = timer.next;
+    this->pool[timer.next].prev = timer.prev;
+    if (timer.prev == timer.next && timer.prev < TIMER_HEAD_COUNT) {
+        // Only the head is left
+        uint32_t head = timer.prev;
+        this->occupied[head / SLOT_COUNT][(head % SLOT_COUNT) >> 6] &= ~((uint64_t)1 << (head & 63));
+    }
+}
+
+void ExampleTimerWheel::cascade(const uint32_t level) {
+    uint32_t slot = (uint32_t)(this->now >> (level * SLOT_BITS)) & TIMER_SLOT_MASK;
+    uint32_t head = level * SLOT_COUNT + slot;
+    uint32_t index = this->pool[head].next;
+    if (index == head) {
+        return;
+    }
+
+    // Detach the whole list, then link every timer again for its remaining time
+    this->pool[this->pool[head].prev].next = TIMER_NONE;
+    this->pool[head].next = head;
+    this->pool[head].prev = head;
+    this->occupied[level][slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+    while (index != TIMER_NONE) {
+        uint32_t next = this->pool[index].next;
+        this->link(index);
+        this->cascaded++;
+        index = next;
+    }
+}
+
+size_t ExampleTimerWheel::Advance(const uint64_t nowMilliseconds, std::vector<ExampleTimerExpiry>* expiries) {
+    size_t before = expiries->size();
+    while (this->now <= nowMilliseconds) {
+        if (this->count == 0) {
+            this->now = nowMilliseconds + 1;
+            break;
+        }
+
+        uint32_t slot = (uint32_t)this->now & TIMER_SLOT_MASK;
+        if (slot == 0) {
+            for (uint32_t level = 1; level < LEVEL_COUNT; level++) {
+                this->cascade(level);
+                if (((this->now >> (level * SLOT_BITS)) & TIMER_SLOT_MASK) != 0) {
+                    break;
+                }
+            }
+        }
+
+        // Every timer in the current level 0 slot is due now
+        uint32_t index;
+        while ((index = this->pool[slot].next) != slot) {
+            Timer& timer = this->pool[index];
+            this->unlink(index);
+            ExampleTimerExpiry expiry = { ((uint64_t)timer.generation << 32) | index, timer.context, timer.deadline };
+            expiries->push_back(expiry);
+            this->expired++;
+            if (timer.period != 0) {
+                timer.deadline += timer.period;
+                this->link(index);
+            }
+            else {
+                timer.generation++;
+                timer.next = this->freeList;
+                this->freeList = index;
+                this->count--;
+            }
+        }
+        this->now++;
+
+        // Skip the milliseconds with nothing to do
+        if ((this->now & TIMER_SLOT_MASK) != 0 && this->pool[this->now & TIMER_SLOT_MASK].next == (this->now & TIMER_SLOT_MASK)) {
+            this->now = std::max(this->now, std::min(this->GetNextDeadline(), nowMilliseconds + 1));
+        }
+    }
+    return expiries->size() - before;
+}
+
+ExampleTimerId ExampleTimerWheel::Add(const uint64_t delayMilliseconds, const uint32_t periodMilliseconds, const uint64_t context) {
+    uint32_t index = this->allocate();
+    Timer& timer = this->pool[index];
+    timer.deadline = this->now + delayMilliseconds;
+    timer.context = context;
+    timer.period = periodMilliseconds;
+    this->link(index);
+    return ((uint64_t)timer.generation << 32) | index;
+}
+
+bool ExampleTimerWheel::Cancel(const ExampleTimerId id) {
+    uint32_t index = (uint32_t)id;
+    if (index < TIMER_HEAD_COUNT || index >= this->pool.size() || this->pool[index].generation != (uint32_t)(id >> 32)) {
+        return false;
+    }
+    this->unlink(index);
+    Timer& timer = this->pool[index];
+    timer.generation++;
+    timer.next = this->freeList;
+    this->freeList = index;
+    this->count--;
+    return true;
+}
+
+uint64_t ExampleTimerWheel::getNextSlotTime(const uint32_t level) const {
+    // First time at or after now that this level's slots are processed, and
+    // the slot processed then. Level 0 runs every millisecond; level n when
+    // the levels below it wrap to slot 0.
+    const uint32_t shift = level * SLOT_BITS;
+    const uint64_t first = ((this->now + ((uint64_t)1 << shift) - 1) >> shift) << shift;
+    const uint32_t current = (uint32_t)(first >> shift) & TIMER_SLOT_MASK;
+
+    // Search the occupied bits from the current slot, wrapping around
+    const uint32_t wordCount = SLOT_COUNT / 64;
+    for (uint32_t step = 0; step <= wordCount; step++) {
+        uint32_t word = ((current >> 6) + step) % wordCount;
+        uint64_t bits = this->occupied[level][word];
+        if (step == 0) {
+            bits &= ~(uint64_t)0 << (current & 63);
+        }
+        else if (step == wordCount) {
+            bits &= ((uint64_t)1 << (current & 63)) - 1;
+        }
+        if (bits != 0) {
+            uint32_t slot = word * 64 + ExampleLowestBit64(bits);
+            return first + ((uint64_t)((slot - current) & TIMER_SLOT_MASK) << shift);
+        }
+    }
+    return NO_DEADLINE;
+}
+
+uint64_t ExampleTimerWheel::GetNextDeadline() const {
+    if (this->count == 0) {
+        return NO_DEADLINE;
+    }
+    uint64_t deadline = NO_DEADLINE;
+    for (uint32_t level = 0; level < LEVEL_COUNT; level++) {
+        deadline = std::min(deadline, this->getNextSlotTime(level));
+    }
+    return deadline;
+}
@@ -0,0 +1,108 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleTimerWheel.h
+ *
+ * Hierarchical timer wheel with millisecond resolution, for points that are
+ * updated on their own period (simulation, polling, derived values).
+ *
+ * Four levels of 256 slots. Level 0 holds the timers due in the next 256 ms,
+ * one slot per millisecond; each level above covers 256 times the range of
+ * the one below, up to about 49 days. Add and Cancel are O(1): a timer is
+ * linked into the slot of its deadline. When level 0 wraps, the next slot of
+ * level 1 is moved down, and so on (cascading). A timer is moved at most
+ * once per level before it expires.
+ *
+ * Timers live in one pool and are linked by index, so a wheel with 100,000
+ * timers is a few allocations. Expired timers are appended to a vector, the
+ * same way ExampleCOVEngine::Flush reports changes; periodic timers are
+ * rescheduled automatically.
+ *
+ * GetNextDeadline tells the main loop how long it may sleep. It is a lower
+ * bound: it can be the time a higher level slot is moved down rather than the
+ * time a timer expires, in which case Advance only cascades.
+ */
+
+#ifndef __CASBACnetSCExampleTimerWheel_h__
+#define __CASBACnetSCExampleTimerWheel_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Index in the pool (low 32 bits) and a generation that changes every time
+// the pool entry is reused, so a stale id cannot cancel another timer
+typedef uint64_t ExampleTimerId;
+
+struct ExampleTimerExpiry {
+    ExampleTimerId id;
+    uint64_t context;       // Value given to Add, e.g. a table and row
+    uint64_t deadline;      // Millisecond the timer was due
+};
+
+class ExampleTimerWheel {
+public:
+    static const uint32_t LEVEL_COUNT = 4;
+    static const uint32_t SLOT_BITS = 8;
+    static const uint32_t SLOT_COUNT = 1 << SLOT_BITS;
+    static const ExampleTimerId INVALID_TIMER = 0;
+    static const uint64_t NO_DEADLINE = UINT64_MAX;
+
+private:
+    // The first LEVEL_COUNT * SLOT_COUNT entries of the pool are the list
+    // heads of the slots. Timers follow; free entries are linked by next.
+    struct Timer {
+        uint64_t deadline;
+        uint64_t context;
+        uint32_t period;        // 0 for a one shot timer
+        uint32_t next;
+        uint32_t prev;
+        uint32_t generation;    // Odd while the timer is scheduled
+    };
+
+    std::vector<Timer> pool;
+    uint32_t freeList;
+    size_t count;
+    uint64_t now;   // Next millisecond to process
+
+    // One bit per non empty slot, to find the next deadline without walking the slots
+    uint64_t occupied[LEVEL_COUNT][SLOT_COUNT / 64];
+
+    uint32_t allocate();
+    void link(const uint32_t index);
+    void unlink(const uint32_t index);
+    void cascade(const uint32_t level);
+    uint64_t getNextSlotTime(const uint32_t level) const;
+
+public:
+    // Statistics
+    uint64_t expired;
+    uint64_t cascaded;  // Timers moved to a lower level
+
+    ExampleTimerWheel();
+
+    // Remove every timer and start the wheel at nowMilliseconds
+    void Reset(const uint64_t nowMilliseconds);
+    void Reserve(const size_t timerCount);
+
+    // Start a timer that expires delayMilliseconds from the wheel's current
+    // time, then every periodMilliseconds if not 0
+    ExampleTimerId Add(const uint64_t delayMilliseconds, const uint32_t periodMilliseconds, const uint64_t context);
+
+    // Returns false if the timer already expired (one shot) or was cancelled
+    bool Cancel(const ExampleTimerId id);
+
+    // Process every millisecond up to and including nowMilliseconds. Appends
+    // the timers that expired, in deadline order, and returns how many.
+    size_t Advance(const uint64_t nowMilliseconds, std::vector<ExampleTimerExpiry>* expiries);
+
+    // Earliest millisecond at which Advance has work to do, NO_DEADLINE if
+    // there are no timers
+    uint64_t GetNextDeadline() const;
+
+    uint64_t GetTime() const { return this->now; }
+    size_t GetCount() const { return this->count; }
+    size_t GetMemoryUsage() const { return this->pool.capacity() * sizeof(Timer); }
+};
+
+#endif // __CASBACnetSCExampleTimerWheel_h__
@@ -0,0 +1,308 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleTrace.cpp
+ *
+ * See CASBACnetSCExampleTrace.h
+ */
+
+#include "CASBACnetSCExampleTrace.h"
+#include "CASBACnetSCExampleApdu.h"
+#include "WSHubFunction.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+
+// Reply keys. BVLC replies are keyed by message ID, APDU replies by the peer VMAC and invoke ID.
+static const uint64_t TRACE_KEY_BVLC = 0x10000;
+static const uint64_t TRACE_KEY_APDU = 0x8000000000000000ULL;
+
+// Invoke ID of a confirmed request (request) or of its answer (!request), -1 if the APDU has none
+static int16_t TraceGetInvokeId(const uint8_t* apdu, const size_t apduLength, const bool request) {
+    uint8_t type = apdu[0] >> 4;
+    if (request) {
+        return type == APDU_TYPE_CONFIRMED_REQUEST && apduLength >= 3 ? apdu[2] : -1;
+    }
+    if (type == APDU_TYPE_SIMPLE_ACK || type == APDU_TYPE_COMPLEX_ACK || type == APDU_TYPE_ERROR || type == APDU_TYPE_REJECT || type == APDU_TYPE_ABORT) {
+        return apduLength >= 2 ? apdu[1] : -1;
+    }
+    return -1;
+}
+
+static uint64_t TraceGetKey(const uint8_t* frame, const size_t length, const bool request, int16_t* invokeId) {
+    *invokeId = -1;
+    WSHubFrameHeader header;
+    if (!WSHubFrameHeader::Parse(frame, length, &header)) {
+        return 0;
+    }
+
+    switch (header.function) {
+    case BVLC_SC_FUNCTION_ADDRESS_RESOLUTION:
+    case BVLC_SC_FUNCTION_ADVERTISEMENT_SOLICITATION:
+    case BVLC_SC_FUNCTION_CONNECT_REQUEST:
+    case BVLC_SC_FUNCTION_DISCONNECT_REQUEST:
+    case BVLC_SC_FUNCTION_HEARTBEAT_REQUEST:
+        return request ? TRACE_KEY_BVLC | header.messageId : 0;
+    case BVLC_SC_FUNCTION_BVLC_RESULT:
+    case BVLC_SC_FUNCTION_ADDRESS_RESOLUTION_ACK:
+    case BVLC_SC_FUNCTION_ADVERTISEMENT:
+    case BVLC_SC_FUNCTION_CONNECT_ACCEPT:
+    case BVLC_SC_FUNCTION_DISCONNECT_ACK:
+    case BVLC_SC_FUNCTION_HEARTBEAT_ACK:
+        return request ? 0 : TRACE_KEY_BVLC | header.messageId;
+    case BVLC_SC_FUNCTION_ENCAPSULATED_NPDU: {
+        size_t apduLength;
+        const uint8_t* apdu = header.GetApdu(frame, length, &apduLength);
+        if (apdu == NULL) {
+            return 0;
+        }
+        *invokeId = TraceGetInvokeId(apdu, apduLength, request);
+        if (*invokeId < 0) {
+            return 0;
+        }
+        // The request comes from the peer, the answer goes back to it
+        const uint8_t* peer = request ? header.originatingVmac : header.destinationVmac;
+        uint64_t vmac = peer == NULL ? 0 : WSHubFrameHeader::PackVmac(peer);
+        return TRACE_KEY_APDU | (vmac << 8) | (uint64_t)*invokeId;
+    }
+    default:
+        return 0;
+    }
+}
+
+// Ticks to microseconds since the start of the trace
+static void TraceAppendTimestamp(std::string* json, const uint64_t ticks, const uint64_t base, const double ticksPerNanosecond) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", (ticks - base) / ticksPerNanosecond / 1000.0);
+    json->append(buffer);
+}
+
+static void TraceAppendEvent(std::string* json, const char* name, const char phase, const uint32_t id, const uint64_t ticks, const uint64_t base, const double ticksPerNanosecond, const std::string& args) {
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"%s\",\"cat\":\"bacnet_sc\",\"ph\":\"%c\",\"id\":%u,\"pid\":1,\"tid\":1,\"ts\":", name, phase, id);
+    json->append(buffer);
+    TraceAppendTimestamp(json, ticks, base, ticksPerNanosecond);
+    if (!args.empty()) {
+        json->append(",\"args\":{");
+        json->append(args);
+        json->push_back('}');
+    }
+    json->push_back('}');
+}
+
+// A nested stage of a message, skipped if one of its times was not taken
+static void TraceAppendStage(std::string* json, const char* name, const uint32_t id, const uint64_t start, const uint64_t end, const uint64_t base, const double ticksPerNanosecond) {
+    if (start == 0 || end == 0 || end < start) {
+        return;
+    }
+    TraceAppendEvent(json, name, 'b', id, start, base, ticksPerNanosecond, "");
+    TraceAppendEvent(json, name, 'e', id, end, base, ticksPerNanosecond, "");
+}
+
+//
+// ExampleMessageTracer
+// ----------------------------------------------------------------------------
+
+ExampleMessageTracer::ExampleMessageTracer() {
+    this->enabled = false;
+    this->ticksPerNanosecond = 1.0;
+    this->sampleInterval = 1;
+    this->Reset();
+}
+
+void ExampleMessageTracer::Initialize(const uint32_t sampleInterval, const uint32_t maxMessages) {
+    this->ticksPerNanosecond = ExampleProfilerClock::Calibrate(20);
+    this->sampleInterval = sampleInterval == 0 ? 1 : sampleInterval;
+    this->messages.resize(maxMessages == 0 ? 1 : maxMessages);
+    this->Reset();
+    this->enabled = true;
+}
+
+void ExampleMessageTracer::Reset() {
+    for (Message& message : this->messages) {
+        message.sequence = 0;
+    }
+    this->pending.clear();
+    this->receivedCount = 0;
+    this->sentCount = 0;
+    this->nextSequence = 1;
+    this->messagesTraced = 0;
+    this->messagesReplied = 0;
+}
+
+ExampleMessageTracer::Message* ExampleMessageTracer::add() {
+    uint32_t sequence = this->nextSequence++;
+    Message* message = &this->messages[sequence % this->messages.size()];
+
+    // The oldest message is dropped, and with it any reply it still waits for
+    if (message->sequence != 0 && message->key != 0) {
+        auto it = this->pending.find(message->key);
+        if (it != this->pending.end() && it->second == message->sequence) {
+            this->pending.erase(it);
+        }
+    }
+
+    message->sequence = sequence;
+    message->key = 0;
+    message->replyFunction = 0;
+    message->received = false;
+    message->replied = false;
+    message->times.read = 0;
+    message->times.dequeued = 0;
+    message->times.sendStart = 0;
+    message->times.written = 0;
+    this->messagesTraced++;
+    return message;
+}
+
+void ExampleMessageTracer::OnReceived(const uint8_t* frame, const size_t length, const WSFrameTimes& times) {
+    if (!this->enabled || this->messages.empty() || length < BVLC_SC_FIXED_HEADER_LENGTH) {
+        return;
+    }
+    if (this->receivedCount++ % this->sampleInterval != 0) {
+        return;
+    }
+
+    Message* message = this->add();
+    message->messageId = (uint16_t)((frame[2] << 8) | frame[3]);
+    message->function = frame[0];
+    message->length = (uint16_t)length;
+    message->received = true;
+    message->times.read = times.read;
+    message->times.dequeued = times.dequeued;
+    message->key = TraceGetKey(frame, length, true, &message->invokeId);
+    if (message->key != 0) {
+        // A retry with the same key replaces the original request
+        this->pending[message->key] = message->sequence;
+    }
+}
+
+void ExampleMessageTracer::OnSent(const uint8_t* frame, const size_t length, const WSFrameTimes& times) {
+    if (!this->enabled || this->messages.empty() || length < BVLC_SC_FIXED_HEADER_LENGTH) {
+        return;
+    }
+
+    int16_t invokeId;
+    uint64_t key = TraceGetKey(frame, length, false, &invokeId);
+    if (key != 0) {
+        auto it = this->pending.find(key);
+        if (it != this->pending.end()) {
+            Message* message = &this->messages[it->second % this->messages.size()];
+            this->pending.erase(it);
+            message->key = 0;
+            message->replied = true;
+            message->replyFunction = frame[0];
+            message->times.sendStart = times.sendStart;
+            message->times.written = times.written;
+            this->messagesReplied++;
+        }
+        // The answer to a request that was not sampled
+        return;
+    }
+
+    // Unsolicited, sampled on its own
+    if (this->sentCount++ % this->sampleInterval != 0) {
+        return;
+    }
+    Message* message = this->add();
+    message->messageId = (uint16_t)((frame[2] << 8) | frame[3]);
+    message->function = frame[0];
+    message->length = (uint16_t)length;
+    message->invokeId = invokeId;
+    message->times.sendStart = times.sendStart;
+    message->times.written = times.written;
+}
+
+size_t ExampleMessageTracer::GetMessageCount() const {
+    size_t count = 0;
+    for (const Message& message : this->messages) {
+        count += message.sequence != 0 ? 1 : 0;
+    }
+    return count;
+}
+
+void ExampleMessageTracer::Render(std::string* json) const {
+    // Oldest first, starting after the slot written last
+    std::vector<const Message*> order;
+    uint64_t base = UINT64_MAX;
+    for (size_t index = 0; index < this->messages.size(); index++) {
+        const Message* message = &this->messages[(this->nextSequence + index) % this->messages.size()];
+        if (message->sequence == 0) {
+            continue;
+        }
+        order.push_back(message);
+        uint64_t start = message->received ? message->times.read : message->times.sendStart;
+        if (start != 0 && start < base) {
+            base = start;
+        }
+    }
+
+    json->append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    json->append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"BACnet SC messages\"}}");
+    char buffer[160];
+    for (const Message* message : order) {
+        const WSFrameTimes& times = message->times;
+        uint64_t start = message->received ? times.read : times.sendStart;
+        uint64_t end = times.written;
+        if (end == 0) {
+            end = message->replied ? times.sendStart : times.dequeued;
+        }
+        if (start == 0 || end < start) {
+            continue;
+        }
+
+        snprintf(buffer, sizeof(buffer), "\"messageId\":%u,\"length\":%u,\"direction\":\"%s\"", message->messageId, message->length, message->received ? "received" : "sent");
+        std::string args = buffer;
+        if (message->invokeId >= 0) {
+            snprintf(buffer, sizeof(buffer), ",\"invokeId\":%d", message->invokeId);
+            args.append(buffer);
+        }
+        if (message->replied) {
+            args.append(",\"reply\":\"");
+            args.append(GetFunctionName(message->replyFunction));
+            args.push_back('"');
+        }
+
+        const char* name = GetFunctionName(message->function);
+        TraceAppendEvent(json, name, 'b', message->sequence, start, base, this->ticksPerNanosecond, args);
+        TraceAppendStage(json, "queued", message->sequence, times.read, times.dequeued, base, this->ticksPerNanosecond);
+        TraceAppendStage(json, "stack", message->sequence, times.dequeued, times.sendStart, base, this->ticksPerNanosecond);
+        TraceAppendStage(json, "write", message->sequence, times.sendStart, times.written, base, this->ticksPerNanosecond);
+        TraceAppendEvent(json, name, 'e', message->sequence, end, base, this->ticksPerNanosecond, "");
+    }
+    json->append("\n]}\n");
+}
+
+bool ExampleMessageTracer::Write(const std::string& path) const {
+    std::string json;
+    json.reserve(this->messages.size() * 1024);
+    this->Render(&json);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "Error: ExampleMessageTracer::Write() - could not open " << path << std::endl;
+        return false;
+    }
+    file.write(json.data(), json.size());
+    return (bool)file;
+}
+
+uint64_t ExampleMessageTracer::GetRequestKey(const uint8_t* frame, const size_t length) {
+    int16_t invokeId;
+    return TraceGetKey(frame, length, true, &invokeId);
+}
+
+uint64_t ExampleMessageTracer::GetReplyKey(const uint8_t* frame, const size_t length) {
+    int16_t invokeId;
+    return TraceGetKey(frame, length, false, &invokeId);
+}
+
+const char* ExampleMessageTracer::GetFunctionName(const uint8_t function) {
+    static const char* const NAMES[] = {
+        "BVLC-Result", "Encapsulated-NPDU", "Address-Resolution", "Address-Resolution-ACK",
+        "Advertisement", "Advertisement-Solicitation", "Connect-Request", "Connect-Accept",
+        "Disconnect-Request", "Disconnect-ACK", "Heartbeat-Request", "Heartbeat-ACK", "Proprietary-Message"
+    };
+    return function < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[function] : "Unknown";
+}
@@ -0,0 +1,98 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleTrace.h
+ *
+ * Per message lifecycle tracing, written as Chrome trace / Perfetto JSON.
+ *
+ * Each frame carries a WSFrameTimes through the websocket client: when it was
+ * read from the socket (onRead), taken off the receive queue by the CAS
+ * BACnet Stack (pollQueue), handed back to SendWSMessage by the stack, and
+ * when the write completed (onWrite). The tracer matches a sampled request
+ * with its reply and keeps the four times, so one message shows as
+ *
+ *     queued   read -> dequeued       waiting in the receive queue
+ *     stack    dequeued -> sendStart  inside the stack until CallbackSendMessage
+ *     write    sendStart -> written   websocket write
+ *
+ * BVLC-SC replies (BVLC-Result, Heartbeat-ACK, ...) carry the message ID of
+ * the request. An Encapsulated-NPDU reply gets a new message ID from the
+ * stack, so confirmed requests are matched with their answer by the invoke
+ * ID of the APDU and the VMAC of the peer instead.
+ *
+ * One in sampleInterval received frames is traced. Sent frames that answer
+ * nothing (Who-Is, COV notifications, ...) are sampled on their own.
+ * The last maxMessages messages are kept and written on request; open the
+ * file in chrome://tracing or ui.perfetto.dev.
+ *
+ * The tracer is not thread safe, it is called from the stack callbacks on
+ * the stack thread.
+ */
+
+#ifndef __CASBACnetSCExampleTrace_h__
+#define __CASBACnetSCExampleTrace_h__
+
+#include "WSClient.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ExampleMessageTracer {
+private:
+    struct Message {
+        uint32_t sequence;          // 0 for an empty slot
+        uint64_t key;               // Reply key while waiting for the reply, 0 otherwise
+        uint16_t messageId;
+        uint8_t function;
+        uint8_t replyFunction;
+        uint16_t length;
+        int16_t invokeId;           // -1 if not an APDU with an invoke ID
+        bool received;              // false for a sent frame traced on its own
+        bool replied;
+        WSFrameTimes times;
+    };
+
+    bool enabled;
+    double ticksPerNanosecond;
+    uint32_t sampleInterval;
+    uint32_t receivedCount;
+    uint32_t sentCount;
+    uint32_t nextSequence;
+
+    std::vector<Message> messages;                      // Ring, slot is sequence % size
+    std::unordered_map<uint64_t, uint32_t> pending;     // Reply key to sequence
+
+    Message* add();
+
+public:
+    // Statistics
+    uint64_t messagesTraced;
+    uint64_t messagesReplied;
+
+    ExampleMessageTracer();
+
+    // Trace one in sampleInterval frames, keep up to maxMessages. Calibrates the clock.
+    void Initialize(const uint32_t sampleInterval, const uint32_t maxMessages);
+    void SetEnabled(const bool enabled) { this->enabled = enabled; }
+    bool IsEnabled() const { return this->enabled; }
+    void Reset();
+
+    // A frame given to the stack by CallbackReceiveMessage, times has read and dequeued set
+    void OnReceived(const uint8_t* frame, const size_t length, const WSFrameTimes& times);
+    // A frame sent by CallbackSendMessage, times has sendStart and written set
+    void OnSent(const uint8_t* frame, const size_t length, const WSFrameTimes& times);
+
+    // Chrome trace event format, one async track per message
+    void Render(std::string* json) const;
+    bool Write(const std::string& path) const;
+    size_t GetMessageCount() const;
+
+    // Key of the reply a frame waits for (request) or is (reply), 0 if none
+    static uint64_t GetRequestKey(const uint8_t* frame, const size_t length);
+    static uint64_t GetReplyKey(const uint8_t* frame, const size_t length);
+    static const char* GetFunctionName(const uint8_t function);
+};
+
+#endif // __CASBACnetSCExampleTrace_h__
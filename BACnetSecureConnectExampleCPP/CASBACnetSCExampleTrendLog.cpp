@@ -0,0 +1,375 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleTrendLog.cpp
+ *
+ * See CASBACnetSCExampleTrendLog.h
+ */
+
+#include "CASBACnetSCExampleTrendLog.h"
+#include "CASBACnetSCExampleBits.h"
+
+#include <algorithm>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+// The largest record: a 36 bit timestamp code and a 44 bit value code
+static const uint32_t TREND_LOG_MAX_RECORD_BITS = 80;
+static const uint32_t TREND_LOG_NO_WINDOW = 32;
+// Bytes after the last block, so a read of 8 bytes never runs past the buffer
+static const size_t TREND_LOG_PADDING = 8;
+
+// The bit stream is written most significant bit first
+static inline uint64_t TrendLogLoadBigEndian(const uint8_t* bytes) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+#ifdef _MSC_VER
+    return _byteswap_uint64(word);
+#else
+    return __builtin_bswap64(word);
+#endif // _MSC_VER
+}
+
+static inline uint32_t TrendLogFloatBits(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Timestamp code: the change of interval in as few bits as it needs
+//	0                   same interval
+//	10   + 7 bits       -63 .. 64
+//	110  + 9 bits       -255 .. 256
+//	1110 + 12 bits      -2047 .. 2048
+//	1111 + 32 bits      any other int32
+struct TrendLogTimeCode {
+    uint32_t prefix;
+    uint32_t prefixBits;
+    int64_t offset;
+    uint32_t valueBits;
+};
+static const TrendLogTimeCode TREND_LOG_TIME_CODES[] = {
+    { 0x2, 2, 63, 7 },
+    { 0x6, 3, 255, 9 },
+    { 0xE, 4, 2047, 12 },
+    { 0xF, 4, 2147483648ll, 32 },
+};
+
+// Reads records one after the other, from the start of a block
+struct ExampleTrendLog::Cursor {
+    const ExampleTrendLog* log;
+    uint32_t order;
+    uint32_t block;
+    uint32_t bit;
+    uint32_t index;
+    uint64_t sequence;
+    uint64_t timestamp;
+    int64_t delta;
+    uint32_t value;
+    uint32_t leading;
+    uint32_t trailing;
+
+    explicit Cursor(const ExampleTrendLog* log) : log(log) {}
+
+    void Start(const uint32_t order) {
+        this->order = order;
+        this->block = this->log->getBlock(order);
+        const Block& header = this->log->blocks[this->block];
+        this->bit = 0;
+        this->index = 0;
+        this->sequence = header.firstSequence;
+        this->timestamp = header.firstTimestamp;
+        this->delta = 0;
+        this->value = TrendLogFloatBits(header.firstValue);
+        this->leading = TREND_LOG_NO_WINDOW;
+        this->trailing = TREND_LOG_NO_WINDOW;
+    }
+
+    // 1 to 32 bits. Loads the 8 bytes around them at once, the buffer has
+    // TREND_LOG_PADDING bytes after the last block for this.
+    uint32_t ReadBits(const uint32_t bitCount) {
+        const uint8_t* bytes = &this->log->data[(size_t)this->block * BLOCK_SIZE + (this->bit >> 3)];
+        uint64_t word = TrendLogLoadBigEndian(bytes) << (this->bit & 7);
+        this->bit += bitCount;
+        return (uint32_t)(word >> (64 - bitCount));
+    }
+
+    // Move to the next record. Returns false after the newest record.
+    bool Next() {
+        this->index++;
+        if (this->index >= this->log->blocks[this->block].count) {
+            if (this->order + 1 >= this->log->used) {
+                return false;
+            }
+            this->Start(this->order + 1);
+            return true;
+        }
+        this->sequence++;
+
+        uint32_t code = 0;
+        while (code < 4 && this->ReadBits(1) == 1) {
+            code++;
+        }
+        if (code > 0) {
+            const TrendLogTimeCode& timeCode = TREND_LOG_TIME_CODES[code - 1];
+            this->delta += (int64_t)this->ReadBits(timeCode.valueBits) - timeCode.offset;
+        }
+        this->timestamp += this->delta;
+
+        if (this->ReadBits(1) == 1) {
+            if (this->ReadBits(1) == 1) {
+                this->leading = this->ReadBits(5);
+                uint32_t length = this->ReadBits(5) + 1;
+                this->trailing = 32 - this->leading - length;
+            }
+            uint32_t length = 32 - this->leading - this->trailing;
+            this->value ^= this->ReadBits(length) << this->trailing;
+        }
+        return true;
+    }
+
+    void Get(ExampleTrendLogRecord* record) const {
+        record->timestamp = this->timestamp;
+        memcpy(&record->value, &this->value, sizeof(float));
+        record->sequence = (uint32_t)this->sequence;
+    }
+};
+
+ExampleTrendLog::ExampleTrendLog() {
+    this->Initialize(0);
+}
+
+void ExampleTrendLog::Initialize(const uint32_t blockCount) {
+    this->blocks.assign(blockCount, Block());
+    this->data.assign((size_t)blockCount * BLOCK_SIZE + TREND_LOG_PADDING, 0);
+    this->oldest = 0;
+    this->used = 0;
+    this->lastTimestamp = 0;
+    this->lastDelta = 0;
+    this->lastValue = 0;
+    this->lastLeading = TREND_LOG_NO_WINDOW;
+    this->lastTrailing = TREND_LOG_NO_WINDOW;
+    this->totalCount = 0;
+    this->recordCount = 0;
+}
+
+void ExampleTrendLog::startBlock(const uint64_t timestamp, const float value) {
+    if (this->used == this->blocks.size()) {
+        // Full, drop the oldest block
+        this->recordCount -= this->blocks[this->oldest].count;
+        this->oldest = (this->oldest + 1) % (uint32_t)this->blocks.size();
+        this->used--;
+    }
+    uint32_t block = this->getBlock(this->used);
+    this->used++;
+    this->totalCount++;
+    this->recordCount++;
+
+    Block& header = this->blocks[block];
+    header.firstTimestamp = timestamp;
+    header.firstSequence = this->totalCount;
+    header.firstValue = value;
+    header.count = 1;
+    header.bitLength = 0;
+    memset(&this->data[(size_t)block * BLOCK_SIZE], 0, BLOCK_SIZE);
+
+    this->lastTimestamp = timestamp;
+    this->lastDelta = 0;
+    this->lastValue = TrendLogFloatBits(value);
+    this->lastLeading = TREND_LOG_NO_WINDOW;
+    this->lastTrailing = TREND_LOG_NO_WINDOW;
+}
+
+void ExampleTrendLog::writeBits(const uint32_t block, const uint64_t value, uint32_t bitCount) {
+    uint8_t* data = &this->data[(size_t)block * BLOCK_SIZE];
+    Block& header = this->blocks[block];
+    while (bitCount > 0) {
+        uint32_t available = 8 - (header.bitLength & 7);
+        uint32_t take = std::min(available, bitCount);
+        uint32_t bits = (uint32_t)(value >> (bitCount - take)) & ((1u << take) - 1);
+        data[header.bitLength >> 3] |= (uint8_t)(bits << (available - take));
+        header.bitLength = (uint16_t)(header.bitLength + take);
+        bitCount -= take;
+    }
+}
+
+void ExampleTrendLog::Add(const uint64_t timestamp, const float value) {
+    if (this->blocks.empty()) {
+        return;
+    }
+    if (this->used == 0) {
+        this->startBlock(timestamp, value);
+        return;
+    }
+    uint32_t block = this->getBlock(this->used - 1);
+    Block& header = this->blocks[block];
+    uint64_t time = std::max(timestamp, this->lastTimestamp);
+    int64_t delta = (int64_t)(time - this->lastTimestamp);
+    int64_t deltaOfDelta = delta - this->lastDelta;
+    if (header.count == UINT16_MAX || header.bitLength + TREND_LOG_MAX_RECORD_BITS > BLOCK_SIZE * 8 ||
+        deltaOfDelta < INT32_MIN || deltaOfDelta > INT32_MAX) {
+        this->startBlock(time, value);
+        return;
+    }
+
+    // Timestamp
+    if (deltaOfDelta == 0) {
+        this->writeBits(block, 0, 1);
+    }
+    else {
+        for (const TrendLogTimeCode& timeCode : TREND_LOG_TIME_CODES) {
+            int64_t encoded = deltaOfDelta + timeCode.offset;
+            if (encoded >= 0 && encoded < ((int64_t)1 << timeCode.valueBits)) {
+                this->writeBits(block, timeCode.prefix, timeCode.prefixBits);
+                this->writeBits(block, (uint64_t)encoded, timeCode.valueBits);
+                break;
+            }
+        }
+    }
+
+    // Value
+    uint32_t bits = TrendLogFloatBits(value);
+    uint32_t changed = bits ^ this->lastValue;
+    if (changed == 0) {
+        this->writeBits(block, 0, 1);
+    }
+    else {
+        uint32_t leading = 31 - ExampleHighestBit32(changed);
+        uint32_t trailing = ExampleLowestBit32(changed);
+        if (this->lastLeading != TREND_LOG_NO_WINDOW && leading >= this->lastLeading && trailing >= this->lastTrailing) {
+            // Fits in the window of the previous value
+            this->writeBits(block, 0x2, 2);
+            this->writeBits(block, changed >> this->lastTrailing, 32 - this->lastLeading - this->lastTrailing);
+        }
+        else {
+            uint32_t length = 32 - leading - trailing;
+            this->writeBits(block, 0x3, 2);
+            this->writeBits(block, leading, 5);
+            this->writeBits(block, length - 1, 5);
+            this->writeBits(block, changed >> trailing, length);
+            this->lastLeading = leading;
+            this->lastTrailing = trailing;
+        }
+    }
+
+    header.count++;
+    this->lastTimestamp = time;
+    this->lastDelta = delta;
+    this->lastValue = bits;
+    this->totalCount++;
+    this->recordCount++;
+}
+
+uint32_t ExampleTrendLog::findSequence(const uint64_t sequence) const {
+    // Last block whose first record is at or before the sequence
+    uint32_t low = 0;
+    uint32_t high = this->used;
+    while (high - low > 1) {
+        uint32_t middle = (low + high) / 2;
+        if (this->blocks[this->getBlock(middle)].firstSequence <= sequence) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+uint32_t ExampleTrendLog::findTime(const uint64_t timestamp, const bool orEqual) const {
+    uint32_t low = 0;
+    uint32_t high = this->used;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        uint64_t first = this->blocks[this->getBlock(middle)].firstTimestamp;
+        if (first < timestamp || (orEqual && first == timestamp)) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low == 0 ? this->used : low - 1;
+}
+
+size_t ExampleTrendLog::read(const uint64_t sequence, const size_t count, std::vector<ExampleTrendLogRecord>* records) const {
+    Cursor cursor(this);
+    cursor.Start(this->findSequence(sequence));
+    while (cursor.sequence < sequence) {
+        if (!cursor.Next()) {
+            return 0;
+        }
+    }
+    size_t read = 0;
+    do {
+        ExampleTrendLogRecord record;
+        cursor.Get(&record);
+        records->push_back(record);
+        read++;
+    } while (read < count && cursor.Next());
+    return read;
+}
+
+size_t ExampleTrendLog::readRange(const uint64_t reference, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const {
+    if (this->recordCount == 0 || count == 0) {
+        return 0;
+    }
+    const uint64_t first = this->totalCount - this->recordCount + 1;
+    const uint64_t last = this->totalCount;
+    if (reference < first || reference > last) {
+        return 0;
+    }
+    if (count > 0) {
+        return this->read(reference, (size_t)std::min<uint64_t>((uint64_t)count, last - reference + 1), records);
+    }
+    uint64_t start = std::max<uint64_t>(first, reference + 1 - std::min<uint64_t>(reference, (uint64_t)(-(int64_t)count)));
+    return this->read(start, (size_t)(reference - start + 1), records);
+}
+
+size_t ExampleTrendLog::ReadByPosition(const uint32_t position, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const {
+    if (position == 0) {
+        return 0;
+    }
+    return this->readRange(this->totalCount - this->recordCount + position, count, records);
+}
+
+size_t ExampleTrendLog::ReadBySequence(const uint32_t sequence, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const {
+    // Sequence numbers are 32 bit in BACnet and wrap; pick the one not after the newest record
+    uint64_t full = (this->totalCount & ~(uint64_t)UINT32_MAX) | sequence;
+    if (full > this->totalCount && full > UINT32_MAX) {
+        full -= (uint64_t)UINT32_MAX + 1;
+    }
+    return this->readRange(full, count, records);
+}
+
+size_t ExampleTrendLog::ReadByTime(const uint64_t timestamp, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const {
+    if (this->recordCount == 0 || count == 0) {
+        return 0;
+    }
+    Cursor cursor(this);
+    if (count > 0) {
+        // First record newer than the time
+        uint32_t order = this->findTime(timestamp, true);
+        cursor.Start(order == this->used ? 0 : order);
+        while (cursor.timestamp <= timestamp) {
+            if (!cursor.Next()) {
+                return 0;
+            }
+        }
+        return this->readRange(cursor.sequence, count, records);
+    }
+
+    // Last record older than the time
+    uint32_t order = this->findTime(timestamp, false);
+    if (order == this->used) {
+        return 0;
+    }
+    cursor.Start(order);
+    uint64_t reference = cursor.sequence;
+    while (cursor.Next() && cursor.timestamp < timestamp) {
+        reference = cursor.sequence;
+    }
+    return this->readRange(reference, count, records);
+}
@@ -0,0 +1,107 @@
+/*
+ * BACnet SC Example C++
+ * ----------------------------------------------------------------------------
+ * CASBACnetSCExampleTrendLog.h
+ *
+ * Trend Log buffer: a fixed amount of memory holding the newest records of
+ * one point, compressed, with the ReadRange queries of BACnet (by position,
+ * by sequence number and by time).
+ *
+ * The buffer is a ring of fixed size blocks. Each block starts from a
+ * timestamp and value stored in full, then holds a bit stream:
+ *	- timestamps as the change in the interval since the previous record
+ *	  (delta of delta). A log with a steady interval costs 1 bit per record.
+ *	- values as the XOR with the previous value. Only the bits that changed
+ *	  are stored; an unchanged value costs 1 bit.
+ * When the ring is full, the oldest block and its records are dropped.
+ *
+ * A query finds the block holding its first record by binary search on the
+ * block headers, then decodes from the start of that block only until the
+ * requested window is read.
+ */
+
+#ifndef __CASBACnetSCExampleTrendLog_h__
+#define __CASBACnetSCExampleTrendLog_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct ExampleTrendLogRecord {
+    uint64_t timestamp;     // Unix time in milliseconds
+    float value;
+    uint32_t sequence;      // Sequence number of BACnet, counts every record ever logged
+};
+
+class ExampleTrendLog {
+public:
+    static const uint32_t BLOCK_SIZE = 512;    // Bytes of bit stream per block
+
+private:
+    struct Block {
+        uint64_t firstTimestamp;
+        uint64_t firstSequence;
+        float firstValue;
+        uint16_t count;
+        uint16_t bitLength;
+    };
+
+    struct Cursor;
+
+    std::vector<Block> blocks;
+    std::vector<uint8_t> data;   // BLOCK_SIZE bytes per block
+    uint32_t oldest;        // Ring position of the oldest block
+    uint32_t used;          // Blocks holding records
+
+    // Encoder state of the newest block
+    uint64_t lastTimestamp;
+    int64_t lastDelta;
+    uint32_t lastValue;
+    uint32_t lastLeading;
+    uint32_t lastTrailing;
+
+    uint64_t totalCount;
+    size_t recordCount;
+
+    uint32_t getBlock(const uint32_t order) const { return (this->oldest + order) % (uint32_t)this->blocks.size(); }
+    void startBlock(const uint64_t timestamp, const float value);
+    void writeBits(const uint32_t block, const uint64_t value, const uint32_t bitCount);
+
+    // Ring order of the last block starting at or before the sequence
+    uint32_t findSequence(const uint64_t sequence) const;
+    // Ring order of the last block starting before (or at) the time, used if none
+    uint32_t findTime(const uint64_t timestamp, const bool orEqual) const;
+
+    // Decode count records starting at sequence
+    size_t read(const uint64_t sequence, const size_t count, std::vector<ExampleTrendLogRecord>* records) const;
+    // ReadRange from the record with the reference sequence number
+    size_t readRange(const uint64_t reference, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const;
+
+public:
+    ExampleTrendLog();
+
+    // Fixed memory of blockCount * BLOCK_SIZE bytes of records. Removes all records.
+    void Initialize(const uint32_t blockCount);
+
+    // Timestamps must not go backwards, an earlier timestamp is logged as the previous one
+    void Add(const uint64_t timestamp, const float value);
+
+    // ReadRange. count > 0 reads count records from the reference forward,
+    // count < 0 reads -count records up to the reference. Records are
+    // appended oldest first; returns how many.
+    // By position: 1 is the oldest record in the buffer
+    size_t ReadByPosition(const uint32_t position, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const;
+    size_t ReadBySequence(const uint32_t sequence, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const;
+    // By time: records newer than (count > 0) or older than (count < 0) the reference time
+    size_t ReadByTime(const uint64_t timestamp, const int32_t count, std::vector<ExampleTrendLogRecord>* records) const;
+
+    // Record_Count and Total_Record_Count of the Trend Log
+    size_t GetRecordCount() const { return this->recordCount; }
+    uint32_t GetTotalRecordCount() const { return (uint32_t)this->totalCount; }
+
+    // Bytes of the blocks in use, including their headers
+    size_t GetUsedBytes() const { return this->used * (BLOCK_SIZE + sizeof(Block)); }
+    size_t GetMemoryUsage() const { return this->data.capacity() + this->blocks.capacity() * sizeof(Block); }
+};
+
+#endif // __CASBACnetSCExampleTrendLog_h__
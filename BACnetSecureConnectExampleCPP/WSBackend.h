@@ -0,0 +1,26 @@
+#pragma once
+
+//
+// Network backend
+// ----------------------------------------------------------------------------
+// Which Asio reactor runs the websocket transport: epoll on Linux, IOCP on
+// Windows and kqueue on macOS, as Asio picks it. Each frame costs a read or a
+// write system call plus the epoll_wait that reported the socket ready. The
+// backend is printed at startup and by the "backend" benchmark.
+
+#include <boost/asio/detail/config.hpp>
+
+// Name of the reactor the sockets run on, for reports
+inline const char* WSGetNetworkBackend() {
+#if defined(BOOST_ASIO_HAS_IOCP)
+    return "iocp";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+    return "epoll";
+#elif defined(BOOST_ASIO_HAS_KQUEUE)
+    return "kqueue";
+#elif defined(BOOST_ASIO_HAS_DEV_POLL)
+    return "/dev/poll";
+#else
+    return "select";
+#endif
+}
@@ -0,0 +1,204 @@
+#include "WSCapture.h"
+
+#include <boost/asio/post.hpp>
+
+#include <chrono>
+#include <iostream>
+
+// pcap file format, in host byte order, which readers detect from the magic number
+static const uint32_t WS_CAPTURE_PCAP_MAGIC = 0xA1B2C3D4;
+static const uint16_t WS_CAPTURE_PCAP_VERSION_MAJOR = 2;
+static const uint16_t WS_CAPTURE_PCAP_VERSION_MINOR = 4;
+static const uint32_t WS_CAPTURE_PCAP_LINKTYPE_USER0 = 147;
+static const size_t WS_CAPTURE_PCAP_RECORD_HEADER_LENGTH = 16;
+
+WSCapture::WSCapture() : flushTimer(ioc) {
+    this->writing = false;
+    this->open = false;
+    this->maxPendingBytes = 0;
+    this->flushIntervalMilliseconds = 0;
+    this->closing = false;
+    this->file = NULL;
+    this->framesCaptured = 0;
+    this->bytesWritten = 0;
+    this->writes = 0;
+    this->dropped = 0;
+}
+
+WSCapture::~WSCapture() {
+    this->Close();
+}
+
+bool WSCapture::Open(const std::string& filename, const size_t maxPendingBytes, const uint32_t flushIntervalMilliseconds) {
+    this->Close();
+
+    struct {
+        uint32_t magic;
+        uint16_t versionMajor;
+        uint16_t versionMinor;
+        int32_t thisZone;
+        uint32_t sigFigs;
+        uint32_t snapLength;
+        uint32_t linkType;
+    } header = { WS_CAPTURE_PCAP_MAGIC, WS_CAPTURE_PCAP_VERSION_MAJOR, WS_CAPTURE_PCAP_VERSION_MINOR, 0, 0, 65535, WS_CAPTURE_PCAP_LINKTYPE_USER0 };
+
+    this->file = fopen(filename.c_str(), "wb");
+    if (this->file == NULL || fwrite(&header, sizeof(header), 1, this->file) != 1) {
+        std::cout << "Error: WSCapture::Open() - Could not write " << filename << std::endl;
+        if (this->file != NULL) {
+            fclose(this->file);
+            this->file = NULL;
+        }
+        return false;
+    }
+    fflush(this->file);
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pending.clear();
+        this->writing = false;
+        this->maxPendingBytes = maxPendingBytes;
+        this->flushIntervalMilliseconds = flushIntervalMilliseconds;
+        this->open = true;
+    }
+    this->closing = false;
+
+    this->ioc.restart();
+    this->iocWorkGuard.reset(new boost::asio::executor_work_guard<boost::asio::io_context::executor_type>(boost::asio::make_work_guard(this->ioc)));
+    this->armTimer();
+    this->thread = std::thread([this] {
+        try {
+            this->ioc.run();
+        }
+        catch (std::exception& e) {
+            std::cout << "DEBUG: WSCapture ioc.run() EXCEPTION - " << e.what() << std::endl;
+        }
+    });
+    return true;
+}
+
+void WSCapture::Close() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->open = false;
+    }
+    if (!this->thread.joinable()) {
+        return;
+    }
+
+    // The writer runs until the last batch is written
+    boost::asio::post(this->ioc, [this] {
+        this->closing = true;
+        this->flushTimer.cancel();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->writing) {
+                return;     // The write in progress continues until pending is empty
+            }
+            this->writing = true;
+        }
+        this->writeNext();
+    });
+    this->iocWorkGuard.reset();
+    this->thread.join();
+
+    fclose(this->file);
+    this->file = NULL;
+}
+
+bool WSCapture::IsOpen() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->open;
+}
+
+void WSCapture::Record(const uint8_t direction, const uint8_t* frame, const size_t length) {
+    uint64_t microseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    uint32_t recordHeader[4] = {
+        (uint32_t)(microseconds / 1000000),
+        (uint32_t)(microseconds % 1000000),
+        (uint32_t)(length + 1),     // Captured length, with the direction byte
+        (uint32_t)(length + 1)      // Original length
+    };
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->open) {
+        return;
+    }
+    if (this->pending.size() + WS_CAPTURE_PCAP_RECORD_HEADER_LENGTH + 1 + length > this->maxPendingBytes) {
+        this->dropped++;
+        return;
+    }
+    this->pending.append(reinterpret_cast<const char*>(recordHeader), WS_CAPTURE_PCAP_RECORD_HEADER_LENGTH);
+    this->pending.push_back((char)direction);
+    this->pending.append(reinterpret_cast<const char*>(frame), length);
+    this->framesCaptured++;
+
+    // Otherwise the flush timer takes it, the writer is not woken for every frame
+    if (!this->writing && this->pending.size() >= this->maxPendingBytes / 4) {
+        this->writing = true;
+        boost::asio::post(this->ioc, [this] { this->writeNext(); });
+    }
+}
+
+void WSCapture::armTimer() {
+    if (this->closing) {
+        return;
+    }
+    this->flushTimer.expires_after(std::chrono::milliseconds(this->flushIntervalMilliseconds));
+    this->flushTimer.async_wait([this](const boost::system::error_code& errorCode) { this->onTimer(errorCode); });
+}
+
+void WSCapture::onTimer(const boost::system::error_code& errorCode) {
+    if (errorCode || this->closing) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->writing) {
+            return;     // The timer is armed again when that write is done
+        }
+        this->writing = true;
+    }
+    this->writeNext();
+}
+
+void WSCapture::writeNext() {
+    this->batch.clear();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->pending.empty()) {
+            this->writing = false;
+            this->armTimer();
+            return;
+        }
+        // Both buffers keep their capacity, nothing is allocated once they are grown
+        this->batch.swap(this->pending);
+    }
+
+    size_t bytesWritten = fwrite(this->batch.data(), 1, this->batch.size(), this->file);
+    bool failed = bytesWritten != this->batch.size() || fflush(this->file) != 0;
+    if (failed) {
+        std::cout << "Error: WSCapture - write failed" << std::endl;
+    }
+    this->onWrite(bytesWritten, failed);
+}
+
+void WSCapture::onWrite(const size_t bytesWritten, const bool failed) {
+    this->writes++;
+    this->bytesWritten += bytesWritten;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (failed) {
+        // Disk full or gone, stop capturing rather than report the error for every frame
+        this->open = false;
+        this->pending.clear();
+        this->writing = false;
+        return;
+    }
+    if (this->pending.size() >= this->maxPendingBytes / 4 || (this->closing && !this->pending.empty())) {
+        // Posted, not called, so a steady stream of batches does not grow the stack
+        boost::asio::post(this->ioc, [this] { this->writeNext(); });
+        return;
+    }
+    this->writing = false;
+    this->armTimer();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+// Direction of a captured frame, the first byte of each record
+static const uint8_t WS_CAPTURE_RECEIVED = 0;
+static const uint8_t WS_CAPTURE_SENT = 1;
+
+//
+// WSCapture
+// ----------------------------------------------------------------------------
+// Writes every frame sent and received to a pcap file, link type USER0 (147):
+// each record is the direction byte followed by the BVLC-SC message. In
+// Wireshark, decode DLT 147 with a custom dissector or view the raw bytes.
+//
+// Record() only appends to a pending buffer under a lock, it never waits on
+// the disk and does not wake the writer thread. The writer writes the buffer
+// in one write every flushIntervalMilliseconds, or as soon as it holds a
+// quarter of maxPendingBytes, so a busy connection costs a small fraction of a
+// write system call per frame. When the disk falls behind and the buffer
+// reaches maxPendingBytes, frames are dropped and counted, the connections are
+// not slowed down.
+class WSCapture {
+private:
+    boost::asio::io_context ioc;
+    std::unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> iocWorkGuard;
+    std::thread thread;
+    boost::asio::steady_timer flushTimer;
+
+    std::mutex mutex;
+    std::string pending;        // Records not yet handed to the writer
+    bool writing;               // A batch is being written or about to be, the writer takes pending when it is done
+    bool open;
+    size_t maxPendingBytes;
+    uint32_t flushIntervalMilliseconds;
+
+    // Writer thread only
+    std::string batch;
+    bool closing;               // Write what is pending and stop
+    FILE* file;
+
+    void armTimer();
+    void onTimer(const boost::system::error_code& errorCode);
+    void writeNext();
+    void onWrite(const size_t bytesWritten, const bool failed);
+
+public:
+    // Statistics, readable from any thread
+    std::atomic<uint64_t> framesCaptured;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> writes;           // Write operations, each one a batch of records
+    std::atomic<uint64_t> dropped;          // Pending buffer full
+
+    WSCapture();
+    ~WSCapture();
+
+    // Create (or truncate) filename and write the pcap header
+    bool Open(const std::string& filename, const size_t maxPendingBytes = 4 * 1024 * 1024, const uint32_t flushIntervalMilliseconds = 50);
+    // Write what is pending and close the file
+    void Close();
+    bool IsOpen();
+
+    // Any thread. direction is WS_CAPTURE_*.
+    void Record(const uint8_t direction, const uint8_t* frame, const size_t length);
+};
@@ -1,75 +1,8 @@
 #include "WSClient.h"
 #include <boost/asio/ssl/host_name_verification.hpp> // Explicit include - don't know why Visual Studio does not detect this
+#include <chrono>
 #include <iomanip>
 
-//
-// Uri
-// ----------------------------------------------------------------------------
-// https://stackoverflow.com/a/11044337
-//
-
-struct Uri {
-public:
-    std::string QueryString, Path, Protocol, Host, Port;
-
-    static Uri Parse(const std::string &uri) {
-        Uri result;
-
-        typedef std::string::const_iterator iterator_t;
-
-        if (uri.length() == 0)
-            return result;
-
-        iterator_t uriEnd = uri.end();
-
-        // get query start
-        iterator_t queryStart = std::find(uri.begin(), uriEnd, '?');
-
-        // protocol
-        iterator_t protocolStart = uri.begin();
-        iterator_t protocolEnd = std::find(protocolStart, uriEnd, ':'); //"://");
-
-        if (protocolEnd != uriEnd) {
-            std::string prot = &*(protocolEnd);
-            if ((prot.length() > 3) && (prot.substr(0, 3).compare("://") == 0)) {
-                result.Protocol = std::string(protocolStart, protocolEnd);
-                protocolEnd += 3; //      ://
-            } else
-                protocolEnd = uri.begin(); // no protocol
-        } else
-            protocolEnd = uri.begin(); // no protocol
-
-        // host
-        iterator_t hostStart = protocolEnd;
-        iterator_t pathStart = std::find(hostStart, uriEnd, '/'); // get pathStart
-
-        iterator_t hostEnd = std::find(protocolEnd,
-                                       (pathStart != uriEnd) ? pathStart : queryStart,
-                                       L':'); // check for port
-
-        result.Host = std::string(hostStart, hostEnd);
-
-        // port
-        if ((hostEnd != uriEnd) && ((&*(hostEnd))[0] == ':')) // we have a port
-        {
-            hostEnd++;
-            iterator_t portEnd = (pathStart != uriEnd) ? pathStart : queryStart;
-            result.Port = std::string(hostEnd, portEnd);
-        }
-
-        // path
-        if (pathStart != uriEnd)
-            result.Path = std::string(pathStart, queryStart);
-
-        // query
-        if (queryStart != uriEnd)
-            result.QueryString = std::string(queryStart, uri.end());
-
-        return result;
-
-    } // Parse
-};    // uri
-
 //
 // WSClientUnsecure
 // ----------------------------------------------------------------------------
@@ -78,6 +11,16 @@ WSClientUnsecure::WSClientUnsecure() {
     this->async_ws = NULL;
 }
 
+WSClientUnsecure::~WSClientUnsecure() {
+    // The io_context thread must be gone before the members it uses, and the
+    // stream before the io_context
+    this->ioc.stop();
+    for (std::thread& thread : this->threads) {
+        thread.join();
+    }
+    this->async_ws.reset();
+}
+
 bool WSClientUnsecure::IsConnected() {
     if (this->async_ws != NULL) {
 
@@ -94,6 +37,10 @@ bool WSClientUnsecure::Connect(const WSURI uri, uint8_t* errorCode) {
 
     // Wrap async WSClient
     this->async_ws = std::make_shared<WSClientUnsecureAsync>(this->ioc);
+    this->async_ws->metrics = this->metrics;
+    this->async_ws->capture = this->capture;
+    this->receiveQueue.Clear();
+    this->async_ws->queue = &this->receiveQueue;
 
 
     // Condition variables to stall for connection to be established
@@ -135,14 +82,19 @@ void WSClientUnsecure::Disconnect() {
     this->async_ws->doClose();
 }
 
-size_t WSClientUnsecure::SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode) {
+size_t WSClientUnsecure::SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode, WSFrameTimes *times) {
     if (this->async_ws == NULL) {
         return 0; // Not connected
     }
 
     try {
+        uint64_t sendStart = ExampleProfilerClock::Now();
         this->async_ws->doWrite(message, messageLength);
         *errorCode = this->async_ws->getAndResetErrorCode();
+        if (times != NULL) {
+            times->sendStart = sendStart;
+            times->written = this->async_ws->getWrittenTicks();
+        }
         return this->async_ws->getBytesWritten();
     }
     catch (std::exception const& e) {
@@ -153,12 +105,12 @@ size_t WSClientUnsecure::SendWSMessage(const uint8_t *message, const uint16_t me
     }
 }
 
-size_t WSClientUnsecure::RecvWSMessage(uint8_t *message, uint16_t maxMessageLength, uint8_t *errorCode) {
+size_t WSClientUnsecure::RecvWSMessage(uint8_t *message, uint16_t maxMessageLength, uint8_t *errorCode, WSFrameTimes *times) {
     if (this->async_ws == NULL) {
         return 0; // Not connected
     }
 
-    size_t bytesRead = this->async_ws->pollQueue(message, maxMessageLength, errorCode);
+    size_t bytesRead = this->async_ws->pollQueue(message, maxMessageLength, errorCode, times);
     *errorCode = this->async_ws->getAndResetErrorCode();
     return bytesRead;
 }
@@ -244,8 +196,10 @@ void WSClientUnsecureAsync::onHandshake(beast::error_code errorCode) {
     this->connectDone = true;
     this->connectCv.notify_all();
 
-    // Add code here for post connection setup, if any
-    
+    // Read from the start, not only after the first write
+    if (!errorCode) {
+        this->doRead();
+    }
 }
 
 // Write to server
@@ -254,6 +208,10 @@ void WSClientUnsecureAsync::doWrite(const uint8_t* message, const uint16_t messa
 
     this->writeDone = false;
     std::unique_lock<std::mutex> lck(this->writeMtx);
+    std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+    if (this->capture != NULL) {
+        this->capture->Record(WS_CAPTURE_SENT, message, messageLength);
+    }
 
     // Write to socket
     this->ws.binary(true);
@@ -264,6 +222,13 @@ void WSClientUnsecureAsync::doWrite(const uint8_t* message, const uint16_t messa
     while (!this->writeDone) {
         this->writeCv.wait(lck);
     }
+    if (this->metrics != NULL) {
+        this->metrics->writeLatency->Observe((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - writeStart).count());
+        WSFrameView view(message, messageLength);
+        if (view.IsValid() && view.GetFunction() < BVLC_SC_FUNCTION_COUNT) {
+            this->metrics->messagesOut[view.GetFunction()]->Add();
+        }
+    }
 }
 
 // Write operation done
@@ -277,10 +242,18 @@ void WSClientUnsecureAsync::onWrite(beast::error_code errorCode, std::size_t byt
         this->errorCode = ERROR_TCP_ERROR;
         std::cout << "OnWrite failed: ERROR_TCP_ERROR errorCode=" << errorCode << std::endl;
         this->bytesWritten = 0;
+        if (this->metrics != NULL) {
+            this->metrics->errors->Add();
+        }
     }
     else {
         // Write value
         this->bytesWritten = bytesWritten;
+        this->writtenTicks = ExampleProfilerClock::Now();
+        if (this->metrics != NULL) {
+            this->metrics->framesOut->Add();
+            this->metrics->bytesOut->Add(bytesWritten);
+        }
     }
 
     // Free bytesWritten lock
@@ -316,8 +289,8 @@ size_t WSClientUnsecureAsync::getBytesWritten() {
 void WSClientUnsecureAsync::doRead() {
     std::cout << "in WSClientUnsecureAsync::doRead()\n";
 
-    // Check if read already pending
-    if (!readPending) {
+    // Check if read already pending, or paused until the stack catches up
+    if (!readPending && this->queue->CanRead()) {
         // Read to buffer
         this->ws.async_read(this->buffer, beast::bind_front_handler(&WSClientUnsecureAsync::onRead, shared_from_this()));
         readPending = true;
@@ -331,6 +304,15 @@ void WSClientUnsecureAsync::onRead(beast::error_code errorCode, std::size_t byte
     if (errorCode) {
         this->errorCode = ERROR_TCP_ERROR;
         std::cout << "Error: WSClientUnsecureAsync::onRead() - " << errorCode << std::endl;
+        if (errorCode == websocket::error::message_too_big) {
+            this->queue->drops.Add(WS_DROP_TOO_LONG);
+            if (this->metrics != NULL) {
+                this->metrics->framesDropped[WS_DROP_TOO_LONG]->Add();
+            }
+        }
+        if (this->metrics != NULL) {
+            this->metrics->errors->Add();
+        }
         return;
     }
 
@@ -339,22 +321,46 @@ void WSClientUnsecureAsync::onRead(beast::error_code errorCode, std::size_t byte
         return;
     }
 
-    // Secure queue lock
-    this->messageQueueMtx.lock();
+    uint64_t readTicks = ExampleProfilerClock::Now();
 
     auto bufferData = this->buffer.data();
 
+    // Classified in place, before the frame is copied
+    WSFrameView view(static_cast<const uint8_t*>(bufferData.data()), bufferData.size());
+    if (this->capture != NULL) {
+        this->capture->Record(WS_CAPTURE_RECEIVED, static_cast<const uint8_t*>(bufferData.data()), bufferData.size());
+    }
+    uint8_t function = view.IsValid() ? view.GetFunction() : BVLC_SC_FUNCTION_COUNT;
+    uint8_t priority = view.IsValid() ? view.GetPriority() : WS_PRIORITY_BULK;
+
     std::string bufferString = std::string(net::buffers_begin(bufferData), net::buffers_end(bufferData));
 
     std::cout << "INFO: onRead(), got message - " << WSCommon::HexStringToString(bufferString) << std::endl;
-    this->messageQueue.push(bufferString);
+    WSReceivedFrame frame = { std::move(bufferString), readTicks };
     this->buffer.consume(bytesRead);
+    bool pause;
+    uint8_t dropped = this->queue->Push(frame, priority, &pause);
+    if (this->metrics != NULL) {
+        this->metrics->framesIn->Add();
+        this->metrics->bytesIn->Add(bytesRead);
+        if (function < BVLC_SC_FUNCTION_COUNT) {
+            this->metrics->messagesIn[function]->Add();
+        }
+        else {
+            this->metrics->malformedIn->Add();
+        }
+        this->metrics->receiveQueueDepth->Set((int64_t)this->queue->Size());
+        if (dropped != WS_DROP_NONE) {
+            this->metrics->framesDropped[dropped]->Add();
+        }
+    }
 
-    // Free queue lock
-    this->messageQueueMtx.unlock();
-
-    // Read done, no read pending
+    // Read done, read the next one unless the queue is full. pollQueue()
+    // starts reading again once the stack has caught up.
     this->readPending = false;
+    if (!pause) {
+        this->doRead();
+    }
 }
 
 // Close connection
@@ -393,34 +399,37 @@ bool WSClientUnsecureAsync::IsConnected() {
 }
 
 // Poll queue for messages
-size_t WSClientUnsecureAsync::pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode) {
-    std::string currentMessage;
-
-    // Secure queue lock
-    this->messageQueueMtx.lock();
-
-    if (this->messageQueue.size() > 0) {
-        // There is message in queue
-        currentMessage = this->messageQueue.front();
-        std::cout << "INFO: Got message from BACnet Hub - " << WSCommon::HexStringToString(currentMessage) << std::endl;
-        this->messageQueue.pop();
-    }
-    else {
+size_t WSClientUnsecureAsync::pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode, WSFrameTimes* times) {
+    WSReceivedFrame currentMessage;
+    bool resume;
+    if (!this->queue->Pop(&currentMessage, &resume)) {
         // No messages in queue
-        // Free queue lock
-        this->messageQueueMtx.unlock();
         return 0;
     }
+    std::cout << "INFO: Got message from BACnet Hub - " << WSCommon::HexStringToString(currentMessage.data) << std::endl;
+    if (this->metrics != NULL) {
+        this->metrics->receiveQueueDepth->Set((int64_t)this->queue->Size());
+    }
+    if (resume) {
+        // Reading was paused on a full queue, start it again on the strand of the stream
+        net::post(this->ws.get_executor(), beast::bind_front_handler(&WSClientUnsecureAsync::doRead, shared_from_this()));
+    }
 
-    // Free queue lock
-    this->messageQueueMtx.unlock();
+    if (times != NULL) {
+        times->read = currentMessage.readTicks;
+        times->dequeued = ExampleProfilerClock::Now();
+    }
 
     // Copy to pointer
-    if (currentMessage.size() < maxMessageLength) {
-        memcpy(message, currentMessage.c_str(), currentMessage.size());
-        return currentMessage.size();
+    if (currentMessage.data.size() <= maxMessageLength) {
+        memcpy(message, currentMessage.data.c_str(), currentMessage.data.size());
+        return currentMessage.data.size();
     }
     else {
+        this->queue->drops.Add(WS_DROP_BUFFER_TOO_SMALL);
+        if (this->metrics != NULL) {
+            this->metrics->framesDropped[WS_DROP_BUFFER_TOO_SMALL]->Add();
+        }
         return 0;
     }
 }
@@ -513,6 +522,10 @@ std::cout << "in WSClientSecureAsync::onSslHandshake()" << std::endl;
         std::cout << "OnSslHandshake failed: ERROR_TLS_SERVER_CERTIFICATE_ERROR errorCode=" << errorCode << std::endl;
         return;
     }
+    if (this->ws.next_layer().IsKtlsMode()) {
+        // A direction the kernel did not take stays in user space
+        std::cout << "INFO: kernel TLS send=" << this->IsKtlsSend() << " receive=" << this->IsKtlsReceive() << std::endl;
+    }
 
     // Turn off timeout because websocket stream has it own timeout system
     beast::get_lowest_layer(this->ws).expires_never();
@@ -566,6 +579,10 @@ void WSClientSecureAsync::doWrite(const uint8_t* message, const uint16_t message
 
     this->writeDone = false;
     std::unique_lock<std::mutex> lck(this->writeMtx);
+    std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+    if (this->capture != NULL) {
+        this->capture->Record(WS_CAPTURE_SENT, message, messageLength);
+    }
 
     // Write to socket
     this->ws.binary(true);
@@ -576,6 +593,13 @@ void WSClientSecureAsync::doWrite(const uint8_t* message, const uint16_t message
     while (!this->writeDone) {
         this->writeCv.wait(lck);
     }
+    if (this->metrics != NULL) {
+        this->metrics->writeLatency->Observe((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - writeStart).count());
+        WSFrameView view(message, messageLength);
+        if (view.IsValid() && view.GetFunction() < BVLC_SC_FUNCTION_COUNT) {
+            this->metrics->messagesOut[view.GetFunction()]->Add();
+        }
+    }
 }
 
 // Write operation done
@@ -589,10 +613,18 @@ void WSClientSecureAsync::onWrite(beast::error_code errorCode, std::size_t bytes
         this->errorCode = ERROR_TCP_ERROR;
         std::cout << "OnWrite failed: ERROR_TCP_ERROR errorCode=" << errorCode << std::endl;
         this->bytesWritten = 0;
+        if (this->metrics != NULL) {
+            this->metrics->errors->Add();
+        }
     }
     else {
         // Write value
         this->bytesWritten = bytesWritten;
+        this->writtenTicks = ExampleProfilerClock::Now();
+        if (this->metrics != NULL) {
+            this->metrics->framesOut->Add();
+            this->metrics->bytesOut->Add(bytesWritten);
+        }
     }
 
     // Free bytesWritten lock
@@ -628,8 +660,8 @@ size_t WSClientSecureAsync::getBytesWritten() {
 void WSClientSecureAsync::doRead() {
     std::cout << "in WSClientSecureAsync::doRead()\n";
 
-    // Check if read already pending
-    if (!readPending) {
+    // Check if read already pending, or paused until the stack catches up
+    if (!readPending && this->queue->CanRead()) {
         // Read to buffer
         this->ws.async_read(this->buffer, beast::bind_front_handler(&WSClientSecureAsync::onRead, shared_from_this()));
         readPending = true;
@@ -642,6 +674,15 @@ void WSClientSecureAsync::onRead(beast::error_code errorCode, std::size_t bytesR
     if (errorCode) {
         this->errorCode = ERROR_TCP_ERROR;
         std::cout << "onRead failed: ERROR_TCP_ERROR errorCode=" << errorCode << std::endl;
+        if (errorCode == websocket::error::message_too_big) {
+            this->queue->drops.Add(WS_DROP_TOO_LONG);
+            if (this->metrics != NULL) {
+                this->metrics->framesDropped[WS_DROP_TOO_LONG]->Add();
+            }
+        }
+        if (this->metrics != NULL) {
+            this->metrics->errors->Add();
+        }
         return;
     }
 
@@ -650,22 +691,46 @@ void WSClientSecureAsync::onRead(beast::error_code errorCode, std::size_t bytesR
         return;
     }
 
-    // Secure queue lock
-    this->messageQueueMtx.lock();
+    uint64_t readTicks = ExampleProfilerClock::Now();
 
     auto bufferData = this->buffer.data();
 
+    // Classified in place, before the frame is copied
+    WSFrameView view(static_cast<const uint8_t*>(bufferData.data()), bufferData.size());
+    if (this->capture != NULL) {
+        this->capture->Record(WS_CAPTURE_RECEIVED, static_cast<const uint8_t*>(bufferData.data()), bufferData.size());
+    }
+    uint8_t function = view.IsValid() ? view.GetFunction() : BVLC_SC_FUNCTION_COUNT;
+    uint8_t priority = view.IsValid() ? view.GetPriority() : WS_PRIORITY_BULK;
+
     std::string bufferString = std::string(net::buffers_begin(bufferData), net::buffers_end(bufferData));
 
     std::cout << "INFO: onRead(), got message - " << WSCommon::HexStringToString(bufferString) << std::endl;
-    this->messageQueue.push(bufferString);
+    WSReceivedFrame frame = { std::move(bufferString), readTicks };
     this->buffer.consume(bytesRead);
+    bool pause;
+    uint8_t dropped = this->queue->Push(frame, priority, &pause);
+    if (this->metrics != NULL) {
+        this->metrics->framesIn->Add();
+        this->metrics->bytesIn->Add(bytesRead);
+        if (function < BVLC_SC_FUNCTION_COUNT) {
+            this->metrics->messagesIn[function]->Add();
+        }
+        else {
+            this->metrics->malformedIn->Add();
+        }
+        this->metrics->receiveQueueDepth->Set((int64_t)this->queue->Size());
+        if (dropped != WS_DROP_NONE) {
+            this->metrics->framesDropped[dropped]->Add();
+        }
+    }
 
-    // Free queue lock
-    this->messageQueueMtx.unlock();
-
-    // Read done, no read pending
+    // Read done, read the next one unless the queue is full. pollQueue()
+    // starts reading again once the stack has caught up.
     this->readPending = false;
+    if (!pause) {
+        this->doRead();
+    }
 }
 
 // Close connection
@@ -706,34 +771,37 @@ bool WSClientSecureAsync::IsConnected() {
 }
 
 // Poll queue for messages
-size_t WSClientSecureAsync::pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode) {
-    std::string currentMessage;
-
-    // Secure queue lock
-    this->messageQueueMtx.lock();
-
-    if (this->messageQueue.size() > 0) {
-        // There is message in queue
-        currentMessage = this->messageQueue.front();
-        std::cout << "INFO: Got message from BACnet Hub - " << WSCommon::HexStringToString(currentMessage) << std::endl;
-        this->messageQueue.pop();
-    }
-    else {
+size_t WSClientSecureAsync::pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode, WSFrameTimes* times) {
+    WSReceivedFrame currentMessage;
+    bool resume;
+    if (!this->queue->Pop(&currentMessage, &resume)) {
         // No messages in queue
-        // Free queue lock
-        this->messageQueueMtx.unlock();
         return 0;
     }
+    std::cout << "INFO: Got message from BACnet Hub - " << WSCommon::HexStringToString(currentMessage.data) << std::endl;
+    if (this->metrics != NULL) {
+        this->metrics->receiveQueueDepth->Set((int64_t)this->queue->Size());
+    }
+    if (resume) {
+        // Reading was paused on a full queue, start it again on the strand of the stream
+        net::post(this->ws.get_executor(), beast::bind_front_handler(&WSClientSecureAsync::doRead, shared_from_this()));
+    }
 
-    // Free queue lock
-    this->messageQueueMtx.unlock();
+    if (times != NULL) {
+        times->read = currentMessage.readTicks;
+        times->dequeued = ExampleProfilerClock::Now();
+    }
 
     // Copy to pointer
-    if (currentMessage.size() < maxMessageLength) {
-        memcpy(message, currentMessage.c_str(), currentMessage.size());
-        return currentMessage.size();
+    if (currentMessage.data.size() <= maxMessageLength) {
+        memcpy(message, currentMessage.data.c_str(), currentMessage.data.size());
+        return currentMessage.data.size();
     }
     else {
+        this->queue->drops.Add(WS_DROP_BUFFER_TOO_SMALL);
+        if (this->metrics != NULL) {
+            this->metrics->framesDropped[WS_DROP_BUFFER_TOO_SMALL]->Add();
+        }
         return 0;
     }
 }
@@ -762,6 +830,16 @@ WSClientSecure::WSClientSecure(const std::string& certFilename, const std::strin
     this->m_key = keyFilename;
 }
 
+WSClientSecure::~WSClientSecure() {
+    // The io_context thread must be gone before the members it uses, and the
+    // stream before the io_context
+    this->ioc.stop();
+    for (std::thread& thread : this->threads) {
+        thread.join();
+    }
+    this->async_ws.reset();
+}
+
 bool WSClientSecure::IsConnected() {
     if (this->async_ws != NULL) {
 
@@ -786,9 +864,24 @@ bool WSClientSecure::Connect(const WSURI uri, uint8_t* errorCode) {
     this->ctx.set_options(boost::asio::ssl::context::default_workarounds |
         boost::asio::ssl::context::no_sslv2 |
         boost::asio::ssl::context::no_sslv3);
+    try {
+        this->tlsSettings.Apply(this->ctx);
+    }
+    catch (std::exception const& e) {
+        std::cout << "Error: WSClientSecure::Connect() - " << e.what() << std::endl;
+        *errorCode = ERROR_TLS_ERROR;
+        return false;
+    }
 
     // Wrap async WSClient
     this->async_ws = std::make_shared<WSClientSecureAsync>(this->ioc, this->ctx);
+    if (!this->async_ws->SetKtls(this->ktls)) {
+        std::cout << "WSClientSecure: kernel TLS is not available in this build, TLS stays in user space" << std::endl;
+    }
+    this->async_ws->metrics = this->metrics;
+    this->async_ws->capture = this->capture;
+    this->receiveQueue.Clear();
+    this->async_ws->queue = &this->receiveQueue;
 
     // Setup conditional variables to stall for connection
     this->async_ws->connectDone = false;
@@ -823,14 +916,19 @@ void WSClientSecure::Disconnect() {
     this->async_ws->doClose();
 }
 
-size_t WSClientSecure::SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode) {
+size_t WSClientSecure::SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode, WSFrameTimes *times) {
     if (this->async_ws == NULL) {
         return 0; // Not connected
     }
 
     try {
+        uint64_t sendStart = ExampleProfilerClock::Now();
         this->async_ws->doWrite(message, messageLength);
         *errorCode = this->async_ws->getAndResetErrorCode();
+        if (times != NULL) {
+            times->sendStart = sendStart;
+            times->written = this->async_ws->getWrittenTicks();
+        }
         return this->async_ws->getBytesWritten();
     }
     catch (std::exception const& e) {
@@ -841,12 +939,12 @@ size_t WSClientSecure::SendWSMessage(const uint8_t *message, const uint16_t mess
     }
 }
 
-size_t WSClientSecure::RecvWSMessage(uint8_t *message, uint16_t maxMessageLength, uint8_t *errorCode) {
+size_t WSClientSecure::RecvWSMessage(uint8_t *message, uint16_t maxMessageLength, uint8_t *errorCode, WSFrameTimes *times) {
     if (this->async_ws == NULL) {
         return 0; // Not connected
     }
 
-    size_t bytesRead = this->async_ws->pollQueue(message, maxMessageLength, errorCode);
+    size_t bytesRead = this->async_ws->pollQueue(message, maxMessageLength, errorCode, times);
     *errorCode = this->async_ws->getAndResetErrorCode();
     return bytesRead;
 }
@@ -893,15 +991,17 @@ bool WSNetworkLayer::AddConnection(const WSURI uri, uint8_t *errorCode, const st
             return false;
         }
         this->clients[uri] = unsecureClient;
-        return this->clients[uri]->Connect(uri, errorCode);
+        return this->connect(uri, errorCode);
     } else if (uriSplit.Protocol.compare("wss") == 0) {
         WSClientSecure* secureClient = new (std::nothrow) WSClientSecure(certFilename, keyFilename);
         if (secureClient == NULL) {
             std::cout << "Error: out of memory when creating secureClient" << std::endl;
             return false;
         }
+        secureClient->SetKtls(this->ktls);
+        secureClient->SetTlsSettings(this->tlsSettings);
         this->clients[uri] = secureClient;
-        return this->clients[uri]->Connect(uri, errorCode);
+        return this->connect(uri, errorCode);
     }
     else {
         // Unknown
@@ -909,6 +1009,35 @@ bool WSNetworkLayer::AddConnection(const WSURI uri, uint8_t *errorCode, const st
         return false;
     }
 }
+
+// Connect a client just added to the list
+bool WSNetworkLayer::connect(const WSURI uri, uint8_t *errorCode) {
+    WSClientBase *ws = this->clients[uri];
+    ws->SetQueueLimits(this->queueLimits, this->budget);
+    ws->SetOnReceive(this->onReceive);
+    ws->SetCapture(this->capture);
+    if (this->registry == NULL) {
+        return ws->Connect(uri, errorCode);
+    }
+
+    ExampleConnectionMetrics *metrics = &this->metrics[uri];
+    if (metrics->framesIn == NULL) {
+        this->registry->AddConnection(uri, metrics);
+    }
+    ws->SetMetrics(metrics);
+
+    bool connected = ws->Connect(uri, errorCode);
+    if (!connected || *errorCode != 0) {
+        metrics->errors->Add();
+        return connected;
+    }
+    if (metrics->connects->Get() > 0) {
+        metrics->reconnects->Add();
+    }
+    metrics->connects->Add();
+    return true;
+}
+
 void WSNetworkLayer::RemoveConnection(const WSURI uri) {
     // Check to see if this connection exists
     WSClientBase *ws = GetWSClient(uri);
@@ -925,7 +1054,7 @@ void WSNetworkLayer::RemoveConnection(const WSURI uri) {
     // Remove from client list.
     this->clients.erase(uri);
 }
-size_t WSNetworkLayer::SendWSMessage(const WSURI uri, const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode) {
+size_t WSNetworkLayer::SendWSMessage(const WSURI uri, const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode, WSFrameTimes *times) {
     // Check to see if this connection exists
     WSClientBase *ws = GetWSClient(uri);
     if (ws == NULL) {
@@ -934,10 +1063,10 @@ size_t WSNetworkLayer::SendWSMessage(const WSURI uri, const uint8_t *message, co
     }
 
     // Send message
-    return ws->SendWSMessage(message, messageLength, errorCode);
+    return ws->SendWSMessage(message, messageLength, errorCode, times);
 }
 
-size_t WSNetworkLayer::RecvWSMessage(const WSURI uri, uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode) {
+size_t WSNetworkLayer::RecvWSMessage(const WSURI uri, uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode, WSFrameTimes *times) {
     // Check to see if this connection exists
     WSClientBase *ws = GetWSClient(uri);
     if (ws == NULL) {
@@ -946,7 +1075,7 @@ size_t WSNetworkLayer::RecvWSMessage(const WSURI uri, uint8_t *message, const ui
     }
 
     // Send message
-    return ws->RecvWSMessage(message, maxMessageLength, errorCode);
+    return ws->RecvWSMessage(message, maxMessageLength, errorCode, times);
 }
 
 std::string WSCommon::HexStringToString(std::string hexString) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "WSBackend.h"
+
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core.hpp>
@@ -14,6 +16,7 @@
 #include <boost/beast/ssl.hpp>
 #include <boost/bind.hpp>
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <string>
@@ -32,8 +35,94 @@ using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 #include <map>
 #include <string>
 
+#include "CASBACnetSCExampleMetrics.h"
+#include "CASBACnetSCExampleProfiler.h"
+#include "WSFrameView.h"
+#include "WSCapture.h"
+#include "WSQueue.h"
+#include "WSTlsStream.h"
+#include "WSTlsSettings.h"
+
 typedef std::string WSURI;
 
+//
+// Uri
+// ----------------------------------------------------------------------------
+// https://stackoverflow.com/a/11044337
+//
+
+struct Uri {
+public:
+    std::string QueryString, Path, Protocol, Host, Port;
+
+    static Uri Parse(const std::string &uri) {
+        Uri result;
+
+        typedef std::string::const_iterator iterator_t;
+
+        if (uri.length() == 0)
+            return result;
+
+        iterator_t uriEnd = uri.end();
+
+        // get query start
+        iterator_t queryStart = std::find(uri.begin(), uriEnd, '?');
+
+        // protocol
+        iterator_t protocolStart = uri.begin();
+        iterator_t protocolEnd = std::find(protocolStart, uriEnd, ':'); //"://");
+
+        if (protocolEnd != uriEnd) {
+            std::string prot = &*(protocolEnd);
+            if ((prot.length() > 3) && (prot.substr(0, 3).compare("://") == 0)) {
+                result.Protocol = std::string(protocolStart, protocolEnd);
+                protocolEnd += 3; //      ://
+            } else
+                protocolEnd = uri.begin(); // no protocol
+        } else
+            protocolEnd = uri.begin(); // no protocol
+
+        // host
+        iterator_t hostStart = protocolEnd;
+        iterator_t pathStart = std::find(hostStart, uriEnd, '/'); // get pathStart
+
+        iterator_t hostEnd = std::find(protocolEnd,
+                                       (pathStart != uriEnd) ? pathStart : queryStart,
+                                       L':'); // check for port
+
+        result.Host = std::string(hostStart, hostEnd);
+
+        // port
+        if ((hostEnd != uriEnd) && ((&*(hostEnd))[0] == ':')) // we have a port
+        {
+            hostEnd++;
+            iterator_t portEnd = (pathStart != uriEnd) ? pathStart : queryStart;
+            result.Port = std::string(hostEnd, portEnd);
+        }
+
+        // path
+        if (pathStart != uriEnd)
+            result.Path = std::string(pathStart, queryStart);
+
+        // query
+        if (queryStart != uriEnd)
+            result.QueryString = std::string(queryStart, uri.end());
+
+        return result;
+
+    } // Parse
+};    // uri
+
+// When a frame passed each stage, in ExampleProfilerClock ticks, for
+// ExampleMessageTracer. Received frames have read and dequeued set, sent
+// frames sendStart and written.
+struct WSFrameTimes {
+    uint64_t read;          // onRead()
+    uint64_t dequeued;      // pollQueue()
+    uint64_t sendStart;     // SendWSMessage()
+    uint64_t written;       // onWrite()
+};
+
 #define WEB_SOCKET_DEFAULT_PORT_NOT_SECURE "80"
 #define WEB_SOCKET_DEFAULT_PORT_SECURE "443"
 #define IOC_THREADS 1
@@ -44,13 +133,27 @@ typedef std::string WSURI;
 // ----------------------------------------------------------------------------
 //
 class WSClientBase{
-private:
+protected:
+    ExampleConnectionMetrics* metrics = NULL;     // NULL when the metrics are not collected
+    WSCapture* capture = NULL;                    // NULL when the frames are not captured
+    WSReceiveQueue receiveQueue;                  // Kept over a reconnect, so are its drop counters
+
 public:
+    virtual ~WSClientBase() {}
+    void SetMetrics(ExampleConnectionMetrics* metrics) { this->metrics = metrics; }
+    void SetCapture(WSCapture* capture) { this->capture = capture; }
+    // Before Connect
+    void SetQueueLimits(const WSQueueLimits& limits, WSMemoryBudget* budget) { this->receiveQueue.SetLimits(limits, budget); }
+    // Before Connect
+    void SetOnReceive(std::function<void()> onReceive) { this->receiveQueue.SetOnPush(std::move(onReceive)); }
+    WSReceiveQueue& GetReceiveQueue() { return this->receiveQueue; }
+
     virtual bool IsConnected() = 0;
     virtual bool Connect(const WSURI uri, uint8_t *errorCode) = 0;
     virtual void Disconnect() = 0;
-    virtual size_t SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode) = 0;
-    virtual size_t RecvWSMessage(uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode) = 0;
+    // times, if not NULL, is set to when the frame passed each stage
+    virtual size_t SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode, WSFrameTimes *times = NULL) = 0;
+    virtual size_t RecvWSMessage(uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode, WSFrameTimes *times = NULL) = 0;
 };
 
 //
@@ -72,15 +175,13 @@ private:
 
     beast::flat_buffer buffer;
     size_t bytesWritten;
+    uint64_t writtenTicks;
     uint8_t bufArr[1024];
     bool readPending;
 
     // Locks for write operation
     std::mutex writeLenMtx;
 
-    // Queue for messages
-    std::queue<std::string> messageQueue;
-    std::mutex messageQueueMtx;
     std::mutex notifyRead;
 
     // Async functions
@@ -113,13 +214,25 @@ public:
     bool closeDone;
     bool connectDone;
 
+    // Set by the wrapping client, NULL when the metrics are not collected
+    ExampleConnectionMetrics* metrics;
+    // Set by the wrapping client, NULL when the frames are not captured
+    WSCapture* capture;
+    // Set by the wrapping client, frames read and not yet polled
+    WSReceiveQueue* queue;
+
     // Constructor
     explicit WSClientUnsecureAsync(net::io_context& ioc)
         : resolver(net::make_strand(ioc))
         , ws(net::make_strand(ioc)) {
+        this->ws.read_message_max(BVLC_SC_MAX_BVLC_LENGTH);
         this->errorCode = 0;
         this->ioc = &ioc;
         this->readPending = false;
+        this->writtenTicks = 0;
+        this->metrics = NULL;
+        this->capture = NULL;
+        this->queue = NULL;
     }
 
     // Functions
@@ -131,7 +244,8 @@ public:
 
     // Getters
     size_t getBytesWritten();
-    size_t pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode);
+    uint64_t getWrittenTicks() { return this->writtenTicks; }
+    size_t pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode, WSFrameTimes* times = NULL);
     uint8_t getAndResetErrorCode();
 
     // Status
@@ -152,11 +266,12 @@ private:
 
 public:
     WSClientUnsecure();
+    ~WSClientUnsecure();
     bool IsConnected();
     bool Connect(const WSURI uri, uint8_t* errorCode);
     void Disconnect();
-    size_t SendWSMessage(const uint8_t* message, const uint16_t messageLength, uint8_t* errorCode);
-    size_t RecvWSMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* errorCode);
+    size_t SendWSMessage(const uint8_t* message, const uint16_t messageLength, uint8_t* errorCode, WSFrameTimes* times = NULL);
+    size_t RecvWSMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* errorCode, WSFrameTimes* times = NULL);
 };
 
 //
@@ -166,7 +281,7 @@ public:
 class WSClientSecureAsync : public std::enable_shared_from_this<WSClientSecureAsync> {
 private:
     tcp::resolver resolver;
-    websocket::stream<beast::ssl_stream<beast::tcp_stream>> ws;
+    websocket::stream<WSTlsStream> ws;     // beast::ssl_stream, or OpenSSL on the socket with kTLS, see WSTlsStream
     std::string host;
     std::string port;
     uint8_t errorCode;
@@ -179,15 +294,13 @@ private:
 
     beast::flat_buffer buffer;
     size_t bytesWritten;
+    uint64_t writtenTicks;
     uint8_t bufArr[1024];
     bool readPending;
 
     // Locks for write operation
     std::mutex writeLenMtx;
 
-    // Queue for messages
-    std::queue<std::string> messageQueue;
-    std::mutex messageQueueMtx;
     std::mutex notifyRead;
 
     // Async functions
@@ -222,19 +335,32 @@ public:
     bool closeDone;
     bool connectDone;
 
+    // Set by the wrapping client, NULL when the metrics are not collected
+    ExampleConnectionMetrics* metrics;
+    // Set by the wrapping client, NULL when the frames are not captured
+    WSCapture* capture;
+    // Set by the wrapping client, frames read and not yet polled
+    WSReceiveQueue* queue;
+
     // Constructor
     explicit WSClientSecureAsync(net::io_context& ioc, ssl::context& ctx)
         : resolver(net::make_strand(ioc))
         , ws(net::make_strand(ioc), ctx) {
+        this->ws.read_message_max(BVLC_SC_MAX_BVLC_LENGTH);
         this->errorCode = 0;
         this->ioc = &ioc;
         this->ctx = &ctx;
         this->readPending = false;
+        this->writtenTicks = 0;
+        this->metrics = NULL;
+        this->capture = NULL;
+        this->queue = NULL;
     }
 
     // Getters
     size_t getBytesWritten();
-    size_t pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode);
+    uint64_t getWrittenTicks() { return this->writtenTicks; }
+    size_t pollQueue(uint8_t* message, uint16_t maxMessageLength, uint8_t* errorCode, WSFrameTimes* times = NULL);
     uint8_t getAndResetErrorCode();
 
     // Functions
@@ -243,6 +369,11 @@ public:
     void doRead();
     void doClose();
 
+    // Before run(), false when this build cannot offload TLS to the kernel
+    bool SetKtls(const bool enabled) { return this->ws.next_layer().SetKtls(enabled, *this->ctx); }
+    bool IsKtlsSend() const { return this->ws.next_layer().IsKtlsSend(); }
+    bool IsKtlsReceive() const { return this->ws.next_layer().IsKtlsReceive(); }
+
     // Status
     bool IsConnected();
 };
@@ -262,15 +393,26 @@ private:
 
     std::string m_cert;
     std::string m_key;
+    bool ktls = false;
+    WSTlsSettings tlsSettings;
 
 public:
     WSClientSecure();
     WSClientSecure(const std::string& certFilename, const std::string& keyFilename);
+    ~WSClientSecure();
+    // Before Connect. Offload the TLS record layer to the kernel after the
+    // handshake where Linux and OpenSSL 3 allow it, see WSTlsStream.
+    void SetKtls(const bool enabled) { this->ktls = enabled; }
+    // After Connect, true for each direction the kernel took
+    bool IsKtlsSend() { return this->async_ws != NULL && this->async_ws->IsKtlsSend(); }
+    bool IsKtlsReceive() { return this->async_ws != NULL && this->async_ws->IsKtlsReceive(); }
+    // Before Connect. Key exchange groups, cipher suites and signature algorithms, see WSTlsSettings.
+    void SetTlsSettings(const WSTlsSettings& settings) { this->tlsSettings = settings; }
     bool IsConnected();
     bool Connect(const WSURI uri, uint8_t* errorCode);
     void Disconnect();
-    size_t SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode);
-    size_t RecvWSMessage(uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode);
+    size_t SendWSMessage(const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode, WSFrameTimes *times = NULL);
+    size_t RecvWSMessage(uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode, WSFrameTimes *times = NULL);
 };
 
 //
@@ -282,15 +424,42 @@ class WSNetworkLayer {
 private:
     std::map<WSURI, WSClientBase *> clients;
 
+    // Kept after a connection is removed so the counters continue over a reconnect
+    ExampleMetricsRegistry* registry = NULL;
+    std::map<WSURI, ExampleConnectionMetrics> metrics;
+    WSCapture* capture = NULL;
+    bool ktls = false;
+    WSTlsSettings tlsSettings;
+
+    WSQueueLimits queueLimits;
+    WSMemoryBudget* budget = NULL;
+    std::function<void()> onReceive;
+
     // Check to see if this connection exists
     WSClientBase *GetWSClient(WSURI uri);
 
+    // Connect a client just added to the list, counting the connect in its metrics
+    bool connect(const WSURI uri, uint8_t *errorCode);
+
 public:
+    // Collect per-connection metrics in this registry, for the connections added after the call
+    void SetMetrics(ExampleMetricsRegistry* registry) { this->registry = registry; }
+    // Write the frames of the connections added after the call to this capture file
+    void SetCapture(WSCapture* capture) { this->capture = capture; }
+    // Kernel TLS for the wss:// connections added after the call, see WSTlsStream
+    void SetKtls(const bool enabled) { this->ktls = enabled; }
+    // Handshake settings of the wss:// connections added after the call
+    void SetTlsSettings(const WSTlsSettings& settings) { this->tlsSettings = settings; }
+    // Bound the receive queue of the connections added after the call. budget, if not NULL, is shared by all of them.
+    void SetQueueLimits(const WSQueueLimits& limits, WSMemoryBudget* budget) { this->queueLimits = limits; this->budget = budget; }
+    // Called on a transport thread when a frame of a connection added after the call is queued for RecvWSMessage
+    void SetOnReceive(std::function<void()> onReceive) { this->onReceive = onReceive; }
+
     bool AddConnection(const WSURI uri, uint8_t *errorCode, const std::string& certFilename = "", const std::string& keyFilename = "");
     void RemoveConnection(const WSURI uri);
     bool IsConnected(const WSURI uri);
-    size_t SendWSMessage(const WSURI uri, const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode);
-    size_t RecvWSMessage(const WSURI uri, uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode);
+    size_t SendWSMessage(const WSURI uri, const uint8_t *message, const uint16_t messageLength, uint8_t *errorCode, WSFrameTimes *times = NULL);
+    size_t RecvWSMessage(const WSURI uri, uint8_t *message, const uint16_t maxMessageLength, uint8_t *errorCode, WSFrameTimes *times = NULL);
 };
 
 // Error Codes
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "WSQueue.h"
+#include "CASBACnetSCExampleApdu.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// BVLC-SC message functions (ASHRAE 135-2020 AB.2)
+static const uint8_t BVLC_SC_FUNCTION_BVLC_RESULT = 0x00;
+static const uint8_t BVLC_SC_FUNCTION_ENCAPSULATED_NPDU = 0x01;
+static const uint8_t BVLC_SC_FUNCTION_ADDRESS_RESOLUTION = 0x02;
+static const uint8_t BVLC_SC_FUNCTION_ADDRESS_RESOLUTION_ACK = 0x03;
+static const uint8_t BVLC_SC_FUNCTION_ADVERTISEMENT = 0x04;
+static const uint8_t BVLC_SC_FUNCTION_ADVERTISEMENT_SOLICITATION = 0x05;
+static const uint8_t BVLC_SC_FUNCTION_CONNECT_REQUEST = 0x06;
+static const uint8_t BVLC_SC_FUNCTION_CONNECT_ACCEPT = 0x07;
+static const uint8_t BVLC_SC_FUNCTION_DISCONNECT_REQUEST = 0x08;
+static const uint8_t BVLC_SC_FUNCTION_DISCONNECT_ACK = 0x09;
+static const uint8_t BVLC_SC_FUNCTION_HEARTBEAT_REQUEST = 0x0A;
+static const uint8_t BVLC_SC_FUNCTION_HEARTBEAT_ACK = 0x0B;
+static const uint8_t BVLC_SC_FUNCTION_PROPRIETARY_MESSAGE = 0x0C;
+static const uint8_t BVLC_SC_FUNCTION_COUNT = 0x0D;
+
+// BVLC-SC control flags
+static const uint8_t BVLC_SC_CONTROL_ORIGINATING_VMAC = 0x08;
+static const uint8_t BVLC_SC_CONTROL_DESTINATION_VMAC = 0x04;
+static const uint8_t BVLC_SC_CONTROL_DESTINATION_OPTIONS = 0x02;
+static const uint8_t BVLC_SC_CONTROL_DATA_OPTIONS = 0x01;
+
+// BVLC-SC header option marker
+static const uint8_t BVLC_SC_HEADER_OPTION_MORE = 0x80;
+static const uint8_t BVLC_SC_HEADER_OPTION_DATA = 0x20;
+
+static const uint8_t BVLC_SC_VMAC_LENGTH = 6;
+static const uint8_t BVLC_SC_UUID_LENGTH = 16;
+static const uint8_t BVLC_SC_FIXED_HEADER_LENGTH = 4;
+
+// The broadcast VMAC (X'FFFFFFFFFFFF') packed the same way as WSHubFrameHeader::PackVmac()
+static const uint64_t BVLC_SC_BROADCAST_VMAC = 0xFFFFFFFFFFFFULL;
+
+// NPDU control bits (ASHRAE 135 6.2.2)
+static const uint8_t NPDU_CONTROL_NETWORK_MESSAGE = 0x80;
+static const uint8_t NPDU_CONTROL_DESTINATION = 0x20;
+static const uint8_t NPDU_CONTROL_SOURCE = 0x08;
+static const uint8_t NPDU_CONTROL_EXPECTING_REPLY = 0x04;
+
+//
+// WSFrameView
+// ----------------------------------------------------------------------------
+// A BVLC-SC header decoded in place: function, control flags, message ID,
+// VMACs and the header options around the payload. It points into the frame,
+// nothing is copied or allocated, and every member is constexpr, so the
+// transport can classify each frame it reads or writes for the cost of a few
+// loads and compares. The fields are only meaningful when IsValid().
+class WSFrameView {
+private:
+    const uint8_t* frame;
+    size_t length;
+    size_t optionsOffset;       // First byte after the VMACs
+    size_t payloadOffset;       // First byte after the header options, 0 when the header is malformed
+
+    // End of the list of header options at offset, 0 when it runs past the frame
+    static constexpr size_t skipOptions(const uint8_t* frame, const size_t length, size_t offset) {
+        bool more = true;
+        while (more) {
+            if (offset >= length) {
+                return 0;
+            }
+            uint8_t marker = frame[offset++];
+            if (marker & BVLC_SC_HEADER_OPTION_DATA) {
+                if (offset + 2 > length) {
+                    return 0;
+                }
+                offset += 2 + (size_t)((frame[offset] << 8) | frame[offset + 1]);
+                if (offset > length) {
+                    return 0;
+                }
+            }
+            more = (marker & BVLC_SC_HEADER_OPTION_MORE) != 0;
+        }
+        return offset;
+    }
+
+public:
+    constexpr WSFrameView(const uint8_t* frame, const size_t length) :
+        frame(frame),
+        length(frame == NULL ? 0 : length),
+        optionsOffset(0),
+        payloadOffset(0) {
+        if (this->length >= BVLC_SC_FIXED_HEADER_LENGTH) {
+            size_t offset = BVLC_SC_FIXED_HEADER_LENGTH;
+            offset += (frame[1] & BVLC_SC_CONTROL_ORIGINATING_VMAC) ? BVLC_SC_VMAC_LENGTH : 0;
+            offset += (frame[1] & BVLC_SC_CONTROL_DESTINATION_VMAC) ? BVLC_SC_VMAC_LENGTH : 0;
+            if (offset <= this->length) {
+                this->optionsOffset = offset;
+                if (frame[1] & BVLC_SC_CONTROL_DESTINATION_OPTIONS) {
+                    offset = skipOptions(frame, this->length, offset);
+                }
+                if (offset != 0 && (frame[1] & BVLC_SC_CONTROL_DATA_OPTIONS)) {
+                    offset = skipOptions(frame, this->length, offset);
+                }
+                this->payloadOffset = offset;
+            }
+        }
+    }
+
+    constexpr bool IsValid() const { return this->payloadOffset != 0; }
+
+    constexpr uint8_t GetFunction() const { return this->frame[0]; }
+    constexpr uint8_t GetControl() const { return this->frame[1]; }
+    constexpr uint16_t GetMessageId() const { return (uint16_t)((this->frame[2] << 8) | this->frame[3]); }
+
+    // NULL when not present
+    constexpr const uint8_t* GetOriginatingVmac() const {
+        return (this->frame[1] & BVLC_SC_CONTROL_ORIGINATING_VMAC) ? this->frame + BVLC_SC_FIXED_HEADER_LENGTH : NULL;
+    }
+    constexpr const uint8_t* GetDestinationVmac() const {
+        return (this->frame[1] & BVLC_SC_CONTROL_DESTINATION_VMAC) ? this->frame + this->optionsOffset - BVLC_SC_VMAC_LENGTH : NULL;
+    }
+    constexpr bool IsBroadcast() const {
+        const uint8_t* destination = this->GetDestinationVmac();
+        return destination != NULL && (destination[0] & destination[1] & destination[2] & destination[3] & destination[4] & destination[5]) == 0xFF;
+    }
+
+    // Header options: destination options first, then data options
+    constexpr size_t GetOptionsOffset() const { return this->optionsOffset; }
+    constexpr size_t GetPayloadOffset() const { return this->payloadOffset; }
+    constexpr const uint8_t* GetPayload() const { return this->frame + this->payloadOffset; }
+    constexpr size_t GetPayloadLength() const { return this->length - this->payloadOffset; }
+
+    // APDU of an Encapsulated-NPDU, NULL for any other function, a network layer message or a short frame
+    constexpr const uint8_t* GetApdu(size_t* apduLength) const {
+        return this->IsValid() && this->GetFunction() == BVLC_SC_FUNCTION_ENCAPSULATED_NPDU ? GetNpduApdu(this->GetPayload(), this->GetPayloadLength(), apduLength) : NULL;
+    }
+
+    // WS_PRIORITY_* class of the frame when it is sent to one node, see WSPriorityWriteQueue
+    constexpr uint8_t GetPriority() const {
+        if (this->GetFunction() != BVLC_SC_FUNCTION_ENCAPSULATED_NPDU) {
+            return WS_PRIORITY_CONTROL;
+        }
+        size_t apduLength = 0;
+        const uint8_t* apdu = this->GetApdu(&apduLength);
+        return apdu == NULL ? WS_PRIORITY_BULK : GetApduPriority(apdu);
+    }
+
+    // APDU of an NPDU, NULL for a network layer message or when there is none
+    static constexpr const uint8_t* GetNpduApdu(const uint8_t* npdu, const size_t npduLength, size_t* apduLength) {
+        if (npduLength < 2 || (npdu[1] & NPDU_CONTROL_NETWORK_MESSAGE)) {
+            return NULL;
+        }
+        size_t offset = 2;
+        if (npdu[1] & NPDU_CONTROL_DESTINATION) {
+            if (offset + 3 > npduLength) {
+                return NULL;
+            }
+            offset += 3 + npdu[offset + 2];     // DNET, DLEN, DADR
+        }
+        if (npdu[1] & NPDU_CONTROL_SOURCE) {
+            if (offset + 3 > npduLength) {
+                return NULL;
+            }
+            offset += 3 + npdu[offset + 2];     // SNET, SLEN, SADR
+        }
+        if (npdu[1] & NPDU_CONTROL_DESTINATION) {
+            offset++;                           // Hop count
+        }
+        if (offset >= npduLength) {
+            return NULL;
+        }
+        *apduLength = npduLength - offset;
+        return npdu + offset;
+    }
+
+    // Confirmed requests and their answers, unless segmented, are WS_PRIORITY_CONFIRMED
+    static constexpr uint8_t GetApduPriority(const uint8_t* apdu) {
+        uint8_t type = apdu[0] >> 4;
+        if (type == APDU_TYPE_UNCONFIRMED_REQUEST || type > APDU_TYPE_ABORT) {
+            return WS_PRIORITY_BULK;
+        }
+        // A segmented transfer is many frames, its Segment-ACKs are not
+        if ((type == APDU_TYPE_CONFIRMED_REQUEST || type == APDU_TYPE_COMPLEX_ACK) && (apdu[0] & APDU_SEGMENTED_MESSAGE)) {
+            return WS_PRIORITY_BULK;
+        }
+        return WS_PRIORITY_CONFIRMED;
+    }
+
+    // e.g. "heartbeat_request", for metric labels and reports
+    static constexpr const char* GetFunctionName(const uint8_t function) {
+        switch (function) {
+        case BVLC_SC_FUNCTION_BVLC_RESULT: return "bvlc_result";
+        case BVLC_SC_FUNCTION_ENCAPSULATED_NPDU: return "encapsulated_npdu";
+        case BVLC_SC_FUNCTION_ADDRESS_RESOLUTION: return "address_resolution";
+        case BVLC_SC_FUNCTION_ADDRESS_RESOLUTION_ACK: return "address_resolution_ack";
+        case BVLC_SC_FUNCTION_ADVERTISEMENT: return "advertisement";
+        case BVLC_SC_FUNCTION_ADVERTISEMENT_SOLICITATION: return "advertisement_solicitation";
+        case BVLC_SC_FUNCTION_CONNECT_REQUEST: return "connect_request";
+        case BVLC_SC_FUNCTION_CONNECT_ACCEPT: return "connect_accept";
+        case BVLC_SC_FUNCTION_DISCONNECT_REQUEST: return "disconnect_request";
+        case BVLC_SC_FUNCTION_DISCONNECT_ACK: return "disconnect_ack";
+        case BVLC_SC_FUNCTION_HEARTBEAT_REQUEST: return "heartbeat_request";
+        case BVLC_SC_FUNCTION_HEARTBEAT_ACK: return "heartbeat_ack";
+        case BVLC_SC_FUNCTION_PROPRIETARY_MESSAGE: return "proprietary_message";
+        default: return "unknown";
+        }
+    }
+};
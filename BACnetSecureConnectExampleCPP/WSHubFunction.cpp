@@ -0,0 +1,557 @@
+#include "WSHubFunction.h"
+
+//
+// WSHubFrameHeader
+// ----------------------------------------------------------------------------
+
+bool WSHubFrameHeader::Parse(const uint8_t* frame, const size_t length, WSHubFrameHeader* header) {
+    WSFrameView view(frame, length);
+    if (!view.IsValid()) {
+        return false;
+    }
+    header->function = view.GetFunction();
+    header->control = view.GetControl();
+    header->messageId = view.GetMessageId();
+    header->originatingVmac = view.GetOriginatingVmac();
+    header->destinationVmac = view.GetDestinationVmac();
+    header->optionsOffset = view.GetOptionsOffset();
+    header->payloadOffset = view.GetPayloadOffset();
+    return true;
+}
+
+const uint8_t* WSHubFrameHeader::GetApdu(const uint8_t* frame, const size_t length, size_t* apduLength) const {
+    if (this->function != BVLC_SC_FUNCTION_ENCAPSULATED_NPDU || this->payloadOffset >= length) {
+        return NULL;
+    }
+    return WSFrameView::GetNpduApdu(frame + this->payloadOffset, length - this->payloadOffset, apduLength);
+}
+
+uint8_t WSHubFrameHeader::GetPriority(const uint8_t* frame, const size_t length) const {
+    if (this->function != BVLC_SC_FUNCTION_ENCAPSULATED_NPDU) {
+        return WS_PRIORITY_CONTROL;
+    }
+    // Network layer messages and unconfirmed requests
+    size_t apduLength = 0;
+    const uint8_t* apdu = this->GetApdu(frame, length, &apduLength);
+    return apdu == NULL ? WS_PRIORITY_BULK : WSFrameView::GetApduPriority(apdu);
+}
+
+uint64_t WSHubFrameHeader::PackVmac(const uint8_t* vmac) {
+    uint64_t packed = 0;
+    for (uint8_t offset = 0; offset < BVLC_SC_VMAC_LENGTH; offset++) {
+        packed = (packed << 8) | vmac[offset];
+    }
+    return packed;
+}
+
+void WSHubFrameHeader::UnpackVmac(const uint64_t packed, uint8_t* vmac) {
+    for (uint8_t offset = 0; offset < BVLC_SC_VMAC_LENGTH; offset++) {
+        vmac[offset] = (uint8_t)(packed >> (8 * (BVLC_SC_VMAC_LENGTH - 1 - offset)));
+    }
+}
+
+//
+// WSHubSessionBase
+// ----------------------------------------------------------------------------
+
+WSHubSessionBase::WSHubSessionBase(WSHubFunction* hub) {
+    this->hub = hub;
+    this->writeQueue.SetLimits(hub->GetQueueLimits(), hub->GetMemoryBudget(), &hub->GetQueueDrops());
+    this->closing = false;
+    this->vmac = 0;
+    memset(this->uuid, 0, BVLC_SC_UUID_LENGTH);
+    this->maxBvlcLength = BVLC_SC_MAX_BVLC_LENGTH;
+    this->broadcastIndex = 0;
+    this->connected = false;
+}
+
+void WSHubSessionBase::onAccept(beast::error_code errorCode) {
+    if (errorCode) {
+        std::cout << "WSHubSession: accept failed errorCode=" << errorCode << std::endl;
+        return;
+    }
+
+    this->asyncRead();
+}
+
+void WSHubSessionBase::onRead(beast::error_code errorCode, std::size_t bytesRead) {
+    if (errorCode) {
+        if (errorCode == websocket::error::message_too_big) {
+            this->hub->GetQueueDrops().Add(WS_DROP_TOO_LONG);
+        }
+        // Connection closed or failed, remove from the routing table
+        this->closing = true;
+        this->hub->OnSessionClosed(this);
+        return;
+    }
+
+    // flat_buffer is always contiguous
+    auto bufferData = this->buffer.data();
+    this->hub->OnFrame(this, static_cast<const uint8_t*>(bufferData.data()), bufferData.size());
+    this->buffer.consume(bytesRead);
+
+    if (!this->closing) {
+        this->asyncRead();
+    }
+}
+
+bool WSHubSessionBase::Send(const WSHubFrame& frame, const uint8_t priority) {
+    if (this->closing) {
+        return true;
+    }
+
+    bool kept = this->writeQueue.Push(frame, priority);
+    if (this->writing == NULL) {
+        this->writeNext();
+    }
+    return kept;
+}
+
+void WSHubSessionBase::writeNext() {
+    // The scheduler picks the class, see WSPriorityWriteQueue::Pop()
+    this->writing = this->writeQueue.Pop();
+    if (this->writing == NULL) {
+        if (this->closing) {
+            this->asyncClose();
+        }
+        return;
+    }
+    if (this->hub->GetCapture() != NULL) {
+        this->hub->GetCapture()->Record(WS_CAPTURE_SENT, reinterpret_cast<const uint8_t*>(this->writing->data()), this->writing->size());
+    }
+    this->asyncWrite(this->writing);
+}
+
+void WSHubSessionBase::onWrite(beast::error_code errorCode, std::size_t bytesWritten) {
+    (void)bytesWritten;
+
+    this->writing.reset();
+    if (errorCode) {
+        this->writeQueue.Clear();
+        this->Close();
+        return;
+    }
+
+    this->writeNext();
+}
+
+void WSHubSessionBase::Close() {
+    if (this->closing) {
+        return;
+    }
+    this->closing = true;
+    this->hub->OnSessionClosed(this);
+
+    // Let the write queue drain (e.g. a Disconnect-ACK) before closing
+    if (this->writing == NULL) {
+        this->asyncClose();
+    }
+}
+
+size_t WSHubSessionBase::GetWriteQueueDepth() {
+    return this->writeQueue.Size();
+}
+
+//
+// WSHubUnsecureSession
+// ----------------------------------------------------------------------------
+
+WSHubUnsecureSession::WSHubUnsecureSession(WSHubFunction* hub, tcp::socket&& socket)
+    : WSHubSessionBase(hub)
+    , ws(std::move(socket)) {
+    this->ws.read_message_max(BVLC_SC_MAX_BVLC_LENGTH);
+}
+
+void WSHubUnsecureSession::run() {
+    // Set suggested timeout settings for the websocket
+    this->ws.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+
+    // Answer with the BACnet/SC hub sub-protocol
+    this->ws.set_option(websocket::stream_base::decorator(
+        [](websocket::response_type& res) {
+            res.set(http::field::sec_websocket_protocol,
+                "hub.bsc.bacnet.org");
+        }));
+    this->ws.binary(true);
+
+    this->ws.async_accept(beast::bind_front_handler(&WSHubUnsecureSession::onAccept, shared_from_this()));
+}
+
+void WSHubUnsecureSession::asyncRead() {
+    this->ws.async_read(this->buffer, beast::bind_front_handler(&WSHubUnsecureSession::onRead, shared_from_this()));
+}
+
+void WSHubUnsecureSession::asyncWrite(const WSHubFrame& frame) {
+    this->ws.async_write(net::buffer(frame->data(), frame->size()), beast::bind_front_handler(&WSHubUnsecureSession::onWrite, shared_from_this()));
+}
+
+void WSHubUnsecureSession::asyncClose() {
+    auto self = shared_from_this();
+    this->ws.async_close(websocket::close_code::normal, [self](beast::error_code) {});
+}
+
+//
+// WSHubSecureSession
+// ----------------------------------------------------------------------------
+
+WSHubSecureSession::WSHubSecureSession(WSHubFunction* hub, tcp::socket&& socket, ssl::context& ctx)
+    : WSHubSessionBase(hub)
+    , ws(std::move(socket), ctx) {
+    this->ws.read_message_max(BVLC_SC_MAX_BVLC_LENGTH);
+}
+
+void WSHubSecureSession::run() {
+    // Set a timeout on the TLS handshake
+    beast::get_lowest_layer(this->ws).expires_after(std::chrono::seconds(30));
+
+    this->ws.next_layer().async_handshake(
+        ssl::stream_base::server,
+        beast::bind_front_handler(
+            &WSHubSecureSession::onSslHandshake,
+            std::static_pointer_cast<WSHubSecureSession>(shared_from_this())));
+}
+
+void WSHubSecureSession::onSslHandshake(beast::error_code errorCode) {
+    if (errorCode) {
+        std::cout << "WSHubSecureSession: TLS handshake failed errorCode=" << errorCode << std::endl;
+        return;
+    }
+
+    // Turn off timeout because websocket stream has it own timeout system
+    beast::get_lowest_layer(this->ws).expires_never();
+
+    // Set suggested timeout settings for the websocket
+    this->ws.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+
+    // Answer with the BACnet/SC hub sub-protocol
+    this->ws.set_option(websocket::stream_base::decorator(
+        [](websocket::response_type& res) {
+            res.set(http::field::sec_websocket_protocol,
+                "hub.bsc.bacnet.org");
+        }));
+    this->ws.binary(true);
+
+    this->ws.async_accept(beast::bind_front_handler(&WSHubSecureSession::onAccept, shared_from_this()));
+}
+
+void WSHubSecureSession::asyncRead() {
+    this->ws.async_read(this->buffer, beast::bind_front_handler(&WSHubSecureSession::onRead, shared_from_this()));
+}
+
+void WSHubSecureSession::asyncWrite(const WSHubFrame& frame) {
+    this->ws.async_write(net::buffer(frame->data(), frame->size()), beast::bind_front_handler(&WSHubSecureSession::onWrite, shared_from_this()));
+}
+
+void WSHubSecureSession::asyncClose() {
+    auto self = shared_from_this();
+    this->ws.async_close(websocket::close_code::normal, [self](beast::error_code) {});
+}
+
+//
+// WSHubFunction
+// ----------------------------------------------------------------------------
+
+WSHubFunction::WSHubFunction() {
+    this->secure = false;
+    memset(this->vmac, 0, BVLC_SC_VMAC_LENGTH);
+    memset(this->uuid, 0, BVLC_SC_UUID_LENGTH);
+    this->framesReceived = 0;
+    this->unicastForwarded = 0;
+    this->broadcastForwarded = 0;
+    this->broadcastDeliveries = 0;
+    this->framesDropped = 0;
+    this->connectionCount = 0;
+    this->budget = NULL;
+    this->capture = NULL;
+}
+
+WSHubFunction::~WSHubFunction() {
+    this->Stop();
+}
+
+bool WSHubFunction::Start(const std::string& address, const uint16_t port, const uint8_t* hubVmac, const uint8_t* hubUuid, const std::string& certFilename, const std::string& keyFilename) {
+    memcpy(this->vmac, hubVmac, BVLC_SC_VMAC_LENGTH);
+    memcpy(this->uuid, hubUuid, BVLC_SC_UUID_LENGTH);
+
+    // Size the routing table for a large site up front
+    this->routingTable.reserve(4096);
+    this->broadcastList.reserve(4096);
+
+    try {
+        if (certFilename.size() > 0 && keyFilename.size() > 0) {
+            this->ctx.set_options(boost::asio::ssl::context::default_workarounds |
+                boost::asio::ssl::context::no_sslv2 |
+                boost::asio::ssl::context::no_sslv3);
+            this->tlsSettings.Apply(this->ctx);
+            this->ctx.use_certificate_chain_file(certFilename);
+            this->ctx.use_private_key_file(keyFilename, ssl::context::pem);
+            this->secure = true;
+        }
+
+        tcp::endpoint endpoint(net::ip::make_address(address), port);
+        this->acceptor = std::make_shared<tcp::acceptor>(net::make_strand(this->ioc));
+        this->acceptor->open(endpoint.protocol());
+        this->acceptor->set_option(net::socket_base::reuse_address(true));
+        this->acceptor->bind(endpoint);
+        this->acceptor->listen(net::socket_base::max_listen_connections);
+    }
+    catch (std::exception const& e) {
+        std::cout << "Error: WSHubFunction::Start() - " << e.what() << std::endl;
+        return false;
+    }
+
+    this->doAccept();
+    this->thread = std::thread([this] {
+        try {
+            this->ioc.run();
+        }
+        catch (std::exception& e) {
+            std::cout << "DEBUG: WSHubFunction ioc.run() EXCEPTION - " << e.what() << std::endl;
+        }
+    });
+    return true;
+}
+
+void WSHubFunction::Stop() {
+    if (!this->thread.joinable()) {
+        return;
+    }
+
+    net::post(this->ioc, [this] {
+        beast::error_code errorCode;
+        if (this->acceptor) {
+            this->acceptor->close(errorCode);
+        }
+        this->routingTable.clear();
+        this->broadcastList.clear();
+        this->ioc.stop();
+    });
+    this->thread.join();
+}
+
+uint16_t WSHubFunction::GetPort() {
+    if (!this->acceptor) {
+        return 0;
+    }
+    return this->acceptor->local_endpoint().port();
+}
+
+void WSHubFunction::doAccept() {
+    this->acceptor->async_accept(net::make_strand(this->ioc), beast::bind_front_handler(&WSHubFunction::onAccept, this));
+}
+
+void WSHubFunction::onAccept(beast::error_code errorCode, tcp::socket socket) {
+    if (errorCode) {
+        if (errorCode == net::error::operation_aborted) {
+            return; // Hub stopped
+        }
+        std::cout << "WSHubFunction: accept failed errorCode=" << errorCode << std::endl;
+    }
+    else {
+        beast::error_code ignored;
+        socket.set_option(tcp::no_delay(true), ignored);
+        if (this->writeLimits.socketSendBufferBytes > 0) {
+            // A backlog waits in the write queue, where priorities apply, instead of the socket
+            socket.set_option(net::socket_base::send_buffer_size((int)this->writeLimits.socketSendBufferBytes), ignored);
+        }
+
+        std::shared_ptr<WSHubSessionBase> session;
+        if (this->secure) {
+            session = std::make_shared<WSHubSecureSession>(this, std::move(socket), this->ctx);
+        }
+        else {
+            session = std::make_shared<WSHubUnsecureSession>(this, std::move(socket));
+        }
+        session->run();
+    }
+
+    this->doAccept();
+}
+
+void WSHubFunction::OnFrame(WSHubSessionBase* session, const uint8_t* frame, const size_t length) {
+    this->framesReceived++;
+    if (this->capture != NULL) {
+        this->capture->Record(WS_CAPTURE_RECEIVED, frame, length);
+    }
+
+    WSHubFrameHeader header;
+    if (!WSHubFrameHeader::Parse(frame, length, &header)) {
+        this->framesDropped++;
+        return;
+    }
+
+    if (!session->connected) {
+        if (header.function == BVLC_SC_FUNCTION_CONNECT_REQUEST) {
+            this->handleConnectRequest(session, header, frame, length);
+        }
+        else {
+            // Anything before a Connect-Request is a protocol error
+            this->framesDropped++;
+        }
+        return;
+    }
+
+    switch (header.function) {
+    case BVLC_SC_FUNCTION_HEARTBEAT_REQUEST: {
+        session->Send(this->encodeControl(BVLC_SC_FUNCTION_HEARTBEAT_ACK, header.messageId, NULL, 0), WS_PRIORITY_CONTROL);
+        break;
+    }
+    case BVLC_SC_FUNCTION_DISCONNECT_REQUEST: {
+        session->Send(this->encodeControl(BVLC_SC_FUNCTION_DISCONNECT_ACK, header.messageId, NULL, 0), WS_PRIORITY_CONTROL);
+        session->Close();
+        break;
+    }
+    case BVLC_SC_FUNCTION_HEARTBEAT_ACK:
+    case BVLC_SC_FUNCTION_DISCONNECT_ACK: {
+        // Nothing to do
+        break;
+    }
+    default: {
+        // Encapsulated-NPDU, Address-Resolution, Advertisement, etc.
+        this->forward(session, header, frame, length);
+        break;
+    }
+    }
+}
+
+void WSHubFunction::handleConnectRequest(WSHubSessionBase* session, const WSHubFrameHeader& header, const uint8_t* frame, const size_t length) {
+    // Payload: VMAC (6), Device UUID (16), Max BVLC Length (2), Max NPDU Length (2)
+    const size_t connectPayloadLength = BVLC_SC_VMAC_LENGTH + BVLC_SC_UUID_LENGTH + 4;
+    if (header.payloadOffset + connectPayloadLength > length) {
+        this->framesDropped++;
+        return;
+    }
+    const uint8_t* payload = frame + header.payloadOffset;
+    uint64_t nodeVmac = WSHubFrameHeader::PackVmac(payload);
+    const uint8_t* nodeUuid = payload + BVLC_SC_VMAC_LENGTH;
+
+    if (nodeVmac == BVLC_SC_BROADCAST_VMAC || nodeVmac == WSHubFrameHeader::PackVmac(this->vmac)) {
+        this->sendResultNak(session, header, BVLC_SC_ERROR_CLASS_COMMUNICATION, BVLC_SC_ERROR_CODE_NODE_DUPLICATE_VMAC);
+        return;
+    }
+
+    auto existing = this->routingTable.find(nodeVmac);
+    if (existing != this->routingTable.end()) {
+        if (memcmp(existing->second->uuid, nodeUuid, BVLC_SC_UUID_LENGTH) != 0) {
+            // A different device already uses this VMAC
+            this->sendResultNak(session, header, BVLC_SC_ERROR_CLASS_COMMUNICATION, BVLC_SC_ERROR_CODE_NODE_DUPLICATE_VMAC);
+            return;
+        }
+        // Same device reconnecting, the new connection replaces the old one
+        existing->second->Close();
+    }
+
+    session->vmac = nodeVmac;
+    memcpy(session->uuid, nodeUuid, BVLC_SC_UUID_LENGTH);
+    session->maxBvlcLength = (uint16_t)((payload[22] << 8) | payload[23]);
+    session->connected = true;
+    session->broadcastIndex = this->broadcastList.size();
+    this->broadcastList.push_back(session);
+    this->routingTable[nodeVmac] = session->shared_from_this();
+    this->connectionCount = this->routingTable.size();
+
+    // Connect-Accept payload: VMAC (6), Device UUID (16), Max BVLC Length (2), Max NPDU Length (2)
+    uint8_t accept[BVLC_SC_VMAC_LENGTH + BVLC_SC_UUID_LENGTH + 4];
+    memcpy(accept, this->vmac, BVLC_SC_VMAC_LENGTH);
+    memcpy(accept + BVLC_SC_VMAC_LENGTH, this->uuid, BVLC_SC_UUID_LENGTH);
+    accept[22] = (uint8_t)(BVLC_SC_MAX_BVLC_LENGTH >> 8);
+    accept[23] = (uint8_t)(BVLC_SC_MAX_BVLC_LENGTH & 0xFF);
+    accept[24] = (uint8_t)(BVLC_SC_MAX_NPDU_LENGTH >> 8);
+    accept[25] = (uint8_t)(BVLC_SC_MAX_NPDU_LENGTH & 0xFF);
+    session->Send(this->encodeControl(BVLC_SC_FUNCTION_CONNECT_ACCEPT, header.messageId, accept, sizeof(accept)), WS_PRIORITY_CONTROL);
+}
+
+void WSHubFunction::forward(WSHubSessionBase* session, const WSHubFrameHeader& header, const uint8_t* frame, const size_t length) {
+    if (header.destinationVmac == NULL) {
+        // Addressed to the hub itself, the hub function does not process these
+        this->framesDropped++;
+        return;
+    }
+
+    // Rewrite the header once: the destination VMAC is removed and the
+    // originating VMAC of the sending node is added.
+    // Header options and payload are copied unchanged.
+    std::shared_ptr<std::string> rewritten = std::make_shared<std::string>();
+    rewritten->resize(BVLC_SC_FIXED_HEADER_LENGTH + BVLC_SC_VMAC_LENGTH + (length - header.optionsOffset));
+    uint8_t* out = reinterpret_cast<uint8_t*>(&(*rewritten)[0]);
+    out[0] = header.function;
+    out[1] = (uint8_t)((header.control & ~(BVLC_SC_CONTROL_ORIGINATING_VMAC | BVLC_SC_CONTROL_DESTINATION_VMAC)) | BVLC_SC_CONTROL_ORIGINATING_VMAC);
+    out[2] = frame[2];
+    out[3] = frame[3];
+    WSHubFrameHeader::UnpackVmac(session->vmac, out + BVLC_SC_FIXED_HEADER_LENGTH);
+    memcpy(out + BVLC_SC_FIXED_HEADER_LENGTH + BVLC_SC_VMAC_LENGTH, frame + header.optionsOffset, length - header.optionsOffset);
+    WSHubFrame shared = rewritten;
+
+    uint64_t destination = WSHubFrameHeader::PackVmac(header.destinationVmac);
+    if (destination == BVLC_SC_BROADCAST_VMAC) {
+        // Fan-out: every destination queue references the same buffer.
+        // Broadcast control messages, e.g. an Advertisement, keep their
+        // class, anything else waits behind unicast traffic.
+        uint8_t priority = header.function == BVLC_SC_FUNCTION_ENCAPSULATED_NPDU ? WS_PRIORITY_BULK : WS_PRIORITY_CONTROL;
+        this->broadcastForwarded++;
+        uint64_t deliveries = 0;
+        for (WSHubSessionBase* peer : this->broadcastList) {
+            if (peer != session) {
+                peer->Send(shared, priority);
+                deliveries++;
+            }
+        }
+        this->broadcastDeliveries += deliveries;
+        return;
+    }
+
+    auto route = this->routingTable.find(destination);
+    if (route == this->routingTable.end()) {
+        this->framesDropped++;
+        return;
+    }
+    route->second->Send(shared, header.GetPriority(frame, length));
+    this->unicastForwarded++;
+}
+
+void WSHubFunction::sendResultNak(WSHubSessionBase* session, const WSHubFrameHeader& header, const uint16_t errorClass, const uint16_t errorCode) {
+    // Payload: Result For BVLC Function (1), Result Code (1), Error Header Marker (1), Error Class (2), Error Code (2)
+    uint8_t result[7];
+    result[0] = header.function;
+    result[1] = 0x01; // NAK
+    result[2] = 0x00; // No header options in error
+    result[3] = (uint8_t)(errorClass >> 8);
+    result[4] = (uint8_t)(errorClass & 0xFF);
+    result[5] = (uint8_t)(errorCode >> 8);
+    result[6] = (uint8_t)(errorCode & 0xFF);
+    session->Send(this->encodeControl(BVLC_SC_FUNCTION_BVLC_RESULT, header.messageId, result, sizeof(result)), WS_PRIORITY_CONTROL);
+}
+
+WSHubFrame WSHubFunction::encodeControl(const uint8_t function, const uint16_t messageId, const uint8_t* payload, const size_t payloadLength) {
+    std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+    frame->resize(BVLC_SC_FIXED_HEADER_LENGTH + payloadLength);
+    uint8_t* out = reinterpret_cast<uint8_t*>(&(*frame)[0]);
+    out[0] = function;
+    out[1] = 0;
+    out[2] = (uint8_t)(messageId >> 8);
+    out[3] = (uint8_t)(messageId & 0xFF);
+    if (payloadLength > 0) {
+        memcpy(out + BVLC_SC_FIXED_HEADER_LENGTH, payload, payloadLength);
+    }
+    return frame;
+}
+
+void WSHubFunction::OnSessionClosed(WSHubSessionBase* session) {
+    if (!session->connected) {
+        return;
+    }
+    session->connected = false;
+
+    // Remove from the dense broadcast list (swap with last)
+    WSHubSessionBase* last = this->broadcastList.back();
+    this->broadcastList[session->broadcastIndex] = last;
+    last->broadcastIndex = session->broadcastIndex;
+    this->broadcastList.pop_back();
+
+    // Only erase the routing entry if it still points at this session (it may have been replaced by a reconnect)
+    auto route = this->routingTable.find(session->vmac);
+    if (route != this->routingTable.end() && route->second.get() == session) {
+        this->routingTable.erase(route);
+    }
+    this->connectionCount = this->routingTable.size();
+}
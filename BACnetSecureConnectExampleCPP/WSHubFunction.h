@@ -0,0 +1,198 @@
+#pragma once
+
+#include "WSClient.h"
+#include "WSFrameView.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+// BACnet error class/code used in the BVLC-Result NAK sent for a duplicate VMAC
+static const uint16_t BVLC_SC_ERROR_CLASS_COMMUNICATION = 7;
+static const uint16_t BVLC_SC_ERROR_CODE_NODE_DUPLICATE_VMAC = 140;
+
+// A frame that is shared between the write queues of every session it is sent to.
+// Broadcasts are encoded once and the same buffer is handed to all destinations.
+typedef std::shared_ptr<const std::string> WSHubFrame;
+
+//
+// WSHubFrameHeader
+// ----------------------------------------------------------------------------
+// The fields of a WSFrameView the hub needs to route a frame.
+// Points into the frame, nothing is copied.
+struct WSHubFrameHeader {
+    uint8_t function;
+    uint8_t control;
+    uint16_t messageId;
+    const uint8_t* originatingVmac;     // NULL when not present
+    const uint8_t* destinationVmac;     // NULL when not present
+    size_t optionsOffset;               // Offset of the first byte after the VMACs (header options or payload)
+    size_t payloadOffset;               // Offset of the first payload byte
+
+    static bool Parse(const uint8_t* frame, const size_t length, WSHubFrameHeader* header);
+    // APDU of an Encapsulated-NPDU, NULL for a network layer message or a short frame
+    const uint8_t* GetApdu(const uint8_t* frame, const size_t length, size_t* apduLength) const;
+    // WS_PRIORITY_* class of the frame when it is sent to one node
+    uint8_t GetPriority(const uint8_t* frame, const size_t length) const;
+    static uint64_t PackVmac(const uint8_t* vmac);
+    static void UnpackVmac(const uint64_t packed, uint8_t* vmac);
+};
+
+class WSHubFunction;
+
+//
+// WSHubSessionBase
+// ----------------------------------------------------------------------------
+// One node connected to the hub. Owns the per-connection write queue, see
+// WSPriorityWriteQueue.
+// Sessions, the routing table and the write queues are only touched from the
+// hub's io_context thread, so no locks are needed on the forwarding path.
+class WSHubSessionBase : public std::enable_shared_from_this<WSHubSessionBase> {
+protected:
+    WSHubFunction* hub;
+    beast::flat_buffer buffer;
+    WSPriorityWriteQueue writeQueue;
+    WSHubFrame writing;         // Taken from writeQueue, NULL when no write is pending
+    bool closing;
+
+    // Stream specific operations
+    virtual void asyncRead() = 0;
+    virtual void asyncWrite(const WSHubFrame& frame) = 0;
+    virtual void asyncClose() = 0;
+
+    void writeNext();
+
+public:
+    // Completion handlers shared by both stream types
+    void onAccept(beast::error_code errorCode);
+    void onRead(beast::error_code errorCode, std::size_t bytesRead);
+    void onWrite(beast::error_code errorCode, std::size_t bytesWritten);
+
+    uint64_t vmac;
+    uint8_t uuid[BVLC_SC_UUID_LENGTH];
+    uint16_t maxBvlcLength;
+    size_t broadcastIndex;  // Position in WSHubFunction::broadcastList
+    bool connected;     // Connect-Request accepted and present in the routing table
+
+    explicit WSHubSessionBase(WSHubFunction* hub);
+    virtual ~WSHubSessionBase() {}
+
+    // Start the TLS (if any) and websocket accept
+    virtual void run() = 0;
+
+    // Queue a frame for this node. The frame is not copied. False when it,
+    // or a waiting frame, was dropped on a full queue.
+    bool Send(const WSHubFrame& frame, const uint8_t priority);
+    void Close();
+
+    size_t GetWriteQueueDepth();
+    const WSPriorityWriteQueue& GetWriteQueue() const { return this->writeQueue; }
+};
+
+//
+// WSHubUnsecureSession
+// ----------------------------------------------------------------------------
+class WSHubUnsecureSession : public WSHubSessionBase {
+private:
+    websocket::stream<beast::tcp_stream> ws;
+
+    void asyncRead();
+    void asyncWrite(const WSHubFrame& frame);
+    void asyncClose();
+
+public:
+    WSHubUnsecureSession(WSHubFunction* hub, tcp::socket&& socket);
+    void run();
+};
+
+//
+// WSHubSecureSession
+// ----------------------------------------------------------------------------
+class WSHubSecureSession : public WSHubSessionBase {
+private:
+    websocket::stream<beast::ssl_stream<beast::tcp_stream>> ws;
+
+    void onSslHandshake(beast::error_code errorCode);
+    void asyncRead();
+    void asyncWrite(const WSHubFrame& frame);
+    void asyncClose();
+
+public:
+    WSHubSecureSession(WSHubFunction* hub, tcp::socket&& socket, ssl::context& ctx);
+    void run();
+};
+
+//
+// WSHubFunction
+// ----------------------------------------------------------------------------
+// Optional BACnet/SC hub function. Accepts node connections, keeps a
+// VMAC -> session routing table and forwards unicast and broadcast frames.
+//
+// The write queue of each node is bounded by WSQueueLimits and an optional
+// WSMemoryBudget. The hub cannot slow one sender down for one slow
+// destination, so a full queue drops: the oldest waiting frame with
+// WS_QUEUE_POLICY_DROP_OLDEST, the new one otherwise. A broadcast frame is
+// counted once per queue it waits in.
+class WSHubFunction {
+private:
+    net::io_context ioc;
+    net::executor_work_guard<boost::asio::io_context::executor_type> iocWorkGuard = boost::asio::make_work_guard(ioc);
+    ssl::context ctx{ssl::context::tlsv13_server};
+    WSTlsSettings tlsSettings;
+    bool secure;
+    std::shared_ptr<tcp::acceptor> acceptor;
+    std::thread thread;     // The hub runs on a single io_context thread, see WSHubSessionBase
+
+    uint8_t vmac[BVLC_SC_VMAC_LENGTH];
+    uint8_t uuid[BVLC_SC_UUID_LENGTH];
+
+    // VMAC -> session. Reserved up front so the table does not rehash while nodes connect.
+    std::unordered_map<uint64_t, std::shared_ptr<WSHubSessionBase>> routingTable;
+    std::vector<WSHubSessionBase*> broadcastList;     // Dense copy of the routing table values for fan-out
+
+    WSQueueLimits writeLimits;
+    WSMemoryBudget* budget;     // NULL when there is none
+    WSCapture* capture;         // NULL when the frames are not captured
+
+    void doAccept();
+    void onAccept(beast::error_code errorCode, tcp::socket socket);
+
+    void handleConnectRequest(WSHubSessionBase* session, const WSHubFrameHeader& header, const uint8_t* frame, const size_t length);
+    void forward(WSHubSessionBase* session, const WSHubFrameHeader& header, const uint8_t* frame, const size_t length);
+    void sendResultNak(WSHubSessionBase* session, const WSHubFrameHeader& header, const uint16_t errorClass, const uint16_t errorCode);
+    WSHubFrame encodeControl(const uint8_t function, const uint16_t messageId, const uint8_t* payload, const size_t payloadLength);
+
+public:
+    // Statistics, readable from any thread
+    std::atomic<uint64_t> framesReceived;
+    std::atomic<uint64_t> unicastForwarded;
+    std::atomic<uint64_t> broadcastForwarded;     // Number of broadcast frames received from nodes
+    std::atomic<uint64_t> broadcastDeliveries;    // Number of write queue entries created by those broadcasts
+    std::atomic<uint64_t> framesDropped;          // Unknown destination, malformed, or not connected
+    WSDropCounters queueDrops;                    // Write queue full, over the memory budget, or a frame over the read limit
+    std::atomic<size_t> connectionCount;
+
+    WSHubFunction();
+    ~WSHubFunction();
+
+    // Before Start. budget, if not NULL, may be shared with other connections and must outlive the hub.
+    void SetQueueLimits(const WSQueueLimits& limits, WSMemoryBudget* budget) { this->writeLimits = limits; this->budget = budget; }
+    const WSQueueLimits& GetQueueLimits() const { return this->writeLimits; }
+    WSMemoryBudget* GetMemoryBudget() { return this->budget; }
+    WSDropCounters& GetQueueDrops() { return this->queueDrops; }
+    // Before Start. Every frame received and sent by the hub is written to capture, which must outlive the hub.
+    void SetCapture(WSCapture* capture) { this->capture = capture; }
+    WSCapture* GetCapture() { return this->capture; }
+    // Before Start. Key exchange groups, cipher suites and signature algorithms of the wss:// connections.
+    void SetTlsSettings(const WSTlsSettings& settings) { this->tlsSettings = settings; }
+
+    // Start listening. When certFilename and keyFilename are set the hub accepts wss:// connections, otherwise ws://
+    bool Start(const std::string& address, const uint16_t port, const uint8_t* hubVmac, const uint8_t* hubUuid, const std::string& certFilename = "", const std::string& keyFilename = "");
+    void Stop();
+    uint16_t GetPort();
+
+    // Called by sessions, on the hub thread
+    void OnFrame(WSHubSessionBase* session, const uint8_t* frame, const size_t length);
+    void OnSessionClosed(WSHubSessionBase* session);
+};
@@ -0,0 +1,290 @@
+#include "WSQueue.h"
+
+#include <algorithm>
+
+//
+// WSMemoryBudget
+// ----------------------------------------------------------------------------
+
+bool WSMemoryBudget::Reserve(const size_t bytes) {
+    size_t used = this->used.load(std::memory_order_relaxed);
+    do {
+        if (used + bytes > this->limit) {
+            return false;
+        }
+    } while (!this->used.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+
+    size_t peak = this->peak.load(std::memory_order_relaxed);
+    while (used + bytes > peak && !this->peak.compare_exchange_weak(peak, used + bytes, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+//
+// WSDropCounters
+// ----------------------------------------------------------------------------
+
+uint64_t WSDropCounters::GetTotal() const {
+    uint64_t total = 0;
+    for (uint8_t reason = 0; reason < WS_DROP_REASON_COUNT; reason++) {
+        total += this->Get(reason);
+    }
+    return total;
+}
+
+const char* WSDropCounters::GetReasonName(const uint8_t reason) {
+    static const char* const NAMES[WS_DROP_REASON_COUNT] = { "queue_full", "memory_budget", "too_long", "buffer_too_small" };
+    return reason < WS_DROP_REASON_COUNT ? NAMES[reason] : "unknown";
+}
+
+//
+// WSReceiveQueue
+// ----------------------------------------------------------------------------
+
+WSReceiveQueue::WSReceiveQueue() {
+    this->bytes = 0;
+    this->paused = false;
+    this->budget = NULL;
+    this->peakFrames = 0;
+}
+
+WSReceiveQueue::~WSReceiveQueue() {
+    this->Clear();
+}
+
+void WSReceiveQueue::SetLimits(const WSQueueLimits& limits, WSMemoryBudget* budget) {
+    this->Clear();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->limits = limits;
+    this->budget = budget;
+}
+
+void WSReceiveQueue::SetOnPush(std::function<void()> onPush) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->onPush = std::move(onPush);
+}
+
+uint8_t WSReceiveQueue::Push(WSReceivedFrame& frame, const uint8_t priority, bool* pause) {
+    *pause = false;
+    size_t length = frame.data.size();
+    uint8_t dropped = WS_DROP_NONE;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->limits.policy == WS_QUEUE_POLICY_PAUSE_READING) {
+        // The reader paused before the queue could overflow, see below. Only
+        // a frame that could never fit is dropped, pausing on it would never
+        // resume.
+        if (length > this->limits.maxBytes) {
+            this->drops.Add(WS_DROP_QUEUE_FULL);
+            return WS_DROP_QUEUE_FULL;
+        }
+    }
+    else if (this->frames.size() + 1 > this->limits.maxFrames || this->bytes + length > this->limits.maxBytes) {
+        bool dropOldest = this->limits.policy == WS_QUEUE_POLICY_DROP_OLDEST || (this->limits.policy == WS_QUEUE_POLICY_DROP_NEWEST && priority == WS_PRIORITY_CONTROL);
+        if (!dropOldest || this->frames.empty()) {
+            this->drops.Add(WS_DROP_QUEUE_FULL);
+            return WS_DROP_QUEUE_FULL;
+        }
+        while (!this->frames.empty() && (this->frames.size() + 1 > this->limits.maxFrames || this->bytes + length > this->limits.maxBytes)) {
+            size_t oldest = this->frames.front().data.size();
+            this->bytes -= oldest;
+            if (this->budget != NULL) {
+                this->budget->Release(oldest);
+            }
+            this->frames.pop_front();
+            this->drops.Add(WS_DROP_QUEUE_FULL);
+        }
+        dropped = WS_DROP_QUEUE_FULL;
+    }
+    if (this->budget != NULL && !this->budget->Reserve(length)) {
+        this->drops.Add(WS_DROP_MEMORY_BUDGET);
+        return WS_DROP_MEMORY_BUDGET;
+    }
+
+    this->bytes += length;
+    this->frames.push_back(std::move(frame));
+    if (this->frames.size() > this->peakFrames) {
+        this->peakFrames = this->frames.size();
+    }
+
+    // Stop while the largest frame the next read can return still fits
+    if (this->limits.policy == WS_QUEUE_POLICY_PAUSE_READING && (this->frames.size() >= this->limits.maxFrames || this->bytes + BVLC_SC_MAX_BVLC_LENGTH > this->limits.maxBytes)) {
+        this->paused = true;
+        *pause = true;
+    }
+    if (this->onPush) {
+        this->onPush();
+    }
+    return dropped;
+}
+
+bool WSReceiveQueue::CanRead() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return !this->paused;
+}
+
+bool WSReceiveQueue::Pop(WSReceivedFrame* frame, bool* resume) {
+    *resume = false;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->frames.empty()) {
+        return false;
+    }
+    *frame = std::move(this->frames.front());
+    this->frames.pop_front();
+    this->bytes -= frame->data.size();
+    if (this->budget != NULL) {
+        this->budget->Release(frame->data.size());
+    }
+
+    if (this->paused && this->frames.size() <= this->limits.maxFrames / 2 && this->bytes <= this->limits.maxBytes / 2) {
+        this->paused = false;
+        *resume = true;
+    }
+    return true;
+}
+
+void WSReceiveQueue::Clear() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->budget != NULL) {
+        this->budget->Release(this->bytes);
+    }
+    this->frames.clear();
+    this->bytes = 0;
+    this->paused = false;
+}
+
+size_t WSReceiveQueue::Size() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->frames.size();
+}
+
+//
+// WSPriorityWriteQueue
+// ----------------------------------------------------------------------------
+
+WSPriorityWriteQueue::WSPriorityWriteQueue() {
+    this->frames = 0;
+    this->bytes = 0;
+    this->budget = NULL;
+    this->drops = NULL;
+    this->agedCount = 0;
+    for (uint8_t priority = 0; priority < WS_PRIORITY_COUNT; priority++) {
+        this->sentCount[priority] = 0;
+    }
+}
+
+WSPriorityWriteQueue::~WSPriorityWriteQueue() {
+    this->Clear();
+}
+
+void WSPriorityWriteQueue::SetLimits(const WSQueueLimits& limits, WSMemoryBudget* budget, WSDropCounters* drops) {
+    this->Clear();
+    this->limits = limits;
+    this->budget = budget;
+    this->drops = drops;
+}
+
+void WSPriorityWriteQueue::countDrop(const uint8_t reason) {
+    if (this->drops != NULL) {
+        this->drops->Add(reason);
+    }
+}
+
+void WSPriorityWriteQueue::drop(const uint8_t priority, const bool newest) {
+    std::deque<Entry>& queue = this->classes[priority];
+    size_t length = newest ? queue.back().frame->size() : queue.front().frame->size();
+    if (newest) {
+        queue.pop_back();
+    }
+    else {
+        queue.pop_front();
+    }
+    this->frames--;
+    this->bytes -= length;
+    if (this->budget != NULL) {
+        this->budget->Release(length);
+    }
+    this->countDrop(WS_DROP_QUEUE_FULL);
+}
+
+bool WSPriorityWriteQueue::Push(const std::shared_ptr<const std::string>& frame, const uint8_t priority) {
+    uint8_t queuePriority = this->limits.prioritized ? priority : WS_PRIORITY_CONTROL;
+    size_t length = frame->size();
+    bool kept = true;
+    while (this->frames + 1 > this->limits.maxFrames || this->bytes + length > this->limits.maxBytes) {
+        kept = false;
+        uint8_t lowest = WS_PRIORITY_COUNT;
+        for (uint8_t candidate = WS_PRIORITY_COUNT; candidate-- > 0;) {
+            if (!this->classes[candidate].empty()) {
+                lowest = candidate;
+                break;
+            }
+        }
+        if (lowest < WS_PRIORITY_COUNT && lowest > queuePriority) {
+            // A lower class makes room
+            this->drop(lowest, this->limits.policy != WS_QUEUE_POLICY_DROP_OLDEST);
+        }
+        else if (lowest == queuePriority && this->limits.policy == WS_QUEUE_POLICY_DROP_OLDEST) {
+            this->drop(lowest, false);
+        }
+        else {
+            this->countDrop(WS_DROP_QUEUE_FULL);
+            return false;
+        }
+    }
+    if (this->budget != NULL && !this->budget->Reserve(length)) {
+        this->countDrop(WS_DROP_MEMORY_BUDGET);
+        return false;
+    }
+
+    Entry entry = { frame, std::chrono::steady_clock::now() };
+    this->classes[queuePriority].push_back(std::move(entry));
+    this->frames++;
+    this->bytes += length;
+    return kept;
+}
+
+std::shared_ptr<const std::string> WSPriorityWriteQueue::Pop() {
+    if (this->frames == 0) {
+        return NULL;
+    }
+
+    // Strict priority
+    uint8_t next = 0;
+    while (this->classes[next].empty()) {
+        next++;
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    // Unless a lower class has waited too long
+    std::chrono::milliseconds aging(this->limits.agingMilliseconds);
+    for (uint8_t lower = next + 1; lower < WS_PRIORITY_COUNT; lower++) {
+        if (!this->classes[lower].empty() && now - std::max(this->classes[lower].front().queued, this->lastSent[lower]) >= aging) {
+            next = lower;
+            this->agedCount++;
+            break;
+        }
+    }
+
+    std::shared_ptr<const std::string> frame = std::move(this->classes[next].front().frame);
+    this->classes[next].pop_front();
+    this->frames--;
+    this->bytes -= frame->size();
+    if (this->budget != NULL) {
+        this->budget->Release(frame->size());
+    }
+    this->lastSent[next] = now;
+    this->sentCount[next]++;
+    return frame;
+}
+
+void WSPriorityWriteQueue::Clear() {
+    for (uint8_t priority = 0; priority < WS_PRIORITY_COUNT; priority++) {
+        this->classes[priority].clear();
+    }
+    if (this->budget != NULL) {
+        this->budget->Release(this->bytes);
+    }
+    this->frames = 0;
+    this->bytes = 0;
+}
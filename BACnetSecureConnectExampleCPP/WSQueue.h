@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+// Largest BVLC-SC message, also the websocket read limit of every connection
+static const uint16_t BVLC_SC_MAX_BVLC_LENGTH = 1600;
+static const uint16_t BVLC_SC_MAX_NPDU_LENGTH = 1497;
+
+// What a bounded queue does with a frame when it is full
+static const uint8_t WS_QUEUE_POLICY_PAUSE_READING = 0;    // Stop reading the socket until the queue drains to half, TCP slows the sender down
+static const uint8_t WS_QUEUE_POLICY_DROP_NEWEST = 1;
+static const uint8_t WS_QUEUE_POLICY_DROP_OLDEST = 2;
+
+// Why a frame was dropped, the index of WSDropCounters
+static const uint8_t WS_DROP_QUEUE_FULL = 0;               // Limits of the connection
+static const uint8_t WS_DROP_MEMORY_BUDGET = 1;            // WSMemoryBudget shared by every connection
+static const uint8_t WS_DROP_TOO_LONG = 2;                 // Longer than the websocket read limit, the connection is closed
+static const uint8_t WS_DROP_BUFFER_TOO_SMALL = 3;         // Longer than the buffer it was read into
+static const uint8_t WS_DROP_REASON_COUNT = 4;
+static const uint8_t WS_DROP_NONE = 0xFF;
+
+// Outbound priority classes, highest first
+static const uint8_t WS_PRIORITY_CONTROL = 0;      // BVLC-SC control messages: Connect, Heartbeat, Disconnect, BVLC-Result, Advertisement...
+static const uint8_t WS_PRIORITY_CONFIRMED = 1;    // Confirmed requests and their answers, not segmented
+static const uint8_t WS_PRIORITY_BULK = 2;         // Unconfirmed requests, broadcasts, segments and network layer messages
+static const uint8_t WS_PRIORITY_COUNT = 3;
+
+// Limits of one queue of one connection
+struct WSQueueLimits {
+    size_t maxFrames;
+    size_t maxBytes;
+    uint8_t policy;     // WS_QUEUE_POLICY_*
+    // Write queues only
+    bool prioritized;                   // false: one FIFO for every WS_PRIORITY_* class
+    uint32_t agingMilliseconds;         // A lower class waiting this long sends one frame ahead of the higher ones
+    size_t socketSendBufferBytes;       // SO_SNDBUF, 0 for the system default. Frames in the socket are sent in order whatever their class.
+
+    WSQueueLimits() :
+        maxFrames(256),
+        maxBytes(256 * 1600),
+        policy(WS_QUEUE_POLICY_PAUSE_READING),
+        prioritized(true),
+        agingMilliseconds(50),
+        socketSendBufferBytes(0) {}
+};
+
+//
+// WSMemoryBudget
+// ----------------------------------------------------------------------------
+// Bytes held by the queues of every connection that shares it, so many
+// connections that are each within their limits cannot together grow the
+// process without bound. A frame that does not fit is dropped whatever the
+// policy of its queue: pausing would wait on other connections.
+class WSMemoryBudget {
+private:
+    std::atomic<size_t> used;
+    std::atomic<size_t> peak;
+    size_t limit;
+
+public:
+    explicit WSMemoryBudget(const size_t limit = 16 * 1024 * 1024) : used(0), peak(0), limit(limit) {}
+
+    // Any thread
+    bool Reserve(const size_t bytes);
+    void Release(const size_t bytes) { this->used.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    size_t GetUsed() const { return this->used.load(std::memory_order_relaxed); }
+    size_t GetPeak() const { return this->peak.load(std::memory_order_relaxed); }
+    size_t GetLimit() const { return this->limit; }
+};
+
+// Frames dropped by reason, readable from any thread
+struct WSDropCounters {
+    std::atomic<uint64_t> counts[WS_DROP_REASON_COUNT];
+
+    WSDropCounters() {
+        for (uint8_t reason = 0; reason < WS_DROP_REASON_COUNT; reason++) {
+            this->counts[reason] = 0;
+        }
+    }
+    void Add(const uint8_t reason) { this->counts[reason].fetch_add(1, std::memory_order_relaxed); }
+    uint64_t Get(const uint8_t reason) const { return this->counts[reason].load(std::memory_order_relaxed); }
+    uint64_t GetTotal() const;
+
+    // e.g. "queue_full", for metric labels and reports
+    static const char* GetReasonName(const uint8_t reason);
+};
+
+// A received frame waiting in the queue of a client
+struct WSReceivedFrame {
+    std::string data;
+    uint64_t readTicks;
+};
+
+//
+// WSReceiveQueue
+// ----------------------------------------------------------------------------
+// Frames read by the io_context thread of a client and not yet taken by the
+// CAS BACnet Stack, bounded by WSQueueLimits and an optional WSMemoryBudget.
+// With WS_QUEUE_POLICY_PAUSE_READING the reader stops as soon as a frame of
+// BVLC_SC_MAX_BVLC_LENGTH would no longer fit, so nothing is dropped but a
+// frame over maxBytes on its own, and Pop() tells it to start again once the
+// queue is down to half. With
+// WS_QUEUE_POLICY_DROP_NEWEST a WS_PRIORITY_CONTROL frame, e.g. a
+// Heartbeat-ACK or a Disconnect-Request, drops the oldest frame instead, so a
+// flood of broadcasts cannot make the stack miss the state of the connection.
+class WSReceiveQueue {
+private:
+    std::mutex mutex;
+    std::deque<WSReceivedFrame> frames;
+    size_t bytes;
+    bool paused;
+    WSQueueLimits limits;
+    WSMemoryBudget* budget;     // NULL when there is none
+    std::function<void()> onPush;
+
+public:
+    WSDropCounters drops;
+    size_t peakFrames;          // Most frames queued at once
+
+    WSReceiveQueue();
+    ~WSReceiveQueue();
+
+    // Before the connection is made
+    void SetLimits(const WSQueueLimits& limits, WSMemoryBudget* budget);
+    // Before the connection is made. Called on the reader thread for every
+    // frame queued, with the queue locked, to wake the consumer.
+    void SetOnPush(std::function<void()> onPush);
+
+    // Reader. priority is the WS_PRIORITY_* class of the frame. Returns
+    // WS_DROP_NONE or the reason a frame, this one or the oldest, was
+    // dropped. *pause is set when the reader must stop reading.
+    uint8_t Push(WSReceivedFrame& frame, const uint8_t priority, bool* pause);
+    // Reader, false when reading is paused
+    bool CanRead();
+
+    // Consumer. False when the queue is empty. *resume is set when the
+    // reader was paused and must start reading again.
+    bool Pop(WSReceivedFrame* frame, bool* resume);
+
+    // Frames of an old connection, and reading no longer paused
+    void Clear();
+    size_t Size();
+};
+
+//
+// WSPriorityWriteQueue
+// ----------------------------------------------------------------------------
+// Frames waiting to be written to one connection, one FIFO per WS_PRIORITY_*
+// class, so a Heartbeat-ACK or the answer to a confirmed request does not
+// wait behind a burst of broadcasts. The next frame is taken from the highest
+// class that has one (strict priority). So that a busy higher class cannot
+// starve a lower one, a lower class whose front frame has waited
+// agingMilliseconds, since it was queued and since the class last sent,
+// sends one frame first.
+//
+// The limits count every class together. A full queue makes room by dropping
+// from the lowest class below the new frame: its newest frame, or its oldest
+// with WS_QUEUE_POLICY_DROP_OLDEST. Otherwise the new frame is dropped (its
+// own class drops its oldest with WS_QUEUE_POLICY_DROP_OLDEST). Write queues
+// cannot pause their sender, WS_QUEUE_POLICY_PAUSE_READING drops the newest.
+//
+// Not thread safe: used from the thread or strand of the connection.
+class WSPriorityWriteQueue {
+private:
+    struct Entry {
+        std::shared_ptr<const std::string> frame;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    std::deque<Entry> classes[WS_PRIORITY_COUNT];
+    std::chrono::steady_clock::time_point lastSent[WS_PRIORITY_COUNT];
+    size_t frames;
+    size_t bytes;
+    WSQueueLimits limits;
+    WSMemoryBudget* budget;     // NULL when there is none
+    WSDropCounters* drops;      // NULL when drops are not counted
+
+    void drop(const uint8_t priority, const bool newest);
+    void countDrop(const uint8_t reason);
+
+public:
+    // Statistics
+    uint64_t agedCount;                 // Frames sent ahead of a higher class by aging
+    uint64_t sentCount[WS_PRIORITY_COUNT];
+
+    WSPriorityWriteQueue();
+    ~WSPriorityWriteQueue();
+
+    // Before the first Push
+    void SetLimits(const WSQueueLimits& limits, WSMemoryBudget* budget, WSDropCounters* drops);
+
+    // False when this frame, or a queued one, was dropped
+    bool Push(const std::shared_ptr<const std::string>& frame, const uint8_t priority);
+    // The next frame to write, NULL when there is none. From here on it no
+    // longer counts against the limits.
+    std::shared_ptr<const std::string> Pop();
+
+    void Clear();
+    size_t Size() const { return this->frames; }
+    bool IsEmpty() const { return this->frames == 0; }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <string>
+
+//
+// WSTlsSettings
+// ----------------------------------------------------------------------------
+// What a TLS 1.3 handshake negotiates, for the contexts of the wss://
+// connections, the hub function and the virtual devices. Each list is in the
+// OpenSSL syntax, in order of preference, and an empty one keeps the OpenSSL
+// default.
+//
+// Most of the CPU time of a handshake is the key exchange and the signature
+// of the certificate key, not the cipher: X25519 and P-256 cost far less than
+// P-384 or the ffdhe groups, and an ECDSA P-256 key signs many times faster
+// than an RSA key. The key type is the one of the certificate and key files.
+// "handshake" in CASBACnetSCExampleBenchmark measures each choice.
+struct WSTlsSettings {
+    std::string groups;                 // Key exchange, e.g. "X25519:P-256". The client sends a key share for the first one.
+    std::string ciphersuites;           // TLS 1.3 cipher suites, e.g. "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256"
+    std::string signatureAlgorithms;    // e.g. "ECDSA+SHA256:rsa_pss_rsae_sha256", also limits the certificates accepted from the peer
+
+    WSTlsSettings() {}
+
+    // After the options of the context are set, before its first connection.
+    // Throws boost::system::system_error for a list OpenSSL does not accept,
+    // as the ssl::context calls do.
+    void Apply(boost::asio::ssl::context& ctx) const {
+        SSL_CTX* handle = ctx.native_handle();
+        ERR_clear_error();
+        if (!this->groups.empty() && SSL_CTX_set1_groups_list(handle, this->groups.c_str()) != 1) {
+            throwError("groups " + this->groups);
+        }
+        if (!this->ciphersuites.empty() && SSL_CTX_set_ciphersuites(handle, this->ciphersuites.c_str()) != 1) {
+            throwError("ciphersuites " + this->ciphersuites);
+        }
+        if (!this->signatureAlgorithms.empty() && SSL_CTX_set1_sigalgs_list(handle, this->signatureAlgorithms.c_str()) != 1) {
+            throwError("signature algorithms " + this->signatureAlgorithms);
+        }
+    }
+
+private:
+    static void throwError(const std::string& what) {
+        // Some of these calls fail without an error on the OpenSSL queue
+        unsigned long error = ERR_get_error();
+        boost::system::error_code errorCode = error != 0 ? boost::system::error_code(static_cast<int>(error), boost::asio::error::get_ssl_category()) : boost::system::error_code(boost::asio::error::invalid_argument);
+        throw boost::system::system_error(errorCode, what);
+    }
+};
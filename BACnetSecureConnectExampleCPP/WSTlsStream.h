@@ -0,0 +1,273 @@
+#pragma once
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <string>
+
+// Kernel TLS needs Linux and OpenSSL 3 built with it. Elsewhere the kTLS mode
+// is never turned on and every connection uses the Beast SSL stream.
+#if defined(__linux__) && defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define WS_TLS_HAS_KTLS 1
+#endif
+
+//
+// WSTlsStream
+// ----------------------------------------------------------------------------
+// The TLS layer under the websocket of WSClientSecureAsync, with the members
+// of beast::ssl_stream that it uses.
+//
+// By default it is a beast::ssl_stream: OpenSSL encrypts in user space into
+// the memory BIO pair of the Asio SSL engine, which is copied to the socket.
+//
+// With SetKtls(true), before the connect, OpenSSL runs on the socket itself
+// with SSL_OP_ENABLE_KTLS. After the handshake it hands the keys of each
+// direction the kernel supports to the kernel TLS record layer: SSL_write()
+// then writes plaintext to the socket and the kernel encrypts it, with no
+// user space record buffer. OpenSSL 3.0 offloads sending for TLS 1.2 and 1.3
+// and receiving for TLS 1.2 only (TLS 1.3 from OpenSSL 3.2), and only when the
+// "tls" kernel module is loaded. Any direction that is not offloaded stays in
+// user space on the socket, so the connection works the same either way;
+// IsKtlsSend() and IsKtlsReceive() tell what the kernel took. Only that
+// fallback has run so far; the offload itself is not verified yet.
+//
+// Not thread safe: every operation runs on the strand of the connection.
+class WSTlsStream {
+public:
+    typedef boost::beast::tcp_stream next_layer_type;
+    typedef next_layer_type::executor_type executor_type;
+
+private:
+    boost::beast::ssl_stream<boost::beast::tcp_stream> stream;     // Owns the socket, and is the TLS layer without kTLS
+    SSL* ssl;                       // On the socket in the kTLS mode, NULL otherwise
+    std::string writeBuffer;        // The buffers of one write, coalesced into one TLS record
+
+    template <class Handler> friend void async_teardown(boost::beast::role_type role, WSTlsStream& stream, Handler&& handler);
+    friend void teardown(boost::beast::role_type role, WSTlsStream& stream, boost::beast::error_code& errorCode);
+
+    // The error of an SSL_* call that did not succeed and does not want to wait
+    boost::beast::error_code getError(const int result) {
+        switch (SSL_get_error(this->ssl, result)) {
+        case SSL_ERROR_ZERO_RETURN:
+            return boost::asio::error::eof;
+        case SSL_ERROR_SYSCALL:
+            if (ERR_peek_error() == 0) {
+                // Closed without close_notify
+                return errno != 0 ? boost::beast::error_code(errno, boost::system::system_category()) : boost::beast::error_code(boost::asio::ssl::error::stream_truncated);
+            }
+            break;
+        default:
+            break;
+        }
+        return boost::beast::error_code(static_cast<int>(ERR_get_error()), boost::asio::error::get_ssl_category());
+    }
+
+    // One SSL_* call, retried when the socket is ready until it is done.
+    // Completes through a post when the first call is enough, never inside
+    // the initiating function.
+    template <class Call, bool Transfer>
+    struct Operation {
+        WSTlsStream* stream;
+        Call call;                  // int(size_t* bytes), an SSL_*_ex call
+        bool started;
+        bool done;
+        boost::beast::error_code result;
+        size_t bytes;
+
+        Operation(WSTlsStream* stream, Call call) : stream(stream), call(call), started(false), done(false), bytes(0) {}
+
+        template <class Self>
+        void complete(Self& self, std::true_type) { self.complete(this->result, this->bytes); }
+        template <class Self>
+        void complete(Self& self, std::false_type) { self.complete(this->result); }
+
+        template <class Self>
+        void operator()(Self& self, boost::beast::error_code errorCode = boost::beast::error_code()) {
+            bool first = !this->started;
+            this->started = true;
+            if (!this->done) {
+                if (errorCode) {
+                    this->result = errorCode;
+                    this->done = true;
+                }
+                else {
+                    ERR_clear_error();
+                    int callResult = this->call(&this->bytes);
+                    if (callResult == 1) {
+                        this->done = true;
+                    }
+                    else {
+                        int error = SSL_get_error(this->stream->ssl, callResult);
+                        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+                            this->stream->next_layer().socket().async_wait(error == SSL_ERROR_WANT_READ ? boost::asio::socket_base::wait_read : boost::asio::socket_base::wait_write, std::move(self));
+                            return;
+                        }
+                        this->result = this->stream->getError(callResult);
+                        this->bytes = 0;
+                        this->done = true;
+                    }
+                }
+                if (first) {
+                    boost::asio::post(std::move(self));
+                    return;
+                }
+            }
+            this->complete(self, std::integral_constant<bool, Transfer>());
+        }
+    };
+
+    template <bool Transfer, class Signature, class Call, class Handler>
+    void start(Call call, Handler&& handler) {
+        boost::asio::async_compose<Handler, Signature>(Operation<Call, Transfer>(this, call), handler, this->stream.next_layer().socket());
+    }
+
+public:
+    template <class Executor>
+    WSTlsStream(Executor&& executor, boost::asio::ssl::context& ctx) : stream(std::forward<Executor>(executor), ctx) {
+        this->ssl = NULL;
+    }
+    ~WSTlsStream() {
+        if (this->ssl != NULL) {
+            SSL_free(this->ssl);
+        }
+    }
+
+    // Before the handshake, after the context is set up. Returns false, and
+    // the stream stays in user space, when this build cannot offload TLS.
+    bool SetKtls(const bool enabled, boost::asio::ssl::context& ctx) {
+        if (this->ssl != NULL) {
+            SSL_free(this->ssl);
+            this->ssl = NULL;
+        }
+#if defined(WS_TLS_HAS_KTLS)
+        if (enabled) {
+            this->ssl = SSL_new(ctx.native_handle());
+            if (this->ssl == NULL) {
+                return false;
+            }
+            SSL_set_options(this->ssl, SSL_OP_ENABLE_KTLS);
+            // Retried writes may come from writeBuffer after it was assigned again
+            SSL_set_mode(this->ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+            return true;
+        }
+#else
+        (void)ctx;
+#endif
+        return !enabled;
+    }
+    bool IsKtlsMode() const { return this->ssl != NULL; }
+    // After the handshake, true when the kernel encrypts or decrypts
+    bool IsKtlsSend() const {
+#if defined(WS_TLS_HAS_KTLS)
+        return this->ssl != NULL && BIO_get_ktls_send(SSL_get_wbio(this->ssl));
+#else
+        return false;
+#endif
+    }
+    bool IsKtlsReceive() const {
+#if defined(WS_TLS_HAS_KTLS)
+        return this->ssl != NULL && BIO_get_ktls_recv(SSL_get_rbio(this->ssl));
+#else
+        return false;
+#endif
+    }
+
+    executor_type get_executor() noexcept { return this->stream.get_executor(); }
+    next_layer_type& next_layer() { return this->stream.next_layer(); }
+    const next_layer_type& next_layer() const { return this->stream.next_layer(); }
+    SSL* native_handle() { return this->ssl != NULL ? this->ssl : this->stream.native_handle(); }
+
+    template <class Handler>
+    void async_handshake(const boost::asio::ssl::stream_base::handshake_type type, Handler&& handler) {
+        if (this->ssl == NULL) {
+            this->stream.async_handshake(type, std::forward<Handler>(handler));
+            return;
+        }
+
+        boost::asio::ip::tcp::socket& socket = this->next_layer().socket();
+        boost::beast::error_code ignored;
+        socket.non_blocking(true, ignored);
+        SSL_set_fd(this->ssl, (int)socket.native_handle());
+        if (type == boost::asio::ssl::stream_base::client) {
+            SSL_set_connect_state(this->ssl);
+        }
+        else {
+            SSL_set_accept_state(this->ssl);
+        }
+        SSL* ssl = this->ssl;
+        this->start<false, void(boost::beast::error_code)>([ssl](size_t*) { return SSL_do_handshake(ssl); }, std::forward<Handler>(handler));
+    }
+
+    template <class MutableBufferSequence, class Handler>
+    void async_read_some(const MutableBufferSequence& buffers, Handler&& handler) {
+        if (this->ssl == NULL) {
+            this->stream.async_read_some(buffers, std::forward<Handler>(handler));
+            return;
+        }
+
+        // SSL_read() fills one buffer per call
+        boost::asio::mutable_buffer buffer;
+        for (auto iterator = boost::asio::buffer_sequence_begin(buffers); iterator != boost::asio::buffer_sequence_end(buffers); ++iterator) {
+            buffer = *iterator;
+            if (buffer.size() > 0) {
+                break;
+            }
+        }
+        SSL* ssl = this->ssl;
+        this->start<true, void(boost::beast::error_code, size_t)>([ssl, buffer](size_t* bytes) {
+            return buffer.size() == 0 ? 1 : SSL_read_ex(ssl, buffer.data(), buffer.size(), bytes);
+        }, std::forward<Handler>(handler));
+    }
+
+    template <class ConstBufferSequence, class Handler>
+    void async_write_some(const ConstBufferSequence& buffers, Handler&& handler) {
+        if (this->ssl == NULL) {
+            this->stream.async_write_some(buffers, std::forward<Handler>(handler));
+            return;
+        }
+
+        // A websocket frame header and its payload in one record (and one
+        // system call with kTLS), as beast::ssl_stream does
+        this->writeBuffer.resize(std::min(boost::asio::buffer_size(buffers), (size_t)16384));
+        boost::asio::buffer_copy(boost::asio::buffer(&this->writeBuffer[0], this->writeBuffer.size()), buffers);
+        SSL* ssl = this->ssl;
+        const std::string* data = &this->writeBuffer;
+        this->start<true, void(boost::beast::error_code, size_t)>([ssl, data](size_t* bytes) {
+            return data->size() == 0 ? 1 : SSL_write_ex(ssl, data->data(), data->size(), bytes);
+        }, std::forward<Handler>(handler));
+    }
+};
+
+// Websocket close, found by argument dependent lookup: close_notify, then the TCP shutdown
+inline void teardown(boost::beast::role_type role, WSTlsStream& stream, boost::beast::error_code& errorCode) {
+    if (stream.ssl == NULL) {
+        boost::beast::teardown(role, stream.stream, errorCode);
+        return;
+    }
+    ERR_clear_error();
+    SSL_shutdown(stream.ssl);
+    boost::beast::websocket::teardown(role, stream.next_layer().socket(), errorCode);
+}
+
+template <class Handler>
+void async_teardown(boost::beast::role_type role, WSTlsStream& stream, Handler&& handler) {
+    if (stream.ssl == NULL) {
+        boost::beast::async_teardown(role, stream.stream, std::forward<Handler>(handler));
+        return;
+    }
+    // Non-blocking, a close_notify that does not fit in the socket is not sent
+    ERR_clear_error();
+    SSL_shutdown(stream.ssl);
+    boost::beast::websocket::async_teardown(role, stream.next_layer().socket(), std::forward<Handler>(handler));
+}
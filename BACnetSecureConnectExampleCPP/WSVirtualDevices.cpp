@@ -0,0 +1,704 @@
+#include "WSVirtualDevices.h"
+
+#include <string.h>
+
+// Max APDU length accepted, by the value of the second byte of a confirmed request (ASHRAE 135 20.1.2.5)
+static const uint32_t WSVirtualDeviceMaxApdu[16] = { 50, 128, 206, 480, 1024, 1476, 1476, 1476, 1476, 1476, 1476, 1476, 1476, 1476, 1476, 1476 };
+
+//
+// WSVirtualDeviceSessionBase
+// ----------------------------------------------------------------------------
+
+WSVirtualDeviceSessionBase::WSVirtualDeviceSessionBase(WSVirtualDevices* devices, const WSVirtualDevice* device, net::io_context& ioc)
+    : strand(net::make_strand(ioc))
+    , timer(strand) {
+    this->devices = devices;
+    // Reading pauses at maxWriteQueueFrames, well before the default limits
+    this->writeQueue.SetLimits(WSQueueLimits(), NULL, NULL);
+    this->readPaused = false;
+    this->closeAfterWrite = false;
+    this->generation = 0;
+    this->messageId = 0;
+    this->reconnectMilliseconds = devices->GetSettings().reconnectMinMilliseconds;
+    this->heartbeatSent = false;
+    this->device = device;
+    this->state = STATE_WAITING;
+}
+
+void WSVirtualDeviceSessionBase::Connect() {
+    net::post(this->strand, beast::bind_front_handler(&WSVirtualDeviceSessionBase::connect, shared_from_this()));
+}
+
+void WSVirtualDeviceSessionBase::connect() {
+    this->generation++;
+    this->open();
+    this->state = STATE_CONNECTING;
+    this->buffer.clear();
+    this->writeQueue.Clear();
+    this->writing.reset();
+    this->readPaused = false;
+    this->closeAfterWrite = false;
+    this->heartbeatSent = false;
+
+    // One timeout for the TCP connect, the handshakes and the Connect-Accept
+    this->armTimer(this->devices->GetSettings().connectTimeoutMilliseconds);
+    this->getTcpStream().async_connect(this->devices->endpoints, beast::bind_front_handler(&WSVirtualDeviceSessionBase::onConnect, shared_from_this(), this->generation));
+}
+
+void WSVirtualDeviceSessionBase::armTimer(const uint32_t milliseconds) {
+    this->timer.expires_after(std::chrono::milliseconds(milliseconds));
+    this->timer.async_wait(beast::bind_front_handler(&WSVirtualDeviceSessionBase::onTimer, shared_from_this(), this->generation));
+}
+
+void WSVirtualDeviceSessionBase::onConnect(const uint32_t generation, beast::error_code errorCode, const tcp::endpoint& endpoint) {
+    (void)endpoint;
+    if (generation != this->generation) {
+        return;
+    }
+    if (errorCode) {
+        this->fail();
+        return;
+    }
+    beast::error_code ignored;
+    this->getTcpStream().socket().set_option(tcp::no_delay(true), ignored);
+    this->asyncHandshake();
+}
+
+void WSVirtualDeviceSessionBase::onHandshake(const uint32_t generation, beast::error_code errorCode) {
+    if (generation != this->generation) {
+        return;
+    }
+    if (errorCode) {
+        this->fail();
+        return;
+    }
+
+    // Connect-Request: VMAC (6), Device UUID (16), Max BVLC Length (2), Max NPDU Length (2)
+    uint8_t request[BVLC_SC_FIXED_HEADER_LENGTH + BVLC_SC_VMAC_LENGTH + BVLC_SC_UUID_LENGTH + 4];
+    request[0] = BVLC_SC_FUNCTION_CONNECT_REQUEST;
+    request[1] = 0;
+    request[2] = (uint8_t)(this->messageId >> 8);
+    request[3] = (uint8_t)this->messageId;
+    this->messageId++;
+    memcpy(request + 4, this->device->vmac, BVLC_SC_VMAC_LENGTH);
+    memcpy(request + 10, this->device->uuid, BVLC_SC_UUID_LENGTH);
+    request[26] = (uint8_t)(BVLC_SC_MAX_BVLC_LENGTH >> 8);
+    request[27] = (uint8_t)(BVLC_SC_MAX_BVLC_LENGTH & 0xFF);
+    request[28] = (uint8_t)(BVLC_SC_MAX_NPDU_LENGTH >> 8);
+    request[29] = (uint8_t)(BVLC_SC_MAX_NPDU_LENGTH & 0xFF);
+    this->send(request, sizeof(request), WS_PRIORITY_CONTROL);
+    this->asyncRead();
+}
+
+void WSVirtualDeviceSessionBase::onRead(const uint32_t generation, beast::error_code errorCode, std::size_t bytesRead) {
+    if (generation != this->generation) {
+        return;
+    }
+    if (errorCode) {
+        this->fail();
+        return;
+    }
+
+    // flat_buffer is always contiguous
+    auto bufferData = this->buffer.data();
+    this->onFrame(static_cast<const uint8_t*>(bufferData.data()), bufferData.size());
+    this->buffer.consume(bytesRead);
+
+    if (generation != this->generation) {
+        return;
+    }
+    // A hub that sends requests faster than the replies can be written is
+    // slowed down by TCP instead of growing the write queue
+    if (this->writeQueue.Size() >= this->devices->GetSettings().maxWriteQueueFrames) {
+        this->readPaused = true;
+        this->devices->readPauses++;
+        return;
+    }
+    this->asyncRead();
+}
+
+void WSVirtualDeviceSessionBase::send(const uint8_t* frame, const size_t length, const uint8_t priority) {
+    this->writeQueue.Push(std::make_shared<std::string>((const char*)frame, length), priority);
+    if (this->writing == NULL) {
+        this->writeNext();
+    }
+}
+
+void WSVirtualDeviceSessionBase::writeNext() {
+    this->writing = this->writeQueue.Pop();
+    if (this->writing != NULL) {
+        this->asyncWrite(this->writing);
+    }
+}
+
+void WSVirtualDeviceSessionBase::onWrite(const uint32_t generation, beast::error_code errorCode, std::size_t bytesWritten) {
+    (void)bytesWritten;
+    if (generation != this->generation) {
+        return;
+    }
+    if (errorCode) {
+        this->fail();
+        return;
+    }
+
+    this->devices->framesSent++;
+    this->writing.reset();
+    if (this->readPaused && this->writeQueue.Size() <= this->devices->GetSettings().maxWriteQueueFrames / 2) {
+        this->readPaused = false;
+        this->asyncRead();
+    }
+    if (this->writeQueue.IsEmpty() && this->closeAfterWrite) {
+        this->fail();
+        return;
+    }
+    this->writeNext();
+}
+
+void WSVirtualDeviceSessionBase::onTimer(const uint32_t generation, beast::error_code errorCode) {
+    if (errorCode || generation != this->generation) {
+        // Timer moved or the connection is gone
+        return;
+    }
+
+    switch (this->state) {
+    case STATE_CONNECTING: {
+        this->fail();
+        break;
+    }
+    case STATE_CONNECTED: {
+        if (this->heartbeatSent) {
+            // Nothing from the hub for a whole period after the Heartbeat-Request
+            this->fail();
+            return;
+        }
+        const WSVirtualDeviceSettings& settings = this->devices->GetSettings();
+        if (std::chrono::steady_clock::now() - this->lastReceived >= std::chrono::seconds(settings.heartbeatSeconds)) {
+            uint8_t request[BVLC_SC_FIXED_HEADER_LENGTH] = { BVLC_SC_FUNCTION_HEARTBEAT_REQUEST, 0, (uint8_t)(this->messageId >> 8), (uint8_t)this->messageId };
+            this->messageId++;
+            this->send(request, sizeof(request), WS_PRIORITY_CONTROL);
+            this->heartbeatSent = true;
+        }
+        this->armTimer(settings.heartbeatSeconds * 1000);
+        break;
+    }
+    case STATE_WAITING: {
+        // End of the reconnect delay
+        this->devices->Queue(shared_from_this());
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void WSVirtualDeviceSessionBase::fail() {
+    if (this->state == STATE_WAITING) {
+        return;
+    }
+    if (this->state == STATE_CONNECTED) {
+        this->devices->connectedCount--;
+        this->devices->disconnects++;
+    }
+    else {
+        this->devices->connectFailures++;
+        this->devices->OnConnectDone();
+    }
+
+    // Completions of this connection are ignored from here on
+    this->generation++;
+    this->state = STATE_WAITING;
+    beast::error_code ignored;
+    this->getTcpStream().socket().close(ignored);
+    // The frame being written stays alive until the next connect, its
+    // completion may still run
+    this->writeQueue.Clear();
+
+    // Between half and all of the delay, picked per device and attempt
+    uint32_t half = this->reconnectMilliseconds / 2;
+    uint32_t spread = (this->device->instance * 2654435761u + this->generation * 40503u) % (half + 1);
+    this->armTimer(half + spread);
+    this->reconnectMilliseconds = std::min(this->reconnectMilliseconds * 2, this->devices->GetSettings().reconnectMaxMilliseconds);
+}
+
+void WSVirtualDeviceSessionBase::onFrame(const uint8_t* frame, const size_t length) {
+    this->devices->framesReceived++;
+    this->lastReceived = std::chrono::steady_clock::now();
+    this->heartbeatSent = false;
+
+    WSHubFrameHeader header;
+    if (!WSHubFrameHeader::Parse(frame, length, &header)) {
+        return;
+    }
+
+    switch (header.function) {
+    case BVLC_SC_FUNCTION_CONNECT_ACCEPT: {
+        if (this->state == STATE_CONNECTING) {
+            this->state = STATE_CONNECTED;
+            this->devices->connectedCount++;
+            this->devices->OnConnectDone();
+            this->reconnectMilliseconds = this->devices->GetSettings().reconnectMinMilliseconds;
+            this->armTimer(this->devices->GetSettings().heartbeatSeconds * 1000);
+        }
+        break;
+    }
+    case BVLC_SC_FUNCTION_BVLC_RESULT: {
+        // A NAK of our Connect-Request, e.g. a duplicate VMAC
+        if (this->state == STATE_CONNECTING && header.payloadOffset + 2 <= length && frame[header.payloadOffset] == BVLC_SC_FUNCTION_CONNECT_REQUEST && frame[header.payloadOffset + 1] != 0) {
+            this->fail();
+        }
+        break;
+    }
+    case BVLC_SC_FUNCTION_HEARTBEAT_REQUEST: {
+        uint8_t ack[BVLC_SC_FIXED_HEADER_LENGTH] = { BVLC_SC_FUNCTION_HEARTBEAT_ACK, 0, frame[2], frame[3] };
+        this->send(ack, sizeof(ack), WS_PRIORITY_CONTROL);
+        break;
+    }
+    case BVLC_SC_FUNCTION_DISCONNECT_REQUEST: {
+        // Close once the Disconnect-ACK is written, then reconnect as after a failure
+        uint8_t ack[BVLC_SC_FIXED_HEADER_LENGTH] = { BVLC_SC_FUNCTION_DISCONNECT_ACK, 0, frame[2], frame[3] };
+        this->send(ack, sizeof(ack), WS_PRIORITY_CONTROL);
+        this->closeAfterWrite = true;
+        break;
+    }
+    case BVLC_SC_FUNCTION_ENCAPSULATED_NPDU: {
+        if (this->state == STATE_CONNECTED) {
+            this->onNpdu(header, frame, length);
+        }
+        break;
+    }
+    default:
+        // Heartbeat-ACK, Advertisement, etc.
+        break;
+    }
+}
+
+void WSVirtualDeviceSessionBase::onNpdu(const WSHubFrameHeader& header, const uint8_t* frame, const size_t length) {
+    size_t apduLength;
+    const uint8_t* apdu = header.GetApdu(frame, length, &apduLength);
+    if (apdu == NULL || apduLength < 2) {
+        return;
+    }
+
+    uint8_t reply[APDU_MAX_LENGTH];
+    uint8_t replyFrame[APDU_MAX_LENGTH + 64];
+    size_t replyLength = 0;
+    const uint8_t* destination = header.originatingVmac;
+    if (apdu[0] == (APDU_TYPE_UNCONFIRMED_REQUEST << 4) && apdu[1] == APDU_SERVICE_WHO_IS) {
+        // Who-Is for every device, or for a range of instances
+        ExampleApduReader reader(apdu, apduLength, 2);
+        uint32_t low = 0;
+        uint32_t high = APDU_MAX_INSTANCE;
+        if (!reader.IsEnd() && (!reader.ReadContextUnsigned(0, &low) || !reader.ReadContextUnsigned(1, &high))) {
+            return;
+        }
+        if (this->device->instance < low || this->device->instance > high) {
+            return;
+        }
+        replyLength = ExampleApdu::BuildIAm(reply, sizeof(reply), this->device->instance, APDU_MAX_LENGTH, this->devices->GetSettings().vendorId);
+        destination = NULL;
+    }
+    else if ((apdu[0] >> 4) == APDU_TYPE_CONFIRMED_REQUEST && destination != NULL) {
+        replyLength = this->answer(apdu, apduLength, reply, sizeof(reply));
+    }
+    if (replyLength == 0) {
+        return;
+    }
+
+    size_t frameLength = ExampleApdu::BuildFrame(replyFrame, sizeof(replyFrame), this->messageId++, destination, false, reply, replyLength);
+    if (frameLength > 0) {
+        // I-Am is bulk, answers to confirmed requests are not
+        this->send(replyFrame, frameLength, destination == NULL ? WS_PRIORITY_BULK : WS_PRIORITY_CONFIRMED);
+        this->devices->requestsAnswered++;
+    }
+}
+
+// ComplexAck, Error, Reject or Abort for a confirmed request, 0 if there is nothing to answer
+size_t WSVirtualDeviceSessionBase::answer(const uint8_t* apdu, const size_t apduLength, uint8_t* buffer, const size_t capacity) {
+    if (apduLength < 4 || capacity < 3) {
+        return 0;
+    }
+    const uint8_t invokeId = apdu[2];
+    const uint8_t service = apdu[3];
+    size_t maxApdu = std::min<size_t>(WSVirtualDeviceMaxApdu[apdu[1] & 0x0F], capacity);
+    if (apdu[0] & 0x08) {
+        // Segmented request
+        buffer[0] = (uint8_t)((APDU_TYPE_ABORT << 4) | 0x01);
+        buffer[1] = invokeId;
+        buffer[2] = APDU_ABORT_SEGMENTATION_NOT_SUPPORTED;
+        return 3;
+    }
+
+    ExampleApduReader reader(apdu, apduLength, 4);
+    ExampleApduWriter writer(buffer, maxApdu);
+    uint16_t objectType;
+    uint32_t objectInstance;
+    uint32_t property;
+    uint32_t errorCode;
+    ExampleApduTag tag;
+    if (service == APDU_SERVICE_READ_PROPERTY) {
+        if (!reader.ReadContextObjectIdentifier(0, &objectType, &objectInstance) || !reader.ReadContextUnsigned(1, &property)) {
+            return 0;
+        }
+        bool found;
+        if (!reader.IsEnd()) {
+            // Property array index, none of the properties served is an array
+            errorCode = APDU_ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY;
+            found = false;
+        }
+        else {
+            found = this->readProperty(objectType, objectInstance, property, NULL, &errorCode);
+        }
+        if (!found) {
+            ExampleApduWriter error(buffer, maxApdu);
+            error.Byte(APDU_TYPE_ERROR << 4);
+            error.Byte(invokeId);
+            error.Byte(service);
+            error.ApplicationEnumerated(errorCode == APDU_ERROR_CODE_UNKNOWN_OBJECT ? APDU_ERROR_CLASS_OBJECT : APDU_ERROR_CLASS_PROPERTY);
+            error.ApplicationEnumerated(errorCode);
+            return error.GetLength();
+        }
+        writer.Byte(APDU_TYPE_COMPLEX_ACK << 4);
+        writer.Byte(invokeId);
+        writer.Byte(service);
+        writer.ContextObjectIdentifier(0, objectType, objectInstance);
+        writer.ContextUnsigned(1, property);
+        writer.OpeningTag(3);
+        this->readProperty(objectType, objectInstance, property, &writer, &errorCode);
+        writer.ClosingTag(3);
+    }
+    else if (service == APDU_SERVICE_READ_PROPERTY_MULTIPLE) {
+        writer.Byte(APDU_TYPE_COMPLEX_ACK << 4);
+        writer.Byte(invokeId);
+        writer.Byte(service);
+        while (!reader.IsEnd()) {
+            if (!reader.ReadContextObjectIdentifier(0, &objectType, &objectInstance) || !reader.ReadOpeningTag(1)) {
+                return 0;
+            }
+            writer.ContextObjectIdentifier(0, objectType, objectInstance);
+            writer.OpeningTag(1);
+            while (!reader.IsClosingTag(1)) {
+                if (!reader.ReadContextUnsigned(0, &property)) {
+                    return 0;
+                }
+                writer.ContextUnsigned(2, property);
+                bool found;
+                if (reader.PeekTag(&tag) && tag.context && !tag.opening && !tag.closing && tag.number == 1) {
+                    // None of the properties served is an array
+                    uint32_t arrayIndex;
+                    if (!reader.ReadContextUnsigned(1, &arrayIndex)) {
+                        return 0;
+                    }
+                    writer.ContextUnsigned(3, arrayIndex);
+                    errorCode = APDU_ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY;
+                    found = false;
+                }
+                else {
+                    found = this->readProperty(objectType, objectInstance, property, NULL, &errorCode);
+                }
+                if (found) {
+                    writer.OpeningTag(4);
+                    this->readProperty(objectType, objectInstance, property, &writer, &errorCode);
+                    writer.ClosingTag(4);
+                }
+                else {
+                    writer.OpeningTag(5);
+                    writer.ApplicationEnumerated(errorCode == APDU_ERROR_CODE_UNKNOWN_OBJECT ? APDU_ERROR_CLASS_OBJECT : APDU_ERROR_CLASS_PROPERTY);
+                    writer.ApplicationEnumerated(errorCode);
+                    writer.ClosingTag(5);
+                }
+            }
+            reader.ReadClosingTag(1);
+            writer.ClosingTag(1);
+        }
+    }
+    else {
+        buffer[0] = APDU_TYPE_REJECT << 4;
+        buffer[1] = invokeId;
+        buffer[2] = APDU_REJECT_UNRECOGNIZED_SERVICE;
+        return 3;
+    }
+
+    if (writer.IsOverflow()) {
+        // Does not fit in the max APDU of the client, and there is no segmentation
+        buffer[0] = (uint8_t)((APDU_TYPE_ABORT << 4) | 0x01);
+        buffer[1] = invokeId;
+        buffer[2] = APDU_ABORT_SEGMENTATION_NOT_SUPPORTED;
+        return 3;
+    }
+    return writer.GetLength();
+}
+
+// Check a property exists, and when writer is not NULL write its value
+bool WSVirtualDeviceSessionBase::readProperty(const uint16_t objectType, const uint32_t objectInstance, const uint32_t property, ExampleApduWriter* writer, uint32_t* errorCode) {
+    bool isDevice = objectType == APDU_OBJECT_TYPE_DEVICE && objectInstance == this->device->instance;
+    bool isAnalogInput = objectType == APDU_OBJECT_TYPE_ANALOG_INPUT && objectInstance < this->device->analogInputCount;
+    if (!isDevice && !isAnalogInput) {
+        *errorCode = APDU_ERROR_CODE_UNKNOWN_OBJECT;
+        return false;
+    }
+    if (property == APDU_PROPERTY_OBJECT_IDENTIFIER) {
+        if (writer != NULL) {
+            writer->ApplicationObjectIdentifier(objectType, objectInstance);
+        }
+        return true;
+    }
+    if (isAnalogInput && property == APDU_PROPERTY_PRESENT_VALUE) {
+        if (writer != NULL) {
+            writer->ApplicationReal(this->device->presentValues[objectInstance].load(std::memory_order_relaxed));
+        }
+        return true;
+    }
+    *errorCode = APDU_ERROR_CODE_UNKNOWN_PROPERTY;
+    return false;
+}
+
+//
+// WSVirtualDeviceUnsecureSession
+// ----------------------------------------------------------------------------
+
+WSVirtualDeviceUnsecureSession::WSVirtualDeviceUnsecureSession(WSVirtualDevices* devices, const WSVirtualDevice* device, net::io_context& ioc)
+    : WSVirtualDeviceSessionBase(devices, device, ioc) {
+    this->open();
+}
+
+void WSVirtualDeviceUnsecureSession::open() {
+    this->ws.reset(new websocket::stream<beast::tcp_stream>(this->strand));
+    this->ws->read_message_max(BVLC_SC_MAX_BVLC_LENGTH);
+}
+
+beast::tcp_stream& WSVirtualDeviceUnsecureSession::getTcpStream() {
+    return beast::get_lowest_layer(*this->ws);
+}
+
+void WSVirtualDeviceUnsecureSession::asyncHandshake() {
+    // Ask for the BACnet/SC hub sub-protocol
+    this->ws->set_option(websocket::stream_base::decorator(
+        [](websocket::request_type& req) {
+            req.set(http::field::sec_websocket_protocol,
+                "hub.bsc.bacnet.org");
+        }));
+    this->ws->binary(true);
+    this->ws->async_handshake(this->devices->host, this->devices->path, beast::bind_front_handler(&WSVirtualDeviceSessionBase::onHandshake, shared_from_this(), this->generation));
+}
+
+void WSVirtualDeviceUnsecureSession::asyncRead() {
+    this->ws->async_read(this->buffer, beast::bind_front_handler(&WSVirtualDeviceSessionBase::onRead, shared_from_this(), this->generation));
+}
+
+void WSVirtualDeviceUnsecureSession::asyncWrite(const WSHubFrame& frame) {
+    this->ws->async_write(net::buffer(frame->data(), frame->size()), beast::bind_front_handler(&WSVirtualDeviceSessionBase::onWrite, shared_from_this(), this->generation));
+}
+
+//
+// WSVirtualDeviceSecureSession
+// ----------------------------------------------------------------------------
+
+WSVirtualDeviceSecureSession::WSVirtualDeviceSecureSession(WSVirtualDevices* devices, const WSVirtualDevice* device, net::io_context& ioc, ssl::context& ctx)
+    : WSVirtualDeviceSessionBase(devices, device, ioc)
+    , ctx(ctx) {
+    this->open();
+}
+
+void WSVirtualDeviceSecureSession::open() {
+    this->ws.reset(new websocket::stream<beast::ssl_stream<beast::tcp_stream>>(this->strand, this->ctx));
+    this->ws->read_message_max(BVLC_SC_MAX_BVLC_LENGTH);
+}
+
+beast::tcp_stream& WSVirtualDeviceSecureSession::getTcpStream() {
+    return beast::get_lowest_layer(*this->ws);
+}
+
+void WSVirtualDeviceSecureSession::asyncHandshake() {
+    // Set SNI Hostname (many hosts need this to handshake successfully)
+    if (!SSL_set_tlsext_host_name(this->ws->next_layer().native_handle(), this->devices->host.c_str())) {
+        this->fail();
+        return;
+    }
+    this->ws->next_layer().async_handshake(
+        ssl::stream_base::client,
+        beast::bind_front_handler(
+            &WSVirtualDeviceSecureSession::onSslHandshake,
+            std::static_pointer_cast<WSVirtualDeviceSecureSession>(shared_from_this()),
+            this->generation));
+}
+
+void WSVirtualDeviceSecureSession::onSslHandshake(const uint32_t generation, beast::error_code errorCode) {
+    if (generation != this->generation) {
+        return;
+    }
+    if (errorCode) {
+        this->fail();
+        return;
+    }
+
+    // Ask for the BACnet/SC hub sub-protocol
+    this->ws->set_option(websocket::stream_base::decorator(
+        [](websocket::request_type& req) {
+            req.set(http::field::sec_websocket_protocol,
+                "hub.bsc.bacnet.org");
+        }));
+    this->ws->binary(true);
+    this->ws->async_handshake(this->devices->host, this->devices->path, beast::bind_front_handler(&WSVirtualDeviceSessionBase::onHandshake, shared_from_this(), this->generation));
+}
+
+void WSVirtualDeviceSecureSession::asyncRead() {
+    this->ws->async_read(this->buffer, beast::bind_front_handler(&WSVirtualDeviceSessionBase::onRead, shared_from_this(), this->generation));
+}
+
+void WSVirtualDeviceSecureSession::asyncWrite(const WSHubFrame& frame) {
+    this->ws->async_write(net::buffer(frame->data(), frame->size()), beast::bind_front_handler(&WSVirtualDeviceSessionBase::onWrite, shared_from_this(), this->generation));
+}
+
+//
+// WSVirtualDevices
+// ----------------------------------------------------------------------------
+
+WSVirtualDevices::WSVirtualDevices()
+    : launcher(net::make_strand(ioc))
+    , launchTimer(launcher) {
+    this->secure = false;
+    this->connecting = 0;
+    this->launching = false;
+    this->connectedCount = 0;
+    this->connectsStarted = 0;
+    this->connectFailures = 0;
+    this->disconnects = 0;
+    this->framesReceived = 0;
+    this->framesSent = 0;
+    this->requestsAnswered = 0;
+    this->readPauses = 0;
+}
+
+WSVirtualDevices::~WSVirtualDevices() {
+    this->Stop();
+}
+
+size_t WSVirtualDevices::Add(const uint32_t instance, const uint8_t* vmac, const uint8_t* uuid, const uint32_t analogInputCount) {
+    std::unique_ptr<WSVirtualDevice> device(new WSVirtualDevice);
+    device->instance = instance;
+    memcpy(device->vmac, vmac, BVLC_SC_VMAC_LENGTH);
+    memcpy(device->uuid, uuid, BVLC_SC_UUID_LENGTH);
+    device->analogInputCount = analogInputCount;
+    device->presentValues.reset(new std::atomic<float>[analogInputCount]);
+    for (uint32_t object = 0; object < analogInputCount; object++) {
+        device->presentValues[object].store(0.0f, std::memory_order_relaxed);
+    }
+    this->devices.push_back(std::move(device));
+    return this->devices.size() - 1;
+}
+
+void WSVirtualDevices::SetPresentValue(const size_t position, const uint32_t object, const float value) {
+    const WSVirtualDevice& device = *this->devices[position];
+    if (object < device.analogInputCount) {
+        device.presentValues[object].store(value, std::memory_order_relaxed);
+    }
+}
+
+bool WSVirtualDevices::Start(const std::string& hubUri, const std::string& certFilename, const std::string& keyFilename) {
+    Uri uri = Uri::Parse(hubUri);
+    this->secure = uri.Protocol == "wss";
+    this->host = uri.Host;
+    this->path = uri.Path.empty() ? "/" : uri.Path;
+    std::string port = uri.Port.empty() ? (this->secure ? WEB_SOCKET_DEFAULT_PORT_SECURE : WEB_SOCKET_DEFAULT_PORT_NOT_SECURE) : uri.Port;
+
+    try {
+        if (this->secure) {
+            // One context, the certificate and key are loaded once for every device
+            this->ctx.set_options(boost::asio::ssl::context::default_workarounds |
+                boost::asio::ssl::context::no_sslv2 |
+                boost::asio::ssl::context::no_sslv3);
+            this->tlsSettings.Apply(this->ctx);
+            this->ctx.use_certificate_file(certFilename, ssl::context::pem);
+            this->ctx.use_private_key_file(keyFilename, ssl::context::pem);
+        }
+
+        // Resolved once, not once per device and reconnect
+        tcp::resolver resolver(this->ioc);
+        this->endpoints = resolver.resolve(this->host, port);
+    }
+    catch (std::exception const& e) {
+        std::cout << "Error: WSVirtualDevices::Start() - " << e.what() << std::endl;
+        return false;
+    }
+
+    for (const std::unique_ptr<WSVirtualDevice>& device : this->devices) {
+        std::shared_ptr<WSVirtualDeviceSessionBase> session;
+        if (this->secure) {
+            session = std::make_shared<WSVirtualDeviceSecureSession>(this, device.get(), this->ioc, this->ctx);
+        }
+        else {
+            session = std::make_shared<WSVirtualDeviceUnsecureSession>(this, device.get(), this->ioc);
+        }
+        this->sessions.push_back(session);
+        this->Queue(session);
+    }
+
+    for (uint32_t offset = 0; offset < std::max<uint32_t>(this->settings.threads, 1); offset++) {
+        this->threads.emplace_back([this] {
+            try {
+                this->ioc.run();
+            }
+            catch (std::exception& e) {
+                std::cout << "DEBUG: WSVirtualDevices ioc.run() EXCEPTION - " << e.what() << std::endl;
+            }
+        });
+    }
+    return true;
+}
+
+void WSVirtualDevices::Stop() {
+    if (this->threads.empty()) {
+        return;
+    }
+    this->ioc.stop();
+    for (std::thread& thread : this->threads) {
+        thread.join();
+    }
+    this->threads.clear();
+    // Closes every connection
+    this->sessions.clear();
+    this->launchQueue.clear();
+    this->connectedCount = 0;
+}
+
+void WSVirtualDevices::Queue(const std::shared_ptr<WSVirtualDeviceSessionBase>& session) {
+    net::post(this->launcher, [this, session] {
+        this->launchQueue.push_back(session);
+        if (!this->launching) {
+            this->launching = true;
+            this->launch();
+        }
+    });
+}
+
+void WSVirtualDevices::OnConnectDone() {
+    net::post(this->launcher, [this] {
+        this->connecting--;
+    });
+}
+
+// One connection start per interval, on the launcher strand
+void WSVirtualDevices::launch() {
+    if (this->launchQueue.empty()) {
+        this->launching = false;
+        return;
+    }
+    if (this->connecting < this->settings.maxConnecting) {
+        this->connecting++;
+        this->connectsStarted++;
+        this->launchQueue.front()->Connect();
+        this->launchQueue.pop_front();
+    }
+    this->launchTimer.expires_after(std::chrono::milliseconds(this->settings.connectIntervalMilliseconds));
+    this->launchTimer.async_wait([this](beast::error_code errorCode) {
+        if (!errorCode) {
+            this->launch();
+        }
+    });
+}
+
+void WSVirtualDevices::Print() {
+    std::cout << "Virtual devices: " << this->connectedCount << " of " << this->devices.size() << " connected, " << this->connectsStarted << " connects, ";
+    std::cout << this->connectFailures << " failed, " << this->disconnects << " lost, " << this->framesReceived << " frames in, " << this->framesSent << " out, ";
+    std::cout << this->requestsAnswered << " requests answered, " << this->readPauses << " read pauses" << std::endl;
+}
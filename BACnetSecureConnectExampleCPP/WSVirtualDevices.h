@@ -0,0 +1,224 @@
+#pragma once
+
+#include "WSHubFunction.h"
+#include "CASBACnetSCExampleApdu.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Settings shared by every virtual device of a WSVirtualDevices
+struct WSVirtualDeviceSettings {
+    uint32_t threads;                       // io_context threads shared by all the hub connections
+    uint32_t connectIntervalMilliseconds;   // Between two connection starts
+    uint32_t maxConnecting;                 // Connections between TCP connect and Connect-Accept at once
+    uint32_t connectTimeoutMilliseconds;    // From TCP connect to Connect-Accept
+    uint32_t reconnectMinMilliseconds;      // After a lost connection, doubled on each failure
+    uint32_t reconnectMaxMilliseconds;
+    uint32_t heartbeatSeconds;              // Heartbeat-Request after this long without a frame from the hub
+    uint32_t maxWriteQueueFrames;           // Replies waiting to be written before a device stops reading requests
+    uint16_t vendorId;                      // In the I-Am of the virtual devices
+
+    WSVirtualDeviceSettings() :
+        threads(2),
+        connectIntervalMilliseconds(10),
+        maxConnecting(16),
+        connectTimeoutMilliseconds(10000),
+        reconnectMinMilliseconds(1000),
+        reconnectMaxMilliseconds(60000),
+        heartbeatSeconds(300),
+        maxWriteQueueFrames(64),
+        vendorId(389) {}
+};
+
+// Identity and objects of one virtual device
+struct WSVirtualDevice {
+    uint32_t instance;
+    uint8_t vmac[BVLC_SC_VMAC_LENGTH];
+    uint8_t uuid[BVLC_SC_UUID_LENGTH];
+    uint32_t analogInputCount;
+    std::unique_ptr<std::atomic<float>[]> presentValues;    // Of Analog Input 0 to analogInputCount - 1, written from any thread
+};
+
+class WSVirtualDevices;
+
+//
+// WSVirtualDeviceSessionBase
+// ----------------------------------------------------------------------------
+// One virtual device and its connection to the hub. Everything but the
+// present values runs on the strand of the session, so sessions run in
+// parallel on the shared threads without locks. A lost connection is made
+// again through the connection starts of WSVirtualDevices.
+class WSVirtualDeviceSessionBase : public std::enable_shared_from_this<WSVirtualDeviceSessionBase> {
+public:
+    static const uint8_t STATE_WAITING = 0;         // For a connection start or a reconnect delay
+    static const uint8_t STATE_CONNECTING = 1;      // TCP connect to Connect-Accept
+    static const uint8_t STATE_CONNECTED = 2;
+
+protected:
+    WSVirtualDevices* devices;
+    net::strand<net::io_context::executor_type> strand;
+    net::steady_timer timer;                // Connect timeout, heartbeat or reconnect delay, by state
+    beast::flat_buffer buffer;
+    WSPriorityWriteQueue writeQueue;        // Heartbeats and Connect-Requests ahead of replies, replies ahead of I-Ams
+    WSHubFrame writing;                     // Taken from writeQueue, NULL when no write is pending
+    bool readPaused;                        // Until the write queue is down to half
+    bool closeAfterWrite;                   // Disconnect-ACK queued
+    uint32_t generation;                    // Of the connection, completions of an older one are ignored
+    uint16_t messageId;
+    uint32_t reconnectMilliseconds;
+    std::chrono::steady_clock::time_point lastReceived;
+    bool heartbeatSent;
+
+    // Stream specific operations
+    virtual void open() = 0;                // New stream for the next connection
+    virtual beast::tcp_stream& getTcpStream() = 0;
+    virtual void asyncHandshake() = 0;      // TLS, if any, and websocket handshake
+    virtual void asyncRead() = 0;
+    virtual void asyncWrite(const WSHubFrame& frame) = 0;
+
+    void connect();
+    void armTimer(const uint32_t milliseconds);
+    void fail();
+    void send(const uint8_t* frame, const size_t length, const uint8_t priority);
+    void writeNext();
+    void onFrame(const uint8_t* frame, const size_t length);
+    void onNpdu(const WSHubFrameHeader& header, const uint8_t* frame, const size_t length);
+    size_t answer(const uint8_t* apdu, const size_t apduLength, uint8_t* buffer, const size_t capacity);
+    bool readProperty(const uint16_t objectType, const uint32_t objectInstance, const uint32_t property, ExampleApduWriter* writer, uint32_t* errorCode);
+
+public:
+    // Completion handlers shared by both stream types
+    void onConnect(const uint32_t generation, beast::error_code errorCode, const tcp::endpoint& endpoint);
+    void onHandshake(const uint32_t generation, beast::error_code errorCode);
+    void onRead(const uint32_t generation, beast::error_code errorCode, std::size_t bytesRead);
+    void onWrite(const uint32_t generation, beast::error_code errorCode, std::size_t bytesWritten);
+    void onTimer(const uint32_t generation, beast::error_code errorCode);
+
+    const WSVirtualDevice* device;
+    uint8_t state;                          // STATE_*, session strand only
+
+    WSVirtualDeviceSessionBase(WSVirtualDevices* devices, const WSVirtualDevice* device, net::io_context& ioc);
+    virtual ~WSVirtualDeviceSessionBase() {}
+
+    // Any thread, the connect is started on the strand of the session
+    void Connect();
+};
+
+//
+// WSVirtualDeviceUnsecureSession
+// ----------------------------------------------------------------------------
+class WSVirtualDeviceUnsecureSession : public WSVirtualDeviceSessionBase {
+private:
+    std::unique_ptr<websocket::stream<beast::tcp_stream>> ws;
+
+    void open();
+    beast::tcp_stream& getTcpStream();
+    void asyncHandshake();
+    void asyncRead();
+    void asyncWrite(const WSHubFrame& frame);
+
+public:
+    WSVirtualDeviceUnsecureSession(WSVirtualDevices* devices, const WSVirtualDevice* device, net::io_context& ioc);
+};
+
+//
+// WSVirtualDeviceSecureSession
+// ----------------------------------------------------------------------------
+class WSVirtualDeviceSecureSession : public WSVirtualDeviceSessionBase {
+private:
+    ssl::context& ctx;
+    std::unique_ptr<websocket::stream<beast::ssl_stream<beast::tcp_stream>>> ws;
+
+    void open();
+    beast::tcp_stream& getTcpStream();
+    void asyncHandshake();
+    void onSslHandshake(const uint32_t generation, beast::error_code errorCode);
+    void asyncRead();
+    void asyncWrite(const WSHubFrame& frame);
+
+public:
+    WSVirtualDeviceSecureSession(WSVirtualDevices* devices, const WSVirtualDevice* device, net::io_context& ioc, ssl::context& ctx);
+};
+
+//
+// WSVirtualDevices
+// ----------------------------------------------------------------------------
+// Many virtual BACnet/SC devices in one process, e.g. the downstream
+// controllers of a gateway. Each device has its own instance, UUID, VMAC and
+// hub connection, and answers Who-Is, ReadProperty and ReadPropertyMultiple
+// for its Device object and its Analog Inputs by itself. The CAS BACnet Stack
+// is not involved: it has one UUID and one hub connector per process.
+//
+// All the connections share one io_context, its threads and one TLS context
+// (certificate and key loaded once). Connections are started one every
+// connectIntervalMilliseconds with at most maxConnecting in progress, the
+// first ones and the reconnects alike, so a hub restart is not answered by a
+// connect storm. The reconnect delay of a device doubles on each failure and
+// is spread between half and all of it.
+class WSVirtualDevices {
+private:
+    net::io_context ioc;
+    net::executor_work_guard<boost::asio::io_context::executor_type> iocWorkGuard = boost::asio::make_work_guard(ioc);
+    ssl::context ctx{ssl::context::tlsv13_client};
+    WSTlsSettings tlsSettings;
+    bool secure;
+    WSVirtualDeviceSettings settings;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WSVirtualDevice>> devices;
+    std::vector<std::shared_ptr<WSVirtualDeviceSessionBase>> sessions;     // One per device, from Start
+
+    // Connection starts, on the launcher strand
+    net::strand<net::io_context::executor_type> launcher;
+    net::steady_timer launchTimer;
+    std::deque<std::shared_ptr<WSVirtualDeviceSessionBase>> launchQueue;
+    uint32_t connecting;
+    bool launching;
+
+    void launch();
+
+public:
+    // Hub, resolved once in Start
+    std::string host;
+    std::string path;
+    tcp::resolver::results_type endpoints;
+
+    // Statistics, readable from any thread
+    std::atomic<size_t> connectedCount;
+    std::atomic<uint64_t> connectsStarted;
+    std::atomic<uint64_t> connectFailures;          // Before Connect-Accept
+    std::atomic<uint64_t> disconnects;              // After Connect-Accept
+    std::atomic<uint64_t> framesReceived;
+    std::atomic<uint64_t> framesSent;
+    std::atomic<uint64_t> requestsAnswered;         // Confirmed requests and Who-Is
+    std::atomic<uint64_t> readPauses;               // A device stopped reading until its replies were written
+
+    WSVirtualDevices();
+    ~WSVirtualDevices();
+
+    // Before Start
+    void SetSettings(const WSVirtualDeviceSettings& settings) { this->settings = settings; }
+    const WSVirtualDeviceSettings& GetSettings() const { return this->settings; }
+    // Before Start. Key exchange groups, cipher suites and signature algorithms, see WSTlsSettings.
+    void SetTlsSettings(const WSTlsSettings& settings) { this->tlsSettings = settings; }
+    // Add a device with analogInputCount Analog Inputs, returns its position
+    size_t Add(const uint32_t instance, const uint8_t* vmac, const uint8_t* uuid, const uint32_t analogInputCount);
+
+    // Connect every device to the hub. wss:// needs certFilename and keyFilename.
+    bool Start(const std::string& hubUri, const std::string& certFilename = "", const std::string& keyFilename = "");
+    void Stop();
+
+    size_t Size() const { return this->devices.size(); }
+    const WSVirtualDevice& Get(const size_t position) const { return *this->devices[position]; }
+    // Any thread, e.g. a field driver
+    void SetPresentValue(const size_t position, const uint32_t object, const float value);
+
+    // Called by sessions
+    ssl::context& GetContext() { return this->ctx; }
+    void Queue(const std::shared_ptr<WSVirtualDeviceSessionBase>& session);
+    void OnConnectDone();
+
+    void Print();
+};